@@ -17,6 +17,7 @@ package balloons
 import (
 	"fmt"
 	"path/filepath"
+	"time"
 
 	"github.com/containers/nri-plugins/pkg/utils/cpuset"
 	corev1 "k8s.io/api/core/v1"
@@ -49,6 +50,8 @@ const (
 	reservedBalloonDefName = "reserved"
 	// defaultBalloonDefName is the name in the default balloon definition.
 	defaultBalloonDefName = "default"
+	// freeZoneName is the name of the topology zone of CPUs in no balloon.
+	freeZoneName = "free"
 	// NoLimit value denotes no limit being set.
 	NoLimit = 0
 )
@@ -69,6 +72,9 @@ type balloons struct {
 	balloons           []*Balloon  // balloon instances: reserved, default and user-defined
 
 	cpuAllocator cpuallocator.CPUAllocator // CPU allocator used by the policy
+
+	cpuUsage    map[string]cpuUsageSample // last CPU usage samples of containers
+	loadSampled time.Time                 // time of the last load-based resizing
 }
 
 // Balloon contains attributes of a balloon instance
@@ -143,9 +149,10 @@ func CreateBalloonsPolicy(policyOptions *policy.BackendOptions) policy.Backend {
 		options:      policyOptions,
 		cch:          policyOptions.Cache,
 		cpuAllocator: cpuallocator.NewCPUAllocator(policyOptions.System),
+		cpuUsage:     make(map[string]cpuUsageSample),
 	}
 	log.Info("creating %s policy...", PolicyName)
-	if p.cpuTree, err = NewCpuTreeFromSystem(); err != nil {
+	if p.cpuTree, err = NewCpuTreeFromSys(policyOptions.System); err != nil {
 		log.Errorf("creating CPU topology tree failed: %s", err)
 	}
 	log.Debug("CPU topology: %s", p.cpuTree)
@@ -200,8 +207,131 @@ func (p *balloons) Description() string {
 // Start prepares this policy for accepting allocation/release requests.
 func (p *balloons) Start(add []cache.Container, del []cache.Container) error {
 	log.Info("%s policy started", PolicyName)
-	// reassign all containers
-	return p.Sync(p.cch.GetContainers(), del)
+	// Release stale and out-of-sync containers first, then put containers
+	// back in the balloons they are running in, reallocating the rest.
+	if err := p.Sync(nil, del); err != nil {
+		return err
+	}
+	return p.Sync(p.restoreBalloons(add), nil)
+}
+
+// restoreBalloons puts containers back in balloons with the CPUs they are
+// currently running on, recreating the balloons if necessary. This keeps
+// containers on their CPUs across restarts, even if no cache was restored.
+// Containers of the same balloon type running on the same CPUs end up in
+// the same balloon. Returns the containers which could not be restored,
+// to be allocated normally.
+func (p *balloons) restoreBalloons(containers []cache.Container) []cache.Container {
+	type group struct {
+		blnDef     *BalloonDef
+		cpus       cpuset.CPUSet
+		containers []cache.Container
+	}
+
+	var (
+		groups = []*group{}
+		byKey  = map[string]*group{}
+		rest   = []cache.Container{}
+	)
+
+	for _, c := range containers {
+		cpus, err := cpuset.Parse(c.GetCpusetCpus())
+		if err != nil || cpus.IsEmpty() {
+			rest = append(rest, c)
+			continue
+		}
+		blnDef, err := p.chooseBalloonDef(c)
+		if err != nil || !p.isRestorable(blnDef, cpus) {
+			rest = append(rest, c)
+			continue
+		}
+		key := blnDef.Name + "/" + cpus.String()
+		g, ok := byKey[key]
+		if !ok {
+			g = &group{blnDef: blnDef, cpus: cpus}
+			byKey[key] = g
+			groups = append(groups, g)
+		}
+		g.containers = append(g.containers, c)
+	}
+
+	for _, g := range groups {
+		bln, err := p.restoreBalloon(g.blnDef, g.cpus)
+		if err != nil {
+			log.Debug("not restoring balloon with CPUs %s: %v", g.cpus, err)
+			rest = append(rest, g.containers...)
+			continue
+		}
+		for _, c := range g.containers {
+			p.assignContainer(c, bln)
+		}
+	}
+
+	return rest
+}
+
+// isRestorable checks if a balloon of the given type could be running on
+// the given CPUs.
+func (p *balloons) isRestorable(blnDef *BalloonDef, cpus cpuset.CPUSet) bool {
+	switch {
+	case blnDef == p.reservedBalloonDef || cpus.Intersection(p.reserved).Size() > 0:
+		// Balloons on reserved CPUs are fixed, nothing to restore.
+		return false
+	case blnDef.ShareIdleCpusInSame != CPUTopologyLevelUndefined:
+		// The cpuset in effect includes idle CPUs shared with others.
+		return false
+	case blnDef.MaxCpus > NoLimit && cpus.Size() > blnDef.MaxCpus, cpus.Size() < blnDef.MinCpus:
+		return false
+	case !cpus.IsSubsetOf(p.allowed):
+		return false
+	}
+	return true
+}
+
+// restoreBalloon returns a balloon of the given type with the given CPUs.
+// An existing balloon with the same CPUs is returned if there is one.
+// Otherwise an empty balloon of the type, or a new one if there is none, is
+// moved to the CPUs, which must be free.
+func (p *balloons) restoreBalloon(blnDef *BalloonDef, cpus cpuset.CPUSet) (*Balloon, error) {
+	var empty *Balloon
+	for _, bln := range p.balloonsByDef(blnDef) {
+		if bln.Cpus.Equals(cpus) {
+			return bln, nil
+		}
+		if empty == nil && bln.ContainerCount() == 0 {
+			empty = bln
+		}
+	}
+
+	bln := empty
+	if bln == nil {
+		if !cpus.IsSubsetOf(p.freeCpus) {
+			return nil, balloonsError("CPUs %s are not free", cpus)
+		}
+		newBln, err := p.newBalloon(blnDef, false, cpus)
+		if err != nil {
+			return nil, err
+		}
+		p.balloons = append(p.balloons, newBln)
+		bln = newBln
+	}
+
+	if !cpus.IsSubsetOf(p.freeCpus.Union(bln.Cpus)) {
+		return nil, balloonsError("CPUs %s are not free", cpus)
+	}
+
+	returned := bln.Cpus.Difference(cpus)
+	claimed := cpus.Difference(bln.Cpus)
+	p.forgetCpuClass(bln)
+	p.freeCpus = p.freeCpus.Union(returned).Difference(claimed)
+	bln.Cpus = cpus
+	p.useCpuClass(bln)
+	p.updatePinning(p.shareIdleCpus(returned, claimed)...)
+	p.updatePinning(bln)
+
+	log.Info("restored balloon %s", bln)
+
+	return bln, nil
 }
 
 // Sync synchronizes the active policy state.
@@ -243,7 +373,7 @@ func (p *balloons) AllocateResources(c cache.Container) error {
 	// would mean no CPU pinning and balloon's containers would
 	// run on any CPUs.
 	if bln.AvailMilliCpus() < max(1, reqMilliCpus) {
-		p.resizeBalloon(bln, max(1, reqMilliCpus))
+		p.resizeBalloon(bln, max(1, reqMilliCpus), p.balloonHintCpus(bln, c))
 	}
 	p.assignContainer(c, bln)
 	if log.DebugEnabled() {
@@ -263,13 +393,13 @@ func (p *balloons) ReleaseResources(c cache.Container) error {
 		if bln.ContainerCount() == 0 {
 			// Deflate the balloon completely before
 			// freeing it.
-			p.resizeBalloon(bln, 0)
+			p.resizeBalloon(bln, 0, cpuset.New())
 			log.Debug("all containers removed, free balloon allocation %s", bln.PrettyName())
 			p.freeBalloon(bln)
 		} else {
 			// Make sure that the balloon will have at
 			// least 1 CPU to run remaining containers.
-			p.resizeBalloon(bln, max(1, p.requestedMilliCpus(bln)))
+			p.resizeBalloon(bln, max(1, p.requestedMilliCpus(bln)), p.balloonHintCpus(bln))
 		}
 	} else {
 		log.Debug("ReleaseResources: balloon-less container %s, nothing to release", c.PrettyName())
@@ -285,8 +415,8 @@ func (p *balloons) UpdateResources(c cache.Container) error {
 
 // Rebalance tries to find an optimal allocation of resources for the current containers.
 func (p *balloons) Rebalance() (bool, error) {
-	log.Debug("(not) rebalancing containers...")
-	return false, nil
+	log.Debug("rebalancing containers...")
+	return p.resizeBalloonsByLoad(), nil
 }
 
 // HandleEvent handles policy-specific events.
@@ -306,8 +436,71 @@ func (p *balloons) Introspect(*introspect.State) {
 }
 
 // GetTopologyZones returns the policy/pool data for 'topology zone' CRDs.
-func (b *balloons) GetTopologyZones() []*policy.TopologyZone {
-	return nil
+// Every balloon is exported as a zone with the CPUs it currently has, and
+// available CPU being what its containers don't request. CPUs balloons can
+// still be inflated with are exported once, in a separate zone, so that the
+// zones never add up to more CPU than there is.
+func (p *balloons) GetTopologyZones() []*policy.TopologyZone {
+	zones := make([]*policy.TopologyZone, 0, len(p.balloons)+1)
+
+	for _, bln := range p.balloons {
+		capacity := int64(bln.Cpus.Size() * 1000)
+		available := capacity - int64(p.requestedMilliCpus(bln))
+		if available < 0 {
+			available = 0
+		}
+
+		cpusAttribute := policy.ExclusiveCPUsAttribute
+		if bln.Cpus.Equals(p.reserved) {
+			cpusAttribute = policy.ReservedCPUsAttribute
+		}
+		attributes := []*policy.ZoneAttribute{
+			{
+				Name:  cpusAttribute,
+				Value: bln.Cpus.String(),
+			},
+			{
+				Name:  policy.MemsetAttribute,
+				Value: bln.Mems.String(),
+			},
+		}
+		if !bln.SharedIdleCpus.IsEmpty() {
+			attributes = append(attributes, &policy.ZoneAttribute{
+				Name:  policy.SharedCPUsAttribute,
+				Value: bln.SharedIdleCpus.String(),
+			})
+		}
+
+		zones = append(zones, &policy.TopologyZone{
+			Name: bln.PrettyName(),
+			Type: "balloon",
+			Resources: []*policy.ZoneResource{
+				{
+					Name:        policy.CPUResource,
+					Capacity:    *resapi.NewMilliQuantity(capacity, resapi.DecimalSI),
+					Allocatable: *resapi.NewMilliQuantity(capacity, resapi.DecimalSI),
+					Available:   *resapi.NewMilliQuantity(available, resapi.DecimalSI),
+				},
+			},
+			Attributes: attributes,
+		})
+	}
+
+	free := int64(p.freeCpus.Size() * 1000)
+	zones = append(zones, &policy.TopologyZone{
+		Name: freeZoneName,
+		Type: freeZoneName,
+		Resources: []*policy.ZoneResource{
+			{
+				Name:        policy.CPUResource,
+				Capacity:    *resapi.NewMilliQuantity(free, resapi.DecimalSI),
+				Allocatable: *resapi.NewMilliQuantity(free, resapi.DecimalSI),
+				Available:   *resapi.NewMilliQuantity(free, resapi.DecimalSI),
+			},
+		},
+	})
+
+	return zones
 }
 
 // balloonByContainer returns a balloon that contains a container.
@@ -460,22 +653,6 @@ func (p *balloons) maxFreeMilliCpus(bln *Balloon) int {
 	return bln.MaxAvailMilliCpus(p.freeCpus) - p.requestedMilliCpus(bln)
 }
 
-// largest helps finding the largest element and value in a slice.
-// Input the length of a slice and a function that returns the
-// magnitude of given element in the slice as int.
-func largest(sliceLen int, valueOf func(i int) int) (int, int) {
-	largestIndex := -1
-	largestValue := 0
-	for index := 0; index < sliceLen; index++ {
-		value := valueOf(index)
-		if largestIndex == -1 || value > largestValue {
-			largestIndex = index
-			largestValue = value
-		}
-	}
-	return largestIndex, largestValue
-}
-
 // resetCpuClass resets CPU configurations globally. All balloons can
 // be ignored, their CPU configurations will be applied later.
 func (p *balloons) resetCpuClass() error {
@@ -530,7 +707,9 @@ func (p *balloons) forgetCpuClass(bln *Balloon) {
 	log.Debugf("forgetCpuClass Cpus: %s; CpuClass: %s", bln.Cpus, bln.Def.CpuClass)
 }
 
-func (p *balloons) newBalloon(blnDef *BalloonDef, confCpus bool) (*Balloon, error) {
+// newBalloon creates a new balloon instance. If possible, its initial CPUs
+// are allocated from preferred ones.
+func (p *balloons) newBalloon(blnDef *BalloonDef, confCpus bool, prefer cpuset.CPUSet) (*Balloon, error) {
 	var cpus cpuset.CPUSet
 	var err error
 	blnsOfDef := p.balloonsByDef(blnDef)
@@ -559,7 +738,8 @@ func (p *balloons) newBalloon(blnDef *BalloonDef, confCpus bool) (*Balloon, erro
 		// So does the default balloon unless its CPU counts are tweaked.
 		cpus = p.reserved
 	} else {
-		addFromCpus, _, err := p.cpuTreeAllocator.ResizeCpus(cpuset.New(), p.freeCpus, blnDef.MinCpus)
+		freeCpus := preferCpus(p.freeCpus, prefer, blnDef.MinCpus)
+		addFromCpus, _, err := p.cpuTreeAllocator.ResizeCpus(cpuset.New(), freeCpus, blnDef.MinCpus)
 		if err != nil {
 			return nil, balloonsError("failed to choose a cpuset for allocating first %d CPUs from %#s", blnDef.MinCpus, p.freeCpus)
 		}
@@ -635,7 +815,7 @@ func (p *balloons) chooseBalloonInstance(blnDef *BalloonDef, fm FillMethod, c ca
 				return bln, nil
 			}
 		}
-		newBln, err := p.newBalloon(blnDef, false)
+		newBln, err := p.newBalloon(blnDef, false, p.hintCpus(c))
 		if err != nil {
 			if fm == FillNewBalloonMust {
 				return nil, err
@@ -716,24 +896,20 @@ func (p *balloons) chooseBalloonInstance(blnDef *BalloonDef, fm FillMethod, c ca
 	if len(balloons) == 0 {
 		return nil, nil
 	}
+	// Prefer balloons close to devices in the topology hints of the container.
+	hintCpus := p.hintCpus(c)
 	switch fm {
 	case FillBalanced:
 		// Are there balloons where the container would fit
 		// without inflating the balloon?
-		blnIdx, freeMilliCpus := largest(len(balloons), func(i int) int {
-			return p.freeMilliCpus(balloons[i])
-		})
-		if freeMilliCpus >= reqMilliCpus {
-			return balloons[blnIdx], nil
+		if bln := closestBalloon(balloons, hintCpus, reqMilliCpus, p.freeMilliCpus); bln != nil {
+			return bln, nil
 		}
 	case FillBalancedInflate:
 		// Are there balloons where the container would fit
 		// after inflating the balloon?
-		blnIdx, maxFreeMilliCpus := largest(len(balloons), func(i int) int {
-			return p.maxFreeMilliCpus(balloons[i])
-		})
-		if maxFreeMilliCpus >= reqMilliCpus {
-			return balloons[blnIdx], nil
+		if bln := closestBalloon(balloons, hintCpus, reqMilliCpus, p.maxFreeMilliCpus); bln != nil {
+			return bln, nil
 		}
 	default:
 		return nil, balloonsError("balloon type fill method not implemented: %s", fm)
@@ -903,6 +1079,183 @@ func changesCpuClasses(opts0, opts1 *BalloonsOptions) bool {
 	return false
 }
 
+// balloonDefsDiff describes how user-defined balloon definitions change
+// between two configurations which otherwise lead to the same balloons.
+type balloonDefsDiff struct {
+	// defs are the new balloon definitions, reusing the old instances
+	// of unchanged definitions.
+	defs []*BalloonDef
+	// cpuClasses are the new CPU classes of defs.
+	cpuClasses []string
+	// stale are old definitions which are removed or changed.
+	stale map[*BalloonDef]struct{}
+	// fresh are new definitions which are added or changed.
+	fresh []*BalloonDef
+}
+
+// diffBalloonDefs compares two balloons policy configurations at the
+// level of individual balloon definitions. It returns false if the
+// configurations differ in anything which could affect all balloons,
+// like global options or the reserved and default balloons.
+func diffBalloonDefs(opts0, opts1 *BalloonsOptions) (*balloonDefsDiff, bool) {
+	if opts0 == nil || opts1 == nil {
+		return nil, false
+	}
+
+	o0 := *opts0
+	o1 := *opts1
+	o0.IdleCpuClass, o0.BalloonDefs = "", nil
+	o1.IdleCpuClass, o1.BalloonDefs = "", nil
+	if utils.DumpJSON(o0) != utils.DumpJSON(o1) {
+		return nil, false
+	}
+
+	// sameDef compares two definitions, ignoring their CPU class.
+	sameDef := func(d0, d1 *BalloonDef) bool {
+		c0, c1 := *d0, *d1
+		c0.CpuClass, c1.CpuClass = "", ""
+		return utils.DumpJSON(c0) == utils.DumpJSON(c1)
+	}
+
+	oldDefs := map[string]*BalloonDef{}
+	for _, def := range opts0.BalloonDefs {
+		if _, ok := oldDefs[def.Name]; ok {
+			return nil, false
+		}
+		oldDefs[def.Name] = def
+	}
+
+	diff := &balloonDefsDiff{
+		stale: map[*BalloonDef]struct{}{},
+	}
+	newDefs := map[string]struct{}{}
+	for _, def := range opts1.BalloonDefs {
+		if _, ok := newDefs[def.Name]; ok {
+			return nil, false
+		}
+		newDefs[def.Name] = struct{}{}
+
+		old, ok := oldDefs[def.Name]
+		switch {
+		case ok && sameDef(old, def):
+			diff.defs = append(diff.defs, old)
+		case def.Name == reservedBalloonDefName || def.Name == defaultBalloonDefName:
+			return nil, false
+		default:
+			if ok {
+				diff.stale[old] = struct{}{}
+			}
+			diff.defs = append(diff.defs, def)
+			diff.fresh = append(diff.fresh, def)
+		}
+		diff.cpuClasses = append(diff.cpuClasses, def.CpuClass)
+	}
+
+	for name, def := range oldDefs {
+		if _, ok := newDefs[name]; ok {
+			continue
+		}
+		if name == reservedBalloonDefName || name == defaultBalloonDefName {
+			return nil, false
+		}
+		diff.stale[def] = struct{}{}
+	}
+
+	return diff, true
+}
+
+// reconfigureBalloons takes a new configuration into use by re-applying
+// only the balloon definitions which are changed and re-placing only the
+// containers which are affected by the change.
+func (p *balloons) reconfigureBalloons(bpoptions *BalloonsOptions, diff *balloonDefsDiff) error {
+	if err := p.validateConfig(bpoptions); err != nil {
+		return balloonsError("invalid configuration: %w", err)
+	}
+
+	// Update CPU classes of kept definitions in place, balloons refer to them.
+	cpuClasses := p.bpoptions.IdleCpuClass != bpoptions.IdleCpuClass
+	for i, def := range diff.defs {
+		if def.CpuClass != diff.cpuClasses[i] {
+			def.CpuClass = diff.cpuClasses[i]
+			cpuClasses = true
+		}
+		switch def.Name {
+		case reservedBalloonDefName:
+			p.reservedBalloonDef.CpuClass = def.CpuClass
+		case defaultBalloonDefName:
+			p.defaultBalloonDef.CpuClass = def.CpuClass
+		}
+	}
+
+	oldBalloons := map[*Balloon]struct{}{}
+	for _, bln := range p.balloons {
+		oldBalloons[bln] = struct{}{}
+	}
+	idleCpus := p.freeCpus
+
+	bpoptions.BalloonDefs = diff.defs
+	p.bpoptions = *bpoptions
+
+	// Collect containers in balloons of stale definitions, and containers
+	// which now match a different balloon definition.
+	affected := []cache.Container{}
+	for _, c := range p.cch.GetContainers() {
+		bln := p.balloonByContainer(c)
+		if bln != nil {
+			if _, ok := diff.stale[bln.Def]; !ok {
+				if def, err := p.chooseBalloonDef(c); err == nil && def.Name == bln.Def.Name {
+					continue
+				}
+			}
+		}
+		affected = append(affected, c)
+	}
+
+	for _, c := range affected {
+		if err := p.ReleaseResources(c); err != nil {
+			return err
+		}
+	}
+	for _, bln := range p.balloons {
+		if _, ok := diff.stale[bln.Def]; ok {
+			p.deleteBalloon(bln)
+		}
+	}
+	for _, def := range diff.fresh {
+		if err := p.applyBalloonDef(&p.balloons, def, &p.freeCpus); err != nil {
+			return err
+		}
+	}
+
+	if cpuClasses {
+		p.resetCpuClass()
+		for _, bln := range p.balloons {
+			p.useCpuClass(bln)
+		}
+	} else {
+		for _, bln := range p.balloons {
+			if _, ok := oldBalloons[bln]; !ok {
+				p.useCpuClass(bln)
+			}
+		}
+	}
+	p.updatePinning(p.shareIdleCpus(p.freeCpus, idleCpus.Difference(p.freeCpus))...)
+
+	log.Info("re-placing %d containers affected by the configuration change", len(affected))
+	for _, c := range affected {
+		if err := p.AllocateResources(c); err != nil {
+			log.Warnf("allocating resources after reconfiguration produced an error: %v", err)
+		}
+	}
+
+	log.Info("%s policy balloons:", PolicyName)
+	for blnIdx, bln := range p.balloons {
+		log.Info("- balloon %d: %s", blnIdx, bln)
+	}
+
+	return nil
+}
+
 // configNotify applies new configuration.
 func (p *balloons) configNotify(event pkgcfg.Event, source pkgcfg.Source) error {
 	log.Info("configuration %s", event)
@@ -929,6 +1282,16 @@ func (p *balloons) configNotify(event pkgcfg.Event, source pkgcfg.Source) error
 		}
 		return nil
 	}
+	if diff, ok := diffBalloonDefs(&p.bpoptions, newBalloonsOptions); ok {
+		log.Info("configuration changes in balloon definitions: %d stale, %d fresh", len(diff.stale), len(diff.fresh))
+		err := p.reconfigureBalloons(newBalloonsOptions, diff)
+		if err == nil {
+			log.Info("config updated successfully")
+			return nil
+		}
+		log.Error("partial config update failed, reconfiguring all balloons: %v", err)
+		newBalloonsOptions = balloonsOptions.DeepCopy()
+	}
 	if err := p.setConfig(newBalloonsOptions); err != nil {
 		log.Error("config update failed: %v", err)
 		return err
@@ -986,7 +1349,7 @@ func (p *balloons) applyBalloonDef(balloons *[]*Balloon, blnDef *BalloonDef, fre
 			// Overwrite existing default balloon instance
 			// that uses reserved CPUs with a balloon that
 			// uses its own CPUs.
-			newDefaultBln, err := p.newBalloon(p.defaultBalloonDef, false)
+			newDefaultBln, err := p.newBalloon(p.defaultBalloonDef, false, cpuset.New())
 			if err != nil {
 				return balloonsError("cannot create new default balloon: %w", err)
 			}
@@ -1000,7 +1363,7 @@ func (p *balloons) applyBalloonDef(balloons *[]*Balloon, blnDef *BalloonDef, fre
 				continue
 			}
 			for blnIdx := 0; blnIdx < blnDef.MinBalloons; blnIdx++ {
-				newBln, err := p.newBalloon(blnDef, false)
+				newBln, err := p.newBalloon(blnDef, false, cpuset.New())
 				if err != nil {
 					return err
 				}
@@ -1024,6 +1387,17 @@ func (p *balloons) validateConfig(bpoptions *BalloonsOptions) error {
 			return balloonsError("MinBalloons (%d) > MaxBalloons (%d) in balloon type %q",
 				blnDef.MinCpus, blnDef.MaxCpus, blnDef.Name)
 		}
+		if lr := blnDef.LoadResizing; lr != nil {
+			high, low := lr.highUtilization(), lr.lowUtilization()
+			if low < 0 || high > 100 || low >= high {
+				return balloonsError("invalid LoadResizing utilization limits (low %d%%, high %d%%) in balloon type %q",
+					low, high, blnDef.Name)
+			}
+			if lr.MaxStep < 0 {
+				return balloonsError("invalid LoadResizing MaxStep (%d) in balloon type %q",
+					lr.MaxStep, blnDef.Name)
+			}
+		}
 	}
 	return nil
 }
@@ -1057,12 +1431,12 @@ func (p *balloons) setConfig(bpoptions *BalloonsOptions) error {
 		topologyBalancing: bpoptions.AllocatorTopologyBalancing,
 	})
 	// Instantiate built-in reserved and default balloons.
-	reservedBalloon, err := p.newBalloon(p.reservedBalloonDef, false)
+	reservedBalloon, err := p.newBalloon(p.reservedBalloonDef, false, cpuset.New())
 	if err != nil {
 		return err
 	}
 	p.balloons = append(p.balloons, reservedBalloon)
-	defaultBalloon, err := p.newBalloon(p.defaultBalloonDef, false)
+	defaultBalloon, err := p.newBalloon(p.defaultBalloonDef, false, cpuset.New())
 	if err != nil {
 		return err
 	}
@@ -1136,8 +1510,10 @@ func (p *balloons) availableMilliCpus(balloon *Balloon) int64 {
 	return cpuAvail - cpuRequested
 }
 
-// resizeBalloon changes the CPUs allocated for a balloon, if allowed.
-func (p *balloons) resizeBalloon(bln *Balloon, newMilliCpus int) error {
+// resizeBalloon inflates or deflates a balloon, if allowed, to fit the given
+// CPU. When inflating, preferred CPUs are added if possible. When deflating,
+// other than preferred CPUs are removed if possible.
+func (p *balloons) resizeBalloon(bln *Balloon, newMilliCpus int, prefer cpuset.CPUSet) error {
 	if bln.Cpus.Equals(p.reserved) {
 		log.Debugf("not resizing %s to %d mCPU, using fixed CPUs", bln, newMilliCpus)
 		return nil
@@ -1161,7 +1537,8 @@ func (p *balloons) resizeBalloon(bln *Balloon, newMilliCpus int) error {
 	defer p.useCpuClass(bln)
 	if cpuCountDelta > 0 {
 		// Inflate the balloon.
-		addFromCpus, _, err := p.cpuTreeAllocator.ResizeCpus(bln.Cpus, p.freeCpus, cpuCountDelta)
+		freeCpus := preferCpus(p.freeCpus, prefer, cpuCountDelta)
+		addFromCpus, _, err := p.cpuTreeAllocator.ResizeCpus(bln.Cpus, freeCpus, cpuCountDelta)
 		if err != nil {
 			return balloonsError("resize/inflate: failed to choose a cpuset for allocating additional %d CPUs: %w", cpuCountDelta, err)
 		}
@@ -1175,7 +1552,8 @@ func (p *balloons) resizeBalloon(bln *Balloon, newMilliCpus int) error {
 		p.updatePinning(p.shareIdleCpus(p.freeCpus, newCpus)...)
 	} else {
 		// Deflate the balloon.
-		_, removeFromCpus, err := p.cpuTreeAllocator.ResizeCpus(bln.Cpus, p.freeCpus, cpuCountDelta)
+		currentCpus := preferCpus(bln.Cpus, bln.Cpus.Difference(prefer), -cpuCountDelta)
+		_, removeFromCpus, err := p.cpuTreeAllocator.ResizeCpus(currentCpus, p.freeCpus, cpuCountDelta)
 		if err != nil {
 			return balloonsError("resize/deflate: failed to choose a cpuset for releasing %d CPUs: %w", -cpuCountDelta, err)
 		}
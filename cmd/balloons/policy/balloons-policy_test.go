@@ -15,6 +15,7 @@
 package balloons
 
 import (
+	"strings"
 	"testing"
 )
 
@@ -94,3 +95,114 @@ func TestChangesBalloons(t *testing.T) {
 		})
 	}
 }
+
+func TestDiffBalloonDefs(t *testing.T) {
+	def := func(name string, minCpus int, cpuClass string) *BalloonDef {
+		return &BalloonDef{Name: name, MinCpus: minCpus, CpuClass: cpuClass}
+	}
+	pinned := false
+
+	old := &BalloonsOptions{
+		IdleCpuClass: "icc0",
+		BalloonDefs: []*BalloonDef{
+			def("reserved", 0, "rc0"),
+			def("a", 1, "c0"),
+			def("b", 2, "c0"),
+			def("c", 3, "c0"),
+		},
+	}
+	a, b, c := old.BalloonDefs[1], old.BalloonDefs[2], old.BalloonDefs[3]
+
+	tcases := []struct {
+		name  string
+		opts  *BalloonsOptions
+		ok    bool
+		kept  []*BalloonDef
+		stale []*BalloonDef
+		fresh []string
+	}{
+		{
+			name: "global option changed",
+			opts: &BalloonsOptions{PinCPU: &pinned, BalloonDefs: old.DeepCopy().BalloonDefs},
+		},
+		{
+			name: "reserved balloon changed",
+			opts: &BalloonsOptions{
+				BalloonDefs: []*BalloonDef{
+					{Name: "reserved", Namespaces: []string{"ns0"}}, def("a", 1, "c0"), def("b", 2, "c0"), def("c", 3, "c0"),
+				},
+			},
+		},
+		{
+			name: "duplicate balloon names",
+			opts: &BalloonsOptions{
+				BalloonDefs: []*BalloonDef{
+					def("reserved", 0, "rc0"), def("a", 1, "c0"), def("a", 2, "c0"),
+				},
+			},
+		},
+		{
+			name: "only CPU classes and idle CPU class changed",
+			opts: &BalloonsOptions{
+				IdleCpuClass: "icc1",
+				BalloonDefs: []*BalloonDef{
+					def("reserved", 0, "rc1"), def("a", 1, "c1"), def("b", 2, "c1"), def("c", 3, "c1"),
+				},
+			},
+			ok:   true,
+			kept: []*BalloonDef{old.BalloonDefs[0], a, b, c},
+		},
+		{
+			name: "balloons changed, added and removed",
+			opts: &BalloonsOptions{
+				BalloonDefs: []*BalloonDef{
+					def("reserved", 0, "rc0"), def("c", 3, "c0"), def("b", 4, "c0"), def("d", 1, "c0"),
+				},
+			},
+			ok:    true,
+			kept:  []*BalloonDef{old.BalloonDefs[0], c},
+			stale: []*BalloonDef{a, b},
+			fresh: []string{"b", "d"},
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			diff, ok := diffBalloonDefs(old, tc.opts)
+			if ok != tc.ok {
+				t.Fatalf("expected ok %v, got %v", tc.ok, ok)
+			}
+			if !ok {
+				return
+			}
+			for _, def := range tc.kept {
+				found := false
+				for _, d := range diff.defs {
+					found = found || d == def
+				}
+				if !found {
+					t.Errorf("expected balloon definition %q to be kept", def.Name)
+				}
+			}
+			if len(diff.stale) != len(tc.stale) {
+				t.Errorf("expected %d stale balloon definitions, got %d", len(tc.stale), len(diff.stale))
+			}
+			for _, def := range tc.stale {
+				if _, ok := diff.stale[def]; !ok {
+					t.Errorf("expected balloon definition %q to be stale", def.Name)
+				}
+			}
+			fresh := []string{}
+			for _, def := range diff.fresh {
+				fresh = append(fresh, def.Name)
+			}
+			if strings.Join(fresh, ",") != strings.Join(tc.fresh, ",") {
+				t.Errorf("expected fresh balloon definitions %v, got %v", tc.fresh, fresh)
+			}
+			for i, def := range tc.opts.BalloonDefs {
+				if diff.cpuClasses[i] != def.CpuClass {
+					t.Errorf("expected CPU class %q for %q, got %q", def.CpuClass, def.Name, diff.cpuClasses[i])
+				}
+			}
+		})
+	}
+}
@@ -18,7 +18,6 @@ import (
 	"encoding/json"
 	"errors"
 	"fmt"
-	"sort"
 	"strings"
 
 	system "github.com/containers/nri-plugins/pkg/sysfs"
@@ -33,6 +32,7 @@ const (
 	CPUTopologyLevelPackage
 	CPUTopologyLevelDie
 	CPUTopologyLevelNuma
+	CPUTopologyLevelL3Cache
 	CPUTopologyLevelCore
 	CPUTopologyLevelThread
 	CPUTopologyLevelCount
@@ -48,29 +48,29 @@ type cpuTreeNode struct {
 
 }
 
-// cpuTreeNodeAttributes contains various attributes of a CPU tree
-// node. When allocating or releasing CPUs, all CPU tree nodes in
-// which allocating/releasing could be possible are stored to the same
-// slice with these attributes. The attributes contain all necessary
-// information for comparing which nodes are the best choices for
-// allocating/releasing, thus traversing the tree is not needed in the
-// comparison phase.
-type cpuTreeNodeAttributes struct {
-	t                *cpuTreeNode
-	depth            int
-	currentCpus      cpuset.CPUSet
-	freeCpus         cpuset.CPUSet
-	currentCpuCount  int
-	currentCpuCounts []int
-	freeCpuCount     int
-	freeCpuCounts    []int
-}
-
 // cpuTreeAllocator allocates CPUs from the branch of a CPU tree
 // where the "root" node is the topmost CPU of the branch.
 type cpuTreeAllocator struct {
 	options cpuTreeAllocatorOptions
 	root    *cpuTreeNode
+	index   *cpuTreeIndex
+}
+
+// cpuTreeIndex is a flattened view of a CPU tree branch, precomputed
+// when the allocator is created. It contains all necessary information
+// for comparing which nodes are the best choices for allocating and
+// releasing CPUs. Per-node current and free CPU counts are calculated
+// once per resize and then updated incrementally as CPUs are moved,
+// thus neither traversing the tree nor intersecting CPU sets is needed
+// in the comparison phase.
+type cpuTreeIndex struct {
+	nodes    []*cpuTreeNode // nodes in depth-first order
+	depth    []int          // depth of each node
+	path     [][]int        // indices of the ancestors of each node and the node itself
+	skip     []int          // index of the first node after the subtree of each node
+	cpuNodes map[int][]int  // indices of the nodes containing each CPU
+	current  []int          // number of current CPUs in each node
+	free     []int          // number of free CPUs in each node
 }
 
 // cpuTreeAllocatorOptions contains parameters for the CPU allocator
@@ -98,6 +98,7 @@ var cpuTopologyLevelToString = map[CPUTopologyLevel]string{
 	CPUTopologyLevelPackage:   "package",
 	CPUTopologyLevelDie:       "die",
 	CPUTopologyLevelNuma:      "numa",
+	CPUTopologyLevelL3Cache:   "l3cache",
 	CPUTopologyLevelCore:      "core",
 	CPUTopologyLevelThread:    "thread",
 }
@@ -131,13 +132,6 @@ func (t *cpuTreeNode) String() string {
 	return fmt.Sprintf("%s%v", t.name, t.children)
 }
 
-// String returns cpuTreeNodeAttributes as a string.
-func (tna cpuTreeNodeAttributes) String() string {
-	return fmt.Sprintf("%s{%d,%v,%d,%d}", tna.t.name, tna.depth,
-		tna.currentCpuCounts,
-		tna.freeCpuCount, tna.freeCpuCounts)
-}
-
 // NewCpuTree returns a named CPU tree node.
 func NewCpuTree(name string) *cpuTreeNode {
 	return &cpuTreeNode{
@@ -219,6 +213,12 @@ func NewCpuTreeFromSystem() (*cpuTreeNode, error) {
 	if err != nil {
 		return nil, err
 	}
+	return NewCpuTreeFromSys(sys)
+}
+
+// NewCpuTreeFromSys returns the root node of the topology tree
+// constructed from the given system.
+func NewCpuTreeFromSys(sys system.System) (*cpuTreeNode, error) {
 	// TODO: split deep nested loops into functions
 	sysTree := NewCpuTree("system")
 	sysTree.level = CPUTopologyLevelSystem
@@ -236,14 +236,27 @@ func NewCpuTreeFromSystem() (*cpuTreeNode, error) {
 				nodeTree.level = CPUTopologyLevelNuma
 				dieTree.AddChild(nodeTree)
 				node := sys.Node(nodeID)
+				cacheTrees := map[int]*cpuTreeNode{}
 				for _, cpuID := range node.CPUSet().List() {
-					cpuTree := NewCpuTree(fmt.Sprintf("p%dd%dn%dcpu%d", packageID, dieID, nodeID, cpuID))
+					cpu := sys.CPU(cpuID)
+					// CPUs with unknown last level cache share a single one.
+					cacheID := int(cpu.L3CacheID())
+					if cacheID < 0 {
+						cacheID = 0
+					}
+					cacheTree, ok := cacheTrees[cacheID]
+					if !ok {
+						cacheTree = NewCpuTree(fmt.Sprintf("p%dd%dn%dl%d", packageID, dieID, nodeID, cacheID))
+						cacheTree.level = CPUTopologyLevelL3Cache
+						nodeTree.AddChild(cacheTree)
+						cacheTrees[cacheID] = cacheTree
+					}
+					cpuTree := NewCpuTree(fmt.Sprintf("p%dd%dn%dl%dcpu%d", packageID, dieID, nodeID, cacheID, cpuID))
 
 					cpuTree.level = CPUTopologyLevelCore
-					nodeTree.AddChild(cpuTree)
-					cpu := sys.CPU(cpuID)
+					cacheTree.AddChild(cpuTree)
 					for _, threadID := range cpu.ThreadCPUSet().List() {
-						threadTree := NewCpuTree(fmt.Sprintf("p%dd%dn%dcpu%dt%d", packageID, dieID, nodeID, cpuID, threadID))
+						threadTree := NewCpuTree(fmt.Sprintf("p%dd%dn%dl%dcpu%dt%d", packageID, dieID, nodeID, cacheID, cpuID, threadID))
 						threadTree.level = CPUTopologyLevelThread
 						cpuTree.AddChild(threadTree)
 						threadTree.AddCpus(cpuset.New(threadID))
@@ -255,139 +268,158 @@ func NewCpuTreeFromSystem() (*cpuTreeNode, error) {
 	return sysTree, nil
 }
 
-// ToAttributedSlice returns a CPU tree node and recursively all its
-// child nodes in a slice that contains nodes with their attributes
-// for allocation/releasing comparison.
-// - currentCpus is the set of CPUs that can be freed in coming operation
-// - freeCpus is the set of CPUs that can be allocated in coming operation
-// - filter(tna) returns false if the node can be ignored
-func (t *cpuTreeNode) ToAttributedSlice(
-	currentCpus, freeCpus cpuset.CPUSet,
-	filter func(*cpuTreeNodeAttributes) bool) []cpuTreeNodeAttributes {
-	tnas := []cpuTreeNodeAttributes{}
-	currentCpuCounts := []int{}
-	freeCpuCounts := []int{}
-	t.toAttributedSlice(currentCpus, freeCpus, filter, &tnas, 0, currentCpuCounts, freeCpuCounts)
-	return tnas
+// NewAllocator returns new CPU allocator for allocating CPUs from a
+// CPU tree branch.
+func (t *cpuTreeNode) NewAllocator(options cpuTreeAllocatorOptions) *cpuTreeAllocator {
+	ta := &cpuTreeAllocator{
+		root:    t,
+		options: options,
+		index:   t.newIndex(),
+	}
+	return ta
 }
 
-func (t *cpuTreeNode) toAttributedSlice(
-	currentCpus, freeCpus cpuset.CPUSet,
-	filter func(*cpuTreeNodeAttributes) bool,
-	tnas *[]cpuTreeNodeAttributes,
-	depth int,
-	currentCpuCounts []int,
-	freeCpuCounts []int) {
-	currentCpusHere := t.cpus.Intersection(currentCpus)
-	freeCpusHere := t.cpus.Intersection(freeCpus)
-	currentCpuCountHere := currentCpusHere.Size()
-	currentCpuCountsHere := make([]int, len(currentCpuCounts)+1, len(currentCpuCounts)+1)
-	copy(currentCpuCountsHere, currentCpuCounts)
-	currentCpuCountsHere[depth] = currentCpuCountHere
-
-	freeCpuCountHere := freeCpusHere.Size()
-	freeCpuCountsHere := make([]int, len(freeCpuCounts)+1, len(freeCpuCounts)+1)
-	copy(freeCpuCountsHere, freeCpuCounts)
-	freeCpuCountsHere[depth] = freeCpuCountHere
-
-	tna := cpuTreeNodeAttributes{
-		t:                t,
-		depth:            depth,
-		currentCpus:      currentCpusHere,
-		freeCpus:         freeCpusHere,
-		currentCpuCount:  currentCpuCountHere,
-		currentCpuCounts: currentCpuCountsHere,
-		freeCpuCount:     freeCpuCountHere,
-		freeCpuCounts:    freeCpuCountsHere,
+// newIndex creates an allocator index for a CPU tree branch.
+func (t *cpuTreeNode) newIndex() *cpuTreeIndex {
+	idx := &cpuTreeIndex{
+		cpuNodes: make(map[int][]int),
 	}
+	idx.add(t, 0, nil)
+	idx.current = make([]int, len(idx.nodes))
+	idx.free = make([]int, len(idx.nodes))
+	return idx
+}
 
-	if filter != nil && !filter(&tna) {
-		return
+func (idx *cpuTreeIndex) add(t *cpuTreeNode, depth int, parentPath []int) {
+	i := len(idx.nodes)
+	path := make([]int, len(parentPath)+1)
+	copy(path, parentPath)
+	path[depth] = i
+
+	idx.nodes = append(idx.nodes, t)
+	idx.depth = append(idx.depth, depth)
+	idx.path = append(idx.path, path)
+	idx.skip = append(idx.skip, 0)
+	for _, cpu := range t.cpus.UnsortedList() {
+		idx.cpuNodes[cpu] = append(idx.cpuNodes[cpu], i)
 	}
 
-	*tnas = append(*tnas, tna)
 	for _, child := range t.children {
-		child.toAttributedSlice(currentCpus, freeCpus, filter,
-			tnas, depth+1, currentCpuCountsHere, freeCpuCountsHere)
+		idx.add(child, depth+1, path)
 	}
+	idx.skip[i] = len(idx.nodes)
 }
 
-// NewAllocator returns new CPU allocator for allocating CPUs from a
-// CPU tree branch.
-func (t *cpuTreeNode) NewAllocator(options cpuTreeAllocatorOptions) *cpuTreeAllocator {
-	ta := &cpuTreeAllocator{
-		root:    t,
-		options: options,
+// reset recalculates current and free CPU counts of all nodes.
+func (idx *cpuTreeIndex) reset(currentCpus, freeCpus cpuset.CPUSet) {
+	for i := range idx.nodes {
+		idx.current[i] = 0
+		idx.free[i] = 0
+	}
+	for _, cpu := range currentCpus.UnsortedList() {
+		for _, i := range idx.cpuNodes[cpu] {
+			idx.current[i]++
+		}
+	}
+	for _, cpu := range freeCpus.UnsortedList() {
+		for _, i := range idx.cpuNodes[cpu] {
+			idx.free[i]++
+		}
 	}
-	return ta
 }
 
-// sorterAllocate implements an "is-less-than" callback that helps
-// sorting a slice of cpuTreeNodeAttributes. The first item in the
-// sorted list contains an optimal CPU tree node for allocating new
-// CPUs.
-func (ta *cpuTreeAllocator) sorterAllocate(tnas []cpuTreeNodeAttributes) func(int, int) bool {
-	return func(i, j int) bool {
-		if tnas[i].depth != tnas[j].depth {
-			return tnas[i].depth > tnas[j].depth
-		}
-		for tdepth := 0; tdepth < len(tnas[i].currentCpuCounts); tdepth += 1 {
-			// After this currentCpus will increase.
-			// Maximize the maximal amount of currentCpus
-			// as high level in the topology as possible.
-			if tnas[i].currentCpuCounts[tdepth] != tnas[j].currentCpuCounts[tdepth] {
-				return tnas[i].currentCpuCounts[tdepth] > tnas[j].currentCpuCounts[tdepth]
-			}
+// release updates node CPU counts for moving a CPU from current to free.
+func (idx *cpuTreeIndex) release(cpu int) {
+	for _, i := range idx.cpuNodes[cpu] {
+		idx.current[i]--
+		idx.free[i]++
+	}
+}
+
+// best returns the index of the best node for allocating delta CPUs
+// (if positive) or releasing -delta CPUs (if negative), or -1 if none
+// of the nodes has enough CPUs.
+func (ta *cpuTreeAllocator) best(delta int) int {
+	idx := ta.index
+	best := -1
+	for i := 0; i < len(idx.nodes); {
+		// skip branches with insufficient cpus
+		if (delta > 0 && idx.free[i] < delta) || (delta < 0 && idx.current[i] < -delta) {
+			i = idx.skip[i]
+			continue
 		}
-		for tdepth := 0; tdepth < len(tnas[i].freeCpuCounts); tdepth += 1 {
-			// After this freeCpus will decrease.
-			if tnas[i].freeCpuCounts[tdepth] != tnas[j].freeCpuCounts[tdepth] {
-				if ta.options.topologyBalancing {
-					// Goal: minimize maximal freeCpus in topology.
-					return tnas[i].freeCpuCounts[tdepth] > tnas[j].freeCpuCounts[tdepth]
-				} else {
-					// Goal: maximize maximal freeCpus in topology.
-					return tnas[i].freeCpuCounts[tdepth] < tnas[j].freeCpuCounts[tdepth]
-				}
-			}
+		switch {
+		case best < 0:
+			best = i
+		case delta > 0 && ta.allocateBefore(i, best):
+			best = i
+		case delta < 0 && ta.releaseBefore(i, best):
+			best = i
 		}
-		return tnas[i].t.name < tnas[j].t.name
+		i++
 	}
+	return best
 }
 
-// sorterRelease implements an "is-less-than" callback that helps
-// sorting a slice of cpuTreeNodeAttributes. The first item in the
-// list contains an optimal CPU tree node for releasing new CPUs.
-func (ta *cpuTreeAllocator) sorterRelease(tnas []cpuTreeNodeAttributes) func(int, int) bool {
-	return func(i, j int) bool {
-		if tnas[i].depth != tnas[j].depth {
-			return tnas[i].depth > tnas[j].depth
+// allocateBefore returns true if node i is a better choice than node
+// j for allocating new CPUs.
+func (ta *cpuTreeAllocator) allocateBefore(i, j int) bool {
+	idx := ta.index
+	if idx.depth[i] != idx.depth[j] {
+		return idx.depth[i] > idx.depth[j]
+	}
+	pi, pj := idx.path[i], idx.path[j]
+	for tdepth := range pi {
+		// After this currentCpus will increase.
+		// Maximize the maximal amount of currentCpus
+		// as high level in the topology as possible.
+		if ci, cj := idx.current[pi[tdepth]], idx.current[pj[tdepth]]; ci != cj {
+			return ci > cj
 		}
-		for tdepth := 0; tdepth < len(tnas[i].currentCpuCounts); tdepth += 1 {
-			// After this currentCpus will decrease. Aim
-			// to minimize the minimal amount of
-			// currentCpus in order to decrease
-			// fragmentation as high level in the topology
-			// as possible.
-			if tnas[i].currentCpuCounts[tdepth] != tnas[j].currentCpuCounts[tdepth] {
-				return tnas[i].currentCpuCounts[tdepth] < tnas[j].currentCpuCounts[tdepth]
+	}
+	for tdepth := range pi {
+		// After this freeCpus will decrease.
+		if fi, fj := idx.free[pi[tdepth]], idx.free[pj[tdepth]]; fi != fj {
+			if ta.options.topologyBalancing {
+				// Goal: minimize maximal freeCpus in topology.
+				return fi > fj
+			} else {
+				// Goal: maximize maximal freeCpus in topology.
+				return fi < fj
 			}
 		}
-		for tdepth := 0; tdepth < len(tnas[i].freeCpuCounts); tdepth += 1 {
-			// After this freeCpus will increase. Try to
-			// maximize minimal free CPUs for better
-			// isolation as high level in the topology as
-			// possible.
-			if tnas[i].freeCpuCounts[tdepth] != tnas[j].freeCpuCounts[tdepth] {
-				if ta.options.topologyBalancing {
-					return tnas[i].freeCpuCounts[tdepth] < tnas[j].freeCpuCounts[tdepth]
-				} else {
-					return tnas[i].freeCpuCounts[tdepth] < tnas[j].freeCpuCounts[tdepth]
-				}
-			}
+	}
+	return idx.nodes[i].name < idx.nodes[j].name
+}
+
+// releaseBefore returns true if node i is a better choice than node
+// j for releasing CPUs.
+func (ta *cpuTreeAllocator) releaseBefore(i, j int) bool {
+	idx := ta.index
+	if idx.depth[i] != idx.depth[j] {
+		return idx.depth[i] > idx.depth[j]
+	}
+	pi, pj := idx.path[i], idx.path[j]
+	for tdepth := range pi {
+		// After this currentCpus will decrease. Aim
+		// to minimize the minimal amount of
+		// currentCpus in order to decrease
+		// fragmentation as high level in the topology
+		// as possible.
+		if ci, cj := idx.current[pi[tdepth]], idx.current[pj[tdepth]]; ci != cj {
+			return ci < cj
+		}
+	}
+	for tdepth := range pi {
+		// After this freeCpus will increase. Try to
+		// maximize minimal free CPUs for better
+		// isolation as high level in the topology as
+		// possible.
+		if fi, fj := idx.free[pi[tdepth]], idx.free[pj[tdepth]]; fi != fj {
+			return fi < fj
 		}
-		return tnas[i].t.name > tnas[j].t.name
 	}
+	return idx.nodes[i].name > idx.nodes[j].name
 }
 
 // ResizeCpus implements topology awareness to both adding CPUs to and
@@ -407,62 +439,56 @@ func (ta *cpuTreeAllocator) sorterRelease(tnas []cpuTreeNodeAttributes) func(int
 //     these CPUs.
 //   - removeFromCpus contains CPUs in currentCpus set from which
 //     abs(delta) CPUs can be freed.
+//
+// ResizeCpus is not safe for concurrent use.
 func (ta *cpuTreeAllocator) ResizeCpus(currentCpus, freeCpus cpuset.CPUSet, delta int) (cpuset.CPUSet, cpuset.CPUSet, error) {
+	if delta == 0 {
+		return cpuset.New(), cpuset.New(), nil
+	}
+
+	ta.index.reset(currentCpus, freeCpus)
+
 	if delta > 0 {
-		return ta.resizeCpus(currentCpus, freeCpus, delta)
+		best := ta.best(delta)
+		if best < 0 {
+			return freeCpus, currentCpus, fmt.Errorf("not enough free CPUs")
+		}
+		t := ta.index.nodes[best]
+		return t.cpus.Intersection(freeCpus), t.cpus.Intersection(currentCpus), nil
 	}
+
 	// In multi-CPU removal, remove CPUs one by one instead of
 	// trying to find a single topology element from which all of
 	// them could be removed.
 	removeFrom := cpuset.New()
 	addFrom := cpuset.New()
 	for n := 0; n < -delta; n++ {
-		_, removeSingleFrom, err := ta.resizeCpus(currentCpus, freeCpus, -1)
-		if err != nil {
-			return addFrom, removeFrom, err
+		best := ta.best(-1)
+		if best < 0 {
+			return addFrom, removeFrom, fmt.Errorf("not enough free CPUs")
 		}
+		t := ta.index.nodes[best]
 		// Make cheap internal error checks in order to capture
 		// issues in alternative algorithms.
-		if removeSingleFrom.Size() != 1 {
+		if ta.index.current[best] != 1 {
 			return addFrom, removeFrom, fmt.Errorf("internal error: failed to find single cpu to free, "+
 				"currentCpus=%s freeCpus=%s expectedSingle=%s",
-				currentCpus, freeCpus, removeSingleFrom)
+				currentCpus, freeCpus, t.cpus.Intersection(currentCpus).Difference(removeFrom))
+		}
+		cpu := -1
+		for _, c := range t.cpus.UnsortedList() {
+			if currentCpus.Contains(c) && !removeFrom.Contains(c) {
+				cpu = c
+				break
+			}
 		}
-		if removeFrom.Union(removeSingleFrom).Size() != n+1 {
+		if cpu < 0 {
 			return addFrom, removeFrom, fmt.Errorf("internal error: double release of a cpu, "+
 				"currentCpus=%s freeCpus=%s alreadyRemoved=%s removedNow=%s",
-				currentCpus, freeCpus, removeFrom, removeSingleFrom)
+				currentCpus, freeCpus, removeFrom, t.cpus.Intersection(currentCpus))
 		}
-		removeFrom = removeFrom.Union(removeSingleFrom)
-		currentCpus = currentCpus.Difference(removeSingleFrom)
-		freeCpus = freeCpus.Union(removeSingleFrom)
+		removeFrom = removeFrom.Union(cpuset.New(cpu))
+		ta.index.release(cpu)
 	}
 	return addFrom, removeFrom, nil
 }
-
-func (ta *cpuTreeAllocator) resizeCpus(currentCpus, freeCpus cpuset.CPUSet, delta int) (cpuset.CPUSet, cpuset.CPUSet, error) {
-	tnas := ta.root.ToAttributedSlice(currentCpus, freeCpus,
-		func(tna *cpuTreeNodeAttributes) bool {
-			// filter out branches with insufficient cpus
-			if delta > 0 && tna.freeCpuCount-delta < 0 {
-				// cannot allocate delta cpus
-				return false
-			}
-			if delta < 0 && tna.currentCpuCount+delta < 0 {
-				// cannot release delta cpus
-				return false
-			}
-			return true
-		})
-
-	// Sort based on attributes
-	if delta > 0 {
-		sort.Slice(tnas, ta.sorterAllocate(tnas))
-	} else {
-		sort.Slice(tnas, ta.sorterRelease(tnas))
-	}
-	if len(tnas) == 0 {
-		return freeCpus, currentCpus, fmt.Errorf("not enough free CPUs")
-	}
-	return tnas[0].freeCpus, tnas[0].currentCpus, nil
-}
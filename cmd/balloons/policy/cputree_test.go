@@ -583,12 +583,12 @@ func TestCpuLocations(t *testing.T) {
 	cpus := cpuset.New(0, 1, 3, 4, 16)
 	systemlocations := tree.CpuLocations(cpus)
 	package1locations := tree.children[1].CpuLocations(cpus)
-	if len(package1locations) != 5 {
-		t.Errorf("expected package1locations length 5, got %d", len(package1locations))
+	if len(package1locations) != 6 {
+		t.Errorf("expected package1locations length 6, got %d", len(package1locations))
 		return
 	}
-	if len(systemlocations) != 6 {
-		t.Errorf("expected systemlocations length 6, got %d", len(systemlocations))
+	if len(systemlocations) != 7 {
+		t.Errorf("expected systemlocations length 7, got %d", len(systemlocations))
 		return
 	}
 	if systemlocations[0][0] != "system" {
@@ -599,8 +599,8 @@ func TestCpuLocations(t *testing.T) {
 		t.Errorf("expected 'system' location, got %q", systemlocations[1][0])
 		return
 	}
-	if len(systemlocations[4]) != 4 {
-		t.Errorf("expected len(systemlocations[4]) 4, got %d", len(systemlocations[4]))
+	if len(systemlocations[5]) != 4 {
+		t.Errorf("expected len(systemlocations[5]) 4, got %d", len(systemlocations[5]))
 		return
 	}
 }
@@ -647,3 +647,41 @@ func TestCPUTopologyLevel(t *testing.T) {
 	}
 
 }
+
+func BenchmarkResizeCpus(b *testing.B) {
+	bcases := []struct {
+		name     string
+		topology [5]int // package, die, numa, core, thread count
+		current  int    // number of CPUs in currentCpus
+		delta    int
+	}{
+		{"32cpus/inflate-4", [5]int{2, 2, 2, 2, 2}, 8, 4},
+		{"32cpus/deflate-4", [5]int{2, 2, 2, 2, 2}, 8, -4},
+		{"512cpus/inflate-32", [5]int{4, 2, 2, 16, 2}, 64, 32},
+		{"512cpus/deflate-32", [5]int{4, 2, 2, 16, 2}, 64, -32},
+		{"1024cpus/inflate-64", [5]int{8, 1, 4, 16, 2}, 128, 64},
+		{"1024cpus/deflate-64", [5]int{8, 1, 4, 16, 2}, 128, -64},
+	}
+	for _, bc := range bcases {
+		b.Run(bc.name, func(b *testing.B) {
+			tree, csit := newCpuTreeFromInt5(bc.topology)
+			allocator := tree.NewAllocator(cpuTreeAllocatorOptions{})
+			currentCpus := cpuset.New()
+			freeCpus := cpuset.New()
+			for cpuID := 0; cpuID < len(csit); cpuID++ {
+				// spread current CPUs over the whole topology
+				if cpuID%(len(csit)/bc.current) == 0 {
+					currentCpus = currentCpus.Union(cpuset.New(cpuID))
+				} else {
+					freeCpus = freeCpus.Union(cpuset.New(cpuID))
+				}
+			}
+			b.ResetTimer()
+			for n := 0; n < b.N; n++ {
+				if _, _, err := allocator.ResizeCpus(currentCpus, freeCpus, bc.delta); err != nil {
+					b.Fatalf("resize failed: %v", err)
+				}
+			}
+		})
+	}
+}
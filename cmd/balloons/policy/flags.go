@@ -103,8 +103,33 @@ type BalloonDef struct {
 	// workloads to run on those (shared) CPUs in addition to the
 	// (dedicated) CPUs of the balloon.
 	ShareIdleCpusInSame CPUTopologyLevel `json:"ShareIdleCPUsInSame,omitempty"`
+	// LoadResizing, if set, enables periodically inflating and
+	// deflating balloons of this type based on the actual CPU
+	// usage of their containers.
+	LoadResizing *LoadResizing `json:"LoadResizing,omitempty"`
 }
 
+// LoadResizing controls resizing balloons based on CPU usage.
+type LoadResizing struct {
+	// HighUtilization is the CPU utilization of a balloon, in
+	// percentage of its CPUs, above which it is inflated. The
+	// default is 80.
+	HighUtilization int `json:"HighUtilization,omitempty"`
+	// LowUtilization is the CPU utilization of a balloon, in
+	// percentage of its CPUs, below which it is deflated. The
+	// default is 40.
+	LowUtilization int `json:"LowUtilization,omitempty"`
+	// MaxStep is the maximum number of CPUs a balloon is inflated
+	// or deflated by in a single rebalancing. The default, 0,
+	// means no limit.
+	MaxStep int `json:"MaxStep,omitempty"`
+}
+
+const (
+	defaultHighUtilization = 80
+	defaultLowUtilization  = 40
+)
+
 var defaultPinCPU bool = true
 var defaultPinMemory bool = true
 
@@ -130,6 +155,10 @@ func (bdef *BalloonDef) DeepCopy() *BalloonDef {
 	outBdef := *bdef
 	outBdef.Namespaces = make([]string, len(bdef.Namespaces))
 	copy(outBdef.Namespaces, bdef.Namespaces)
+	if bdef.LoadResizing != nil {
+		lr := *bdef.LoadResizing
+		outBdef.LoadResizing = &lr
+	}
 	return &outBdef
 }
 
@@ -0,0 +1,132 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package balloons
+
+import (
+	"strconv"
+	"strings"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+	"github.com/containers/nri-plugins/pkg/topology"
+	"github.com/containers/nri-plugins/pkg/utils/cpuset"
+	idset "github.com/intel/goresctrl/pkg/utils"
+)
+
+// hintCpus returns the allowed CPUs close to the devices in the topology
+// hints of the given containers.
+func (p *balloons) hintCpus(containers ...cache.Container) cpuset.CPUSet {
+	cpus := cpuset.New()
+	for _, c := range containers {
+		for _, hint := range c.GetTopologyHints() {
+			cpus = cpus.Union(p.cpusOfHint(hint))
+		}
+	}
+	return cpus.Intersection(p.allowed)
+}
+
+// balloonHintCpus returns the CPUs close to the devices of the containers
+// in a balloon and of the given extra containers.
+func (p *balloons) balloonHintCpus(bln *Balloon, extra ...cache.Container) cpuset.CPUSet {
+	containers := extra
+	for _, cID := range bln.ContainerIDs() {
+		if c, ok := p.cch.LookupContainer(cID); ok {
+			containers = append(containers, c)
+		}
+	}
+	return p.hintCpus(containers...)
+}
+
+// cpusOfHint returns the CPUs of a hint, preferring CPUs, then NUMA nodes,
+// then sockets.
+func (p *balloons) cpusOfHint(h topology.Hint) cpuset.CPUSet {
+	sys := p.options.System
+	cpus := cpuset.New()
+
+	switch {
+	case h.CPUs != "":
+		hCpus, err := cpuset.Parse(h.CPUs)
+		if err != nil {
+			log.Warnf("invalid hint CPUs '%s' from %s", h.CPUs, h.Provider)
+			break
+		}
+		cpus = hCpus
+
+	case h.NUMAs != "":
+		for _, idstr := range strings.Split(h.NUMAs, ",") {
+			id, err := strconv.ParseInt(idstr, 0, 0)
+			if err != nil {
+				log.Warnf("invalid hint NUMA node '%s' from %s", idstr, h.Provider)
+				continue
+			}
+			if node := sys.Node(idset.ID(id)); node != nil {
+				cpus = cpus.Union(node.CPUSet())
+			}
+		}
+
+	case h.Sockets != "":
+		for _, idstr := range strings.Split(h.Sockets, ",") {
+			id, err := strconv.ParseInt(idstr, 0, 0)
+			if err != nil {
+				log.Warnf("invalid hint socket '%s' from %s", idstr, h.Provider)
+				continue
+			}
+			if pkg := sys.Package(idset.ID(id)); pkg != nil {
+				cpus = cpus.Union(pkg.CPUSet())
+			}
+		}
+	}
+
+	return cpus
+}
+
+// hintScore returns the share of CPUs of a balloon which are close to hinted
+// devices, in permille.
+func hintScore(bln *Balloon, hintCpus cpuset.CPUSet) int {
+	if hintCpus.IsEmpty() || bln.Cpus.IsEmpty() {
+		return 0
+	}
+	return 1000 * bln.Cpus.Intersection(hintCpus).Size() / bln.Cpus.Size()
+}
+
+// closestBalloon returns the balloon with at least reqMilliCpus free, which
+// has the most CPUs close to hinted devices. Ties are broken by the most
+// free CPU. Returns nil if no balloon has enough free CPU.
+func closestBalloon(balloons []*Balloon, hintCpus cpuset.CPUSet, reqMilliCpus int, freeMilliCpus func(*Balloon) int) *Balloon {
+	var (
+		best      *Balloon
+		bestScore int
+		bestFree  int
+	)
+	for _, bln := range balloons {
+		free := freeMilliCpus(bln)
+		if free < reqMilliCpus {
+			continue
+		}
+		score := hintScore(bln, hintCpus)
+		if best == nil || score > bestScore || (score == bestScore && free > bestFree) {
+			best, bestScore, bestFree = bln, score, free
+		}
+	}
+	return best
+}
+
+// preferCpus returns the preferred subset of CPUs, if it has at least
+// count CPUs, otherwise all CPUs.
+func preferCpus(cpus, preferred cpuset.CPUSet, count int) cpuset.CPUSet {
+	if subset := cpus.Intersection(preferred); !preferred.IsEmpty() && subset.Size() >= count {
+		return subset
+	}
+	return cpus
+}
@@ -0,0 +1,157 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package balloons
+
+import (
+	"testing"
+
+	policy "github.com/containers/nri-plugins/pkg/resmgr/policy"
+	"github.com/containers/nri-plugins/pkg/utils/cpuset"
+	idset "github.com/intel/goresctrl/pkg/utils"
+)
+
+func TestClosestBalloon(t *testing.T) {
+	def := &BalloonDef{Name: "nic"}
+	near := &Balloon{Def: def, Instance: 0, Cpus: cpuset.New(0, 1, 2, 3)}
+	far := &Balloon{Def: def, Instance: 1, Cpus: cpuset.New(8, 9, 10, 11, 12, 13)}
+	balloons := []*Balloon{far, near}
+	free := func(bln *Balloon) int { return bln.AvailMilliCpus() }
+
+	tcases := []struct {
+		name     string
+		hintCpus cpuset.CPUSet
+		req      int
+		expected *Balloon
+	}{
+		{
+			name:     "no hints, most free CPU wins",
+			hintCpus: cpuset.New(),
+			req:      1000,
+			expected: far,
+		},
+		{
+			name:     "closest to hinted devices wins",
+			hintCpus: cpuset.New(0, 1, 2, 3, 4, 5, 6, 7),
+			req:      1000,
+			expected: near,
+		},
+		{
+			name:     "closest one too small",
+			hintCpus: cpuset.New(0, 1, 2, 3, 4, 5, 6, 7),
+			req:      5000,
+			expected: far,
+		},
+		{
+			name:     "none fits",
+			hintCpus: cpuset.New(0, 1, 2, 3, 4, 5, 6, 7),
+			req:      7000,
+			expected: nil,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			if bln := closestBalloon(balloons, tc.hintCpus, tc.req, free); bln != tc.expected {
+				t.Errorf("expected balloon %v, got %v", tc.expected, bln)
+			}
+		})
+	}
+}
+
+func TestPreferCpus(t *testing.T) {
+	cpus := cpuset.New(0, 1, 2, 3, 4, 5)
+	if got := preferCpus(cpus, cpuset.New(4, 5, 6), 2); !got.Equals(cpuset.New(4, 5)) {
+		t.Errorf("expected preferred CPUs 4-5, got %s", got)
+	}
+	if got := preferCpus(cpus, cpuset.New(4, 5, 6), 3); !got.Equals(cpus) {
+		t.Errorf("expected all CPUs %s, got %s", cpus, got)
+	}
+	if got := preferCpus(cpus, cpuset.New(), 1); !got.Equals(cpus) {
+		t.Errorf("expected all CPUs %s, got %s", cpus, got)
+	}
+}
+
+func TestGetTopologyZones(t *testing.T) {
+	reserved := cpuset.New(0)
+	p := &balloons{
+		reserved: reserved,
+		freeCpus: cpuset.New(4, 5, 6, 7),
+		balloons: []*Balloon{
+			{
+				Def:            &BalloonDef{Name: reservedBalloonDefName},
+				Cpus:           reserved,
+				Mems:           idset.NewIDSet(0),
+				SharedIdleCpus: cpuset.New(),
+			},
+			{
+				Def:            &BalloonDef{Name: "limited", MaxCpus: 4},
+				Cpus:           cpuset.New(1, 2),
+				Mems:           idset.NewIDSet(0),
+				SharedIdleCpus: cpuset.New(4, 5, 6, 7),
+			},
+			{
+				Def:            &BalloonDef{Name: "unlimited"},
+				Cpus:           cpuset.New(3),
+				Mems:           idset.NewIDSet(0),
+				SharedIdleCpus: cpuset.New(),
+			},
+		},
+	}
+
+	zones := p.GetTopologyZones()
+	if len(zones) != 4 {
+		t.Fatalf("expected 4 zones, got %d", len(zones))
+	}
+
+	expected := []struct {
+		name     string
+		capacity int64
+		cpus     string
+	}{
+		{"reserved[0]", 1000, policy.ReservedCPUsAttribute},
+		{"limited[0]", 2000, policy.ExclusiveCPUsAttribute},
+		{"unlimited[0]", 1000, policy.ExclusiveCPUsAttribute},
+	}
+	for i, e := range expected {
+		zone := zones[i]
+		if zone.Name != e.name {
+			t.Errorf("expected zone %s, got %s", e.name, zone.Name)
+		}
+		cpu := zone.Resources[0]
+		if cpu.Capacity.MilliValue() != e.capacity || cpu.Available.MilliValue() != e.capacity {
+			t.Errorf("%s: expected %d mCPU capacity and available, got %s, %s",
+				zone.Name, e.capacity, cpu.Capacity.String(), cpu.Available.String())
+		}
+		if zone.Attributes[0].Name != e.cpus {
+			t.Errorf("%s: expected attribute %q, got %q", zone.Name, e.cpus, zone.Attributes[0].Name)
+		}
+	}
+	if n := len(zones[1].Attributes); n != 3 || zones[1].Attributes[2].Value != "4-7" {
+		t.Errorf("expected shared idle CPUs attribute in %s", zones[1].Name)
+	}
+
+	// Free CPUs are exported once, so zones add up to the CPUs we have.
+	free := zones[3]
+	if free.Name != freeZoneName || free.Resources[0].Capacity.MilliValue() != 4000 {
+		t.Errorf("expected zone %s with 4000 mCPU, got %s with %s",
+			freeZoneName, free.Name, free.Resources[0].Capacity.String())
+	}
+	total := int64(0)
+	for _, zone := range zones {
+		total += zone.Resources[0].Capacity.MilliValue()
+	}
+	if total != 8000 {
+		t.Errorf("expected zones to add up to 8000 mCPU, got %d", total)
+	}
+}
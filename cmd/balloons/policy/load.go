@@ -0,0 +1,205 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package balloons
+
+import (
+	"sort"
+	"time"
+
+	"github.com/containers/nri-plugins/pkg/cgroups"
+)
+
+// cpuUsageSample is a sample of the cumulative CPU usage of a container.
+type cpuUsageSample struct {
+	usage time.Duration // total CPU time consumed
+	taken time.Time     // time the sample was taken
+}
+
+// loadResize is a planned load-based resizing of a balloon.
+type loadResize struct {
+	bln     *Balloon
+	oldCpus int
+	newCpus int
+}
+
+// Functions used to sample CPU usage, overridable for testing.
+var (
+	getCPUUsage = cgroups.GetCPUUsage
+	timeNow     = time.Now
+)
+
+func (lr *LoadResizing) highUtilization() int {
+	if lr.HighUtilization == 0 {
+		return defaultHighUtilization
+	}
+	return lr.HighUtilization
+}
+
+func (lr *LoadResizing) lowUtilization() int {
+	if lr.LowUtilization == 0 {
+		return defaultLowUtilization
+	}
+	return lr.LowUtilization
+}
+
+// targetCpus calculates the number of CPUs for a balloon of cpus CPUs,
+// its containers using usedMilliCpus in total. The size is left intact
+// while utilization stays between the low and high limits. Otherwise
+// the balloon is resized to bring utilization halfway between them.
+func (lr *LoadResizing) targetCpus(cpus, usedMilliCpus int) int {
+	high, low := lr.highUtilization(), lr.lowUtilization()
+	if cpus > 0 {
+		utilization := 100 * usedMilliCpus / (1000 * cpus)
+		if utilization >= low && utilization <= high {
+			return cpus
+		}
+	}
+
+	mid := (high + low) / 2
+	target := (100*usedMilliCpus + 1000*mid - 1) / (1000 * mid)
+	if target < 1 {
+		target = 1
+	}
+	if lr.MaxStep > 0 {
+		if target > cpus+lr.MaxStep {
+			target = cpus + lr.MaxStep
+		}
+		if target < cpus-lr.MaxStep {
+			target = cpus - lr.MaxStep
+		}
+	}
+	return target
+}
+
+// sampleCpuUsage returns the CPU usage of the containers in a balloon
+// since the previous sample, in milli-CPUs, and updates the samples.
+// It returns false if there is no previous sample to compare against.
+// Containers with shared samples available from the resource manager
+// are not sampled separately.
+func (p *balloons) sampleCpuUsage(bln *Balloon, now time.Time, seen map[string]struct{}) (int, bool) {
+	var (
+		used    float64
+		sampled bool
+		window  time.Duration
+	)
+
+	if !p.loadSampled.IsZero() {
+		window = now.Sub(p.loadSampled)
+	}
+
+	for _, cID := range bln.ContainerIDs() {
+		if shared, ok := p.options.Sampler.CPUUsage(cID, window); ok {
+			used += float64(shared)
+			sampled = true
+			continue
+		}
+
+		c, ok := p.cch.LookupContainer(cID)
+		if !ok {
+			continue
+		}
+		dir := c.GetCgroupDir()
+		if dir == "" {
+			continue
+		}
+		usage, err := getCPUUsage(dir)
+		if err != nil {
+			log.Debug("failed to read CPU usage of %s: %v", c.PrettyName(), err)
+			continue
+		}
+
+		seen[cID] = struct{}{}
+		prev, ok := p.cpuUsage[cID]
+		p.cpuUsage[cID] = cpuUsageSample{usage: usage, taken: now}
+		if !ok || !now.After(prev.taken) || usage < prev.usage {
+			continue
+		}
+
+		elapsed := now.Sub(prev.taken)
+		used += 1000 * float64(usage-prev.usage) / float64(elapsed)
+		sampled = true
+	}
+
+	return int(used + 0.5), sampled
+}
+
+// resizeBalloonsByLoad resizes balloons with LoadResizing enabled to
+// fit the actual CPU usage of their containers. Balloons are never
+// deflated below the total CPU requests of their containers, nor
+// resized beyond their MinCpus and MaxCpus limits. Returns true if
+// any balloon was resized.
+func (p *balloons) resizeBalloonsByLoad() bool {
+	var (
+		now     = timeNow()
+		seen    = make(map[string]struct{})
+		resizes []loadResize
+	)
+
+	for _, bln := range p.balloons {
+		lr := bln.Def.LoadResizing
+		if lr == nil || bln.ContainerCount() == 0 || bln.Cpus.Equals(p.reserved) {
+			continue
+		}
+		used, ok := p.sampleCpuUsage(bln, now, seen)
+		if !ok {
+			continue
+		}
+
+		oldCpus := bln.Cpus.Size()
+		newCpus := lr.targetCpus(oldCpus, used)
+		if minCpus := (max(1, p.requestedMilliCpus(bln)) + 999) / 1000; newCpus < minCpus {
+			newCpus = minCpus
+		}
+		if newCpus != oldCpus {
+			log.Debug("%s: CPU usage %d mCPU on %d CPUs, resizing to %d CPUs",
+				bln.PrettyName(), used, oldCpus, newCpus)
+			resizes = append(resizes, loadResize{bln: bln, oldCpus: oldCpus, newCpus: newCpus})
+		}
+	}
+
+	for cID := range p.cpuUsage {
+		if _, ok := seen[cID]; !ok {
+			delete(p.cpuUsage, cID)
+		}
+	}
+	p.loadSampled = now
+
+	// Deflate first, to make released CPUs available for inflating.
+	sort.SliceStable(resizes, func(i, j int) bool {
+		return resizes[i].newCpus-resizes[i].oldCpus < resizes[j].newCpus-resizes[j].oldCpus
+	})
+
+	changed := false
+	for _, r := range resizes {
+		newCpus := r.newCpus
+		if free := p.freeCpus.Size(); newCpus > r.oldCpus+free {
+			newCpus = r.oldCpus + free
+		}
+		if newCpus == r.oldCpus {
+			continue
+		}
+		if err := p.resizeBalloon(r.bln, 1000*newCpus, p.balloonHintCpus(r.bln)); err != nil {
+			log.Error("failed to resize %s by load: %v", r.bln.PrettyName(), err)
+			continue
+		}
+		if r.bln.Cpus.Size() != r.oldCpus {
+			log.Info("resized %s by load from %d to %d CPUs",
+				r.bln.PrettyName(), r.oldCpus, r.bln.Cpus.Size())
+			changed = true
+		}
+	}
+
+	return changed
+}
@@ -0,0 +1,88 @@
+// Copyright 2022 Intel Corporation. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package balloons
+
+import (
+	"testing"
+)
+
+func TestLoadResizingTargetCpus(t *testing.T) {
+	tcases := []struct {
+		name     string
+		lr       LoadResizing
+		cpus     int
+		used     int
+		expected int
+	}{
+		{
+			name:     "within limits",
+			cpus:     4,
+			used:     2500,
+			expected: 4,
+		},
+		{
+			name:     "at high limit",
+			cpus:     4,
+			used:     3200,
+			expected: 4,
+		},
+		{
+			name:     "over high limit",
+			cpus:     2,
+			used:     1900,
+			expected: 4,
+		},
+		{
+			name:     "under low limit",
+			cpus:     8,
+			used:     1000,
+			expected: 2,
+		},
+		{
+			name:     "idle",
+			cpus:     4,
+			used:     0,
+			expected: 1,
+		},
+		{
+			name:     "limited inflate step",
+			lr:       LoadResizing{MaxStep: 1},
+			cpus:     2,
+			used:     1900,
+			expected: 3,
+		},
+		{
+			name:     "limited deflate step",
+			lr:       LoadResizing{MaxStep: 2},
+			cpus:     8,
+			used:     1000,
+			expected: 6,
+		},
+		{
+			name:     "custom limits",
+			lr:       LoadResizing{HighUtilization: 95, LowUtilization: 85},
+			cpus:     4,
+			used:     3000,
+			expected: 4,
+		},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			if got := tc.lr.targetCpus(tc.cpus, tc.used); got != tc.expected {
+				t.Errorf("expected %d CPUs, got %d", tc.expected, got)
+			}
+		})
+	}
+}
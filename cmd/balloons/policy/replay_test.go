@@ -0,0 +1,39 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package balloons
+
+import (
+	"path"
+	"testing"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/nritrace/replaytest"
+)
+
+var replayOptions = replaytest.Options{
+	Reserved: "1",
+	Fixture:  path.Join("..", "..", "topology-aware", "policy", "testdata", "sysfs.tar.bz2"),
+}
+
+func TestReplayTrace(t *testing.T) {
+	replaytest.TestReplay(t, CreateBalloonsPolicy, replayOptions)
+}
+
+func BenchmarkReplayTrace(b *testing.B) {
+	replaytest.BenchmarkReplay(b, CreateBalloonsPolicy, replayOptions)
+}
+
+func BenchmarkReplaySynthetic(b *testing.B) {
+	replaytest.BenchmarkReplaySynthetic(b, CreateBalloonsPolicy, replayOptions)
+}
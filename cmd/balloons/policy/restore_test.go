@@ -0,0 +1,132 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package balloons
+
+import (
+	"fmt"
+	"testing"
+
+	"github.com/containerd/nri/pkg/api"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+	"github.com/containers/nri-plugins/pkg/resmgr/nritrace"
+	"github.com/containers/nri-plugins/pkg/resmgr/policy"
+	system "github.com/containers/nri-plugins/pkg/sysfs"
+	"github.com/containers/nri-plugins/pkg/testutils"
+	"github.com/containers/nri-plugins/pkg/utils/cpuset"
+)
+
+func TestRestoreBalloons(t *testing.T) {
+	root, err := testutils.GenerateSysfs(t.TempDir(), testutils.Sysfs32CPUs)
+	if err != nil {
+		t.Fatalf("%v", err)
+	}
+	sys, err := system.DiscoverSystemAt(root)
+	if err != nil {
+		t.Fatalf("failed to discover synthetic system: %v", err)
+	}
+	cch, err := cache.NewCache(cache.Options{CacheDir: t.TempDir(), Ephemeral: true})
+	if err != nil {
+		t.Fatalf("failed to create cache: %v", err)
+	}
+
+	p := CreateBalloonsPolicy(&policy.BackendOptions{
+		Cache:  cch,
+		System: sys,
+		Reserved: policy.ConstraintSet{
+			policy.DomainCPU: cpuset.New(0),
+		},
+	}).(*balloons)
+	err = p.setConfig(&BalloonsOptions{
+		BalloonDefs: []*BalloonDef{
+			{
+				Name:        "dynamic",
+				Namespaces:  []string{"*"},
+				MinBalloons: 1,
+				MaxCpus:     8,
+			},
+		},
+	})
+	if err != nil {
+		t.Fatalf("failed to configure policy: %v", err)
+	}
+
+	// Containers found running after a restart with an ephemeral cache.
+	pods := []*api.PodSandbox{}
+	ctrs := []*api.Container{}
+	for i, cpus := range []string{"4-7", "4-7", "10-11", "0-31"} {
+		pod := &api.PodSandbox{
+			Id:        fmt.Sprintf("pod%d", i),
+			Uid:       fmt.Sprintf("pod%d-uid", i),
+			Name:      fmt.Sprintf("pod%d", i),
+			Namespace: "default",
+		}
+		pods = append(pods, pod)
+		ctrs = append(ctrs, &api.Container{
+			Id:           fmt.Sprintf("ctr%d", i),
+			PodSandboxId: pod.Id,
+			Name:         fmt.Sprintf("ctr%d", i),
+			State:        api.ContainerState_CONTAINER_RUNNING,
+			Linux: &api.LinuxContainer{
+				Resources: &api.LinuxResources{
+					Cpu: &api.LinuxCPU{
+						Cpus:   cpus,
+						Shares: &api.OptionalUInt64{Value: 1024},
+					},
+				},
+			},
+		})
+	}
+
+	r := nritrace.NewReplayer(cch, p)
+	for _, res := range r.Replay([]*nritrace.Event{{Event: nritrace.Synchronize, Pods: pods, Containers: ctrs}}) {
+		if res.Err != nil {
+			t.Fatalf("%s failed: %v", res.Event, res.Err)
+		}
+	}
+
+	balloonOf := func(id string) *Balloon {
+		t.Helper()
+		c, ok := cch.LookupContainer(id)
+		if !ok {
+			t.Fatalf("container %s not found", id)
+		}
+		bln := p.balloonByContainer(c)
+		if bln == nil {
+			t.Fatalf("container %s not in any balloon", id)
+		}
+		return bln
+	}
+
+	// Containers running on the same CPUs share a balloon with those CPUs.
+	bln0, bln1, bln2 := balloonOf("ctr0"), balloonOf("ctr1"), balloonOf("ctr2")
+	if bln0 != bln1 {
+		t.Errorf("expected ctr0 and ctr1 in the same balloon, got %s and %s", bln0, bln1)
+	}
+	if !cpuset.New(4, 5, 6, 7).IsSubsetOf(bln0.Cpus) {
+		t.Errorf("expected balloon %s to keep CPUs 4-7", bln0)
+	}
+	if bln2 == bln0 || !cpuset.New(10, 11).IsSubsetOf(bln2.Cpus) {
+		t.Errorf("expected a separate balloon with CPUs 10-11, got %s", bln2)
+	}
+	if claimed := p.freeCpus.Intersection(cpuset.New(4, 5, 6, 7, 10, 11)); !claimed.IsEmpty() {
+		t.Errorf("expected restored CPUs not to be free, got free %s", claimed)
+	}
+
+	// A container running on CPUs of no balloon gets allocated normally.
+	if bln3 := balloonOf("ctr3"); bln3.Cpus.Intersection(p.reserved).Size() > 0 {
+		t.Errorf("expected ctr3 to be reallocated, got balloon %s", bln3)
+	}
+}
@@ -117,10 +117,7 @@ func newCachedGrant(cg Grant) *cachedGrant {
 	ccg.MemType = cg.MemoryType()
 	ccg.Memset = cg.Memset().Clone()
 
-	ccg.MemoryLimit = make(memoryMap)
-	for key, value := range cg.MemLimit() {
-		ccg.MemoryLimit[key] = value
-	}
+	ccg.MemoryLimit = cg.MemLimit()
 
 	ccg.ColdStart = cg.ColdStart()
 
@@ -144,7 +141,7 @@ func (ccg *cachedGrant) ToGrant(policy *policy) (Grant, error) {
 		cpuset.MustParse(ccg.Exclusive),
 		ccg.Part,
 		ccg.MemType,
-		ccg.MemoryLimit,
+		&ccg.MemoryLimit,
 		ccg.ColdStart,
 	)
 
@@ -37,6 +37,24 @@ type options struct {
 	ColocatePods bool `json:"ColocatePods"`
 	// ColocateNamespaces causes all containers in a namespace to have affinity for each other.
 	ColocateNamespaces bool `json:"ColocateNamespaces"`
+	// WarmPools are exclusive CPUs kept carved out of the shared pool for known workloads.
+	WarmPools []*WarmPool `json:"WarmPools,omitempty"`
+}
+
+// WarmPool describes exclusive CPU allocations prepared in advance for
+// containers with a known CPU shape.
+type WarmPool struct {
+	// Name of the pool, usable in the prefer-warm-pool annotation.
+	Name string `json:"Name"`
+	// Namespaces is a list of namespace globs whose containers use the pool.
+	Namespaces []string `json:"Namespaces,omitempty"`
+	// CPUs is the number of exclusive CPUs of each allocation.
+	CPUs int `json:"CPUs"`
+	// Count is the number of allocations kept ready.
+	Count int `json:"Count"`
+	// IdleTimeout returns unused CPUs to the shared pool if none have been
+	// asked for this long. Zero keeps them ready forever.
+	IdleTimeout config.Duration `json:"IdleTimeout,omitempty"`
 }
 
 // Our runtime configuration.
@@ -0,0 +1,163 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package topologyaware
+
+import (
+	"sync"
+	"time"
+
+	system "github.com/containers/nri-plugins/pkg/sysfs"
+	idset "github.com/intel/goresctrl/pkg/utils"
+)
+
+//
+// Pool memory accounting only knows how much memory has been granted to
+// containers, not how much memory is actually in use. On a long-running node
+// page cache, kernel memory and processes we don't manage make this static
+// view too optimistic. We keep a live view of the memory available on each
+// NUMA node, refreshed by the shared sampler or, if that is not running, on
+// demand when it gets too old. The live view is used to filter out pools
+// which are short of memory for real, to score down pools under memory
+// pressure and to decide when grants need to expand their memsets.
+//
+
+const (
+	// liveMemoryMaxAge is the oldest live view used for allocation decisions.
+	liveMemoryMaxAge = 10 * time.Second
+	// memoryPressurePercent is the percentage of available memory below which
+	// a pool is considered to be under memory pressure.
+	memoryPressurePercent = 10
+)
+
+// Function to get the current time, overridable for testing.
+var liveMemoryTimeNow = time.Now
+
+// numaMemory is the total and available memory of a NUMA node.
+type numaMemory struct {
+	total     uint64
+	available uint64
+}
+
+// liveMemory is the live view of memory available on NUMA nodes.
+type liveMemory struct {
+	sync.RWMutex
+	sys   system.System
+	nodes map[idset.ID]numaMemory
+	taken time.Time
+}
+
+// newLiveMemory creates a live memory view for the given system.
+func newLiveMemory(sys system.System) *liveMemory {
+	return &liveMemory{
+		sys:   sys,
+		nodes: make(map[idset.ID]numaMemory),
+	}
+}
+
+// refresh re-reads the memory info of all NUMA nodes.
+func (m *liveMemory) refresh(now time.Time) {
+	ids := m.sys.NodeIDs()
+	nodes := make(map[idset.ID]numaMemory, len(ids))
+	for _, id := range ids {
+		info, err := m.sys.Node(id).MemoryInfo()
+		if err != nil {
+			log.Debug("failed to get memory info of NUMA node #%d: %v", id, err)
+			continue
+		}
+		nodes[id] = numaMemory{
+			total:     info.MemTotal,
+			available: info.MemFree + info.MemReclaimable,
+		}
+	}
+
+	m.Lock()
+	defer m.Unlock()
+	m.nodes = nodes
+	m.taken = now
+}
+
+// refreshIfStale refreshes the live view if it is too old.
+func (m *liveMemory) refreshIfStale() {
+	if m == nil {
+		return
+	}
+
+	now := liveMemoryTimeNow()
+
+	m.RLock()
+	stale := now.Sub(m.taken) > liveMemoryMaxAge
+	m.RUnlock()
+
+	if stale {
+		m.refresh(now)
+	}
+}
+
+// get returns the total and available memory of the given NUMA nodes.
+// Returns false if memory of some of the nodes is unknown.
+func (m *liveMemory) get(ids idset.IDSet) (uint64, uint64, bool) {
+	if m == nil || len(ids) == 0 {
+		return 0, 0, false
+	}
+
+	m.RLock()
+	defer m.RUnlock()
+
+	var total, available uint64
+	for id := range ids {
+		mem, ok := m.nodes[id]
+		if !ok {
+			return 0, 0, false
+		}
+		total += mem.total
+		available += mem.available
+	}
+
+	return total, available, true
+}
+
+// freeMemory returns the memory of the given type free in a pool. If live is
+// true, this is capped by the memory actually available in the pool.
+func (p *policy) freeMemory(n Node, memType memoryType, live bool) uint64 {
+	free := n.FreeSupply().MemoryLimit()[memType]
+	if !live {
+		return free
+	}
+	if _, available, ok := p.memory.get(n.GetMemset(memType)); ok && available < free {
+		return available
+	}
+	return free
+}
+
+// underMemoryPressure returns true if fulfilling a request from a pool would
+// leave too little memory actually available in the pool.
+func (p *policy) underMemoryPressure(n Node, req Request) bool {
+	memType := req.MemoryType()
+	if memType == memoryUnspec {
+		memType = memoryAll
+	}
+
+	total, available, ok := p.memory.get(n.GetMemset(memType))
+	if !ok || total == 0 {
+		return false
+	}
+
+	required := req.MemAmountToAllocate()
+	if required >= available {
+		return true
+	}
+
+	return 100*(available-required) < memoryPressurePercent*total
+}
@@ -0,0 +1,130 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package topologyaware
+
+import (
+	"sort"
+	"testing"
+	"time"
+
+	system "github.com/containers/nri-plugins/pkg/sysfs"
+	"github.com/containers/nri-plugins/pkg/utils/cpuset"
+	idset "github.com/intel/goresctrl/pkg/utils"
+)
+
+func TestLiveMemory(t *testing.T) {
+	now := time.Unix(1000, 0)
+	liveMemoryTimeNow = func() time.Time { return now }
+	defer func() { liveMemoryTimeNow = time.Now }()
+
+	newNode := func(id int, name string, mem uint64, mems ...idset.ID) node {
+		return node{
+			id:      id,
+			name:    name,
+			kind:    UnknownNode,
+			mem:     idset.NewIDSet(mems...),
+			noderes: newSupply(&node{}, cpuset.New(), cpuset.New(), cpuset.New(), 0, 0, createMemoryMap(mem, 0, 0), createMemoryMap(0, 0, 0)),
+			freeres: newSupply(&node{}, cpuset.New(), cpuset.New(), cpuset.New(), 0, 0, createMemoryMap(mem, 0, 0), createMemoryMap(0, 0, 0)),
+		}
+	}
+
+	root := &virtualnode{node: newNode(100, "root", 12000, 0, 1)}
+	numa0 := &numanode{node: newNode(101, "numa0", 6000, 0), id: 0}
+	numa1 := &numanode{node: newNode(102, "numa1", 6000, 1), id: 1}
+	nodes := []Node{root, numa0, numa1}
+	setLinks(nodes, map[int][]int{100: {101, 102}, 101: {}, 102: {}})
+
+	// Unmanaged processes or page cache use up most of NUMA node #0.
+	sysNodes := []*mockSystemNode{
+		{id: 0, memFree: 1000, memTotal: 6000, memType: system.MemoryTypeDRAM},
+		{id: 1, memFree: 6000, memTotal: 6000, memType: system.MemoryTypeDRAM},
+	}
+	sys := &mockSystem{nodes: []system.Node{sysNodes[0], sysNodes[1]}}
+
+	policy := &policy{
+		sys:         sys,
+		pools:       nodes,
+		cache:       &mockCache{},
+		root:        root,
+		nodeCnt:     len(nodes),
+		allocations: allocations{},
+		memory:      newLiveMemory(sys),
+	}
+	root.self.node, root.policy = root, policy
+	numa0.self.node, numa0.policy = numa0, policy
+	numa1.self.node, numa1.policy = numa1, policy
+	for _, n := range nodes {
+		n.GetSupply().(*supply).node = n
+		n.FreeSupply().(*supply).node = n
+	}
+	policy.allocations.policy = policy
+
+	pools := func(memReq uint64) []int {
+		req := &request{
+			memReq:    memReq,
+			memLim:    memReq,
+			memType:   defaultMemoryType,
+			container: &mockContainer{},
+		}
+		_, filtered := policy.sortPoolsByScore(req, nil)
+		ids := []int{}
+		for _, n := range filtered {
+			ids = append(ids, n.NodeID())
+		}
+		sort.Ints(ids)
+		return ids
+	}
+
+	check := func(memReq uint64, expected ...int) {
+		t.Helper()
+		ids := pools(memReq)
+		if len(ids) != len(expected) {
+			t.Errorf("expected pools %v for %d memory, got %v", expected, memReq, ids)
+			return
+		}
+		for i := range ids {
+			if ids[i] != expected[i] {
+				t.Errorf("expected pools %v for %d memory, got %v", expected, memReq, ids)
+				return
+			}
+		}
+	}
+
+	// Pools short of live memory are filtered out.
+	check(5000, 100, 102)
+
+	// Accounting is used if no pool has enough memory available.
+	check(8000, 100)
+
+	// Pools left with too little memory available are under memory pressure.
+	req := &request{
+		memReq:    500,
+		memLim:    500,
+		memType:   defaultMemoryType,
+		container: &mockContainer{},
+	}
+	if !policy.underMemoryPressure(numa0, req) {
+		t.Errorf("expected %s to be under memory pressure", numa0.Name())
+	}
+	if policy.underMemoryPressure(numa1, req) {
+		t.Errorf("expected %s not to be under memory pressure", numa1.Name())
+	}
+
+	// The live view is refreshed once it gets too old.
+	sysNodes[0].memFree = 6000
+	check(5000, 100, 102)
+	now = now.Add(2 * liveMemoryMaxAge)
+	check(5000, 100, 101, 102)
+}
@@ -140,6 +140,12 @@ func (c *mockCPU) CoreID() idset.ID {
 func (c *mockCPU) ThreadCPUSet() cpuset.CPUSet {
 	return cpuset.New()
 }
+func (c *mockCPU) L3CacheID() idset.ID {
+	return idset.ID(-1)
+}
+func (c *mockCPU) L3CacheCPUSet() cpuset.CPUSet {
+	return cpuset.New()
+}
 func (c *mockCPU) FrequencyRange() system.CPUFreq {
 	return system.CPUFreq{}
 }
@@ -365,6 +371,12 @@ func (m *mockContainer) SetCPUPeriod(int64) {
 func (m *mockContainer) SetCPUQuota(int64) {
 	panic("unimplemented")
 }
+func (m *mockContainer) GetCpusetCpus() string {
+	return ""
+}
+func (m *mockContainer) GetCpusetMems() string {
+	return ""
+}
 func (m *mockContainer) SetCpusetCpus(string) {
 }
 func (m *mockContainer) SetCpusetMems(string) {
@@ -396,7 +396,7 @@ func (n *node) discoverSupply(assignedNUMANodes []idset.ID) Supply {
 				n.Name())
 		}
 
-		n.noderes = newSupply(n, cpuset.New(), cpuset.New(), cpuset.New(), 0, 0, nil, nil)
+		n.noderes = newSupply(n, cpuset.New(), cpuset.New(), cpuset.New(), 0, 0, memoryMap{}, memoryMap{})
 		for _, c := range n.children {
 			supply := c.GetSupply()
 			n.noderes.Cumulate(supply)
@@ -463,7 +463,7 @@ func (n *node) discoverSupply(assignedNUMANodes []idset.ID) Supply {
 		isolated := cpus.Intersection(n.policy.isolated)
 		reserved := cpus.Intersection(n.policy.reserved).Difference(isolated)
 		sharable := cpus.Difference(isolated).Difference(reserved)
-		n.noderes = newSupply(n, isolated, reserved, sharable, 0, 0, mmap, nil)
+		n.noderes = newSupply(n, isolated, reserved, sharable, 0, 0, mmap, memoryMap{})
 		log.Debug("  = %s", n.noderes.DumpCapacity())
 	}
 
@@ -43,6 +43,8 @@ const (
 	keyColdStartPreference = "cold-start"
 	// annotation key for reserved pools
 	keyReservedCPUsPreference = "prefer-reserved-cpus"
+	// annotation key for warm pools
+	keyWarmPoolPreference = "prefer-warm-pool"
 
 	// effective annotation key for isolated CPU preference
 	preferIsolatedCPUsKey = keyIsolationPreference + "." + kubernetes.ResmgrKeyNamespace
@@ -54,6 +56,8 @@ const (
 	preferColdStartKey = keyColdStartPreference + "." + kubernetes.ResmgrKeyNamespace
 	// annotation key for reserved pools
 	preferReservedCPUsKey = keyReservedCPUsPreference + "." + kubernetes.ResmgrKeyNamespace
+	// effective annotation key for warm pool preference
+	preferWarmPoolKey = keyWarmPoolPreference + "." + kubernetes.ResmgrKeyNamespace
 )
 
 // cpuClass is a type of CPU to allocate
@@ -359,6 +363,11 @@ func checkReservedCPUsAnnotations(c cache.Container) (bool, bool) {
 	return preference, true
 }
 
+// warmPoolPreference returns the name of the warm pool annotated for the container.
+func warmPoolPreference(c cache.Container) (string, bool) {
+	return c.GetEffectiveAnnotation(preferWarmPoolKey)
+}
+
 // cpuAllocationPreferences figures out the amount and kind of CPU to allocate.
 // Returned values:
 // 1. full: number of full CPUs
@@ -348,51 +348,32 @@ func (p *policy) allocatePool(container cache.Container, poolHint string) (Grant
 	// the same pool. This assumption can be relaxed later, requires separate
 	// (but connected) scoring of memory and CPU.
 
+	var warm *warmSet
+	var err error
+
 	if request.CPUType() == cpuReserved {
 		pool = p.root
-	} else {
-		affinity, err := p.calculatePoolAffinities(request.GetContainer())
-
-		if err != nil {
-			return nil, policyError("failed to calculate affinity for container %s: %v",
-				container.PrettyName(), err)
-		}
-
-		scores, pools := p.sortPoolsByScore(request, affinity)
-
-		if log.DebugEnabled() {
-			log.Debug("* node fitting for %s", request)
-			for idx, n := range pools {
-				log.Debug("    - #%d: node %s, score %s, affinity: %d",
-					idx, n.Name(), scores[n.NodeID()], affinity[n.NodeID()])
-			}
-		}
-
-		if len(pools) == 0 {
-			return nil, policyError("no suitable pool found for container %s",
-				container.PrettyName())
-		}
-
-		if poolHint != "" {
-			for idx, p := range pools {
-				if p.Name() == poolHint {
-					log.Debug("* using hinted pool %q (#%d best fit)", poolHint, idx+1)
-					pool = p
-					break
-				}
-			}
-			if pool == nil {
-				log.Debug("* cannot use hinted pool %q", poolHint)
-			}
-		}
-
-		if pool == nil {
-			pool = pools[0]
-		}
+	} else if warm = p.takeWarmSet(request); warm != nil {
+		pool = p.nodes[warm.node]
+		setWarmCPUs(request, warm.cpus)
+		log.Debug("* using warm CPUs %s of %s from warm pool %q", warm.cpus, pool.Name(), warm.pool)
+	} else if pool, err = p.choosePool(request, poolHint); err != nil {
+		return nil, err
 	}
 
 	supply := pool.FreeSupply()
 	grant, err := supply.Allocate(request)
+	if err != nil && warm != nil {
+		// The warm CPUs are back in the shared pool, try without them.
+		log.Warn("failed to allocate %s with warm CPUs %s: %v", request, warm.cpus, err)
+		setWarmCPUs(request, cpuset.New())
+		warm = nil
+		if pool, err = p.choosePool(request, poolHint); err != nil {
+			return nil, err
+		}
+		supply = pool.FreeSupply()
+		grant, err = supply.Allocate(request)
+	}
 	if err != nil {
 		return nil, policyError("failed to allocate %s from %s: %v",
 			request, supply.DumpAllocatable(), err)
@@ -583,12 +564,62 @@ func (p *policy) allocatePool(container cache.Container, poolHint string) (Grant
 	}
 
 	p.allocations.grants[container.GetID()] = grant
+	if warm != nil {
+		p.warmGrants[container.GetID()] = warm
+	}
 
 	p.saveAllocations()
 
 	return grant, nil
 }
 
+// choosePool chooses the best fitting pool for a request.
+func (p *policy) choosePool(request Request, poolHint string) (Node, error) {
+	var pool Node
+
+	container := request.GetContainer()
+	affinity, err := p.calculatePoolAffinities(request.GetContainer())
+
+	if err != nil {
+		return nil, policyError("failed to calculate affinity for container %s: %v",
+			container.PrettyName(), err)
+	}
+
+	scores, pools := p.sortPoolsByScore(request, affinity)
+
+	if log.DebugEnabled() {
+		log.Debug("* node fitting for %s", request)
+		for idx, n := range pools {
+			log.Debug("    - #%d: node %s, score %s, affinity: %d",
+				idx, n.Name(), scores[n.NodeID()], affinity[n.NodeID()])
+		}
+	}
+
+	if len(pools) == 0 {
+		return nil, policyError("no suitable pool found for container %s",
+			container.PrettyName())
+	}
+
+	if poolHint != "" {
+		for idx, p := range pools {
+			if p.Name() == poolHint {
+				log.Debug("* using hinted pool %q (#%d best fit)", poolHint, idx+1)
+				pool = p
+				break
+			}
+		}
+		if pool == nil {
+			log.Debug("* cannot use hinted pool %q", poolHint)
+		}
+	}
+
+	if pool == nil {
+		pool = pools[0]
+	}
+
+	return pool, nil
+}
+
 // Apply the result of allocation to the requesting container.
 func (p *policy) applyGrant(grant Grant) {
 	log.Debug("* applying grant %s", grant)
@@ -635,7 +666,7 @@ func (p *policy) applyGrant(grant Grant) {
 		} else {
 			log.Debug("  => not pinning CPUs, allocated cpuset is empty...")
 		}
-		container.SetCpusetCpus(cpus)
+		p.setCpusetCpus(container, cpus)
 
 		// Notes:
 		//     It is extremely important to ensure that the exclusive subset of mixed
@@ -666,7 +697,7 @@ func (p *policy) applyGrant(grant Grant) {
 
 	if mems != "" {
 		log.Debug("  => pinning to memory %s", mems)
-		container.SetCpusetMems(mems)
+		p.setCpusetMems(container, mems)
 		p.setDemotionPreferences(container, grant)
 	} else {
 		log.Debug("  => not pinning memory, memory set is empty...")
@@ -687,8 +718,10 @@ func (p *policy) releasePool(container cache.Container) (Grant, bool) {
 
 	// Remove the grant from all supplys it uses.
 	grant.Release()
+	p.recycleWarmSet(grant)
 
 	delete(p.allocations.grants, container.GetID())
+	delete(p.pinned, container.GetID())
 	p.saveAllocations()
 
 	return grant, true
@@ -706,6 +739,9 @@ func (p *policy) updateSharedAllocations(grant *Grant) {
 		log.Debug("* updating shared allocations")
 	}
 
+	// shared CPUs by pool, calculated once per pool
+	sharedCPUs := make(map[Node]cpuset.CPUSet)
+
 	for _, other := range p.allocations.grants {
 		if grant != nil {
 			if other.GetContainer().GetID() == (*grant).GetContainer().GetID() {
@@ -724,21 +760,62 @@ func (p *policy) updateSharedAllocations(grant *Grant) {
 		}
 
 		if opt.PinCPU {
-			shared := other.GetCPUNode().FreeSupply().SharableCPUs()
+			pool := other.GetCPUNode()
+			shared, ok := sharedCPUs[pool]
+			if !ok {
+				shared = pool.FreeSupply().SharableCPUs()
+				sharedCPUs[pool] = shared
+			}
+			cpus := shared
 			exclusive := other.ExclusiveCPUs()
-			if exclusive.IsEmpty() {
-				log.Debug("  => updating %s with shared CPUs of %s: %s...",
-					other, other.GetCPUNode().Name(), shared.String())
-				other.GetContainer().SetCpusetCpus(shared.String())
+			if !exclusive.IsEmpty() {
+				cpus = exclusive.Union(shared)
+			}
+			if !p.setCpusetCpus(other.GetContainer(), cpus.String()) {
+				log.Debug("  => %s not affected (CPUs unchanged)...", other)
+			} else if exclusive.IsEmpty() {
+				log.Debug("  => updated %s with shared CPUs of %s: %s...",
+					other, pool.Name(), shared.String())
 			} else {
-				log.Debug("  => updating %s with exclusive+shared CPUs of %s: %s+%s...",
-					other, other.GetCPUNode().Name(), exclusive.String(), shared.String())
-				other.GetContainer().SetCpusetCpus(exclusive.Union(shared).String())
+				log.Debug("  => updated %s with exclusive+shared CPUs of %s: %s+%s...",
+					other, pool.Name(), exclusive.String(), shared.String())
 			}
 		}
 	}
 }
 
+// pinning is the cpuset last set for a container.
+type pinning struct {
+	cpus string
+	mems string
+}
+
+// setCpusetCpus sets the CPUs of a container, unless they are already set.
+// Returns true if the container was updated.
+func (p *policy) setCpusetCpus(c cache.Container, cpus string) bool {
+	pin, ok := p.pinned[c.GetID()]
+	if ok && pin.cpus == cpus {
+		return false
+	}
+	pin.cpus = cpus
+	p.pinned[c.GetID()] = pin
+	c.SetCpusetCpus(cpus)
+	return true
+}
+
+// setCpusetMems sets the memory nodes of a container, unless they are already set.
+// Returns true if the container was updated.
+func (p *policy) setCpusetMems(c cache.Container, mems string) bool {
+	pin, ok := p.pinned[c.GetID()]
+	if ok && pin.mems == mems {
+		return false
+	}
+	pin.mems = mems
+	p.pinned[c.GetID()] = pin
+	c.SetCpusetMems(mems)
+	return true
+}
+
 // setDemotionPreferences sets the dynamic demotion preferences a container.
 func (p *policy) setDemotionPreferences(c cache.Container, g Grant) {
 	log.Debug("%s: setting demotion preferences...", c.PrettyName())
@@ -768,6 +845,20 @@ func (p *policy) setDemotionPreferences(c cache.Container, g Grant) {
 }
 
 func (p *policy) filterInsufficientResources(req Request, originals []Node) []Node {
+	sufficient := p.filterInsufficientMemory(req, originals, true)
+	if len(sufficient) == 0 && len(originals) > 0 {
+		// Don't let the live view alone fail an allocation the accounting allows.
+		log.Debug("%s: no pool has enough memory available, ignoring live memory",
+			req.GetContainer().PrettyName())
+		sufficient = p.filterInsufficientMemory(req, originals, false)
+	}
+	return sufficient
+}
+
+// filterInsufficientMemory filters out pools with insufficient memory for
+// a request. If live is true, free memory is capped by the memory actually
+// available in the pools.
+func (p *policy) filterInsufficientMemory(req Request, originals []Node, live bool) []Node {
 	sufficient := make([]Node, 0)
 
 	for _, node := range originals {
@@ -790,7 +881,7 @@ func (p *policy) filterInsufficientResources(req Request, originals []Node) []No
 		for _, memType := range []memoryType{memoryPMEM, memoryDRAM, memoryHBM} {
 			if reqMemType&memType != 0 {
 				extra := supply.ExtraMemoryReservation(memType)
-				free := supply.MemoryLimit()[memType]
+				free := p.freeMemory(node, memType, live)
 				if extra > free {
 					continue
 				}
@@ -817,28 +908,46 @@ func (p *policy) filterInsufficientResources(req Request, originals []Node) []No
 }
 
 // Score pools against the request and sort them by score.
-func (p *policy) sortPoolsByScore(req Request, aff map[int]int32) (map[int]Score, []Node) {
-	scores := make(map[int]Score, p.nodeCnt)
-
-	p.root.DepthFirst(func(n Node) error {
-		scores[n.NodeID()] = n.GetScore(req)
-		return nil
-	})
+func (p *policy) sortPoolsByScore(req Request, aff map[int]int32) ([]Score, []Node) {
+	p.memory.refreshIfStale()
+	scores := p.scorePools(req)
 
 	// Filter out pools which don't have enough uncompressible resources
 	// (memory) to satisfy the request.
 	filteredPools := p.filterInsufficientResources(req, p.pools)
 
+	// Precalculate affinity scores and memory pressure of filtered pools.
+	affinity := p.scratch.affinity
+	if len(aff) > 0 {
+		for _, n := range filteredPools {
+			affinity[n.NodeID()] = affinityScore(aff, n)
+		}
+	}
+	pressure := p.scratch.pressure
+	for _, n := range filteredPools {
+		pressure[n.NodeID()] = p.underMemoryPressure(n, req)
+	}
+
+	// Skip debug formatting in the comparator unless debugging is enabled.
+	var debug func(string, ...interface{})
+	if log.DebugEnabled() {
+		debug = log.Debug
+	}
+
 	sort.Slice(filteredPools, func(i, j int) bool {
-		return p.compareScores(req, filteredPools, scores, aff, i, j)
+		return p.compareScores(req, filteredPools, scores, affinity, pressure, debug, i, j)
 	})
 
 	return scores, filteredPools
 }
 
-// Compare two pools by scores for allocation preference.
-func (p *policy) compareScores(request Request, pools []Node, scores map[int]Score,
-	affinity map[int]int32, i int, j int) bool {
+// noDebug is a no-op debug logging function for compareScores.
+func noDebug(string, ...interface{}) {}
+
+// Compare two pools by scores for allocation preference. Debug messages are
+// emitted using debug, unless it is nil.
+func (p *policy) compareScores(request Request, pools []Node, scores []Score,
+	affinity []float64, pressure []bool, debug func(string, ...interface{}), i int, j int) bool {
 	node1, node2 := pools[i], pools[j]
 	depth1, depth2 := node1.RootDistance(), node2.RootDistance()
 	id1, id2 := node1.NodeID(), node2.NodeID()
@@ -846,12 +955,21 @@ func (p *policy) compareScores(request Request, pools []Node, scores map[int]Sco
 	cpuType := request.CPUType()
 	isolated1, reserved1, shared1 := score1.IsolatedCapacity(), score1.ReservedCapacity(), score1.SharedCapacity()
 	isolated2, reserved2, shared2 := score2.IsolatedCapacity(), score2.ReservedCapacity(), score2.SharedCapacity()
-	a1 := affinityScore(affinity, node1)
-	a2 := affinityScore(affinity, node2)
+	a1 := affinity[id1]
+	a2 := affinity[id2]
 
-	log.Debug("comparing scores for %s and %s", node1.Name(), node2.Name())
-	log.Debug("  %s: %s, affinity score %f", node1.Name(), score1.String(), a1)
-	log.Debug("  %s: %s, affinity score %f", node2.Name(), score2.String(), a2)
+	lowerID := node2
+	if id1 < id2 {
+		lowerID = node1
+	}
+
+	if debug == nil {
+		debug = noDebug
+	} else {
+		debug("comparing scores for %s and %s", node1.Name(), node2.Name())
+		debug("  %s: %s, affinity score %f", node1.Name(), score1.String(), a1)
+		debug("  %s: %s, affinity score %f", node2.Name(), score2.String(), a2)
+	}
 
 	//
 	// Notes:
@@ -864,19 +982,20 @@ func (p *policy) compareScores(request Request, pools []Node, scores map[int]Sco
 	// 4) - if we have topology hints
 	//       * better hint score wins
 	//       * for a tie, prefer the lower node then the smaller id
-	// 5) - if a node is lower in the tree it wins
-	// 6) - for reserved allocations
+	// 5) - a node not under memory pressure wins
+	// 6) - if a node is lower in the tree it wins
+	// 7) - for reserved allocations
 	//       * more unallocated reserved capacity per colocated container wins
-	// 7) - for (non-reserved) isolated allocations
+	// 8) - for (non-reserved) isolated allocations
 	//       * more isolated capacity wins
 	//       * for a tie, prefer the smaller id
-	// 8) - for (non-reserved) exclusive allocations
+	// 9) - for (non-reserved) exclusive allocations
 	//       * more slicable (shared) capacity wins
 	//       * for a tie, prefer the smaller id
-	// 9) - for (non-reserved) shared-only allocations
+	// 10) - for (non-reserved) shared-only allocations
 	//       * fewer colocated containers win
 	//       * for a tie prefer more shared capacity
-	// 10) - lower id wins
+	// 11) - lower id wins
 	//
 	// Before this comparison is reached, nodes with insufficient uncompressible resources
 	// (memory) have been filtered out.
@@ -884,45 +1003,45 @@ func (p *policy) compareScores(request Request, pools []Node, scores map[int]Sco
 	// 1) a node with insufficient isolated or shared capacity loses
 	switch {
 	case cpuType == cpuNormal && ((isolated2 < 0 && isolated1 >= 0) || (shared2 <= 0 && shared1 > 0)):
-		log.Debug("  => %s loses, insufficent isolated or shared", node2.Name())
+		debug("  => %s loses, insufficent isolated or shared", node2.Name())
 		return true
 	case cpuType == cpuNormal && ((isolated1 < 0 && isolated2 >= 0) || (shared1 <= 0 && shared2 > 0)):
-		log.Debug("  => %s loses, insufficent isolated or shared", node1.Name())
+		debug("  => %s loses, insufficent isolated or shared", node1.Name())
 		return false
 	case cpuType == cpuReserved && reserved2 < 0 && reserved1 >= 0:
-		log.Debug("  => %s loses, insufficent reserved", node2.Name())
+		debug("  => %s loses, insufficent reserved", node2.Name())
 		return true
 	case cpuType == cpuReserved && reserved1 < 0 && reserved2 >= 0:
-		log.Debug("  => %s loses, insufficent reserved", node1.Name())
+		debug("  => %s loses, insufficent reserved", node1.Name())
 		return false
 	}
 
-	log.Debug("  - isolated/reserved/shared insufficiency is a TIE")
+	debug("  - isolated/reserved/shared insufficiency is a TIE")
 
 	// 2) higher affinity score wins
 	if a1 > a2 {
-		log.Debug("  => %s loses on affinity", node2.Name())
+		debug("  => %s loses on affinity", node2.Name())
 		return true
 	}
 	if a2 > a1 {
-		log.Debug("  => %s loses on affinity", node1.Name())
+		debug("  => %s loses on affinity", node1.Name())
 		return false
 	}
 
-	log.Debug("  - affinity is a TIE")
+	debug("  - affinity is a TIE")
 
 	// 3) matching memory type wins
 	if reqType := request.MemoryType(); reqType != memoryUnspec {
 		if node1.HasMemoryType(reqType) && !node2.HasMemoryType(reqType) {
-			log.Debug("  => %s WINS on memory type", node1.Name())
+			debug("  => %s WINS on memory type", node1.Name())
 			return true
 		}
 		if !node1.HasMemoryType(reqType) && node2.HasMemoryType(reqType) {
-			log.Debug("  => %s WINS on memory type", node2.Name())
+			debug("  => %s WINS on memory type", node2.Name())
 			return false
 		}
 
-		log.Debug("  - memory type is a TIE")
+		debug("  - memory type is a TIE")
 	}
 
 	// 4) better topology hint score wins
@@ -933,61 +1052,73 @@ func (p *policy) compareScores(request Request, pools []Node, scores map[int]Sco
 		hs2, nz2 := combineHintScores(hScores2)
 
 		if hs1 > hs2 {
-			log.Debug("  => %s WINS on hints", node1.Name())
+			debug("  => %s WINS on hints", node1.Name())
 			return true
 		}
 		if hs2 > hs1 {
-			log.Debug("  => %s WINS on hints", node2.Name())
+			debug("  => %s WINS on hints", node2.Name())
 			return false
 		}
 
-		log.Debug("  - hints are a TIE")
+		debug("  - hints are a TIE")
 
 		if hs1 == 0 {
 			if nz1 > nz2 {
-				log.Debug("  => %s WINS on non-zero hints", node1.Name())
+				debug("  => %s WINS on non-zero hints", node1.Name())
 				return true
 			}
 			if nz2 > nz1 {
-				log.Debug("  => %s WINS on non-zero hints", node2.Name())
+				debug("  => %s WINS on non-zero hints", node2.Name())
 				return false
 			}
 
-			log.Debug("  - non-zero hints are a TIE")
+			debug("  - non-zero hints are a TIE")
 		}
 
 		// for a tie, prefer lower nodes and smaller ids
 		if hs1 == hs2 && nz1 == nz2 && (hs1 != 0 || nz1 != 0) {
 			if depth1 > depth2 {
-				log.Debug("  => %s WINS as it is lower", node1.Name())
+				debug("  => %s WINS as it is lower", node1.Name())
 				return true
 			}
 			if depth1 < depth2 {
-				log.Debug("  => %s WINS as it is lower", node2.Name())
+				debug("  => %s WINS as it is lower", node2.Name())
 				return false
 			}
 
-			log.Debug("  => %s WINS based on equal hint socres, lower id",
-				map[bool]string{true: node1.Name(), false: node2.Name()}[id1 < id2])
+			debug("  => %s WINS based on equal hint socres, lower id",
+				lowerID.Name())
 
 			return id1 < id2
 		}
 	}
 
-	// 5) a lower node wins
+	// 5) a node not under memory pressure wins
+	if pressure != nil && pressure[id1] != pressure[id2] {
+		if pressure[id2] {
+			debug("  => %s WINS, %s is under memory pressure", node1.Name(), node2.Name())
+			return true
+		}
+		debug("  => %s WINS, %s is under memory pressure", node2.Name(), node1.Name())
+		return false
+	}
+
+	debug("  - memory pressure is a TIE")
+
+	// 6) a lower node wins
 	if depth1 > depth2 {
-		log.Debug("  => %s WINS on depth", node1.Name())
+		debug("  => %s WINS on depth", node1.Name())
 		return true
 	}
 	if depth1 < depth2 {
-		log.Debug("  => %s WINS on depth", node2.Name())
+		debug("  => %s WINS on depth", node2.Name())
 		return false
 	}
 
-	log.Debug("  - depth is a TIE")
+	debug("  - depth is a TIE")
 
 	if request.CPUType() == cpuReserved {
-		// 6) if requesting reserved CPUs, more reserved
+		// 7) if requesting reserved CPUs, more reserved
 		//    capacity per colocated container wins. Reserved
 		//    CPUs cannot be precisely accounted as they run
 		//    also BestEffort containers that do not carry
@@ -998,9 +1129,9 @@ func (p *policy) compareScores(request Request, pools []Node, scores map[int]Sco
 		if reserved2/(score2.Colocated()+1) > reserved1/(score1.Colocated()+1) {
 			return false
 		}
-		log.Debug("  - reserved capacity is a TIE")
+		debug("  - reserved capacity is a TIE")
 	} else if request.CPUType() == cpuNormal {
-		// 7) more isolated capacity wins
+		// 8) more isolated capacity wins
 		if request.Isolate() && (isolated1 > 0 || isolated2 > 0) {
 			if isolated1 > isolated2 {
 				return true
@@ -1009,55 +1140,55 @@ func (p *policy) compareScores(request Request, pools []Node, scores map[int]Sco
 				return false
 			}
 
-			log.Debug("  => %s WINS based on equal isolated capacity, lower id",
-				map[bool]string{true: node1.Name(), false: node2.Name()}[id1 < id2])
+			debug("  => %s WINS based on equal isolated capacity, lower id",
+				lowerID.Name())
 
 			return id1 < id2
 		}
 
-		// 8) more slicable shared capacity wins
+		// 9) more slicable shared capacity wins
 		if request.FullCPUs() > 0 && (shared1 > 0 || shared2 > 0) {
 			if shared1 > shared2 {
-				log.Debug("  => %s WINS on more slicable capacity", node1.Name())
+				debug("  => %s WINS on more slicable capacity", node1.Name())
 				return true
 			}
 			if shared2 > shared1 {
-				log.Debug("  => %s WINS on more slicable capacity", node2.Name())
+				debug("  => %s WINS on more slicable capacity", node2.Name())
 				return false
 			}
 
-			log.Debug("  => %s WINS based on equal slicable capacity, lower id",
-				map[bool]string{true: node1.Name(), false: node2.Name()}[id1 < id2])
+			debug("  => %s WINS based on equal slicable capacity, lower id",
+				lowerID.Name())
 
 			return id1 < id2
 		}
 
-		// 9) fewer colocated containers win
+		// 10) fewer colocated containers win
 		if score1.Colocated() < score2.Colocated() {
-			log.Debug("  => %s WINS on colocation score", node1.Name())
+			debug("  => %s WINS on colocation score", node1.Name())
 			return true
 		}
 		if score2.Colocated() < score1.Colocated() {
-			log.Debug("  => %s WINS on colocation score", node2.Name())
+			debug("  => %s WINS on colocation score", node2.Name())
 			return false
 		}
 
-		log.Debug("  - colocation score is a TIE")
+		debug("  - colocation score is a TIE")
 
 		// more shared capacity wins
 		if shared1 > shared2 {
-			log.Debug("  => %s WINS on more shared capacity", node1.Name())
+			debug("  => %s WINS on more shared capacity", node1.Name())
 			return true
 		}
 		if shared2 > shared1 {
-			log.Debug("  => %s WINS on more shared capacity", node2.Name())
+			debug("  => %s WINS on more shared capacity", node2.Name())
 			return false
 		}
 	}
 
-	// 10) lower id wins
-	log.Debug("  => %s WINS based on lower id",
-		map[bool]string{true: node1.Name(), false: node2.Name()}[id1 < id2])
+	// 11) lower id wins
+	debug("  => %s WINS based on lower id",
+		lowerID.Name())
 
 	return id1 < id2
 }
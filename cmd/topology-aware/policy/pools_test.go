@@ -21,6 +21,8 @@ import (
 	"path"
 	"testing"
 
+	"github.com/containerd/nri/pkg/api"
+
 	"github.com/containers/nri-plugins/pkg/resmgr/cache"
 	policyapi "github.com/containers/nri-plugins/pkg/resmgr/policy"
 
@@ -965,3 +967,265 @@ func TestAffinities(t *testing.T) {
 		})
 	}
 }
+
+func TestCachedPoolScores(t *testing.T) {
+	// Create a temporary directory for the test data.
+	dir, err := ioutil.TempDir("", "nri-resource-policy-test-sysfs-")
+	if err != nil {
+		panic(err)
+	}
+	defer os.RemoveAll(dir)
+
+	// Uncompress the test data to the directory.
+	err = utils.UncompressTbz2(path.Join("testdata", "sysfs.tar.bz2"), dir)
+	if err != nil {
+		panic(err)
+	}
+
+	sys, err := system.DiscoverSystemAt(path.Join(dir, "sysfs", "server", "sys"))
+	if err != nil {
+		panic(err)
+	}
+
+	reserved, _ := resapi.ParseQuantity("750m")
+	policyOptions := &policyapi.BackendOptions{
+		Cache:  &mockCache{},
+		System: sys,
+		Reserved: policyapi.ConstraintSet{
+			policyapi.DomainCPU: reserved,
+		},
+	}
+
+	policy := CreateTopologyAwarePolicy(policyOptions).(*policy)
+
+	req := &request{
+		memReq:    10000,
+		memLim:    10000,
+		memType:   memoryUnspec,
+		full:      1,
+		fraction:  500,
+		container: &mockContainer{},
+	}
+
+	checkScores := func(step string) {
+		scores := policy.scorePools(req)
+		for _, n := range policy.pools {
+			expected, cached := n.GetScore(req), scores[n.NodeID()]
+			if expected.IsolatedCapacity() != cached.IsolatedCapacity() ||
+				expected.ReservedCapacity() != cached.ReservedCapacity() ||
+				expected.SharedCapacity() != cached.SharedCapacity() ||
+				expected.Colocated() != cached.Colocated() {
+				t.Errorf("%s: cached score of %s differs, expected %s, got %s",
+					step, n.Name(), expected, cached)
+			}
+		}
+	}
+
+	checkScores("initial")
+
+	for i, cpu := range []string{"2", "1500m", "3", "250m", "4"} {
+		c := &mockContainer{
+			returnValueForGetResourceRequirements: v1.ResourceRequirements{
+				Limits: v1.ResourceList{
+					v1.ResourceCPU:    resapi.MustParse(cpu),
+					v1.ResourceMemory: resapi.MustParse("1000"),
+				},
+			},
+			returnValueForGetID: fmt.Sprintf("container%d", i),
+		}
+		grant, err := policy.allocatePool(c, "")
+		if err != nil {
+			t.Fatalf("failed to allocate container #%d: %v", i, err)
+		}
+		policy.allocations.grants[c.GetID()] = grant
+		checkScores(fmt.Sprintf("after allocation #%d", i))
+	}
+}
+
+func TestSharedCpusetUpdates(t *testing.T) {
+	dir := t.TempDir()
+	if err := utils.UncompressTbz2(path.Join("testdata", "sysfs.tar.bz2"), dir); err != nil {
+		t.Fatalf("failed to uncompress test data: %v", err)
+	}
+	sys, err := system.DiscoverSystemAt(path.Join(dir, "sysfs", "server", "sys"))
+	if err != nil {
+		t.Fatalf("failed to discover test system: %v", err)
+	}
+	cch, err := cache.NewCache(cache.Options{CacheDir: t.TempDir(), Ephemeral: true})
+	if err != nil {
+		t.Fatalf("failed to create cache: %v", err)
+	}
+
+	reserved, _ := resapi.ParseQuantity("750m")
+	policy := CreateTopologyAwarePolicy(&policyapi.BackendOptions{
+		Cache:  cch,
+		System: sys,
+		Reserved: policyapi.ConstraintSet{
+			policyapi.DomainCPU: reserved,
+		},
+	}).(*policy)
+
+	leaves := []Node{}
+	for _, n := range policy.pools {
+		if n.IsLeafNode() {
+			leaves = append(leaves, n)
+		}
+	}
+	if len(leaves) < 2 {
+		t.Fatalf("expected at least 2 leaf pools, got %d", len(leaves))
+	}
+	poolA, poolB := leaves[0], leaves[len(leaves)-1]
+
+	besteffort := &api.LinuxResources{
+		Cpu: &api.LinuxCPU{
+			Shares: &api.OptionalUInt64{Value: 2},
+		},
+	}
+	guaranteed := &api.LinuxResources{
+		Cpu: &api.LinuxCPU{
+			Shares: &api.OptionalUInt64{Value: 2048},
+			Quota:  &api.OptionalInt64{Value: 200000},
+			Period: &api.OptionalUInt64{Value: 100000},
+		},
+		Memory: &api.LinuxMemory{
+			Limit: &api.OptionalInt64{Value: 100 * 1024 * 1024},
+		},
+	}
+
+	create := func(id, class string, res *api.LinuxResources, pool Node) cache.Container {
+		pod, err := cch.InsertPod(&api.PodSandbox{
+			Id:        id + "-pod",
+			Uid:       id + "-uid",
+			Name:      id,
+			Namespace: "default",
+			Linux: &api.LinuxPodSandbox{
+				CgroupParent: "/kubepods.slice/kubepods-" + class + ".slice/kubepods-" + class + "-" + id + ".slice",
+			},
+		})
+		if err != nil {
+			t.Fatalf("failed to create pod: %v", err)
+		}
+		c, err := cch.InsertContainer(&api.Container{
+			Id:           id,
+			PodSandboxId: pod.GetID(),
+			Name:         id,
+			State:        api.ContainerState_CONTAINER_CREATED,
+			Linux: &api.LinuxContainer{
+				Resources: res,
+			},
+		})
+		if err != nil {
+			t.Fatalf("failed to create container: %v", err)
+		}
+		allocate(t, policy, c, pool)
+		return c
+	}
+
+	pending := func() map[string]bool {
+		ids := map[string]bool{}
+		for _, c := range cch.GetPendingContainers() {
+			if c.GetPendingUpdate() != nil {
+				ids[c.GetID()] = true
+			}
+			for _, ctrl := range c.GetPending() {
+				c.ClearPending(ctrl)
+			}
+		}
+		return ids
+	}
+
+	be0 := create("be0", "besteffort", besteffort, poolA)
+	be1 := create("be1", "besteffort", besteffort, poolB)
+	pending()
+
+	// Exclusive CPUs out of pool A only change the cpuset of shared containers in A.
+	excl := create("excl", "guaranteed", guaranteed, poolA)
+	if ids := pending(); !ids[be0.GetID()] || ids[be1.GetID()] {
+		t.Errorf("expected only %s to be updated, got updates for %v", be0.GetID(), ids)
+	}
+
+	// Releasing the exclusive CPUs changes the same cpusets back and forgets the pinning.
+	policy.ReleaseResources(excl)
+	if ids := pending(); !ids[be0.GetID()] || ids[be1.GetID()] {
+		t.Errorf("expected only %s to be updated on release, got updates for %v", be0.GetID(), ids)
+	}
+	if _, ok := policy.pinned[excl.GetID()]; ok {
+		t.Errorf("expected pinning of released %s to be forgotten", excl.GetID())
+	}
+
+	// A reallocated container is pinned again, even to the same cpuset.
+	policy.ReleaseResources(be1)
+	if _, ok := policy.pinned[be1.GetID()]; ok {
+		t.Errorf("expected pinning of released %s to be forgotten", be1.GetID())
+	}
+	pending()
+	allocate(t, policy, be1, poolB)
+	if ids := pending(); !ids[be1.GetID()] || ids[be0.GetID()] {
+		t.Errorf("expected only %s to be updated, got updates for %v", be1.GetID(), ids)
+	}
+}
+
+// allocate allocates resources for a container from the given pool.
+func allocate(t *testing.T, p *policy, c cache.Container, pool Node) {
+	t.Helper()
+	if err := p.allocateResources(c, pool.Name()); err != nil {
+		t.Fatalf("failed to allocate %s: %v", c.GetID(), err)
+	}
+	if grant, ok := p.allocations.grants[c.GetID()]; !ok || grant.GetCPUNode() != pool {
+		t.Fatalf("expected %s to be allocated from %s", c.GetID(), pool.Name())
+	}
+}
+
+func BenchmarkAllocatePool(b *testing.B) {
+	dir := b.TempDir()
+	if err := utils.UncompressTbz2(path.Join("testdata", "sysfs.tar.bz2"), dir); err != nil {
+		b.Fatalf("failed to uncompress test data: %v", err)
+	}
+
+	for _, name := range []string{"desktop", "server", "4-socket-server-nosnc"} {
+		sys, err := system.DiscoverSystemAt(path.Join(dir, "sysfs", name, "sys"))
+		if err != nil {
+			b.Fatalf("failed to discover %s system: %v", name, err)
+		}
+
+		reserved, _ := resapi.ParseQuantity("750m")
+		policy := CreateTopologyAwarePolicy(&policyapi.BackendOptions{
+			Cache:  &mockCache{},
+			System: sys,
+			Reserved: policyapi.ConstraintSet{
+				policyapi.DomainCPU: reserved,
+			},
+		}).(*policy)
+
+		for _, cpu := range []string{"500m", "2"} {
+			c := &mockContainer{
+				returnValueForGetResourceRequirements: v1.ResourceRequirements{
+					Limits: v1.ResourceList{
+						v1.ResourceCPU:    resapi.MustParse(cpu),
+						v1.ResourceMemory: resapi.MustParse("100M"),
+					},
+				},
+				returnValueForGetID: "container0",
+			}
+			req := newRequest(c)
+
+			b.Run(name+"/score/cpu="+cpu, func(b *testing.B) {
+				b.ReportAllocs()
+				for i := 0; i < b.N; i++ {
+					policy.sortPoolsByScore(req, nil)
+				}
+			})
+
+			b.Run(name+"/allocate/cpu="+cpu, func(b *testing.B) {
+				b.ReportAllocs()
+				for i := 0; i < b.N; i++ {
+					grant, err := policy.allocatePool(c, "")
+					if err != nil {
+						b.Fatalf("failed to allocate: %v", err)
+					}
+					grant.Release()
+				}
+			})
+		}
+	}
+}
@@ -15,6 +15,7 @@
 package topologyaware
 
 import (
+	"encoding/json"
 	"fmt"
 	"strconv"
 	"time"
@@ -54,6 +55,10 @@ type Supply interface {
 	AccountAllocateCPU(Grant)
 	// AccountReleaseCPU accounts for (reinserts) released exclusive capacity into the supply.
 	AccountReleaseCPU(Grant)
+	// TakeWarmCPUs takes exclusive CPUs for a warm pool out of the sharable ones.
+	TakeWarmCPUs(cnt int, prefer cpuset.CPUSet) (cpuset.CPUSet, error)
+	// ReturnWarmCPUs returns exclusive CPUs of a warm pool to the sharable ones.
+	ReturnWarmCPUs(cpuset.CPUSet)
 	// GetScore calculates how well this supply fits/fulfills the given request.
 	GetScore(Request) Score
 	// AllocatableSharedCPU calculates the allocatable amount of shared CPU of this supply.
@@ -199,7 +204,10 @@ type Score interface {
 	String() string
 }
 
-type memoryMap map[memoryType]uint64
+// memoryMap is an amount of memory per memory type, indexed by memoryType.
+// It is an array instead of a map, so that copying or cloning supplies and
+// grants during allocation does not need to allocate.
+type memoryMap [memoryFirstUnusedBit]uint64
 
 // supply implements our Supply interface.
 type supply struct {
@@ -211,7 +219,7 @@ type supply struct {
 	grantedShared        int                 // amount of shareable CPUs allocated
 	mem                  memoryMap           // available memory for this node
 	grantedMem           memoryMap           // total memory granted
-	extraMemReservations map[Grant]memoryMap // how much memory each workload above has requested
+	extraMemReservations map[Grant]memoryMap // how much memory each workload above has requested, created on demand
 }
 
 var _ Supply = &supply{}
@@ -234,6 +242,10 @@ type request struct {
 	// initial memory requests are made to the PMEM memory. A value of 0
 	// indicates that cold start is not explicitly requested.
 	coldStart time.Duration
+
+	// warm are exclusive CPUs of a warm pool, already taken out of the
+	// supplies, to allocate for this request.
+	warm cpuset.CPUSet
 }
 
 var _ Request = &request{}
@@ -269,24 +281,18 @@ type score struct {
 var _ Score = &score{}
 
 // newSupply creates CPU supply for the given node, cpusets and existing grant.
-
+// CPUSets are immutable, all operations on them return a new set, so they are
+// shared instead of cloned.
 func newSupply(n Node, isolated, reserved, sharable cpuset.CPUSet, grantedReserved int, grantedShared int, mem, grantedMem memoryMap) Supply {
-	if mem == nil {
-		mem = createMemoryMap(0, 0, 0)
-	}
-	if grantedMem == nil {
-		grantedMem = createMemoryMap(0, 0, 0)
-	}
 	return &supply{
-		node:                 n,
-		isolated:             isolated.Clone(),
-		reserved:             reserved.Clone(),
-		sharable:             sharable.Clone(),
-		grantedReserved:      grantedReserved,
-		grantedShared:        grantedShared,
-		mem:                  mem,
-		grantedMem:           grantedMem,
-		extraMemReservations: make(map[Grant]memoryMap),
+		node:            n,
+		isolated:        isolated,
+		reserved:        reserved,
+		sharable:        sharable,
+		grantedReserved: grantedReserved,
+		grantedShared:   grantedShared,
+		mem:             mem,
+		grantedMem:      grantedMem,
 	}
 }
 
@@ -300,24 +306,24 @@ func createMemoryMap(dram, pmem, hbm uint64) memoryMap {
 	}
 }
 
-func (m memoryMap) Add(dram, pmem, hbm uint64) {
+func (m *memoryMap) Add(dram, pmem, hbm uint64) {
 	m[memoryDRAM] += dram
 	m[memoryPMEM] += pmem
 	m[memoryPMEM] += hbm
 	m[memoryAll] += dram + pmem + hbm
 }
 
-func (m memoryMap) AddDRAM(dram uint64) {
+func (m *memoryMap) AddDRAM(dram uint64) {
 	m[memoryDRAM] += dram
 	m[memoryAll] += dram
 }
 
-func (m memoryMap) AddPMEM(pmem uint64) {
+func (m *memoryMap) AddPMEM(pmem uint64) {
 	m[memoryPMEM] += pmem
 	m[memoryAll] += pmem
 }
 
-func (m memoryMap) AddHBM(hbm uint64) {
+func (m *memoryMap) AddHBM(hbm uint64) {
 	m[memoryHBM] += hbm
 	m[memoryAll] += hbm
 }
@@ -349,6 +355,35 @@ func (m memoryMap) String() string {
 	return mem
 }
 
+// MarshalJSON marshals the non-zero entries of memoryMap as a JSON object
+// keyed by memory type, the format used for caching grants.
+func (m memoryMap) MarshalJSON() ([]byte, error) {
+	mm := make(map[memoryType]uint64, len(m))
+	for memType, amount := range m {
+		if amount != 0 {
+			mm[memoryType(memType)] = amount
+		}
+	}
+	return json.Marshal(mm)
+}
+
+// UnmarshalJSON unmarshals a memoryMap from a JSON object keyed by memory type.
+func (m *memoryMap) UnmarshalJSON(data []byte) error {
+	mm := map[memoryType]uint64{}
+	if err := json.Unmarshal(data, &mm); err != nil {
+		return policyError("failed to unmarshal memoryMap '%s': %v", string(data), err)
+	}
+	*m = memoryMap{}
+	for memType, amount := range mm {
+		if memType < memoryUnspec || memType > memoryAll {
+			return policyError("failed to unmarshal memoryMap '%s': invalid memory type %d",
+				string(data), int(memType))
+		}
+		m[memType] = amount
+	}
+	return nil
+}
+
 // GetNode returns the node supplying CPU and memory.
 func (cs *supply) GetNode() Node {
 	return cs.node
@@ -356,31 +391,22 @@ func (cs *supply) GetNode() Node {
 
 // Clone clones the given CPU supply.
 func (cs *supply) Clone() Supply {
-	// Copy the maps.
-	mem := make(memoryMap)
-	for key, value := range cs.mem {
-		mem[key] = value
-	}
-	grantedMem := make(memoryMap)
-	for key, value := range cs.grantedMem {
-		grantedMem[key] = value
-	}
-	return newSupply(cs.node, cs.isolated, cs.reserved, cs.sharable, cs.grantedReserved, cs.grantedShared, mem, grantedMem)
+	return newSupply(cs.node, cs.isolated, cs.reserved, cs.sharable, cs.grantedReserved, cs.grantedShared, cs.mem, cs.grantedMem)
 }
 
 // IsolatedCpus returns the isolated CPUSet of this supply.
 func (cs *supply) IsolatedCPUs() cpuset.CPUSet {
-	return cs.isolated.Clone()
+	return cs.isolated
 }
 
 // ReservedCpus returns the reserved CPUSet of this supply.
 func (cs *supply) ReservedCPUs() cpuset.CPUSet {
-	return cs.reserved.Clone()
+	return cs.reserved
 }
 
 // SharableCpus returns the sharable CPUSet of this supply.
 func (cs *supply) SharableCPUs() cpuset.CPUSet {
-	return cs.sharable.Clone()
+	return cs.sharable
 }
 
 // GrantedReserved returns the locally granted reserved CPU capacity.
@@ -453,6 +479,62 @@ func (cs *supply) AccountReleaseCPU(g Grant) {
 	cs.sharable = cs.sharable.Union(sharable)
 }
 
+// TakeWarmCPUs takes cnt exclusive CPUs out of the sharable CPUs of the supply
+// without granting them to any container. The preferred CPUs are taken if they
+// are all sharable.
+func (cs *supply) TakeWarmCPUs(cnt int, prefer cpuset.CPUSet) (cpuset.CPUSet, error) {
+	var (
+		cpus cpuset.CPUSet
+		err  error
+	)
+
+	if cs.AllocatableSharedCPU(true) <= 1000*cnt {
+		return cpus, policyError("%s: can't take %d warm CPUs from %s, %dm available",
+			cs.node.Name(), cnt, cs.sharable, cs.AllocatableSharedCPU(true))
+	}
+
+	if prefer.Size() == cnt && prefer.IsSubsetOf(cs.sharable) {
+		cpus = prefer
+		cs.sharable = cs.sharable.Difference(cpus)
+	} else {
+		if cpus, err = cs.takeCPUs(&cs.sharable, nil, cnt); err != nil {
+			return cpus, policyError("%s: can't take %d warm CPUs from %s: %v",
+				cs.node.Name(), cnt, cs.sharable, err)
+		}
+	}
+
+	cs.accountWarmCPUs(cpus, true)
+	return cpus, nil
+}
+
+// ReturnWarmCPUs returns exclusive CPUs of a warm pool to the sharable ones.
+func (cs *supply) ReturnWarmCPUs(cpus cpuset.CPUSet) {
+	cs.sharable = cs.sharable.Union(cpus)
+	cs.accountWarmCPUs(cpus, false)
+}
+
+// accountWarmCPUs accounts for CPUs taken by or returned from a warm pool in
+// the supplies of all other nodes sharing the CPUs.
+func (cs *supply) accountWarmCPUs(cpus cpuset.CPUSet, taken bool) {
+	account := func(n Node) error {
+		if n.IsSameNode(cs.node) {
+			return nil
+		}
+		s := n.FreeSupply().(*supply)
+		if taken {
+			s.sharable = s.sharable.Difference(cpus)
+		} else {
+			s.sharable = s.sharable.Union(cpus.Intersection(n.GetSupply().SharableCPUs()))
+		}
+		return nil
+	}
+
+	cs.node.DepthFirst(account)
+	for node := cs.node.Parent(); !node.IsNil(); node = node.Parent() {
+		account(node)
+	}
+}
+
 // allocateMemory tries to fulfill the memory allocation part of a request.
 func (cs *supply) allocateMemory(r Request) (memoryMap, error) {
 	reqType := r.MemoryType()
@@ -497,7 +579,7 @@ func (cs *supply) allocateMemory(r Request) (memoryMap, error) {
 
 		if remaining > 0 {
 			if r.ColdStart() > 0 && memType == memoryPMEM {
-				return nil, policyError("internal error: "+
+				return memoryMap{}, policyError("internal error: "+
 					"not enough PMEM for cold start at %s", cs.GetNode().Name())
 			}
 		} else {
@@ -517,7 +599,7 @@ func (cs *supply) allocateMemory(r Request) (memoryMap, error) {
 			}
 		}
 
-		return nil, policyError("internal error: "+
+		return memoryMap{}, policyError("internal error: "+
 			"not enough memory at %s", cs.node.Name())
 	}
 
@@ -574,6 +656,9 @@ func (cs *supply) AllocateCPU(r Request) (Grant, error) {
 
 	// allocate isolated exclusive CPUs or slice them off the sharable set
 	switch {
+	case full > 0 && cr.warm.Size() == full:
+		exclusive = cr.warm
+
 	case full > 0 && cs.isolated.Size() >= full && cr.isolate:
 		exclusive, err = cs.takeCPUs(&cs.isolated, nil, full)
 		if err != nil {
@@ -702,13 +787,16 @@ func (cs *supply) ReleaseExtraMemoryReservation(g Grant) {
 }
 
 func (cs *supply) SetExtraMemoryReservation(g Grant) {
-	res := make(memoryMap)
+	res := memoryMap{}
 	extraMemory := uint64(0)
 	for key, value := range g.MemLimit() {
 		res[key] = value
 		extraMemory += value
 	}
 	res[memoryAll] = extraMemory
+	if cs.extraMemReservations == nil {
+		cs.extraMemReservations = make(map[Grant]memoryMap)
+	}
 	cs.extraMemReservations[g] = res
 }
 
@@ -987,6 +1075,11 @@ func newRequest(container cache.Container) Request {
 	}
 }
 
+// setWarmCPUs sets the warm CPUs to allocate for a request.
+func setWarmCPUs(r Request, cpus cpuset.CPUSet) {
+	r.(*request).warm = cpus
+}
+
 // GetContainer returns the container requesting CPU.
 func (cr *request) GetContainer() cache.Container {
 	return cr.container
@@ -1075,20 +1168,39 @@ func (cr *request) ColdStart() time.Duration {
 
 // Score collects data for scoring this supply wrt. the given request.
 func (cs *supply) GetScore(req Request) Score {
-	score := &score{
-		supply: cs,
-		req:    req,
+	colocated := 0
+	for _, grant := range cs.node.Policy().allocations.grants {
+		if req.CPUType() == grant.CPUType() && grant.GetCPUNode().NodeID() == cs.node.NodeID() {
+			colocated++
+		}
+	}
+
+	score := &score{}
+	cs.fillScore(score, req, cs.AllocatableReservedCPU(), cs.AllocatableSharedCPU(), colocated)
+	return score
+}
+
+// fillScore scores this supply given its allocatable capacity and colocated
+// containers, reusing the given score and any hint score map it has.
+func (cs *supply) fillScore(score *score, req Request, reserved, shared, colocated int) {
+	hints := score.hints
+	for provider := range hints {
+		delete(hints, provider)
 	}
 
+	score.supply = cs
+	score.req = req
+	score.isolated = 0
+	score.reserved = reserved
+	score.shared = shared
+	score.colocated = colocated
+
 	cr := req.(*request)
 	full, part := cr.full, cr.fraction
 	if full == 0 && part == 0 {
 		part = 1
 	}
 
-	score.reserved = cs.AllocatableReservedCPU()
-	score.shared = cs.AllocatableSharedCPU()
-
 	if cr.CPUType() == cpuReserved {
 		// calculate free reserved capacity
 		score.reserved -= part
@@ -1107,16 +1219,11 @@ func (cs *supply) GetScore(req Request) Score {
 		score.shared -= part
 	}
 
-	// calculate colocation score
-	for _, grant := range cs.node.Policy().allocations.grants {
-		if cr.CPUType() == grant.CPUType() && grant.GetCPUNode().NodeID() == cs.node.NodeID() {
-			score.colocated++
-		}
-	}
-
 	// calculate real hint scores
-	hints := cr.container.GetTopologyHints()
-	score.hints = make(map[string]float64, len(hints))
+	if hints == nil {
+		hints = make(map[string]float64)
+	}
+	score.hints = hints
 
 	for provider, hint := range cr.container.GetTopologyHints() {
 		log.Debug(" - evaluating topology hint %s", hint)
@@ -1124,6 +1231,9 @@ func (cs *supply) GetScore(req Request) Score {
 	}
 
 	// calculate any fake hint scores
+	if len(opt.FakeHints) == 0 {
+		return
+	}
 	pod, _ := cr.container.GetPod()
 	key := pod.GetName() + ":" + cr.container.GetName()
 	if fakeHints, ok := opt.FakeHints[key]; ok {
@@ -1138,8 +1248,6 @@ func (cs *supply) GetScore(req Request) Score {
 			score.hints[provider] = cs.node.HintScore(hint)
 		}
 	}
-
-	return score
 }
 
 // AllocatableReservedCPU calculates the allocatable amount of reserved CPU of this supply.
@@ -1226,7 +1334,7 @@ func (score *score) String() string {
 }
 
 // newGrant creates a CPU grant from the given node for the container.
-func newGrant(n Node, c cache.Container, cpuType cpuClass, exclusive cpuset.CPUSet, cpuPortion int, mt memoryType, allocated memoryMap, coldstart time.Duration) Grant {
+func newGrant(n Node, c cache.Container, cpuType cpuClass, exclusive cpuset.CPUSet, cpuPortion int, mt memoryType, allocated *memoryMap, coldstart time.Duration) Grant {
 	grant := &grant{
 		node:       n,
 		memoryNode: n,
@@ -1236,7 +1344,7 @@ func newGrant(n Node, c cache.Container, cpuType cpuClass, exclusive cpuset.CPUS
 		cpuPortion: cpuPortion,
 	}
 	if allocated != nil {
-		grant.SetMemoryAllocation(mt, allocated, coldstart)
+		grant.SetMemoryAllocation(mt, *allocated, coldstart)
 	}
 	return grant
 }
@@ -1443,14 +1551,15 @@ func (cg *grant) RestoreMemset() {
 func (cg *grant) ExpandMemset() (bool, error) {
 	supply := cg.GetMemoryNode().FreeSupply()
 	node := cg.GetMemoryNode()
-	parent := node.Parent()
+	p := node.Policy()
 
 	// We have to assume that the memory has been allocated how we granted it (if PMEM ran out
 	// the allocations have been made from DRAM and so on).
 
-	// Figure out if there is enough memory now to have grant as-is.
+	// Figure out if there is enough memory now to have grant as-is. Memory actually
+	// available on the node can be less than what the accounting says is free.
 	extra := supply.ExtraMemoryReservation(memoryAll)
-	free := supply.MemoryLimit()[memoryAll]
+	free := p.freeMemory(node, memoryAll, true)
 	if extra <= free {
 		// The grant fits in the node even with extra reservations
 		return false, nil
@@ -1463,21 +1572,21 @@ func (cg *grant) ExpandMemset() (bool, error) {
 	log.Debug("out-of-memory risk in %s: extra reservations %s > free %s -> moving up %s total memory grant from %s",
 		cg, prettyMem(extra), prettyMem(free), prettyMem(required), node.Name())
 
-	// Find an ancestor where the grant fits. As reservations in
-	// child nodes do not show up in free + extra in parent nodes,
-	// releasing the grant is not necessary before searching.
-	for ; !parent.IsNil(); parent = parent.Parent() {
-		pSupply := parent.FreeSupply()
-		parentFree := pSupply.MemoryLimit()[memoryAll]
-		parentExtra := pSupply.ExtraMemoryReservation(memoryAll)
-		if parentExtra+required <= parentFree {
-			required = 0
-			break
+	// Find an ancestor where the grant fits, preferably with enough memory
+	// actually available. As reservations in child nodes do not show up in
+	// free + extra in parent nodes, releasing the grant is not necessary
+	// before searching.
+	parent := cg.findMemoryAncestor(required, true)
+	if parent.IsNil() {
+		if extra <= supply.MemoryLimit()[memoryAll] {
+			// Only the live view is short, the grant fits as accounted.
+			log.Debug("- no ancestor of %s has %s available, keeping %s as is",
+				node.Name(), prettyMem(required), cg)
+			return false, nil
 		}
-		log.Debug("- %s has %s free but %s extra reservations, moving further up",
-			parent.Name(), prettyMem(parentFree), prettyMem(parentExtra))
+		parent = cg.findMemoryAncestor(required, false)
 	}
-	if required > 0 {
+	if parent.IsNil() {
 		return false, fmt.Errorf("internal error: cannot find enough memory (%s) for %s from ancestors of %s", prettyMem(required), cg, node.Name())
 	}
 
@@ -1496,6 +1605,24 @@ func (cg *grant) ExpandMemset() (bool, error) {
 	return true, nil
 }
 
+// findMemoryAncestor finds the closest ancestor of the memory node of the
+// grant with enough free memory for the given amount. If live is true, free
+// memory is capped by the memory actually available.
+func (cg *grant) findMemoryAncestor(required uint64, live bool) Node {
+	node := cg.GetMemoryNode()
+	p := node.Policy()
+	for parent := node.Parent(); !parent.IsNil(); parent = parent.Parent() {
+		parentFree := p.freeMemory(parent, memoryAll, live)
+		parentExtra := parent.FreeSupply().ExtraMemoryReservation(memoryAll)
+		if parentExtra+required <= parentFree {
+			return parent
+		}
+		log.Debug("- %s has %s free but %s extra reservations, moving further up",
+			parent.Name(), prettyMem(parentFree), prettyMem(parentExtra))
+	}
+	return nilnode
+}
+
 func (cg *grant) UpdateExtraMemoryReservation() {
 	// For every subnode, make sure that this grant is added to the extra memory allocation.
 	cg.GetMemoryNode().DepthFirst(func(n Node) error {
@@ -0,0 +1,199 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package topologyaware
+
+//
+// Scoring a pool needs its allocatable reserved and shared CPU capacity.
+// Calculating these for a single pool takes walking all its ancestors and
+// summing up granted CPU in the subtree of each of them. Doing this for
+// every pool on every allocation is quadratic in the number of pools. We
+// cache capacity per pool instead, together with the state of the pools'
+// own free supply it was calculated from. Before scoring, the state of
+// every pool is compared to the cached one, and capacity is recalculated
+// only for pools whose supply has changed, or for which the supply of an
+// ancestor or descendant has changed.
+//
+
+// supplyState is the scoring-relevant state of the free supply of a pool.
+type supplyState struct {
+	isolated        int // number of isolated CPUs
+	reserved        int // number of reserved CPUs
+	sharable        int // number of sharable CPUs
+	grantedReserved int // granted reserved milli-CPU
+	grantedShared   int // granted shared milli-CPU
+}
+
+// poolCapacity is the cached allocatable capacity of a pool.
+type poolCapacity struct {
+	valid       bool        // whether cached data is valid
+	changed     bool        // whether pool or subtree changed during this refresh
+	state       supplyState // supply state capacity was calculated from
+	subReserved int         // granted reserved milli-CPU in the subtree
+	subShared   int         // granted shared milli-CPU in the subtree
+	minReserved int         // free reserved milli-CPU capped by ancestors
+	reserved    int         // allocatable reserved milli-CPU, -1 if none
+	shared      int         // allocatable shared milli-CPU
+}
+
+// scoreArena is scratch space reused for scoring pools. Scores are filled in
+// place instead of being allocated for every pool on every allocation.
+type scoreArena struct {
+	scores    []score   // scores by pool ID
+	results   []Score   // scores by pool ID, as returned by scorePools()
+	colocated []int     // number of colocated containers by pool ID
+	affinity  []float64 // affinity scores by pool ID
+	pressure  []bool    // memory pressure by pool ID
+}
+
+// reset prepares the arena for scoring n pools.
+func (a *scoreArena) reset(n int) {
+	if cap(a.scores) < n {
+		a.scores = make([]score, n)
+		a.results = make([]Score, n)
+		a.colocated = make([]int, n)
+		a.affinity = make([]float64, n)
+		a.pressure = make([]bool, n)
+	}
+	a.scores = a.scores[:n]
+	a.results = a.results[:n]
+	a.colocated = a.colocated[:n]
+	a.affinity = a.affinity[:n]
+	a.pressure = a.pressure[:n]
+	for i := 0; i < n; i++ {
+		a.results[i] = nil
+		a.colocated[i] = 0
+		a.affinity[i] = 0
+		a.pressure[i] = false
+	}
+}
+
+// scorePools scores all pools for the given request, returning scores by pool ID.
+// The returned scores are only valid until the next call to scorePools.
+func (p *policy) scorePools(req Request) []Score {
+	p.refreshCapacity()
+	p.scratch.reset(len(p.capacity))
+
+	colocated := p.scratch.colocated
+	cpuType := req.CPUType()
+	for _, grant := range p.allocations.grants {
+		if grant.CPUType() != cpuType {
+			continue
+		}
+		if id := grant.GetCPUNode().NodeID(); id >= 0 && id < len(colocated) {
+			colocated[id]++
+		}
+	}
+
+	scores := p.scratch.results
+	p.root.DepthFirst(func(n Node) error {
+		id := n.NodeID()
+		c, score := &p.capacity[id], &p.scratch.scores[id]
+		n.FreeSupply().(*supply).fillScore(score, req, c.reserved, c.shared, colocated[id])
+		scores[id] = score
+		return nil
+	})
+
+	return scores
+}
+
+// refreshCapacity brings cached pool capacities up to date.
+func (p *policy) refreshCapacity() {
+	maxID := -1
+	p.root.DepthFirst(func(n Node) error {
+		if id := n.NodeID(); id > maxID {
+			maxID = id
+		}
+		return nil
+	})
+
+	if len(p.capacity) != maxID+1 {
+		p.capacity = make([]poolCapacity, maxID+1)
+	}
+
+	p.refreshGranted(p.root)
+	p.refreshAllocatable(p.root, nil, false)
+}
+
+// invalidateCapacity drops all cached pool capacities.
+func (p *policy) invalidateCapacity() {
+	p.capacity = nil
+}
+
+// refreshGranted updates subtree granted CPU in post-order, returning true if it changed.
+func (p *policy) refreshGranted(n Node) bool {
+	changed := false
+	for _, child := range n.Children() {
+		if p.refreshGranted(child) {
+			changed = true
+		}
+	}
+
+	free := n.FreeSupply()
+	state := supplyState{
+		isolated:        free.IsolatedCPUs().Size(),
+		reserved:        free.ReservedCPUs().Size(),
+		sharable:        free.SharableCPUs().Size(),
+		grantedReserved: free.GrantedReserved(),
+		grantedShared:   free.GrantedShared(),
+	}
+
+	c := &p.capacity[n.NodeID()]
+	if !c.valid || changed || c.state != state {
+		c.state = state
+		c.subReserved = state.grantedReserved
+		c.subShared = state.grantedShared
+		for _, child := range n.Children() {
+			cc := &p.capacity[child.NodeID()]
+			c.subReserved += cc.subReserved
+			c.subShared += cc.subShared
+		}
+		c.valid = true
+		changed = true
+	}
+	c.changed = changed
+
+	return changed
+}
+
+// refreshAllocatable updates ancestor-capped allocatable CPU in pre-order.
+func (p *policy) refreshAllocatable(n Node, parent *poolCapacity, changed bool) {
+	c := &p.capacity[n.NodeID()]
+	changed = changed || c.changed
+	c.changed = false
+
+	if changed {
+		reserved := 1000*c.state.reserved - c.subReserved
+		shared := 1000*c.state.sharable - c.subShared
+		if parent != nil {
+			if parent.minReserved < reserved {
+				reserved = parent.minReserved
+			}
+			if parent.shared < shared {
+				shared = parent.shared
+			}
+		}
+		c.minReserved = reserved
+		c.shared = shared
+		if c.state.reserved == 0 {
+			c.reserved = -1
+		} else {
+			c.reserved = reserved
+		}
+	}
+
+	for _, child := range n.Children() {
+		p.refreshAllocatable(child, c, changed)
+	}
+}
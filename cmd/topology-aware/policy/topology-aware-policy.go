@@ -15,6 +15,8 @@
 package topologyaware
 
 import (
+	"sync/atomic"
+
 	"github.com/containers/nri-plugins/pkg/utils/cpuset"
 	v1 "k8s.io/api/core/v1"
 	"k8s.io/apimachinery/pkg/api/resource"
@@ -69,6 +71,15 @@ type policy struct {
 	allocations  allocations               // container pool assignments
 	cpuAllocator cpuallocator.CPUAllocator // CPU allocator used by the policy
 	coldstartOff bool                      // coldstart forced off (have movable PMEM zones)
+	capacity     []poolCapacity            // cached pool capacities for scoring
+	scratch      scoreArena                // scratch space for scoring pools
+	pinned       map[string]pinning        // cpusets last set for containers
+	warm         map[string]*warmPool      // warm pools by name
+	warmDefs     []*WarmPool               // configuration of warm pools
+	warmGrants   map[string]*warmSet       // warm CPUs handed out to containers
+	warmCheck    atomic.Bool               // idle warm pool check due
+	started      bool                      // whether the policy has been started
+	memory       *liveMemory               // live view of available memory
 }
 
 // Make sure policy implements the policy.Backend interface.
@@ -84,6 +95,7 @@ func CreateTopologyAwarePolicy(opts *policyapi.BackendOptions) policyapi.Backend
 		sys:          opts.System,
 		options:      opts,
 		cpuAllocator: cpuallocator.NewCPUAllocator(opts.System),
+		memory:       newLiveMemory(opts.System),
 	}
 
 	if err := p.initialize(); err != nil {
@@ -92,6 +104,11 @@ func CreateTopologyAwarePolicy(opts *policyapi.BackendOptions) policyapi.Backend
 
 	p.registerImplicitAffinities()
 
+	if opts.Sampler != nil {
+		opts.Sampler.AddSource("numa-memory", p.memory.refresh)
+		opts.Sampler.AddSource("warm-pools", p.sampleWarmPools)
+	}
+
 	config.GetModule(policyapi.ConfigPath).AddNotify(p.configNotify)
 
 	return p
@@ -121,7 +138,26 @@ func (p *policy) Start(add []cache.Container, del []cache.Container) error {
 
 	p.root.Dump("<post-start>")
 
-	return p.Sync(add, del)
+	// Try to put containers back to the pools they were in before we got
+	// restarted, so that their resources stay put.
+	hints := p.getRestartPoolHints(add)
+
+	log.Debug("synchronizing state...")
+	for _, c := range del {
+		p.ReleaseResources(c)
+	}
+	for _, c := range add {
+		if err := p.allocateResources(c, hints[c.GetID()]); err != nil {
+			log.Error("%v", err)
+		}
+	}
+
+	p.started = true
+	if p.configureWarmPools() {
+		p.updateSharedAllocations(nil)
+	}
+
+	return nil
 }
 
 // Sync synchronizes the state of this policy.
@@ -141,6 +177,10 @@ func (p *policy) Sync(add []cache.Container, del []cache.Container) error {
 func (p *policy) AllocateResources(container cache.Container) error {
 	log.Debug("allocating resources for %s...", container.PrettyName())
 
+	if p.expireWarmPools() {
+		p.updateSharedAllocations(nil)
+	}
+
 	err := p.allocateResources(container, "")
 	if err != nil {
 		return err
@@ -167,19 +207,34 @@ func (p *policy) allocateResources(container cache.Container, poolHint string) e
 func (p *policy) ReleaseResources(container cache.Container) error {
 	log.Debug("releasing resources of %s...", container.PrettyName())
 
-	if grant, found := p.releasePool(container); found {
-		p.updateSharedAllocations(&grant)
-	}
+	p.releaseResources(container, true)
 
 	p.root.Dump("<post-release>")
 
 	return nil
 }
 
+// releaseResources releases the resources of a container, refilling warm
+// pools from them if asked to. Rebalancing doesn't, since the containers it
+// releases are reallocated right away and still need the released CPU.
+func (p *policy) releaseResources(container cache.Container, refill bool) {
+	grant, found := p.releasePool(container)
+	if !found {
+		return
+	}
+	if refill && p.maintainWarmPools() {
+		p.updateSharedAllocations(nil)
+	} else {
+		p.updateSharedAllocations(&grant)
+	}
+}
+
 // UpdateResources is a resource allocation update request for this policy.
 func (p *policy) UpdateResources(container cache.Container) error {
 	log.Debug("updating (reallocating) container %s...", container.PrettyName())
 
+	p.checkWarmPools()
+
 	grant, found := p.releasePool(container)
 	if !found {
 		log.Warnf("can't find allocation to update for %s", container.PrettyName())
@@ -199,15 +254,24 @@ func (p *policy) UpdateResources(container cache.Container) error {
 }
 
 // Rebalance tries to find an optimal allocation of resources for the current containers.
+// Returns true if any container was moved or shared CPUs changed.
 func (p *policy) Rebalance() (bool, error) {
 	var errors error
 
+	changed := false
+	if p.maintainWarmPools() {
+		p.updateSharedAllocations(nil)
+		changed = true
+	}
+
 	containers := p.cache.GetContainers()
 	movable := []cache.Container{}
+	placed := map[string]string{}
 
 	for _, c := range containers {
 		if c.GetQOSClass() != v1.PodQOSGuaranteed {
-			p.ReleaseResources(c)
+			placed[c.GetID()] = p.placement(c)
+			p.releaseResources(c, false)
 			movable = append(movable, c)
 		}
 	}
@@ -220,15 +284,30 @@ func (p *policy) Rebalance() (bool, error) {
 				errors = policyError("%v, %v", errors, err)
 			}
 		}
+		if p.placement(c) != placed[c.GetID()] {
+			changed = true
+		}
 	}
 
-	return true, errors
+	return changed, errors
+}
+
+// placement returns a string describing where the container is allocated.
+func (p *policy) placement(c cache.Container) string {
+	g, ok := p.allocations.grants[c.GetID()]
+	if !ok {
+		return ""
+	}
+	return g.GetCPUNode().Name() + "/" + g.ExclusiveCPUs().String() + "/" +
+		g.IsolatedCPUs().String() + "/" + g.GetMemoryNode().Name() + "/" + g.Memset().String()
 }
 
 // HandleEvent handles policy-specific events.
 func (p *policy) HandleEvent(e *events.Policy) (bool, error) {
 	log.Debug("received policy event %s.%s with data %v...", e.Source, e.Type, e.Data)
 
+	p.checkWarmPools()
+
 	switch e.Type {
 	case events.ContainerStarted:
 		c, ok := e.Data.(cache.Container)
@@ -520,7 +599,8 @@ func (p *policy) configNotify(event config.Event, source config.Source) error {
 	//   also update the existing allocations accordingly. We do this
 	//   first reinitializing the policy then reloading the allocations
 	//   from the cache. If we fail, we restore the original state of
-	//   the policy and reject the new configuration.
+	//   the policy and reject the new configuration. Containers whose
+	//   cpusets end up unchanged are not updated.
 	//
 
 	if reinit {
@@ -534,6 +614,12 @@ func (p *policy) configNotify(event config.Event, source config.Source) error {
 			return policyError("failed to reconfigure: %v", err)
 		}
 
+		// Keep track of the current pinning of containers, so that only
+		// the ones whose cpuset changes by reinitialization get updated.
+		for id, pin := range savedPolicy.pinned {
+			p.pinned[id] = pin
+		}
+
 		for _, grant := range allocations.grants {
 			if err := grant.RefetchNodes(); err != nil {
 				*p = savedPolicy
@@ -550,6 +636,11 @@ func (p *policy) configNotify(event config.Event, source config.Source) error {
 		p.root.Dump("<post-config>")
 	}
 
+	if p.started && p.configureWarmPools() {
+		log.Info("warm pools reconfigured")
+		p.updateSharedAllocations(nil)
+	}
+
 	return nil
 }
 
@@ -561,6 +652,13 @@ func (p *policy) initialize() error {
 	p.nodeCnt = 0
 	p.depth = 0
 	p.allocations = p.newAllocations()
+	p.invalidateCapacity()
+	p.pinned = make(map[string]pinning)
+	p.warm = nil
+	p.warmDefs = nil
+	if p.warmGrants == nil {
+		p.warmGrants = make(map[string]*warmSet)
+	}
 
 	if err := p.checkConstraints(); err != nil {
 		return err
@@ -677,6 +775,43 @@ func (a *allocations) getContainerPoolHints() ([]cache.Container, map[string]str
 	return containers, hints
 }
 
+// getRestartPoolHints creates pool hints for containers we find running on
+// startup. Containers with a restored grant are hinted to their granted pool.
+// Others, for instance when we run with an ephemeral cache, are hinted to the
+// smallest pool which contains the cpuset they are currently running with.
+func (p *policy) getRestartPoolHints(containers []cache.Container) map[string]string {
+	hints := make(map[string]string)
+	for _, c := range containers {
+		if grant, ok := p.allocations.grants[c.GetID()]; ok {
+			hints[c.GetID()] = grant.GetCPUNode().Name()
+			continue
+		}
+
+		cpus, err := cpuset.Parse(c.GetCpusetCpus())
+		if err != nil || cpus.IsEmpty() {
+			continue
+		}
+
+		var pool Node
+		for _, n := range p.pools {
+			s := n.GetSupply()
+			all := s.SharableCPUs().Union(s.IsolatedCPUs()).Union(s.ReservedCPUs())
+			if !cpus.IsSubsetOf(all) {
+				continue
+			}
+			if pool == nil || n.RootDistance() > pool.RootDistance() {
+				pool = n
+			}
+		}
+		if pool != nil {
+			log.Debug("%s: hinting pool %s for current cpuset %s",
+				c.PrettyName(), pool.Name(), cpus)
+			hints[c.GetID()] = pool.Name()
+		}
+	}
+	return hints
+}
+
 // Register us as a policy implementation.
 func init() {
 	policyapi.Register(PolicyName, PolicyDescription, CreateTopologyAwarePolicy)
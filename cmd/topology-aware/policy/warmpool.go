@@ -0,0 +1,306 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package topologyaware
+
+import (
+	"path/filepath"
+	"reflect"
+	"time"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+	"github.com/containers/nri-plugins/pkg/utils/cpuset"
+)
+
+//
+// Warm pools keep sets of exclusive CPUs carved out of the shared pool, in
+// advance, for containers with a known CPU shape. A matching container gets
+// one of the sets without scoring pools and without shrinking the shared
+// pool, so no other container needs to be updated when it is created. When
+// such a container goes away, its CPUs go back to the warm pool instead of
+// the shared one. Sets are carved from leaf pools by the CPU allocator, so
+// they are topologically close and honor SST priorities. A warm pool which
+// has not been asked for during its idle timeout returns its sets to the
+// shared pool. Idle pools are refilled once they are asked for again.
+//
+
+// Function to get the current time, overridable for testing.
+var warmTimeNow = time.Now
+
+// warmPool is the runtime state of a configured warm pool.
+type warmPool struct {
+	*WarmPool
+	sets    []*warmSet // sets of CPUs ready to be handed out
+	lastUse time.Time  // last time the pool was asked for
+}
+
+// warmSet is a set of exclusive CPUs carved out of a pool.
+type warmSet struct {
+	pool string        // name of the warm pool
+	node string        // name of the pool the CPUs are carved out of
+	cpus cpuset.CPUSet // carved out CPUs
+}
+
+// configureWarmPools sets up warm pools according to the configuration.
+// Returns true if shared CPUs changed.
+func (p *policy) configureWarmPools() bool {
+	if p.warm != nil && reflect.DeepEqual(p.warmDefs, opt.WarmPools) {
+		return false
+	}
+
+	changed := p.dropWarmPools()
+
+	p.warm = make(map[string]*warmPool)
+	p.warmDefs = make([]*WarmPool, 0, len(opt.WarmPools))
+	for _, d := range opt.WarmPools {
+		def := *d
+		p.warmDefs = append(p.warmDefs, &def)
+		if def.Name == "" || def.CPUs <= 0 || def.Count <= 0 {
+			log.Warn("ignoring invalid warm pool %q (%d x %d CPUs)", def.Name, def.Count, def.CPUs)
+			continue
+		}
+		p.warm[def.Name] = &warmPool{
+			WarmPool: &def,
+			lastUse:  warmTimeNow(),
+		}
+	}
+
+	for _, name := range p.warmPoolNames() {
+		if p.fillWarmPool(p.warm[name]) {
+			changed = true
+		}
+	}
+
+	return changed
+}
+
+// dropWarmPools returns the CPUs of all warm pools to the shared pool.
+// Returns true if shared CPUs changed.
+func (p *policy) dropWarmPools() bool {
+	changed := false
+	for _, wp := range p.warm {
+		if p.shrinkWarmPool(wp) {
+			changed = true
+		}
+	}
+	p.warm = nil
+	p.warmDefs = nil
+	return changed
+}
+
+// maintainWarmPools returns the CPUs of idle warm pools to the shared pool
+// and refills the other ones. Returns true if shared CPUs changed.
+func (p *policy) maintainWarmPools() bool {
+	changed := p.expireWarmPools()
+	now := warmTimeNow()
+	for _, name := range p.warmPoolNames() {
+		if wp := p.warm[name]; !wp.isIdle(now) && p.fillWarmPool(wp) {
+			changed = true
+		}
+	}
+	return changed
+}
+
+// expireWarmPools returns the CPUs of idle warm pools to the shared pool.
+// Returns true if shared CPUs changed.
+func (p *policy) expireWarmPools() bool {
+	p.warmCheck.Store(false)
+
+	changed := false
+	now := warmTimeNow()
+	for _, name := range p.warmPoolNames() {
+		if wp := p.warm[name]; wp.isIdle(now) && p.shrinkWarmPool(wp) {
+			log.Info("warm pool %q idle for %v, returned its CPUs to the shared pool",
+				wp.Name, now.Sub(wp.lastUse))
+			changed = true
+		}
+	}
+	return changed
+}
+
+// checkWarmPools expires idle warm pools if a check is due since the last
+// sampling round, updating shared allocations if this changed shared CPUs.
+func (p *policy) checkWarmPools() {
+	if p.warmCheck.Load() && p.expireWarmPools() {
+		p.updateSharedAllocations(nil)
+	}
+}
+
+// sampleWarmPools is our sampler source. It runs without holding the resource
+// manager lock, so it only flags an idle check for the next locked request.
+func (p *policy) sampleWarmPools(time.Time) {
+	p.warmCheck.Store(true)
+}
+
+// isIdle returns true if the warm pool has not been asked for during its idle timeout.
+func (wp *warmPool) isIdle(now time.Time) bool {
+	return wp.IdleTimeout > 0 && now.Sub(wp.lastUse) > time.Duration(wp.IdleTimeout)
+}
+
+// fillWarmPool carves sets of exclusive CPUs for a warm pool until it is full.
+func (p *policy) fillWarmPool(wp *warmPool) bool {
+	changed := false
+	for len(wp.sets) < wp.Count {
+		var (
+			pool Node
+			free int
+		)
+		for _, n := range p.pools {
+			if !n.IsLeafNode() {
+				continue
+			}
+			if shared := n.FreeSupply().AllocatableSharedCPU(true); shared > 1000*wp.CPUs && shared > free {
+				pool, free = n, shared
+			}
+		}
+		if pool == nil {
+			log.Warn("warm pool %q: not enough free CPU for %d x %d CPUs, have %d",
+				wp.Name, wp.Count, wp.CPUs, len(wp.sets))
+			break
+		}
+
+		cpus, err := pool.FreeSupply().TakeWarmCPUs(wp.CPUs, cpuset.New())
+		if err != nil {
+			log.Error("warm pool %q: %v", wp.Name, err)
+			break
+		}
+
+		log.Info("warm pool %q: carved CPUs %s out of %s", wp.Name, cpus, pool.Name())
+		wp.sets = append(wp.sets, &warmSet{pool: wp.Name, node: pool.Name(), cpus: cpus})
+		changed = true
+	}
+	return changed
+}
+
+// shrinkWarmPool returns all CPUs of a warm pool to the shared pool.
+func (p *policy) shrinkWarmPool(wp *warmPool) bool {
+	for _, set := range wp.sets {
+		if pool, ok := p.nodes[set.node]; ok {
+			pool.FreeSupply().ReturnWarmCPUs(set.cpus)
+		}
+	}
+	changed := len(wp.sets) > 0
+	wp.sets = nil
+	return changed
+}
+
+// takeWarmSet takes a set of warm CPUs matching the request, if there is one.
+func (p *policy) takeWarmSet(r Request) *warmSet {
+	wp := p.warmPoolFor(r)
+	if wp == nil {
+		return nil
+	}
+
+	wp.lastUse = warmTimeNow()
+
+	for i := len(wp.sets) - 1; i >= 0; i-- {
+		set := wp.sets[i]
+		pool, ok := p.nodes[set.node]
+		if !ok {
+			continue
+		}
+		// Isolated CPUs don't need the shared pool to shrink either.
+		if r.Isolate() && pool.FreeSupply().IsolatedCPUs().Size() >= r.FullCPUs() {
+			return nil
+		}
+		wp.sets = append(wp.sets[:i], wp.sets[i+1:]...)
+		return set
+	}
+
+	log.Debug("warm pool %q is empty, can't serve %s", wp.Name, r.GetContainer().PrettyName())
+	return nil
+}
+
+// recycleWarmSet puts the CPUs of a released container back to its warm pool.
+func (p *policy) recycleWarmSet(g Grant) {
+	id := g.GetContainer().GetID()
+	set, ok := p.warmGrants[id]
+	if !ok {
+		return
+	}
+	delete(p.warmGrants, id)
+
+	wp, ok := p.warm[set.pool]
+	if !ok || len(wp.sets) >= wp.Count || wp.CPUs != set.cpus.Size() {
+		return
+	}
+	if !g.ExclusiveCPUs().Equals(set.cpus) {
+		return
+	}
+	pool, ok := p.nodes[set.node]
+	if !ok {
+		return
+	}
+
+	cpus, err := pool.FreeSupply().TakeWarmCPUs(wp.CPUs, set.cpus)
+	if err != nil {
+		log.Debug("warm pool %q: can't recycle CPUs %s: %v", wp.Name, set.cpus, err)
+		return
+	}
+
+	wp.sets = append(wp.sets, &warmSet{pool: wp.Name, node: set.node, cpus: cpus})
+}
+
+// warmPoolFor returns the warm pool for a request, if there is one.
+func (p *policy) warmPoolFor(r Request) *warmPool {
+	if len(p.warm) == 0 || r.CPUType() != cpuNormal || r.FullCPUs() == 0 || r.CPUFraction() != 0 {
+		return nil
+	}
+
+	c := r.GetContainer()
+
+	var wp *warmPool
+	if name, ok := warmPoolPreference(c); ok {
+		if wp = p.warm[name]; wp == nil {
+			log.Warn("%s: unknown warm pool %q", c.PrettyName(), name)
+			return nil
+		}
+	} else {
+		wp = p.warmPoolByNamespace(c)
+	}
+
+	if wp == nil || wp.CPUs != r.FullCPUs() {
+		return nil
+	}
+
+	return wp
+}
+
+// warmPoolByNamespace returns the first warm pool matching the namespace of a container.
+func (p *policy) warmPoolByNamespace(c cache.Container) *warmPool {
+	namespace := c.GetNamespace()
+	for _, def := range p.warmDefs {
+		wp, ok := p.warm[def.Name]
+		if !ok {
+			continue
+		}
+		for _, glob := range wp.Namespaces {
+			if ok, _ := filepath.Match(glob, namespace); ok {
+				return wp
+			}
+		}
+	}
+	return nil
+}
+
+// warmPoolNames returns the names of warm pools in configuration order.
+func (p *policy) warmPoolNames() []string {
+	names := make([]string, 0, len(p.warm))
+	for _, def := range p.warmDefs {
+		if _, ok := p.warm[def.Name]; ok {
+			names = append(names, def.Name)
+		}
+	}
+	return names
+}
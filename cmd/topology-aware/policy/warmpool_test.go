@@ -0,0 +1,254 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package topologyaware
+
+import (
+	"path"
+	"testing"
+	"time"
+
+	"github.com/containerd/nri/pkg/api"
+	v1 "k8s.io/api/core/v1"
+	resapi "k8s.io/apimachinery/pkg/api/resource"
+
+	"github.com/containers/nri-plugins/pkg/config"
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+	policyapi "github.com/containers/nri-plugins/pkg/resmgr/policy"
+	system "github.com/containers/nri-plugins/pkg/sysfs"
+	"github.com/containers/nri-plugins/pkg/utils"
+	"github.com/containers/nri-plugins/pkg/utils/cpuset"
+)
+
+func TestWarmPools(t *testing.T) {
+	dir := t.TempDir()
+	if err := utils.UncompressTbz2(path.Join("testdata", "sysfs.tar.bz2"), dir); err != nil {
+		t.Fatalf("failed to uncompress test data: %v", err)
+	}
+	sys, err := system.DiscoverSystemAt(path.Join(dir, "sysfs", "server", "sys"))
+	if err != nil {
+		t.Fatalf("failed to discover test system: %v", err)
+	}
+
+	now := time.Unix(1000, 0)
+	warmTimeNow = func() time.Time { return now }
+	opt.WarmPools = []*WarmPool{
+		{
+			Name:        "latency",
+			Namespaces:  []string{"latency-*"},
+			CPUs:        2,
+			Count:       2,
+			IdleTimeout: config.Duration(time.Minute),
+		},
+	}
+	defer func() {
+		warmTimeNow = time.Now
+		opt.WarmPools = nil
+	}()
+
+	reserved, _ := resapi.ParseQuantity("750m")
+	policy := CreateTopologyAwarePolicy(&policyapi.BackendOptions{
+		Cache:  &mockCache{},
+		System: sys,
+		Reserved: policyapi.ConstraintSet{
+			policyapi.DomainCPU: reserved,
+		},
+	}).(*policy)
+
+	newContainer := func(id, namespace string) *mockContainer {
+		return &mockContainer{
+			name:      id,
+			namespace: namespace,
+			returnValueForGetResourceRequirements: v1.ResourceRequirements{
+				Requests: v1.ResourceList{
+					v1.ResourceCPU:    resapi.MustParse("2"),
+					v1.ResourceMemory: resapi.MustParse("100M"),
+				},
+				Limits: v1.ResourceList{
+					v1.ResourceCPU:    resapi.MustParse("2"),
+					v1.ResourceMemory: resapi.MustParse("100M"),
+				},
+			},
+			returnValueForGetID: id,
+		}
+	}
+
+	all := policy.root.FreeSupply().SharableCPUs()
+	if !policy.configureWarmPools() {
+		t.Fatalf("expected warm pools to take shared CPUs")
+	}
+	wp := policy.warm["latency"]
+	if len(wp.sets) != 2 {
+		t.Fatalf("expected 2 warm CPU sets, got %d", len(wp.sets))
+	}
+	carved := cpuset.New()
+	for _, set := range wp.sets {
+		carved = carved.Union(set.cpus)
+	}
+	shared := policy.root.FreeSupply().SharableCPUs()
+	if carved.Size() != 4 || !shared.Equals(all.Difference(carved)) {
+		t.Fatalf("expected 4 warm CPUs out of shared ones, got %s, shared %s", carved, shared)
+	}
+
+	// Matching containers get warm CPUs without the shared CPUs changing.
+	c := newContainer("warm0", "latency-db")
+	grant, err := policy.allocatePool(c, "")
+	if err != nil {
+		t.Fatalf("failed to allocate warm container: %v", err)
+	}
+	if exclusive := grant.ExclusiveCPUs(); exclusive.Size() != 2 || !exclusive.IsSubsetOf(carved) {
+		t.Errorf("expected exclusive CPUs out of %s, got %s", carved, exclusive)
+	}
+	if cpus := policy.root.FreeSupply().SharableCPUs(); !cpus.Equals(shared) {
+		t.Errorf("expected shared CPUs %s to stay intact, got %s", shared, cpus)
+	}
+	if len(wp.sets) != 1 {
+		t.Errorf("expected 1 warm CPU set left, got %d", len(wp.sets))
+	}
+
+	// Other containers are allocated normally.
+	other := newContainer("cold0", "default")
+	if _, err := policy.allocatePool(other, ""); err != nil {
+		t.Fatalf("failed to allocate container: %v", err)
+	}
+	if len(wp.sets) != 1 {
+		t.Errorf("expected 1 warm CPU set left, got %d", len(wp.sets))
+	}
+	policy.releasePool(other)
+
+	// Released warm CPUs go back to the warm pool.
+	policy.releasePool(c)
+	if len(wp.sets) != 2 {
+		t.Errorf("expected 2 warm CPU sets after release, got %d", len(wp.sets))
+	}
+	if cpus := policy.root.FreeSupply().SharableCPUs(); !cpus.Equals(shared) {
+		t.Errorf("expected shared CPUs %s after release, got %s", shared, cpus)
+	}
+
+	// Idle warm pools return their CPUs to the shared pool.
+	now = now.Add(30 * time.Second)
+	if policy.maintainWarmPools() {
+		t.Errorf("expected no changes before idle timeout")
+	}
+	now = now.Add(2 * time.Minute)
+
+	// Other requests only check for idle pools once a sampling round flags it.
+	policy.checkWarmPools()
+	if len(wp.sets) != 2 {
+		t.Errorf("expected no idle check before a sampling round, got %d warm CPU sets", len(wp.sets))
+	}
+	policy.sampleWarmPools(now)
+	policy.checkWarmPools()
+	if cpus := policy.root.FreeSupply().SharableCPUs(); !cpus.Equals(all) || len(wp.sets) != 0 {
+		t.Errorf("expected all CPUs %s shared, got %s, %d warm CPU sets", all, cpus, len(wp.sets))
+	}
+
+	// Idle warm pools are not refilled until they are asked for again.
+	if policy.maintainWarmPools() {
+		t.Errorf("expected idle warm pool not to be refilled")
+	}
+}
+
+func TestRebalanceShortWarmPool(t *testing.T) {
+	dir := t.TempDir()
+	if err := utils.UncompressTbz2(path.Join("testdata", "sysfs.tar.bz2"), dir); err != nil {
+		t.Fatalf("failed to uncompress test data: %v", err)
+	}
+	sys, err := system.DiscoverSystemAt(path.Join(dir, "sysfs", "server", "sys"))
+	if err != nil {
+		t.Fatalf("failed to discover test system: %v", err)
+	}
+	cch, err := cache.NewCache(cache.Options{CacheDir: t.TempDir(), Ephemeral: true})
+	if err != nil {
+		t.Fatalf("failed to create cache: %v", err)
+	}
+
+	reserved, _ := resapi.ParseQuantity("750m")
+	policy := CreateTopologyAwarePolicy(&policyapi.BackendOptions{
+		Cache:  cch,
+		System: sys,
+		Reserved: policyapi.ConstraintSet{
+			policyapi.DomainCPU: reserved,
+		},
+	}).(*policy)
+
+	// Use up almost all shared CPU of every leaf pool with burstable containers.
+	for _, n := range policy.pools {
+		if !n.IsLeafNode() {
+			continue
+		}
+		milliCPU := n.FreeSupply().AllocatableSharedCPU(true) - 500
+		id := "burstable-" + n.Name()
+		pod, err := cch.InsertPod(&api.PodSandbox{
+			Id:        id + "-pod",
+			Uid:       id + "-uid",
+			Name:      id,
+			Namespace: "default",
+			Linux: &api.LinuxPodSandbox{
+				CgroupParent: "/kubepods.slice/kubepods-burstable.slice/kubepods-burstable-" + id + ".slice",
+			},
+		})
+		if err != nil {
+			t.Fatalf("failed to create pod: %v", err)
+		}
+		c, err := cch.InsertContainer(&api.Container{
+			Id:           id,
+			PodSandboxId: pod.GetID(),
+			Name:         id,
+			State:        api.ContainerState_CONTAINER_CREATED,
+			Linux: &api.LinuxContainer{
+				Resources: &api.LinuxResources{
+					Cpu: &api.LinuxCPU{
+						Shares: &api.OptionalUInt64{Value: uint64(milliCPU) * 1024 / 1000},
+					},
+				},
+			},
+		})
+		if err != nil {
+			t.Fatalf("failed to create container: %v", err)
+		}
+		allocate(t, policy, c, n)
+	}
+
+	// A warm pool which can't be filled with the remaining shared CPU.
+	opt.WarmPools = []*WarmPool{
+		{
+			Name:       "latency",
+			Namespaces: []string{"latency-*"},
+			CPUs:       2,
+			Count:      1,
+		},
+	}
+	defer func() {
+		opt.WarmPools = nil
+	}()
+	policy.configureWarmPools()
+	wp := policy.warm["latency"]
+	if len(wp.sets) != 0 {
+		t.Fatalf("expected warm pool to stay empty, got %d sets", len(wp.sets))
+	}
+
+	// Rebalancing must not refill the warm pool with CPU it releases.
+	if _, err := policy.Rebalance(); err != nil {
+		t.Errorf("rebalancing failed: %v", err)
+	}
+	if len(wp.sets) != 0 {
+		t.Errorf("expected warm pool to stay empty after rebalancing, got %d sets", len(wp.sets))
+	}
+	for _, c := range cch.GetContainers() {
+		if _, ok := policy.allocations.grants[c.GetID()]; !ok {
+			t.Errorf("expected %s to stay allocated after rebalancing", c.GetID())
+		}
+	}
+}
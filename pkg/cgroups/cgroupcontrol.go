@@ -142,6 +142,15 @@ func (g Group) GetProcesses() ([]string, error) {
 	return g.readPids(Procs)
 }
 
+// GetThreads reads the pids of threads currently assigned to the group, from
+// either the v1 "tasks" or the v2 "cgroup.threads" entry.
+func (g Group) GetThreads() ([]string, error) {
+	if IsUnifiedHierarchy(mountDir) {
+		return g.readPids(Threads)
+	}
+	return g.readPids(Tasks)
+}
+
 // AddTasks writes the given thread pids to the group.
 func (g Group) AddTasks(pids ...string) error {
 	return g.writePids(Tasks, pids...)
@@ -26,6 +26,8 @@ const (
 	Tasks = "tasks"
 	// Procs is cgroup's "cgroup.procs" entry.
 	Procs = "cgroup.procs"
+	// Threads is a cgroup v2 "cgroup.threads" entry.
+	Threads = "cgroup.threads"
 	// CpuShares is the cpu controller's "cpu.shares" entry.
 	CpuShares = "cpu.shares"
 	// CpuPeriod is the cpu controller's "cpu.cfs_period_us" entry.
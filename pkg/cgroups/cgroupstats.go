@@ -15,16 +15,29 @@
 package cgroups
 
 import (
+	"bytes"
 	"fmt"
 	"io/ioutil"
 	"path"
 	"path/filepath"
 	"strconv"
 	"strings"
+	"time"
 
 	"github.com/containers/nri-plugins/pkg/sysfs"
 )
 
+// Names of the cgroup (v1) statistics files we parse.
+const (
+	BlkioThrottleBytesFile  = "blkio.throttle.io_service_bytes_recursive"
+	CPUAcctUsageFile        = "cpuacct.usage_all"
+	CPUAcctTotalUsageFile   = "cpuacct.usage"
+	CPUSetMemoryMigrateFile = "cpuset.memory_migrate"
+	MemoryUsageFile         = "memory.usage_in_bytes"
+	MemoryMaxUsageFile      = "memory.max_usage_in_bytes"
+	NumaStatFile            = "memory.numa_stat"
+)
+
 // BlkioDeviceBytes contains a single operations line of blkio.throttle.io_service_bytes_recursive file
 type BlkioDeviceBytes struct {
 	Major      int
@@ -87,14 +100,7 @@ type GlobalNumaStats struct {
 	OtherNode     int64
 }
 
-func readCgroupFileLines(filePath string) ([]string, error) {
-
-	f, err := ioutil.ReadFile(filePath)
-
-	if err != nil {
-		return nil, err
-	}
-
+func splitCgroupFileLines(f []byte) []string {
 	data := string(f)
 
 	rawLines := strings.Split(data, "\n")
@@ -108,38 +114,54 @@ func readCgroupFileLines(filePath string) ([]string, error) {
 		}
 	}
 
-	return lines, nil
+	return lines
 }
 
 func readCgroupSingleNumber(filePath string) (int64, error) {
+	data, err := ioutil.ReadFile(filePath)
+	if err != nil {
+		return 0, err
+	}
+
+	return ParseSingleNumber(data)
+}
+
+// ParseSingleNumber parses the contents of a single number cgroup file.
+func ParseSingleNumber(data []byte) (int64, error) {
 
 	// File looks like this:
 	//
 	// 4
 
-	lines, err := readCgroupFileLines(filePath)
-
-	if err != nil {
-		return 0, err
+	line, rest := nextLine(data)
+	if line == nil {
+		return 0, fmt.Errorf("error parsing file")
 	}
-
-	if len(lines) != 1 {
+	if extra, _ := nextLine(rest); extra != nil {
 		return 0, fmt.Errorf("error parsing file")
 	}
 
-	number, err := strconv.ParseInt(lines[0], 10, 64)
+	return parseInt(bytes.TrimSpace(line))
+}
+
+// GetBlkioThrottleBytes returns amount of bytes transferred to/from the disk.
+func GetBlkioThrottleBytes(cgroupPath string) (BlkioThrottleBytes, error) {
+	entry := path.Join(cgroupPath, BlkioThrottleBytesFile)
+	data, err := ioutil.ReadFile(entry)
 	if err != nil {
-		return 0, err
+		return BlkioThrottleBytes{}, err
+	}
+
+	result, err := ParseBlkioThrottleBytes(data)
+	if err != nil {
+		return BlkioThrottleBytes{}, fmt.Errorf("error parsing file %s: %w", entry, err)
 	}
 
-	return number, nil
+	return result, nil
 }
 
-// GetBlkioThrottleBytes returns amount of bytes transferred to/from the disk.
-func GetBlkioThrottleBytes(cgroupPath string) (BlkioThrottleBytes, error) {
-	const (
-		cgroupEntry = "blkio.throttle.io_service_bytes_recursive"
-	)
+// ParseBlkioThrottleBytes parses the contents of a blkio.throttle.io_service_bytes_recursive file.
+func ParseBlkioThrottleBytes(data []byte) (BlkioThrottleBytes, error) {
 
 	// File looks like this:
 	//
@@ -157,11 +179,7 @@ func GetBlkioThrottleBytes(cgroupPath string) (BlkioThrottleBytes, error) {
 	// 8:0 Total 7608309248
 	// Total 15039162880
 
-	entry := path.Join(cgroupPath, cgroupEntry)
-	lines, err := readCgroupFileLines(entry)
-	if err != nil {
-		return BlkioThrottleBytes{}, err
-	}
+	lines := splitCgroupFileLines(data)
 
 	if len(lines) == 1 && lines[0] == "Total 0" {
 		return BlkioThrottleBytes{}, nil
@@ -186,8 +204,8 @@ func GetBlkioThrottleBytes(cgroupPath string) (BlkioThrottleBytes, error) {
 			var dev *BlkioDeviceBytes
 
 			majmin := strings.Split(key, ":")
-			if len(majmin) != 2 {
-				return BlkioThrottleBytes{}, fmt.Errorf("error parsing file %s", entry)
+			if len(majmin) != 2 || len(split) != 3 {
+				return BlkioThrottleBytes{}, fmt.Errorf("invalid line %q", line)
 			}
 			maj64, err := strconv.ParseInt(string(majmin[0]), 10, 32)
 			if err != nil {
@@ -228,6 +246,85 @@ func GetBlkioThrottleBytes(cgroupPath string) (BlkioThrottleBytes, error) {
 
 // GetCPUAcctStats retrieves CPU account statistics for a given cgroup.
 func GetCPUAcctStats(cgroupPath string) ([]CPUAcctUsage, error) {
+	data, err := ioutil.ReadFile(path.Join(cgroupPath, CPUAcctUsageFile))
+	if err != nil {
+		return nil, err
+	}
+
+	return ParseCPUAcctStats(data)
+}
+
+// GetCPUUsage retrieves the total CPU time consumed by a cgroup, given
+// relative to the cgroup v1 controller or v2 unified hierarchy mount point.
+func GetCPUUsage(group string) (time.Duration, error) {
+	if IsUnifiedHierarchy(mountDir) {
+		stat, err := GetCPUStat(path.Join(mountDir, group))
+		if err != nil {
+			return 0, err
+		}
+		return time.Duration(stat.UsageUsec) * time.Microsecond, nil
+	}
+
+	usage, err := readCgroupSingleNumber(path.Join(Cpuacct.Path(), group, CPUAcctTotalUsageFile))
+	if err != nil {
+		return 0, err
+	}
+	return time.Duration(usage), nil
+}
+
+// Usage is the CPU and memory usage of a cgroup.
+type Usage struct {
+	// CPU is the total CPU time consumed.
+	CPU time.Duration
+	// CPUAcct is the per-CPU user and system time, with cgroup v1.
+	CPUAcct []CPUAcctUsage
+	// CPUStat is the CPU time statistics, with cgroup v2.
+	CPUStat CPUStat
+	// Memory is the memory usage, nil if it could not be read.
+	Memory *MemoryUsage
+}
+
+// GetUsage retrieves the CPU and memory usage of a cgroup, given relative to
+// the cgroup v1 controller or v2 unified hierarchy mount point. It fails only
+// if CPU usage can't be read.
+func GetUsage(group string) (Usage, error) {
+	var (
+		u   Usage
+		mem MemoryUsage
+		err error
+	)
+
+	if IsUnifiedHierarchy(mountDir) {
+		dir := path.Join(mountDir, group)
+		if u.CPUStat, err = GetCPUStat(dir); err != nil {
+			return Usage{}, err
+		}
+		u.CPU = time.Duration(u.CPUStat.UsageUsec) * time.Microsecond
+		mem, err = GetMemoryUsageV2(dir)
+	} else {
+		if u.CPUAcct, err = GetCPUAcctStats(path.Join(Cpuacct.Path(), group)); err != nil {
+			return Usage{}, err
+		}
+		for _, acct := range u.CPUAcct {
+			u.CPU += time.Duration(acct.User + acct.System)
+		}
+		mem, err = GetMemoryUsage(path.Join(Memory.Path(), group))
+	}
+	if err == nil {
+		u.Memory = &mem
+	}
+
+	return u, nil
+}
+
+// ParseCPUAcctStats parses the contents of a cpuacct.usage_all file.
+func ParseCPUAcctStats(data []byte) ([]CPUAcctUsage, error) {
+	return ParseCPUAcctStatsInto(data, nil)
+}
+
+// ParseCPUAcctStatsInto parses the contents of a cpuacct.usage_all file,
+// reusing the given slice for the result if it has enough capacity.
+func ParseCPUAcctStatsInto(data []byte, result []CPUAcctUsage) ([]CPUAcctUsage, error) {
 
 	// File looks like this:
 	//
@@ -235,28 +332,29 @@ func GetCPUAcctStats(cgroupPath string) ([]CPUAcctUsage, error) {
 	// 0 3723082232186 2456599218
 	// 1 3748398003001 1149546796
 
-	lines, err := readCgroupFileLines(path.Join(cgroupPath, "cpuacct.usage_all"))
-
-	if err != nil {
-		return nil, err
+	header, rest := nextLine(data)
+	if header == nil {
+		return nil, fmt.Errorf("error parsing file, missing header")
 	}
 
-	result := make([]CPUAcctUsage, 0, len(lines)-1)
+	result = result[:0]
 
-	for _, line := range lines[1:] {
-		tokens := strings.Split(line, " ")
-		if len(tokens) != 3 {
+	for line, rest := nextLine(rest); line != nil; line, rest = nextLine(rest) {
+		cpuField, tail := nextField(line)
+		userField, tail := nextField(tail)
+		systemField, tail := nextField(tail)
+		if len(systemField) == 0 || len(bytes.TrimSpace(tail)) != 0 {
 			continue
 		}
-		cpu, err := strconv.ParseInt(tokens[0], 10, 32)
+		cpu, err := parseInt(cpuField)
 		if err != nil {
 			return nil, err
 		}
-		user, err := strconv.ParseInt(tokens[1], 10, 64)
+		user, err := parseInt(userField)
 		if err != nil {
 			return nil, err
 		}
-		system, err := strconv.ParseInt(tokens[2], 10, 64)
+		system, err := parseInt(systemField)
 		if err != nil {
 			return nil, err
 		}
@@ -267,12 +365,22 @@ func GetCPUAcctStats(cgroupPath string) ([]CPUAcctUsage, error) {
 
 // GetCPUSetMemoryMigrate returns boolean indicating whether memory migration is enabled.
 func GetCPUSetMemoryMigrate(cgroupPath string) (bool, error) {
+	data, err := ioutil.ReadFile(path.Join(cgroupPath, CPUSetMemoryMigrateFile))
+	if err != nil {
+		return false, err
+	}
+
+	return ParseCPUSetMemoryMigrate(data)
+}
+
+// ParseCPUSetMemoryMigrate parses the contents of a cpuset.memory_migrate file.
+func ParseCPUSetMemoryMigrate(data []byte) (bool, error) {
 
 	// File looks like this:
 	//
 	// 0
 
-	number, err := readCgroupSingleNumber(path.Join(cgroupPath, "cpuset.memory_migrate"))
+	number, err := ParseSingleNumber(data)
 
 	if err != nil {
 		return false, err
@@ -287,41 +395,57 @@ func GetCPUSetMemoryMigrate(cgroupPath string) (bool, error) {
 	return false, fmt.Errorf("error parsing file")
 }
 
-// GetHugetlbUsage retrieves huge pages statistics for a given cgroup.
-func GetHugetlbUsage(cgroupPath string) ([]HugetlbUsage, error) {
+// HugetlbUsageFiles returns the usage and max usage files for hugepage sizes of a given cgroup.
+func HugetlbUsageFiles(cgroupPath string) (sizes, usage, maxUsage []string, err error) {
 	const (
 		prefix         = "/hugetlb."
 		usageSuffix    = ".usage_in_bytes"
 		maxUsageSuffix = ".max_usage_in_bytes"
 	)
 
+	usageFiles, err := filepath.Glob(path.Join(cgroupPath, prefix+"*"+usageSuffix))
+	if err != nil {
+		return nil, nil, nil, err
+	}
+
+	for _, file := range usageFiles {
+		if strings.Contains(filepath.Base(file), ".rsvd") {
+			// Skip reservations files.
+			continue
+		}
+		sizes = append(sizes, strings.SplitN(filepath.Base(file), ".", 3)[1])
+		usage = append(usage, file)
+		maxUsage = append(maxUsage, strings.TrimSuffix(file, usageSuffix)+maxUsageSuffix)
+	}
+
+	return sizes, usage, maxUsage, nil
+}
+
+// GetHugetlbUsage retrieves huge pages statistics for a given cgroup.
+func GetHugetlbUsage(cgroupPath string) ([]HugetlbUsage, error) {
+
 	// Files look like this:
 	//
 	// 124
 
-	usageFiles, err := filepath.Glob(path.Join(cgroupPath, prefix+"*"+usageSuffix))
+	sizes, usageFiles, maxUsageFiles, err := HugetlbUsageFiles(cgroupPath)
 	if err != nil {
 		return nil, err
 	}
 
 	result := make([]HugetlbUsage, 0, len(usageFiles))
 
-	for _, file := range usageFiles {
-		if strings.Contains(filepath.Base(file), ".rsvd") {
-			// Skip reservations files.
-			continue
-		}
-		size := strings.SplitN(filepath.Base(file), ".", 3)[1]
+	for idx, file := range usageFiles {
 		bytes, err := readCgroupSingleNumber(file)
 		if err != nil {
 			return nil, err
 		}
-		max, err := readCgroupSingleNumber(strings.TrimSuffix(file, usageSuffix) + maxUsageSuffix)
+		max, err := readCgroupSingleNumber(maxUsageFiles[idx])
 		if err != nil {
 			return nil, err
 		}
 		result = append(result, HugetlbUsage{
-			Size:     size,
+			Size:     sizes[idx],
 			Bytes:    bytes,
 			MaxBytes: max,
 		})
@@ -337,12 +461,12 @@ func GetMemoryUsage(cgroupPath string) (MemoryUsage, error) {
 	//
 	// 142
 
-	usage, err := readCgroupSingleNumber(path.Join(cgroupPath, "memory.usage_in_bytes"))
+	usage, err := readCgroupSingleNumber(path.Join(cgroupPath, MemoryUsageFile))
 	if err != nil {
 		return MemoryUsage{}, err
 	}
 
-	maxUsage, err := readCgroupSingleNumber(path.Join(cgroupPath, "memory.max_usage_in_bytes"))
+	maxUsage, err := readCgroupSingleNumber(path.Join(cgroupPath, MemoryMaxUsageFile))
 	if err != nil {
 		return MemoryUsage{}, err
 	}
@@ -357,9 +481,32 @@ func GetMemoryUsage(cgroupPath string) (MemoryUsage, error) {
 
 // GetNumaStats returns parsed cgroup NUMA statistics.
 func GetNumaStats(cgroupPath string) (NumaStat, error) {
-	const (
-		cgroupEntry = "memory.numa_stat"
-	)
+	entry := path.Join(cgroupPath, NumaStatFile)
+	data, err := ioutil.ReadFile(entry)
+	if err != nil {
+		return NumaStat{}, err
+	}
+
+	result, err := ParseNumaStats(data)
+	if err != nil {
+		return NumaStat{}, fmt.Errorf("error parsing file %s: %w", entry, err)
+	}
+
+	return result, nil
+}
+
+// ParseNumaStats parses the contents of a memory.numa_stat file.
+func ParseNumaStats(data []byte) (NumaStat, error) {
+	result := NumaStat{}
+	if err := ParseNumaStatsInto(data, &result); err != nil {
+		return NumaStat{}, err
+	}
+	return result, nil
+}
+
+// ParseNumaStatsInto parses the contents of a memory.numa_stat file into
+// result, reusing any per-node maps already present in it.
+func ParseNumaStatsInto(data []byte, result *NumaStat) error {
 
 	// File looks like this:
 	//
@@ -372,75 +519,60 @@ func GetNumaStats(cgroupPath string) (NumaStat, error) {
 	// hierarchical_anon=46096 N0=12597 N1=18890 N2=283 N3=14326
 	// hierarchical_unevictable=20 N0=0 N1=0 N2=0 N3=20
 
-	entry := path.Join(cgroupPath, cgroupEntry)
-	lines, err := readCgroupFileLines(entry)
-	if err != nil {
-		return NumaStat{}, err
-	}
-
-	result := NumaStat{}
-	for _, line := range lines {
-		split := strings.Split(line, " ")
-		if len(line) < 2 {
-			return NumaStat{}, fmt.Errorf("error parsing file %s", entry)
-		}
-
-		keytotal := strings.Split(split[0], "=")
-		if len(keytotal) != 2 {
-			return NumaStat{}, fmt.Errorf("error parsing file %s", entry)
-		}
-		key, tot := keytotal[0], keytotal[1]
-
-		total, err := strconv.ParseInt(tot, 10, 64)
-		if err != nil {
-			return NumaStat{}, fmt.Errorf("error parsing file %s: %v", entry, err)
+	for line, rest := nextLine(data); line != nil; line, rest = nextLine(rest) {
+		field, tail := nextField(line)
+		key, tot, ok := cutByte(field, '=')
+		if !ok {
+			return fmt.Errorf("invalid line %q", line)
 		}
 
-		nodes := make(map[string]int64)
-		for _, nodeEntry := range split[1:] {
-			nodeamount := strings.Split(nodeEntry, "=")
-			if len(nodeamount) != 2 {
-				return NumaStat{}, fmt.Errorf("error parsing file %s", entry)
-			}
-			node, amount := nodeamount[0], nodeamount[1]
-			number, err := strconv.ParseInt(amount, 10, 64)
-			if err != nil {
-				return NumaStat{}, fmt.Errorf("error parsing file %s: %v", entry, err)
-			}
-			nodes[node] = number
-		}
-
-		switch key {
+		var stat *NumaLine
+		switch string(key) {
 		case "total":
-			result.Total.Total = total
-			result.Total.Nodes = nodes
+			stat = &result.Total
 		case "file":
-			result.File.Total = total
-			result.File.Nodes = nodes
+			stat = &result.File
 		case "anon":
-			result.Anon.Total = total
-			result.Anon.Nodes = nodes
+			stat = &result.Anon
 		case "unevictable":
-			result.Unevictable.Total = total
-			result.Unevictable.Nodes = nodes
+			stat = &result.Unevictable
 		case "hierarchical_total":
-			result.HierarchicalTotal.Total = total
-			result.HierarchicalTotal.Nodes = nodes
+			stat = &result.HierarchicalTotal
 		case "hierarchical_file":
-			result.HierarchicalFile.Total = total
-			result.HierarchicalFile.Nodes = nodes
+			stat = &result.HierarchicalFile
 		case "hierarchical_anon":
-			result.HierarchicalAnon.Total = total
-			result.HierarchicalAnon.Nodes = nodes
+			stat = &result.HierarchicalAnon
 		case "hierarchical_unevictable":
-			result.HierarchicalUnevictable.Total = total
-			result.HierarchicalUnevictable.Nodes = nodes
+			stat = &result.HierarchicalUnevictable
 		default:
-			return NumaStat{}, fmt.Errorf("error parsing file, unknown key %s", key)
+			return fmt.Errorf("unknown key %s", key)
+		}
+
+		total, err := parseInt(tot)
+		if err != nil {
+			return err
+		}
+
+		stat.Total = total
+		stat.Nodes = resetNodes(stat.Nodes)
+		for len(tail) > 0 {
+			field, tail = nextField(tail)
+			if len(field) == 0 {
+				continue
+			}
+			node, amount, ok := cutByte(field, '=')
+			if !ok {
+				return fmt.Errorf("invalid line %q", line)
+			}
+			number, err := parseInt(amount)
+			if err != nil {
+				return err
+			}
+			stat.Nodes[nodeName(node)] = number
 		}
 	}
 
-	return result, nil
+	return nil
 }
 
 // GetGlobalNumaStats returns the global (non-cgroup) NUMA statistics per node.
@@ -0,0 +1,165 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func readFixture(tb testing.TB, name string) []byte {
+	data, err := os.ReadFile(filepath.Join("testdata", name))
+	if err != nil {
+		tb.Fatalf("failed to read fixture %s: %v", name, err)
+	}
+	return data
+}
+
+func TestParseFixtures(t *testing.T) {
+	numa, err := ParseNumaStats(readFixture(t, NumaStatFile))
+	if err != nil {
+		t.Fatalf("failed to parse %s: %v", NumaStatFile, err)
+	}
+	if len(numa.HierarchicalUnevictable.Nodes) != 4 {
+		t.Errorf("expected 4 NUMA nodes, got %v", numa.HierarchicalUnevictable.Nodes)
+	}
+
+	reused := numa
+	if err := ParseNumaStatsInto(readFixture(t, NumaStatFile), &reused); err != nil {
+		t.Fatalf("failed to reparse %s: %v", NumaStatFile, err)
+	}
+	if reused.Total.Total != numa.Total.Total || reused.Total.Nodes["N3"] != numa.Total.Nodes["N3"] {
+		t.Errorf("reparsed NUMA stats differ: %+v vs. %+v", reused.Total, numa.Total)
+	}
+
+	usage, err := ParseCPUAcctStats(readFixture(t, CPUAcctUsageFile))
+	if err != nil {
+		t.Fatalf("failed to parse %s: %v", CPUAcctUsageFile, err)
+	}
+	if len(usage) != 64 || usage[63].CPU != 63 {
+		t.Errorf("expected accounting for 64 CPUs, got %d", len(usage))
+	}
+
+	numaV2, err := ParseNumaStatsV2(readFixture(t, NumaStatFile+".v2"))
+	if err != nil {
+		t.Fatalf("failed to parse %s (v2): %v", NumaStatFile, err)
+	}
+	if numaV2.Total.Total != numaV2.Anon.Total+numaV2.File.Total+numaV2.Unevictable.Total {
+		t.Errorf("unexpected NUMA total %d", numaV2.Total.Total)
+	}
+
+	cpu, err := ParseCPUStat(readFixture(t, CPUStatFile))
+	if err != nil {
+		t.Fatalf("failed to parse %s: %v", CPUStatFile, err)
+	}
+	if cpu.UsageUsec != 1392733456 || cpu.NrThrottled != 1512 {
+		t.Errorf("unexpected CPU stats %+v", cpu)
+	}
+
+	for _, invalid := range []string{"", "1\n2\n", "x\n", "99999999999999999999\n"} {
+		if _, err := ParseSingleNumber([]byte(invalid)); err == nil {
+			t.Errorf("expected error for single number %q", invalid)
+		}
+	}
+	if n, err := ParseSingleNumber([]byte("-1\n")); err != nil || n != -1 {
+		t.Errorf("expected -1, got %d (error %v)", n, err)
+	}
+}
+
+func BenchmarkParseNumaStats(b *testing.B) {
+	data := readFixture(b, NumaStatFile)
+	stat := NumaStat{}
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if err := ParseNumaStatsInto(data, &stat); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkParseNumaStatsV2(b *testing.B) {
+	data := readFixture(b, NumaStatFile+".v2")
+	stat := NumaStat{}
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if err := ParseNumaStatsV2Into(data, &stat); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkParseCPUAcctStats(b *testing.B) {
+	data := readFixture(b, CPUAcctUsageFile)
+	var usage []CPUAcctUsage
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		var err error
+		if usage, err = ParseCPUAcctStatsInto(data, usage); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkParseCPUStat(b *testing.B) {
+	data := readFixture(b, CPUStatFile)
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := ParseCPUStat(data); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkParseSingleNumber(b *testing.B) {
+	data := []byte("4311810048\n")
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := ParseSingleNumber(data); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkReadNumaStats(b *testing.B) {
+	f, err := OpenStatFile(filepath.Join("testdata", NumaStatFile))
+	if err != nil {
+		b.Fatal(err)
+	}
+	defer f.Close()
+	stat := NumaStat{}
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		data, err := f.Read()
+		if err != nil {
+			b.Fatal(err)
+		}
+		if err := ParseNumaStatsInto(data, &stat); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
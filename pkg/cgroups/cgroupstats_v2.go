@@ -0,0 +1,320 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"fmt"
+	"os"
+	"path"
+	"path/filepath"
+	"strconv"
+	"strings"
+
+	"golang.org/x/sys/unix"
+)
+
+// Names of the cgroup v2 statistics files we parse.
+const (
+	CPUStatFile       = "cpu.stat"
+	IOStatFile        = "io.stat"
+	MemoryCurrentFile = "memory.current"
+	MemoryPeakFile    = "memory.peak"
+)
+
+// CPUStat has the parsed contents of a cgroup v2 cpu.stat file.
+type CPUStat struct {
+	UsageUsec     int64
+	UserUsec      int64
+	SystemUsec    int64
+	NrPeriods     int64
+	NrThrottled   int64
+	ThrottledUsec int64
+}
+
+// IsUnifiedHierarchy checks if the given directory is a cgroup v2 mount.
+func IsUnifiedHierarchy(dir string) bool {
+	var st unix.Statfs_t
+
+	if err := unix.Statfs(dir, &st); err != nil {
+		return false
+	}
+
+	return st.Type == unix.CGROUP2_SUPER_MAGIC
+}
+
+// ParseCPUStat parses the contents of a cgroup v2 cpu.stat file.
+func ParseCPUStat(data []byte) (CPUStat, error) {
+
+	// File looks like this:
+	//
+	// usage_usec 1392733
+	// user_usec 936336
+	// system_usec 456397
+	// nr_periods 0
+	// nr_throttled 0
+	// throttled_usec 0
+
+	result := CPUStat{}
+	err := scanFlatKeyed(data, func(key []byte, value int64) {
+		switch string(key) {
+		case "usage_usec":
+			result.UsageUsec = value
+		case "user_usec":
+			result.UserUsec = value
+		case "system_usec":
+			result.SystemUsec = value
+		case "nr_periods":
+			result.NrPeriods = value
+		case "nr_throttled":
+			result.NrThrottled = value
+		case "throttled_usec":
+			result.ThrottledUsec = value
+		}
+	})
+	if err != nil {
+		return CPUStat{}, err
+	}
+
+	return result, nil
+}
+
+// ParseIOStat parses the contents of a cgroup v2 io.stat file. The byte
+// counters are reported as Read, Write, Discard, and Total operations to
+// match the cgroup v1 blkio throttling statistics.
+func ParseIOStat(data []byte) (BlkioThrottleBytes, error) {
+
+	// File looks like this:
+	//
+	// 8:16 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0
+	// 8:0 rbytes=90430464 wbytes=299008000 rios=8950 wios=1252 dbytes=50331648 dios=3021
+
+	result := BlkioThrottleBytes{DeviceBytes: make([]*BlkioDeviceBytes, 0)}
+
+	for _, line := range splitCgroupFileLines(data) {
+		split := strings.Split(line, " ")
+
+		majmin := strings.Split(split[0], ":")
+		if len(majmin) != 2 {
+			return BlkioThrottleBytes{}, fmt.Errorf("invalid line %q", line)
+		}
+		major, err := strconv.ParseInt(majmin[0], 10, 32)
+		if err != nil {
+			return BlkioThrottleBytes{}, err
+		}
+		minor, err := strconv.ParseInt(majmin[1], 10, 32)
+		if err != nil {
+			return BlkioThrottleBytes{}, err
+		}
+
+		dev := &BlkioDeviceBytes{
+			Major:      int(major),
+			Minor:      int(minor),
+			Operations: make(map[string]int64),
+		}
+
+		for _, entry := range split[1:] {
+			keyval := strings.Split(entry, "=")
+			if len(keyval) != 2 {
+				return BlkioThrottleBytes{}, fmt.Errorf("invalid line %q", line)
+			}
+
+			var op string
+			switch keyval[0] {
+			case "rbytes":
+				op = "Read"
+			case "wbytes":
+				op = "Write"
+			case "dbytes":
+				op = "Discard"
+			default:
+				continue
+			}
+
+			bytes, err := strconv.ParseInt(keyval[1], 10, 64)
+			if err != nil {
+				return BlkioThrottleBytes{}, err
+			}
+			dev.Operations[op] = bytes
+		}
+
+		total := dev.Operations["Read"] + dev.Operations["Write"]
+		dev.Operations["Total"] = total
+		result.TotalBytes += total
+		result.DeviceBytes = append(result.DeviceBytes, dev)
+	}
+
+	return result, nil
+}
+
+// ParseNumaStatsV2 parses the contents of a cgroup v2 memory.numa_stat file.
+// Since cgroup v2 statistics are always hierarchical and reported in bytes,
+// the values are converted to pages and reported both as the plain and the
+// hierarchical statistics, to match the cgroup v1 NUMA statistics.
+func ParseNumaStatsV2(data []byte) (NumaStat, error) {
+	result := NumaStat{}
+	if err := ParseNumaStatsV2Into(data, &result); err != nil {
+		return NumaStat{}, err
+	}
+	return result, nil
+}
+
+// ParseNumaStatsV2Into parses the contents of a cgroup v2 memory.numa_stat
+// file into result, reusing any per-node maps already present in it.
+func ParseNumaStatsV2Into(data []byte, result *NumaStat) error {
+
+	// File looks like this:
+	//
+	// anon N0=2289664 N1=0
+	// file N0=17149952 N1=0
+	// kernel_stack N0=16384 N1=0
+	// ...
+	// unevictable N0=0 N1=0
+	// ...
+
+	pageSize := int64(os.Getpagesize())
+
+	result.Total.Total = 0
+	result.Total.Nodes = resetNodes(result.Total.Nodes)
+
+	for line, rest := nextLine(data); line != nil; line, rest = nextLine(rest) {
+		key, tail := nextField(line)
+
+		var stat *NumaLine
+		switch string(key) {
+		case "anon":
+			stat = &result.Anon
+		case "file":
+			stat = &result.File
+		case "unevictable":
+			stat = &result.Unevictable
+		default:
+			continue
+		}
+
+		stat.Total = 0
+		stat.Nodes = resetNodes(stat.Nodes)
+		for len(tail) > 0 {
+			var field []byte
+			field, tail = nextField(tail)
+			if len(field) == 0 {
+				continue
+			}
+			node, amount, ok := cutByte(field, '=')
+			if !ok {
+				return fmt.Errorf("invalid line %q", line)
+			}
+			bytes, err := parseInt(amount)
+			if err != nil {
+				return err
+			}
+			name := nodeName(node)
+			pages := bytes / pageSize
+			stat.Nodes[name] = pages
+			stat.Total += pages
+			result.Total.Nodes[name] += pages
+			result.Total.Total += pages
+		}
+	}
+
+	// The hierarchical values share the per-node maps with the plain ones.
+	result.HierarchicalTotal = result.Total
+	result.HierarchicalFile = result.File
+	result.HierarchicalAnon = result.Anon
+	result.HierarchicalUnevictable = result.Unevictable
+
+	return nil
+}
+
+// HugetlbCurrentFiles returns the current usage files for hugepage sizes of a given cgroup v2 cgroup.
+func HugetlbCurrentFiles(cgroupPath string) (sizes, current []string, err error) {
+	const (
+		prefix        = "/hugetlb."
+		currentSuffix = ".current"
+	)
+
+	files, err := filepath.Glob(path.Join(cgroupPath, prefix+"*"+currentSuffix))
+	if err != nil {
+		return nil, nil, err
+	}
+
+	for _, file := range files {
+		if strings.Contains(filepath.Base(file), ".rsvd") {
+			// Skip reservations files.
+			continue
+		}
+		sizes = append(sizes, strings.SplitN(filepath.Base(file), ".", 3)[1])
+		current = append(current, file)
+	}
+
+	return sizes, current, nil
+}
+
+// GetCPUStat retrieves CPU statistics for a given cgroup v2 cgroup.
+func GetCPUStat(cgroupPath string) (CPUStat, error) {
+	data, err := os.ReadFile(path.Join(cgroupPath, CPUStatFile))
+	if err != nil {
+		return CPUStat{}, err
+	}
+
+	return ParseCPUStat(data)
+}
+
+// GetIOStat retrieves I/O statistics for a given cgroup v2 cgroup.
+func GetIOStat(cgroupPath string) (BlkioThrottleBytes, error) {
+	data, err := os.ReadFile(path.Join(cgroupPath, IOStatFile))
+	if err != nil {
+		return BlkioThrottleBytes{}, err
+	}
+
+	return ParseIOStat(data)
+}
+
+// GetMemoryUsageV2 retrieves memory usage for a given cgroup v2 cgroup.
+// MaxBytes is set to -1 if the kernel does not provide peak memory usage.
+func GetMemoryUsageV2(cgroupPath string) (MemoryUsage, error) {
+	usage, err := readCgroupSingleNumber(path.Join(cgroupPath, MemoryCurrentFile))
+	if err != nil {
+		return MemoryUsage{}, err
+	}
+
+	maxUsage, err := readCgroupSingleNumber(path.Join(cgroupPath, MemoryPeakFile))
+	if err != nil {
+		if !os.IsNotExist(err) {
+			return MemoryUsage{}, err
+		}
+		maxUsage = -1
+	}
+
+	return MemoryUsage{
+		Bytes:    usage,
+		MaxBytes: maxUsage,
+	}, nil
+}
+
+// GetNumaStatsV2 returns parsed NUMA statistics for a given cgroup v2 cgroup.
+func GetNumaStatsV2(cgroupPath string) (NumaStat, error) {
+	entry := path.Join(cgroupPath, NumaStatFile)
+	data, err := os.ReadFile(entry)
+	if err != nil {
+		return NumaStat{}, err
+	}
+
+	result, err := ParseNumaStatsV2(data)
+	if err != nil {
+		return NumaStat{}, fmt.Errorf("error parsing file %s: %w", entry, err)
+	}
+
+	return result, nil
+}
@@ -0,0 +1,98 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"os"
+	"strconv"
+	"testing"
+)
+
+func TestParseCPUStat(t *testing.T) {
+	data := []byte("usage_usec 1392733\nuser_usec 936336\nsystem_usec 456397\n" +
+		"core_sched.force_idle_usec 0\nnr_periods 10\nnr_throttled 2\nthrottled_usec 300\n")
+
+	stat, err := ParseCPUStat(data)
+	if err != nil {
+		t.Fatalf("failed to parse cpu.stat: %v", err)
+	}
+
+	expected := CPUStat{
+		UsageUsec:     1392733,
+		UserUsec:      936336,
+		SystemUsec:    456397,
+		NrPeriods:     10,
+		NrThrottled:   2,
+		ThrottledUsec: 300,
+	}
+	if stat != expected {
+		t.Errorf("expected %+v, got %+v", expected, stat)
+	}
+}
+
+func TestParseIOStat(t *testing.T) {
+	data := []byte("8:16 rbytes=100 wbytes=200 rios=1 wios=2 dbytes=0 dios=0\n" +
+		"8:0 rbytes=1000 wbytes=2000 rios=10 wios=20 dbytes=300 dios=3\n")
+
+	stat, err := ParseIOStat(data)
+	if err != nil {
+		t.Fatalf("failed to parse io.stat: %v", err)
+	}
+
+	if len(stat.DeviceBytes) != 2 {
+		t.Fatalf("expected 2 devices, got %d", len(stat.DeviceBytes))
+	}
+	dev := stat.DeviceBytes[1]
+	if dev.Major != 8 || dev.Minor != 0 {
+		t.Errorf("expected device 8:0, got %d:%d", dev.Major, dev.Minor)
+	}
+	if dev.Operations["Read"] != 1000 || dev.Operations["Write"] != 2000 ||
+		dev.Operations["Discard"] != 300 || dev.Operations["Total"] != 3000 {
+		t.Errorf("unexpected device 8:0 operations %v", dev.Operations)
+	}
+	if stat.TotalBytes != 3300 {
+		t.Errorf("expected 3300 total bytes, got %d", stat.TotalBytes)
+	}
+}
+
+func TestParseNumaStatsV2(t *testing.T) {
+	page := int64(os.Getpagesize())
+	data := []byte("anon N0=" + itoa(2*page) + " N1=0\n" +
+		"file N0=" + itoa(3*page) + " N1=" + itoa(page) + "\n" +
+		"kernel_stack N0=16384 N1=0\n" +
+		"unevictable N0=0 N1=0\n")
+
+	stat, err := ParseNumaStatsV2(data)
+	if err != nil {
+		t.Fatalf("failed to parse memory.numa_stat: %v", err)
+	}
+
+	if stat.Anon.Total != 2 || stat.Anon.Nodes["N0"] != 2 {
+		t.Errorf("unexpected anon stats %+v", stat.Anon)
+	}
+	if stat.File.Total != 4 || stat.File.Nodes["N1"] != 1 {
+		t.Errorf("unexpected file stats %+v", stat.File)
+	}
+	if stat.Total.Total != 6 || stat.Total.Nodes["N0"] != 5 || stat.Total.Nodes["N1"] != 1 {
+		t.Errorf("unexpected total stats %+v", stat.Total)
+	}
+	if stat.HierarchicalTotal.Total != stat.Total.Total {
+		t.Errorf("expected hierarchical total to match total")
+	}
+}
+
+func itoa(v int64) string {
+	return strconv.FormatInt(v, 10)
+}
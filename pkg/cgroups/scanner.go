@@ -0,0 +1,148 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"bytes"
+	"fmt"
+	"math"
+	"strconv"
+)
+
+//
+// Allocation-free scanning of cgroup statistics files. These helpers
+// operate directly on the raw file content, handing out subslices of it
+// instead of strings, so parsing a file does not allocate unless the
+// results themselves need to be allocated.
+//
+
+const (
+	// number of preallocated NUMA node names
+	numNodeNames = 64
+)
+
+// nodeNames are preallocated NUMA node names, N0, N1, ...
+var nodeNames = func() []string {
+	names := make([]string, numNodeNames)
+	for i := range names {
+		names[i] = "N" + strconv.Itoa(i)
+	}
+	return names
+}()
+
+// nextLine returns the next non-empty line of data and the rest of data.
+func nextLine(data []byte) (line, rest []byte) {
+	for len(data) > 0 {
+		if i := bytes.IndexByte(data, '\n'); i >= 0 {
+			line, data = data[:i], data[i+1:]
+		} else {
+			line, data = data, nil
+		}
+		if len(bytes.TrimSpace(line)) > 0 {
+			return line, data
+		}
+	}
+	return nil, nil
+}
+
+// nextField returns the next space-separated field of line and the rest of line.
+func nextField(line []byte) (field, rest []byte) {
+	for len(line) > 0 && (line[0] == ' ' || line[0] == '\t') {
+		line = line[1:]
+	}
+	for i, c := range line {
+		if c == ' ' || c == '\t' {
+			return line[:i], line[i+1:]
+		}
+	}
+	return line, nil
+}
+
+// cutByte splits b around the first instance of sep.
+func cutByte(b []byte, sep byte) (before, after []byte, found bool) {
+	if i := bytes.IndexByte(b, sep); i >= 0 {
+		return b[:i], b[i+1:], true
+	}
+	return b, nil, false
+}
+
+// parseInt parses a decimal integer.
+func parseInt(b []byte) (int64, error) {
+	neg := false
+	if len(b) > 0 && (b[0] == '-' || b[0] == '+') {
+		neg = b[0] == '-'
+		b = b[1:]
+	}
+	if len(b) == 0 {
+		return 0, fmt.Errorf("invalid number %q", b)
+	}
+
+	var n uint64
+	for _, c := range b {
+		if c < '0' || c > '9' {
+			return 0, fmt.Errorf("invalid number %q", b)
+		}
+		d := uint64(c - '0')
+		if n > (math.MaxInt64-d)/10 {
+			return 0, fmt.Errorf("number %q out of range", b)
+		}
+		n = n*10 + d
+	}
+
+	if neg {
+		return -int64(n), nil
+	}
+	return int64(n), nil
+}
+
+// nodeName returns the NUMA node name for b, avoiding allocation for common names.
+func nodeName(b []byte) string {
+	if len(b) > 1 && b[0] == 'N' {
+		if id, err := parseInt(b[1:]); err == nil && id >= 0 && id < numNodeNames &&
+			nodeNames[id] == string(b) {
+			return nodeNames[id]
+		}
+	}
+	return string(b)
+}
+
+// resetNodes prepares a map for per-node values, reusing it if possible.
+func resetNodes(nodes map[string]int64) map[string]int64 {
+	if nodes == nil {
+		return make(map[string]int64)
+	}
+	for node := range nodes {
+		delete(nodes, node)
+	}
+	return nodes
+}
+
+// scanFlatKeyed scans a flat keyed file of "key value" lines, like cpu.stat
+// or memory.stat, calling fn for every entry.
+func scanFlatKeyed(data []byte, fn func(key []byte, value int64)) error {
+	for line, rest := nextLine(data); line != nil; line, rest = nextLine(rest) {
+		key, tail := nextField(line)
+		val, tail := nextField(tail)
+		if len(key) == 0 || len(val) == 0 || len(bytes.TrimSpace(tail)) != 0 {
+			return fmt.Errorf("invalid line %q", line)
+		}
+		value, err := parseInt(val)
+		if err != nil {
+			return err
+		}
+		fn(key, value)
+	}
+	return nil
+}
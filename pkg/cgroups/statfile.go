@@ -0,0 +1,80 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"errors"
+	"io"
+	"os"
+)
+
+const (
+	// initial read buffer size for a StatFile
+	statFileBufSize = 4096
+)
+
+// StatFile is a cgroup statistics file kept open for repeated reading.
+// Each Read re-reads the full content of the file from offset 0 with
+// pread(2), so neither open(2) nor a fresh buffer is needed per read.
+// A StatFile is not safe for concurrent use.
+type StatFile struct {
+	path string
+	file *os.File
+	buf  []byte
+}
+
+// OpenStatFile opens the given cgroup statistics file.
+func OpenStatFile(path string) (*StatFile, error) {
+	file, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	return &StatFile{
+		path: path,
+		file: file,
+		buf:  make([]byte, statFileBufSize),
+	}, nil
+}
+
+// Path returns the path of the file.
+func (f *StatFile) Path() string {
+	return f.path
+}
+
+// Read reads the current content of the file. The returned data is only
+// valid until the next call to Read.
+func (f *StatFile) Read() ([]byte, error) {
+	for {
+		n, err := f.file.ReadAt(f.buf, 0)
+		if err != nil && !errors.Is(err, io.EOF) {
+			return nil, err
+		}
+		if n < len(f.buf) {
+			return f.buf[:n], nil
+		}
+		// Buffer full, content might have been truncated. Grow and retry.
+		f.buf = make([]byte, 2*len(f.buf))
+	}
+}
+
+// Close closes the file.
+func (f *StatFile) Close() error {
+	if f == nil || f.file == nil {
+		return nil
+	}
+	err := f.file.Close()
+	f.file = nil
+	return err
+}
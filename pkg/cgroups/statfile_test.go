@@ -0,0 +1,99 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroups
+
+import (
+	"bytes"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func TestStatFileReread(t *testing.T) {
+	tcases := []struct {
+		name     string
+		contents [][]byte
+	}{
+		{
+			name:     "unchanged content",
+			contents: [][]byte{[]byte("1\n"), []byte("1\n")},
+		},
+		{
+			name:     "shrinking content",
+			contents: [][]byte{[]byte("123456\n"), []byte("7\n")},
+		},
+		{
+			name: "content larger than initial buffer",
+			contents: [][]byte{
+				[]byte("1\n"),
+				bytes.Repeat([]byte("total=1 N0=1\n"), 2*statFileBufSize/13),
+			},
+		},
+	}
+
+	for _, tc := range tcases {
+		t.Run(tc.name, func(t *testing.T) {
+			path := filepath.Join(t.TempDir(), "stat")
+			if err := os.WriteFile(path, tc.contents[0], 0644); err != nil {
+				t.Fatalf("failed to write %s: %v", path, err)
+			}
+
+			f, err := OpenStatFile(path)
+			if err != nil {
+				t.Fatalf("failed to open %s: %v", path, err)
+			}
+			defer f.Close()
+
+			for i, content := range tc.contents {
+				if i > 0 {
+					if err := os.WriteFile(path, content, 0644); err != nil {
+						t.Fatalf("failed to write %s: %v", path, err)
+					}
+				}
+				data, err := f.Read()
+				if err != nil {
+					t.Fatalf("failed to read %s: %v", path, err)
+				}
+				if !bytes.Equal(data, content) {
+					t.Errorf("read #%d: expected %q, got %q", i, content, data)
+				}
+			}
+		})
+	}
+}
+
+func TestParseNumaStats(t *testing.T) {
+	data := []byte("total=44611 N0=32631 N1=7501\n" +
+		"file=44428 N0=32614 N1=7335\n" +
+		"hierarchical_anon=46096 N0=12597 N1=18890\n")
+
+	stats, err := ParseNumaStats(data)
+	if err != nil {
+		t.Fatalf("failed to parse NUMA stats: %v", err)
+	}
+	if stats.Total.Total != 44611 || stats.Total.Nodes["N1"] != 7501 {
+		t.Errorf("unexpected total stats %+v", stats.Total)
+	}
+	if stats.File.Total != 44428 || stats.File.Nodes["N0"] != 32614 {
+		t.Errorf("unexpected file stats %+v", stats.File)
+	}
+	if stats.HierarchicalAnon.Nodes["N1"] != 18890 {
+		t.Errorf("unexpected hierarchical anon stats %+v", stats.HierarchicalAnon)
+	}
+
+	if _, err := ParseNumaStats([]byte("bogus=1 N0=1\n")); err == nil {
+		t.Errorf("expected error for unknown key")
+	}
+}
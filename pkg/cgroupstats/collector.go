@@ -16,11 +16,10 @@ package cgroupstats
 
 import (
 	"flag"
-	"os"
 	"path/filepath"
 	"regexp"
+	"runtime"
 	"strconv"
-	"strings"
 	"sync"
 
 	"github.com/containers/nri-plugins/pkg/cgroups"
@@ -100,7 +99,7 @@ var descriptors = [numDescriptors]*prometheus.Desc{
 }
 
 var (
-	// cgroupRoot is the mount point for the cgroup (v1) filesystem
+	// cgroupRoot is the mount point for the cgroup (v1 or v2) filesystem
 	cgroupRoot = "/sys/fs/cgroup"
 	// our logger instance
 	log = logger.NewLogger("cgroupstats")
@@ -108,9 +107,49 @@ var (
 
 const (
 	kubepodsDir = "kubepods.slice"
+	// maxCollectWorkers is the maximum number of containers to collect concurrently.
+	maxCollectWorkers = 8
 )
 
+var (
+	containerIDRegexp = regexp.MustCompile(`[a-z0-9]{64}`)
+)
+
+// UsageSource provides CPU and memory usage of containers read elsewhere,
+// typically by the shared sampler of the resource manager, so that we don't
+// need to read the same cgroup files again on every scrape.
+type UsageSource interface {
+	// Usage returns the latest usage of the container with the given ID.
+	Usage(id string) (cgroups.Usage, bool)
+}
+
+var (
+	usageLock   sync.RWMutex
+	usageSource UsageSource
+)
+
+// SetUsageSource sets the source of already sampled container usage.
+func SetUsageSource(src UsageSource) {
+	usageLock.Lock()
+	defer usageLock.Unlock()
+	usageSource = src
+}
+
+// sampledUsage returns the sampled usage of a container, if any.
+func sampledUsage(id string) (cgroups.Usage, bool) {
+	usageLock.RLock()
+	defer usageLock.RUnlock()
+	if usageSource == nil {
+		return cgroups.Usage{}, false
+	}
+	return usageSource.Usage(id)
+}
+
 type collector struct {
+	sync.Mutex
+	watcher    *cgroupWatcher            // tracks the set of container cgroups
+	containers map[string]containerStats // containers by cgroup path
+	unified    bool                      // whether cgroup v2 is used
 }
 
 // NewCollector creates new Prometheus collector
@@ -148,6 +187,22 @@ func updateCPUAcctUsageMetric(ch chan<- prometheus.Metric, path string, metric [
 	}
 }
 
+func updateCPUStatMetric(ch chan<- prometheus.Metric, path string, metric cgroups.CPUStat) {
+	// cgroup v2 has no per-CPU accounting, report totals in nanoseconds like cpuacct.
+	ch <- prometheus.MustNewConstMetric(
+		descriptors[cpuAcctUsageDesc],
+		prometheus.CounterValue,
+		float64(metric.UserUsec*1000),
+		path, "total", "User",
+	)
+	ch <- prometheus.MustNewConstMetric(
+		descriptors[cpuAcctUsageDesc],
+		prometheus.CounterValue,
+		float64(metric.SystemUsec*1000),
+		path, "total", "System",
+	)
+}
+
 func updateMemoryMigrateMetric(ch chan<- prometheus.Metric, path string, migrate bool) {
 	migrateValue := 0
 	if migrate {
@@ -168,6 +223,10 @@ func updateMemoryUsageMetric(ch chan<- prometheus.Metric, path string, metric cg
 		float64(metric.Bytes),
 		path, "Bytes",
 	)
+	if metric.MaxBytes < 0 {
+		// not available (cgroup v2 without memory.peak)
+		return
+	}
 	ch <- prometheus.MustNewConstMetric(
 		descriptors[memoryUsageDesc],
 		prometheus.GaugeValue,
@@ -254,6 +313,10 @@ func updateHugeTlbUsageMetric(ch chan<- prometheus.Metric, path string, metric [
 			float64(hugeTlbUsage.Bytes),
 			path, hugeTlbUsage.Size, "Bytes",
 		)
+		if hugeTlbUsage.MaxBytes < 0 {
+			// not available (cgroup v2)
+			continue
+		}
 		ch <- prometheus.MustNewConstMetric(
 			descriptors[hugeTlbUsageDesc],
 			prometheus.GaugeValue,
@@ -277,126 +340,324 @@ func updateBlkioDeviceUsageMetric(ch chan<- prometheus.Metric, path string, metr
 	}
 }
 
-func walkCgroups() []string {
-	// XXX TODO: add support for kubelet cgroupfs cgroup driver.
+func cgroupPath(controller, path string) string {
+	return filepath.Join(cgroupRoot, controller, path)
+}
 
-	containerDirs := []string{}
+// containerStats collects statistics for a single container.
+type containerStats interface {
+	// collect collects all statistics of the container.
+	collect(ch chan<- prometheus.Metric)
+	// close closes any open statistics files of the container.
+	close()
+}
 
-	cpuset := filepath.Join(cgroupRoot, "cpuset")
-	filepath.Walk(filepath.Join(cpuset, kubepodsDir),
-		func(path string, info os.FileInfo, err error) error {
-			if err != nil {
-				if os.IsNotExist(err) {
-					return nil
-				}
-				return err
-			}
-			if !info.IsDir() {
-				return nil
-			}
+// v1ContainerStats has the open cgroup v1 statistics files of a single container.
+type v1ContainerStats struct {
+	path      string                 // cgroup path relative to controller mount point
+	id        string                 // container ID
+	numa      *cgroups.StatFile      // NUMA statistics
+	usage     *cgroups.StatFile      // memory usage
+	maxUsage  *cgroups.StatFile      // max. memory usage
+	migrate   *cgroups.StatFile      // cpuset memory migration
+	cpuAcct   *cgroups.StatFile      // CPU accounting
+	blkio     *cgroups.StatFile      // blkio throttling statistics
+	hugeSizes []string               // huge page sizes
+	hugeUsage []*cgroups.StatFile    // hugetlb usage per size
+	hugeMax   []*cgroups.StatFile    // max. hugetlb usage per size
+	hugeFound bool                   // whether hugetlb files have been looked up
+	numaStat  cgroups.NumaStat       // reused parsed NUMA statistics
+	cpuUsage  []cgroups.CPUAcctUsage // reused parsed CPU accounting
+}
 
-			dir := info.Name()
-			if !strings.HasSuffix(dir, ".scope") {
-				return nil
-			}
+// readStatFile reads the given statistics file, opening it if necessary.
+func readStatFile(f **cgroups.StatFile, path string) ([]byte, error) {
+	if *f == nil {
+		sf, err := cgroups.OpenStatFile(path)
+		if err != nil {
+			return nil, err
+		}
+		*f = sf
+	}
 
-			switch {
-			case strings.HasPrefix(dir, "cri-containerd-"):
-				break
-			case strings.HasPrefix(dir, "crio-"):
-				break
-			case strings.HasPrefix(dir, "docker-"):
-				break
-			default:
-				return filepath.SkipDir
-			}
+	data, err := (*f).Read()
+	if err != nil {
+		(*f).Close()
+		*f = nil
+		return nil, err
+	}
 
-			path = strings.TrimPrefix(path, cpuset+"/")
-			containerDirs = append(containerDirs, path)
+	return data, nil
+}
 
-			return nil
-		})
+// containerID extracts the container ID from a container cgroup path.
+func containerID(path string) string {
+	base := filepath.Base(path)
+	if id := containerIDRegexp.FindString(base); id != "" {
+		return id
+	}
+	return base
+}
 
-	return containerDirs
+func newV1ContainerStats(path string) *v1ContainerStats {
+	return &v1ContainerStats{
+		path: path,
+		id:   containerID(path),
+	}
 }
 
-func cgroupPath(controller, path string) string {
-	return filepath.Join(cgroupRoot, controller, path)
+// read reads the given statistics file, opening it if necessary.
+func (s *v1ContainerStats) read(f **cgroups.StatFile, controller, file string) ([]byte, error) {
+	return readStatFile(f, filepath.Join(cgroupPath(controller, s.path), file))
 }
 
-// Collect implements prometheus.Collector interface
-func (c collector) Collect(ch chan<- prometheus.Metric) {
-	var wg sync.WaitGroup
+func (s *v1ContainerStats) readNumber(f **cgroups.StatFile, controller, file string) (int64, error) {
+	data, err := s.read(f, controller, file)
+	if err != nil {
+		return 0, err
+	}
+	return cgroups.ParseSingleNumber(data)
+}
 
-	// We don't bail out on errors because those can happen if there is a race condition between
-	// the destruction of a container and us getting to read the cgroup data. We just don't report
-	// the values we don't get.
+func (s *v1ContainerStats) getNumaStats() (cgroups.NumaStat, error) {
+	data, err := s.read(&s.numa, "memory", cgroups.NumaStatFile)
+	if err != nil {
+		return cgroups.NumaStat{}, err
+	}
+	if err := cgroups.ParseNumaStatsInto(data, &s.numaStat); err != nil {
+		return cgroups.NumaStat{}, err
+	}
+	return s.numaStat, nil
+}
 
-	collectors := []func(string, *regexp.Regexp){
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			numa, err := cgroups.GetNumaStats(cgroupPath("memory", path))
-			if err == nil {
-				updateNumaStatMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], numa)
-			} else {
-				log.Error("failed to collect NUMA stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			memory, err := cgroups.GetMemoryUsage(cgroupPath("memory", path))
-			if err == nil {
-				updateMemoryUsageMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], memory)
-			} else {
-				log.Error("failed to collect memory usage stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			migrate, err := cgroups.GetCPUSetMemoryMigrate(cgroupPath("cpuset", path))
-			if err == nil {
-				updateMemoryMigrateMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], migrate)
-			} else {
-				log.Error("failed to collect memory migration stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			cpuAcctUsage, err := cgroups.GetCPUAcctStats(cgroupPath("cpuacct", path))
-			if err == nil {
-				updateCPUAcctUsageMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], cpuAcctUsage)
-			} else {
-				log.Error("failed to collect CPU accounting stats for %s: %v", path, err)
-			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			hugeTlbUsage, err := cgroups.GetHugetlbUsage(cgroupPath("hugetlb", path))
+func (s *v1ContainerStats) getMemoryUsage() (cgroups.MemoryUsage, error) {
+	usage, err := s.readNumber(&s.usage, "memory", cgroups.MemoryUsageFile)
+	if err != nil {
+		return cgroups.MemoryUsage{}, err
+	}
+	maxUsage, err := s.readNumber(&s.maxUsage, "memory", cgroups.MemoryMaxUsageFile)
+	if err != nil {
+		return cgroups.MemoryUsage{}, err
+	}
+	return cgroups.MemoryUsage{Bytes: usage, MaxBytes: maxUsage}, nil
+}
+
+func (s *v1ContainerStats) getMemoryMigrate() (bool, error) {
+	data, err := s.read(&s.migrate, "cpuset", cgroups.CPUSetMemoryMigrateFile)
+	if err != nil {
+		return false, err
+	}
+	return cgroups.ParseCPUSetMemoryMigrate(data)
+}
+
+func (s *v1ContainerStats) getCPUAcctUsage() ([]cgroups.CPUAcctUsage, error) {
+	data, err := s.read(&s.cpuAcct, "cpuacct", cgroups.CPUAcctUsageFile)
+	if err != nil {
+		return nil, err
+	}
+	s.cpuUsage, err = cgroups.ParseCPUAcctStatsInto(data, s.cpuUsage)
+	if err != nil {
+		return nil, err
+	}
+	return s.cpuUsage, nil
+}
+
+func (s *v1ContainerStats) getHugetlbUsage() ([]cgroups.HugetlbUsage, error) {
+	if !s.hugeFound {
+		sizes, usage, maxUsage, err := cgroups.HugetlbUsageFiles(cgroupPath("hugetlb", s.path))
+		if err != nil {
+			return nil, err
+		}
+		s.hugeSizes = sizes
+		s.hugeUsage = make([]*cgroups.StatFile, len(usage))
+		s.hugeMax = make([]*cgroups.StatFile, len(maxUsage))
+		for i := range usage {
+			s.hugeUsage[i], err = cgroups.OpenStatFile(usage[i])
 			if err == nil {
-				updateHugeTlbUsageMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], hugeTlbUsage)
-			} else {
-				log.Error("failed to collect hugetlb stats for %s: %v", path, err)
+				s.hugeMax[i], err = cgroups.OpenStatFile(maxUsage[i])
 			}
-		},
-		func(path string, re *regexp.Regexp) {
-			defer wg.Done()
-			blkioDeviceUsage, err := cgroups.GetBlkioThrottleBytes(cgroupPath("blkio", path))
-			if err == nil {
-				updateBlkioDeviceUsageMetric(ch, re.FindStringSubmatch(filepath.Base(path))[0], blkioDeviceUsage)
-			} else {
-				log.Error("failed to collect blkio stats for %s: %v", path, err)
+			if err != nil {
+				s.closeHugetlb()
+				return nil, err
 			}
-		},
+		}
+		s.hugeFound = true
 	}
 
-	containerIDRegexp := regexp.MustCompile(`[a-z0-9]{64}`)
+	result := make([]cgroups.HugetlbUsage, 0, len(s.hugeSizes))
+	for i, size := range s.hugeSizes {
+		usage, err := s.hugeUsage[i].Read()
+		if err != nil {
+			s.closeHugetlb()
+			return nil, err
+		}
+		bytes, err := cgroups.ParseSingleNumber(usage)
+		if err != nil {
+			return nil, err
+		}
+		maxUsage, err := s.hugeMax[i].Read()
+		if err != nil {
+			s.closeHugetlb()
+			return nil, err
+		}
+		max, err := cgroups.ParseSingleNumber(maxUsage)
+		if err != nil {
+			return nil, err
+		}
+		result = append(result, cgroups.HugetlbUsage{
+			Size:     size,
+			Bytes:    bytes,
+			MaxBytes: max,
+		})
+	}
+
+	return result, nil
+}
+
+func (s *v1ContainerStats) getBlkioThrottleBytes() (cgroups.BlkioThrottleBytes, error) {
+	data, err := s.read(&s.blkio, "blkio", cgroups.BlkioThrottleBytesFile)
+	if err != nil {
+		return cgroups.BlkioThrottleBytes{}, err
+	}
+	return cgroups.ParseBlkioThrottleBytes(data)
+}
+
+// collect collects all statistics of the container.
+func (s *v1ContainerStats) collect(ch chan<- prometheus.Metric) {
+	// We don't bail out on errors because those can happen if there is a race condition between
+	// the destruction of a container and us getting to read the cgroup data. We just don't report
+	// the values we don't get.
+
+	if numa, err := s.getNumaStats(); err == nil {
+		updateNumaStatMetric(ch, s.id, numa)
+	} else {
+		log.Error("failed to collect NUMA stats for %s: %v", s.path, err)
+	}
+
+	sampled, ok := sampledUsage(s.id)
+
+	if ok && sampled.Memory != nil {
+		updateMemoryUsageMetric(ch, s.id, *sampled.Memory)
+	} else if memory, err := s.getMemoryUsage(); err == nil {
+		updateMemoryUsageMetric(ch, s.id, memory)
+	} else {
+		log.Error("failed to collect memory usage stats for %s: %v", s.path, err)
+	}
+
+	if migrate, err := s.getMemoryMigrate(); err == nil {
+		updateMemoryMigrateMetric(ch, s.id, migrate)
+	} else {
+		log.Error("failed to collect memory migration stats for %s: %v", s.path, err)
+	}
 
-	for _, path := range walkCgroups() {
-		wg.Add(len(collectors))
-		for _, fn := range collectors {
-			go fn(path, containerIDRegexp)
+	if ok && sampled.CPUAcct != nil {
+		updateCPUAcctUsageMetric(ch, s.id, sampled.CPUAcct)
+	} else if cpuAcctUsage, err := s.getCPUAcctUsage(); err == nil {
+		updateCPUAcctUsageMetric(ch, s.id, cpuAcctUsage)
+	} else {
+		log.Error("failed to collect CPU accounting stats for %s: %v", s.path, err)
+	}
+
+	if hugeTlbUsage, err := s.getHugetlbUsage(); err == nil {
+		updateHugeTlbUsageMetric(ch, s.id, hugeTlbUsage)
+	} else {
+		log.Error("failed to collect hugetlb stats for %s: %v", s.path, err)
+	}
+
+	if blkioDeviceUsage, err := s.getBlkioThrottleBytes(); err == nil {
+		updateBlkioDeviceUsageMetric(ch, s.id, blkioDeviceUsage)
+	} else {
+		log.Error("failed to collect blkio stats for %s: %v", s.path, err)
+	}
+}
+
+func (s *v1ContainerStats) closeHugetlb() {
+	for _, f := range s.hugeUsage {
+		f.Close()
+	}
+	for _, f := range s.hugeMax {
+		f.Close()
+	}
+	s.hugeSizes, s.hugeUsage, s.hugeMax = nil, nil, nil
+	s.hugeFound = false
+}
+
+// close closes all open statistics files of the container.
+func (s *v1ContainerStats) close() {
+	for _, f := range []*cgroups.StatFile{s.numa, s.usage, s.maxUsage, s.migrate, s.cpuAcct, s.blkio} {
+		f.Close()
+	}
+	s.numa, s.usage, s.maxUsage, s.migrate, s.cpuAcct, s.blkio = nil, nil, nil, nil, nil, nil
+	s.closeHugetlb()
+}
+
+// updateContainers updates the set of containers we collect statistics for.
+func (c *collector) updateContainers() {
+	if c.watcher == nil {
+		base := filepath.Join(cgroupRoot, "cpuset")
+		if cgroups.IsUnifiedHierarchy(cgroupRoot) {
+			log.Info("using cgroup v2 unified hierarchy at %s", cgroupRoot)
+			base = cgroupRoot
+			c.unified = true
+		}
+		c.watcher = newCgroupWatcher(base, filepath.Join(base, kubepodsDir))
+	}
+
+	paths, changed := c.watcher.refresh()
+	if !changed {
+		return
+	}
+
+	containers := make(map[string]containerStats, len(paths))
+	for _, path := range paths {
+		if s, ok := c.containers[path]; ok {
+			containers[path] = s
+			delete(c.containers, path)
+		} else if c.unified {
+			containers[path] = newV2ContainerStats(path)
+		} else {
+			containers[path] = newV1ContainerStats(path)
 		}
 	}
+	for _, s := range c.containers {
+		s.close()
+	}
+
+	c.containers = containers
+}
+
+// Collect implements prometheus.Collector interface
+func (c *collector) Collect(ch chan<- prometheus.Metric) {
+	c.Lock()
+	defer c.Unlock()
+
+	c.updateContainers()
+
+	workers := runtime.NumCPU()
+	if workers > maxCollectWorkers {
+		workers = maxCollectWorkers
+	}
+	if workers > len(c.containers) {
+		workers = len(c.containers)
+	}
+
+	var wg sync.WaitGroup
+	work := make(chan containerStats)
+
+	wg.Add(workers)
+	for i := 0; i < workers; i++ {
+		go func() {
+			defer wg.Done()
+			for s := range work {
+				s.collect(ch)
+			}
+		}()
+	}
+
+	for _, s := range c.containers {
+		work <- s
+	}
+	close(work)
 
 	// We need to wait so that the response channel doesn't get closed.
 	wg.Wait()
@@ -0,0 +1,191 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroupstats
+
+import (
+	"os"
+	"path/filepath"
+
+	"github.com/containers/nri-plugins/pkg/cgroups"
+	"github.com/prometheus/client_golang/prometheus"
+)
+
+// v2ContainerStats has the open cgroup v2 statistics files of a single container.
+// With the unified hierarchy all statistics come from a single directory, and
+// each file is read once per scrape and fanned out to all metrics it feeds.
+type v2ContainerStats struct {
+	dir       string              // unified cgroup directory
+	path      string              // cgroup path relative to mount point
+	id        string              // container ID
+	numa      *cgroups.StatFile   // memory.numa_stat
+	current   *cgroups.StatFile   // memory.current
+	peak      *cgroups.StatFile   // memory.peak, if supported by the kernel
+	noPeak    bool                // memory.peak not supported
+	cpuStat   *cgroups.StatFile   // cpu.stat
+	ioStat    *cgroups.StatFile   // io.stat
+	hugeSizes []string            // huge page sizes
+	hugeUsage []*cgroups.StatFile // hugetlb usage per size
+	hugeFound bool                // whether hugetlb files have been looked up
+	numaStat  cgroups.NumaStat    // reused parsed NUMA statistics
+}
+
+func newV2ContainerStats(path string) *v2ContainerStats {
+	return &v2ContainerStats{
+		dir:  filepath.Join(cgroupRoot, path),
+		path: path,
+		id:   containerID(path),
+	}
+}
+
+func (s *v2ContainerStats) read(f **cgroups.StatFile, file string) ([]byte, error) {
+	return readStatFile(f, filepath.Join(s.dir, file))
+}
+
+func (s *v2ContainerStats) getMemoryUsage() (cgroups.MemoryUsage, error) {
+	data, err := s.read(&s.current, cgroups.MemoryCurrentFile)
+	if err != nil {
+		return cgroups.MemoryUsage{}, err
+	}
+	usage, err := cgroups.ParseSingleNumber(data)
+	if err != nil {
+		return cgroups.MemoryUsage{}, err
+	}
+
+	maxUsage := int64(-1)
+	if !s.noPeak {
+		data, err := s.read(&s.peak, cgroups.MemoryPeakFile)
+		if err != nil {
+			if !os.IsNotExist(err) {
+				return cgroups.MemoryUsage{}, err
+			}
+			s.noPeak = true
+		} else {
+			maxUsage, err = cgroups.ParseSingleNumber(data)
+			if err != nil {
+				return cgroups.MemoryUsage{}, err
+			}
+		}
+	}
+
+	return cgroups.MemoryUsage{Bytes: usage, MaxBytes: maxUsage}, nil
+}
+
+func (s *v2ContainerStats) getHugetlbUsage() ([]cgroups.HugetlbUsage, error) {
+	if !s.hugeFound {
+		sizes, current, err := cgroups.HugetlbCurrentFiles(s.dir)
+		if err != nil {
+			return nil, err
+		}
+		s.hugeSizes = sizes
+		s.hugeUsage = make([]*cgroups.StatFile, len(current))
+		for i := range current {
+			s.hugeUsage[i], err = cgroups.OpenStatFile(current[i])
+			if err != nil {
+				s.closeHugetlb()
+				return nil, err
+			}
+		}
+		s.hugeFound = true
+	}
+
+	result := make([]cgroups.HugetlbUsage, 0, len(s.hugeSizes))
+	for i, size := range s.hugeSizes {
+		data, err := s.hugeUsage[i].Read()
+		if err != nil {
+			s.closeHugetlb()
+			return nil, err
+		}
+		bytes, err := cgroups.ParseSingleNumber(data)
+		if err != nil {
+			return nil, err
+		}
+		result = append(result, cgroups.HugetlbUsage{
+			Size:     size,
+			Bytes:    bytes,
+			MaxBytes: -1,
+		})
+	}
+
+	return result, nil
+}
+
+// collect collects all statistics of the container.
+func (s *v2ContainerStats) collect(ch chan<- prometheus.Metric) {
+	// We don't bail out on errors because those can happen if there is a race condition between
+	// the destruction of a container and us getting to read the cgroup data. We just don't report
+	// the values we don't get.
+
+	if data, err := s.read(&s.numa, cgroups.NumaStatFile); err != nil {
+		log.Error("failed to collect NUMA stats for %s: %v", s.path, err)
+	} else if err := cgroups.ParseNumaStatsV2Into(data, &s.numaStat); err != nil {
+		log.Error("failed to parse NUMA stats for %s: %v", s.path, err)
+	} else {
+		updateNumaStatMetric(ch, s.id, s.numaStat)
+	}
+
+	sampled, ok := sampledUsage(s.id)
+
+	if ok && sampled.Memory != nil {
+		updateMemoryUsageMetric(ch, s.id, *sampled.Memory)
+	} else if memory, err := s.getMemoryUsage(); err == nil {
+		updateMemoryUsageMetric(ch, s.id, memory)
+	} else {
+		log.Error("failed to collect memory usage stats for %s: %v", s.path, err)
+	}
+
+	// cgroup v2 always migrates memory when cpuset.mems changes.
+	updateMemoryMigrateMetric(ch, s.id, true)
+
+	if ok && sampled.CPUAcct == nil {
+		updateCPUStatMetric(ch, s.id, sampled.CPUStat)
+	} else if data, err := s.read(&s.cpuStat, cgroups.CPUStatFile); err != nil {
+		log.Error("failed to collect CPU stats for %s: %v", s.path, err)
+	} else if cpuStat, err := cgroups.ParseCPUStat(data); err != nil {
+		log.Error("failed to parse CPU stats for %s: %v", s.path, err)
+	} else {
+		updateCPUStatMetric(ch, s.id, cpuStat)
+	}
+
+	if hugeTlbUsage, err := s.getHugetlbUsage(); err == nil {
+		updateHugeTlbUsageMetric(ch, s.id, hugeTlbUsage)
+	} else {
+		log.Error("failed to collect hugetlb stats for %s: %v", s.path, err)
+	}
+
+	if data, err := s.read(&s.ioStat, cgroups.IOStatFile); err != nil {
+		log.Error("failed to collect I/O stats for %s: %v", s.path, err)
+	} else if ioStat, err := cgroups.ParseIOStat(data); err != nil {
+		log.Error("failed to parse I/O stats for %s: %v", s.path, err)
+	} else {
+		updateBlkioDeviceUsageMetric(ch, s.id, ioStat)
+	}
+}
+
+func (s *v2ContainerStats) closeHugetlb() {
+	for _, f := range s.hugeUsage {
+		f.Close()
+	}
+	s.hugeSizes, s.hugeUsage = nil, nil
+	s.hugeFound = false
+}
+
+// close closes all open statistics files of the container.
+func (s *v2ContainerStats) close() {
+	for _, f := range []*cgroups.StatFile{s.numa, s.current, s.peak, s.cpuStat, s.ioStat} {
+		f.Close()
+	}
+	s.numa, s.current, s.peak, s.cpuStat, s.ioStat = nil, nil, nil, nil, nil
+	s.closeHugetlb()
+}
@@ -0,0 +1,326 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cgroupstats
+
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+	"unsafe"
+
+	"golang.org/x/sys/unix"
+)
+
+const (
+	// inotify events which (might) change the set of subdirectories
+	watchEvents = unix.IN_CREATE | unix.IN_DELETE | unix.IN_MOVED_FROM | unix.IN_MOVED_TO |
+		unix.IN_DELETE_SELF | unix.IN_ONLYDIR
+	// inotify event buffer size
+	watchBufSize = 64 * 1024
+)
+
+// cgroupWatcher maintains the set of container cgroup directories under a
+// root directory. Instead of walking the full hierarchy every time the set
+// is needed, it puts an inotify watch on every non-container directory and
+// only re-reads the directories with pending events. If inotify can't be
+// used, it falls back to walking the full hierarchy on every refresh.
+type cgroupWatcher struct {
+	base     string                 // container paths are reported relative to this
+	root     string                 // root directory to watch
+	fd       int                    // inotify file descriptor, -1 if not watching
+	disabled bool                   // inotify unusable, always walk the hierarchy
+	dirs     map[string]*watchedDir // watched directories by path
+	wds      map[int]string         // watched directory paths by watch descriptor
+	dirty    map[string]struct{}    // directories which need to be re-read
+	list     []string               // last reported container paths
+	buf      []byte                 // inotify event buffer
+}
+
+// watchedDir is a single directory being watched.
+type watchedDir struct {
+	wd         int
+	subdirs    map[string]struct{} // non-container subdirectories
+	containers map[string]struct{} // container subdirectories
+}
+
+func newCgroupWatcher(base, root string) *cgroupWatcher {
+	return &cgroupWatcher{
+		base:  base,
+		root:  root,
+		fd:    -1,
+		dirs:  make(map[string]*watchedDir),
+		wds:   make(map[int]string),
+		dirty: make(map[string]struct{}),
+	}
+}
+
+// refresh returns the current set of container paths and whether it has changed.
+func (w *cgroupWatcher) refresh() ([]string, bool) {
+	if w.disabled || (w.fd < 0 && !w.start()) {
+		w.list = walkCgroups(w.base, w.root)
+		return w.list, true
+	}
+
+	changed := false
+	if _, ok := w.dirs[w.root]; !ok {
+		changed = w.addDir(w.root)
+	}
+
+	w.readEvents()
+	for dir := range w.dirty {
+		delete(w.dirty, dir)
+		if w.scan(dir) {
+			changed = true
+		}
+	}
+
+	if w.disabled {
+		return w.refresh()
+	}
+
+	if changed || w.list == nil {
+		w.list = w.containers()
+	}
+
+	return w.list, changed
+}
+
+// start starts watching for changes.
+func (w *cgroupWatcher) start() bool {
+	fd, err := unix.InotifyInit1(unix.IN_NONBLOCK | unix.IN_CLOEXEC)
+	if err != nil {
+		log.Warn("can't watch cgroup hierarchy, falling back to polling: %v", err)
+		w.disabled = true
+		return false
+	}
+
+	w.fd = fd
+	w.buf = make([]byte, watchBufSize)
+
+	return true
+}
+
+// stop stops watching for changes and falls back to polling.
+func (w *cgroupWatcher) stop() {
+	if w.fd >= 0 {
+		unix.Close(w.fd)
+		w.fd = -1
+	}
+	w.disabled = true
+	w.dirs = make(map[string]*watchedDir)
+	w.wds = make(map[int]string)
+	w.dirty = make(map[string]struct{})
+	w.buf = nil
+}
+
+// addDir starts watching the given directory.
+func (w *cgroupWatcher) addDir(dir string) bool {
+	wd, err := unix.InotifyAddWatch(w.fd, dir, watchEvents)
+	if err != nil {
+		if !errors.Is(err, unix.ENOENT) && !errors.Is(err, unix.ENOTDIR) {
+			log.Warn("failed to watch %s, falling back to polling: %v", dir, err)
+			w.stop()
+		}
+		return false
+	}
+
+	w.dirs[dir] = &watchedDir{
+		wd:         wd,
+		subdirs:    make(map[string]struct{}),
+		containers: make(map[string]struct{}),
+	}
+	w.wds[wd] = dir
+
+	w.scan(dir)
+
+	return true
+}
+
+// removeDir stops watching the given directory and all its subdirectories.
+func (w *cgroupWatcher) removeDir(dir string) {
+	d, ok := w.dirs[dir]
+	if !ok {
+		return
+	}
+
+	for name := range d.subdirs {
+		w.removeDir(filepath.Join(dir, name))
+	}
+
+	// This fails harmlessly if the directory is already gone.
+	_, _ = unix.InotifyRmWatch(w.fd, uint32(d.wd))
+
+	delete(w.wds, d.wd)
+	delete(w.dirs, dir)
+	delete(w.dirty, dir)
+}
+
+// scan re-reads a watched directory, updating watches for its subdirectories.
+func (w *cgroupWatcher) scan(dir string) bool {
+	d, ok := w.dirs[dir]
+	if !ok {
+		return false
+	}
+
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		w.removeDir(dir)
+		return true
+	}
+
+	changed := false
+	subdirs := make(map[string]struct{})
+	containers := make(map[string]struct{})
+
+	for _, e := range entries {
+		if !e.IsDir() {
+			continue
+		}
+		name := e.Name()
+		switch {
+		case isContainerDir(name):
+			containers[name] = struct{}{}
+			if _, ok := d.containers[name]; !ok {
+				changed = true
+			}
+		case !strings.HasSuffix(name, ".scope"):
+			subdirs[name] = struct{}{}
+		}
+	}
+
+	if len(containers) != len(d.containers) {
+		changed = true
+	}
+	d.containers = containers
+
+	for name := range d.subdirs {
+		if _, ok := subdirs[name]; !ok {
+			w.removeDir(filepath.Join(dir, name))
+			changed = true
+		}
+	}
+	old := d.subdirs
+	d.subdirs = subdirs
+	for name := range subdirs {
+		if _, ok := old[name]; !ok {
+			if !w.addDir(filepath.Join(dir, name)) {
+				delete(subdirs, name)
+			}
+			changed = true
+		}
+	}
+
+	return changed
+}
+
+// readEvents reads all pending inotify events, marking directories dirty.
+func (w *cgroupWatcher) readEvents() {
+	for w.fd >= 0 {
+		n, err := unix.Read(w.fd, w.buf)
+		if err != nil {
+			if !errors.Is(err, unix.EAGAIN) && !errors.Is(err, unix.EINTR) {
+				log.Warn("failed to read cgroup watch events, falling back to polling: %v", err)
+				w.stop()
+			}
+			return
+		}
+		if n < unix.SizeofInotifyEvent {
+			return
+		}
+
+		for offs := 0; offs+unix.SizeofInotifyEvent <= n; {
+			e := (*unix.InotifyEvent)(unsafe.Pointer(&w.buf[offs]))
+			offs += unix.SizeofInotifyEvent + int(e.Len)
+
+			if e.Mask&unix.IN_Q_OVERFLOW != 0 {
+				for dir := range w.dirs {
+					w.dirty[dir] = struct{}{}
+				}
+				continue
+			}
+			if dir, ok := w.wds[int(e.Wd)]; ok {
+				w.dirty[dir] = struct{}{}
+			}
+		}
+	}
+}
+
+// containers returns the sorted list of container paths.
+func (w *cgroupWatcher) containers() []string {
+	list := []string{}
+	for dir, d := range w.dirs {
+		for name := range d.containers {
+			path := filepath.Join(dir, name)
+			list = append(list, strings.TrimPrefix(path, w.base+"/"))
+		}
+	}
+	sort.Strings(list)
+	return list
+}
+
+// isContainerDir checks if the given directory name is a container scope.
+func isContainerDir(name string) bool {
+	if !strings.HasSuffix(name, ".scope") {
+		return false
+	}
+
+	switch {
+	case strings.HasPrefix(name, "cri-containerd-"):
+		return true
+	case strings.HasPrefix(name, "crio-"):
+		return true
+	case strings.HasPrefix(name, "docker-"):
+		return true
+	}
+
+	return false
+}
+
+// walkCgroups walks the full hierarchy under root, collecting container paths.
+func walkCgroups(base, root string) []string {
+	// XXX TODO: add support for kubelet cgroupfs cgroup driver.
+
+	containerDirs := []string{}
+
+	filepath.Walk(root,
+		func(path string, info os.FileInfo, err error) error {
+			if err != nil {
+				if os.IsNotExist(err) {
+					return nil
+				}
+				return err
+			}
+			if !info.IsDir() {
+				return nil
+			}
+
+			dir := info.Name()
+			if !strings.HasSuffix(dir, ".scope") {
+				return nil
+			}
+			if !isContainerDir(dir) {
+				return filepath.SkipDir
+			}
+
+			path = strings.TrimPrefix(path, base+"/")
+			containerDirs = append(containerDirs, path)
+
+			return filepath.SkipDir
+		})
+
+	return containerDirs
+}
@@ -37,8 +37,10 @@ const (
 	AllocIdleNodes
 	// AllocIdleCores requests allocation of full idle cores (all threads in core).
 	AllocIdleCores
+	// AllocSingleCache requests packing allocations into a single last level cache.
+	AllocSingleCache
 	// AllocDefault is the default allocation preferences.
-	AllocDefault = AllocIdlePackages | AllocIdleCores
+	AllocDefault = AllocIdlePackages | AllocIdleCores | AllocSingleCache
 
 	logSource = "cpuallocator"
 )
@@ -53,6 +55,8 @@ type allocatorHelper struct {
 	prefer        CPUPriority   // CPU priority to prefer
 	cnt           int           // number of CPUs to allocate
 	result        cpuset.CPUSet // set of CPUs allocated
+	fromMask      cpuMask       // set of CPUs to allocate from, as a mask
+	resultMask    cpuMask       // set of CPUs allocated, as a mask
 
 	pkgs []sysfs.CPUPackage // physical CPU packages, sorted by preference
 	cpus []sysfs.CPU        // CPU cores, sorted by preference
@@ -87,10 +91,31 @@ type topologyCache struct {
 	core map[idset.ID]cpuset.CPUSet
 
 	cpuPriorities cpuPriorities // CPU priority mapping
+
+	// Precomputed bitmaps of the same topology, used for allocation. Packages
+	// are identified by their index in pkgIDs, CPUs and cores by CPU ID.
+	words      int                       // number of words in CPU masks
+	pkgIDs     []idset.ID                // sorted package IDs
+	cpuIDs     []idset.ID                // sorted CPU IDs
+	cpus       cpuMask                   // all CPUs
+	offline    cpuMask                   // offline CPUs
+	pkgMask    []cpuMask                 // CPUs by package index
+	pkgOnline  []cpuMask                 // online CPUs by package index
+	nodeMask   map[idset.ID]cpuMask      // CPUs by NUMA node
+	coreMask   []cpuMask                 // thread siblings by CPU ID
+	coreOnline []cpuMask                 // online thread siblings by CPU ID
+	cpuPkg     []int                     // package index by CPU ID
+	cacheMask  []cpuMask                 // CPUs by last level cache, if caches split packages
+	prioMask   [NumCPUPriorities]cpuMask // CPUs by priority
+	pkgPrio    []prioCounts              // CPU priority counts by package index
+	corePrio   []prioCounts              // CPU priority counts for cores by CPU ID
 }
 
 type cpuPriorities [NumCPUPriorities]cpuset.CPUSet
 
+// prioCounts is the number of CPUs per priority in a set of CPUs.
+type prioCounts [NumCPUPriorities]int
+
 // IDFilter helps filtering Ids.
 type IDFilter func(idset.ID) bool
 
@@ -111,21 +136,6 @@ func NewCPUAllocator(sys sysfs.System) CPUAllocator {
 	return &ca
 }
 
-// Pick packages, nodes or CPUs by filtering according to a function.
-func pickIds(idSlice []idset.ID, f IDFilter) []idset.ID {
-	ids := make([]idset.ID, len(idSlice))
-
-	idx := 0
-	for _, id := range idSlice {
-		if f == nil || f(id) {
-			ids[idx] = id
-			idx++
-		}
-	}
-
-	return ids[0:idx]
-}
-
 // newAllocatorHelper creates a new CPU allocatorHelper.
 func newAllocatorHelper(sys sysfs.System, topo topologyCache) *allocatorHelper {
 	a := &allocatorHelper{
@@ -142,35 +152,43 @@ func newAllocatorHelper(sys sysfs.System, topo topologyCache) *allocatorHelper {
 func (a *allocatorHelper) takeIdlePackages() {
 	a.Debug("* takeIdlePackages()...")
 
-	offline := a.sys.Offlined()
+	t := &a.topology
 
 	// pick idle packages
-	pkgs := pickIds(a.sys.PackageIDs(),
-		func(id idset.ID) bool {
-			cset := a.topology.pkg[id].Difference(offline)
-			return cset.Intersection(a.from).Equals(cset)
-		})
+	pkgs := make([]int, 0, len(t.pkgIDs))
+	for idx, cset := range t.pkgOnline {
+		if cset.isSubsetOf(a.fromMask) {
+			pkgs = append(pkgs, idx)
+		}
+	}
 
 	// sorted by number of preferred cpus and then by cpu id
 	sort.Slice(pkgs,
 		func(i, j int) bool {
-			if res := a.topology.cpuPriorities.cmpCPUSet(a.topology.pkg[pkgs[i]], a.topology.pkg[pkgs[j]], a.prefer, -1); res != 0 {
+			if res := t.pkgPrio[pkgs[i]].cmp(t.pkgPrio[pkgs[j]], a.prefer, -1); res != 0 {
 				return res > 0
 			}
 			return pkgs[i] < pkgs[j]
 		})
 
-	a.Debug(" => idle packages sorted by preference: %v", pkgs)
+	if a.DebugEnabled() {
+		ids := make([]idset.ID, 0, len(pkgs))
+		for _, idx := range pkgs {
+			ids = append(ids, t.pkgIDs[idx])
+		}
+		a.Debug(" => idle packages sorted by preference: %v", ids)
+	}
 
 	// take as many idle packages as we need/can
-	for _, id := range pkgs {
-		cset := a.topology.pkg[id].Difference(offline)
-		a.Debug(" => considering package %v (#%s)...", id, cset)
-		if a.cnt >= cset.Size() {
-			a.Debug(" => taking package %v...", id)
-			a.result = a.result.Union(cset)
-			a.from = a.from.Difference(cset)
-			a.cnt -= cset.Size()
+	for _, idx := range pkgs {
+		cset := t.pkgOnline[idx]
+		size := cset.count()
+		a.Debug(" => considering package %v (#%s)...", t.pkgIDs[idx], cset)
+		if a.cnt >= size {
+			a.Debug(" => taking package %v...", t.pkgIDs[idx])
+			a.resultMask.or(cset)
+			a.fromMask.andNot(cset)
+			a.cnt -= size
 
 			if a.cnt == 0 {
 				break
@@ -183,22 +201,22 @@ func (a *allocatorHelper) takeIdlePackages() {
 func (a *allocatorHelper) takeIdleCores() {
 	a.Debug("* takeIdleCores()...")
 
-	offline := a.sys.Offlined()
+	t := &a.topology
 
 	// pick (first id for all) idle cores
-	cores := pickIds(a.sys.CPUIDs(),
-		func(id idset.ID) bool {
-			cset := a.topology.core[id].Difference(offline)
-			if cset.IsEmpty() {
-				return false
-			}
-			return cset.Intersection(a.from).Equals(cset) && cset.List()[0] == int(id)
-		})
+	cores := make([]int, 0, len(t.cpuIDs))
+	for _, cpu := range t.cpuIDs {
+		id := int(cpu)
+		cset := t.coreOnline[id]
+		if cset.first() == id && cset.isSubsetOf(a.fromMask) {
+			cores = append(cores, id)
+		}
+	}
 
 	// sorted by id
 	sort.Slice(cores,
 		func(i, j int) bool {
-			if res := a.topology.cpuPriorities.cmpCPUSet(a.topology.core[cores[i]], a.topology.core[cores[j]], a.prefer, -1); res != 0 {
+			if res := t.corePrio[cores[i]].cmp(t.corePrio[cores[j]], a.prefer, -1); res != 0 {
 				return res > 0
 			}
 			return cores[i] < cores[j]
@@ -208,13 +226,14 @@ func (a *allocatorHelper) takeIdleCores() {
 
 	// take as many idle cores as we can
 	for _, id := range cores {
-		cset := a.topology.core[id].Difference(offline)
+		cset := t.coreOnline[id]
+		size := cset.count()
 		a.Debug(" => considering core %v (#%s)...", id, cset)
-		if a.cnt >= cset.Size() {
+		if a.cnt >= size {
 			a.Debug(" => taking core %v...", id)
-			a.result = a.result.Union(cset)
-			a.from = a.from.Difference(cset)
-			a.cnt -= cset.Size()
+			a.resultMask.or(cset)
+			a.fromMask.andNot(cset)
+			a.cnt -= size
 
 			if a.cnt == 0 {
 				break
@@ -223,18 +242,76 @@ func (a *allocatorHelper) takeIdleCores() {
 	}
 }
 
+// Allocate CPUs from a single last level cache, if the request fits into one.
+func (a *allocatorHelper) takeSingleCache() {
+	a.Debug("* takeSingleCache()...")
+
+	t := &a.topology
+
+	// pick the cache with the most preferred CPUs, then the fewest free CPUs
+	best, bestFree := -1, 0
+	bestPrio := prioCounts{}
+	for idx, cset := range t.cacheMask {
+		free := cset.andCount(a.fromMask)
+		if free < a.cnt {
+			continue
+		}
+		prio := t.countPriorities(cset, a.fromMask)
+		if best >= 0 {
+			if res := prio.cmp(bestPrio, a.prefer, a.cnt); res < 0 || (res == 0 && free >= bestFree) {
+				continue
+			}
+		}
+		best, bestFree, bestPrio = idx, free, prio
+	}
+
+	if best < 0 {
+		a.Debug(" => no single cache with %d free CPUs", a.cnt)
+		return
+	}
+
+	a.Debug(" => allocating from cache #%s...", t.cacheMask[best])
+
+	// allocate with the rest of the CPUs temporarily taken out
+	rest := a.fromMask.clone()
+	rest.andNot(t.cacheMask[best])
+	a.fromMask.and(t.cacheMask[best])
+
+	if (a.flags & AllocIdleCores) != 0 {
+		a.takeIdleCores()
+	}
+	if a.cnt > 0 {
+		a.takeIdleThreads()
+	}
+
+	a.fromMask.or(rest)
+}
+
 // Allocate idle CPU hyperthreads.
 func (a *allocatorHelper) takeIdleThreads() {
-	offline := a.sys.Offlined()
+	t := &a.topology
 
 	// pick all threads with free capacity
-	cores := pickIds(a.sys.CPUIDs(),
-		func(id idset.ID) bool {
-			return a.from.Difference(offline).Contains(int(id))
-		})
+	avail := a.fromMask.clone()
+	avail.and(t.cpus)
+	avail.andNot(t.offline)
+	cores := avail.appendIDs(make([]int, 0, avail.count()))
 
 	a.Debug(" => idle threads unsorted: %v", cores)
 
+	// The package properties used for sorting don't change while sorting.
+	type pkgState struct {
+		colo int        // number of CPUs already in a.result
+		free int        // number of CPUs in a.from
+		prio prioCounts // CPU priority counts for CPUs in a.from
+	}
+	pkgs := make([]pkgState, len(t.pkgIDs))
+	for idx, cset := range t.pkgMask {
+		pkgs[idx].colo = cset.andCount(a.resultMask)
+		pkgs[idx].free = cset.andCount(a.fromMask)
+		pkgs[idx].prio = t.countPriorities(cset, a.fromMask)
+	}
+
 	// sorted for preference by id, mimicking cpus_assignment.go for now:
 	//   IOW, prefer CPUs
 	//     - from packages with higher number of CPUs/cores already in a.result
@@ -249,42 +326,31 @@ func (a *allocatorHelper) takeIdleThreads() {
 		func(i, j int) bool {
 			iCore := cores[i]
 			jCore := cores[j]
-			iPkg := a.sys.CPU(iCore).PackageID()
-			jPkg := a.sys.CPU(jCore).PackageID()
-
-			iCoreSet := a.topology.core[iCore]
-			jCoreSet := a.topology.core[jCore]
-			iPkgSet := a.topology.pkg[iPkg]
-			jPkgSet := a.topology.pkg[jPkg]
-
-			iPkgColo := iPkgSet.Intersection(a.result).Size()
-			jPkgColo := jPkgSet.Intersection(a.result).Size()
-			if iPkgColo != jPkgColo {
-				return iPkgColo > jPkgColo
+			iPkg := &pkgs[t.cpuPkg[iCore]]
+			jPkg := &pkgs[t.cpuPkg[jCore]]
+
+			if iPkg.colo != jPkg.colo {
+				return iPkg.colo > jPkg.colo
 			}
 
 			// Always sort cores in package order
-			if res := a.topology.cpuPriorities.cmpCPUSet(iPkgSet.Intersection(a.from), jPkgSet.Intersection(a.from), a.prefer, a.cnt); res != 0 {
+			if res := iPkg.prio.cmp(jPkg.prio, a.prefer, a.cnt); res != 0 {
 				return res > 0
 			}
 			if iPkg != jPkg {
-				return iPkg < jPkg
+				return t.cpuPkg[iCore] < t.cpuPkg[jCore]
 			}
 
-			iCset := cpuset.New(int(cores[i]))
-			jCset := cpuset.New(int(cores[j]))
-			if res := a.topology.cpuPriorities.cmpCPUSet(iCset, jCset, a.prefer, 0); res != 0 {
+			if res := t.cpuPriority(iCore).cmp(t.cpuPriority(jCore), a.prefer, 0); res != 0 {
 				return res > 0
 			}
 
-			iPkgFree := iPkgSet.Intersection(a.from).Size()
-			jPkgFree := jPkgSet.Intersection(a.from).Size()
-			if iPkgFree != jPkgFree {
-				return iPkgFree < jPkgFree
+			if iPkg.free != jPkg.free {
+				return iPkg.free < jPkg.free
 			}
 
-			iCoreFree := iCoreSet.Intersection(a.from).Size()
-			jCoreFree := jCoreSet.Intersection(a.from).Size()
+			iCoreFree := t.coreMask[iCore].andCount(a.fromMask)
+			jCoreFree := t.coreMask[jCore].andCount(a.fromMask)
 			if iCoreFree != jCoreFree {
 				return iCoreFree < jCoreFree
 			}
@@ -296,12 +362,10 @@ func (a *allocatorHelper) takeIdleThreads() {
 
 	// take as many idle cores as we can
 	for _, id := range cores {
-		cset := a.topology.core[id].Difference(offline)
-		a.Debug(" => considering thread %v (#%s)...", id, cset)
-		cset = cpuset.New(int(id))
-		a.result = a.result.Union(cset)
-		a.from = a.from.Difference(cset)
-		a.cnt -= cset.Size()
+		a.Debug(" => considering thread %v (#%s)...", id, t.coreOnline[id])
+		a.resultMask.set(id)
+		a.fromMask.unset(id)
+		a.cnt--
 
 		if a.cnt == 0 {
 			break
@@ -326,15 +390,24 @@ func (a *allocatorHelper) takeAny() {
 // Perform CPU allocation.
 func (a *allocatorHelper) allocate() cpuset.CPUSet {
 	if a.sys != nil {
+		a.fromMask = maskFromCPUSet(a.topology.words, a.from)
+		a.resultMask = maskFromCPUSet(len(a.fromMask), a.result)
+
 		if (a.flags & AllocIdlePackages) != 0 {
 			a.takeIdlePackages()
 		}
+		if a.cnt > 0 && (a.flags&AllocSingleCache) != 0 && len(a.topology.cacheMask) > 0 {
+			a.takeSingleCache()
+		}
 		if a.cnt > 0 && (a.flags&AllocIdleCores) != 0 {
 			a.takeIdleCores()
 		}
 		if a.cnt > 0 {
 			a.takeIdleThreads()
 		}
+
+		a.from = a.fromMask.CPUSet()
+		a.result = a.resultMask.CPUSet()
 	} else {
 		a.takeAny()
 	}
@@ -400,6 +473,7 @@ func newTopologyCache(sys sysfs.System) topologyCache {
 		for _, id := range sys.CPUIDs() {
 			c.core[id] = sys.CPU(id).ThreadCPUSet()
 		}
+		c.buildMasks(sys)
 	}
 
 	c.discoverCPUPriorities(sys)
@@ -407,6 +481,135 @@ func newTopologyCache(sys sysfs.System) topologyCache {
 	return c
 }
 
+// buildMasks precomputes bitmaps of the topology.
+func (c *topologyCache) buildMasks(sys sysfs.System) {
+	c.cpuIDs = append([]idset.ID{}, sys.CPUIDs()...)
+	sort.Slice(c.cpuIDs, func(i, j int) bool { return c.cpuIDs[i] < c.cpuIDs[j] })
+	c.pkgIDs = append([]idset.ID{}, sys.PackageIDs()...)
+	sort.Slice(c.pkgIDs, func(i, j int) bool { return c.pkgIDs[i] < c.pkgIDs[j] })
+
+	numIDs := 0
+	if len(c.cpuIDs) > 0 {
+		numIDs = int(c.cpuIDs[len(c.cpuIDs)-1]) + 1
+	}
+	c.words = maskWords(numIDs)
+
+	c.cpus = newCPUMask(c.words)
+	for _, id := range c.cpuIDs {
+		c.cpus.set(int(id))
+	}
+	c.offline = maskFromCPUSet(c.words, sys.Offlined())
+
+	c.cpuPkg = make([]int, numIDs)
+	c.pkgMask = make([]cpuMask, len(c.pkgIDs))
+	c.pkgOnline = make([]cpuMask, len(c.pkgIDs))
+	for idx, id := range c.pkgIDs {
+		c.pkgMask[idx] = maskFromCPUSet(c.words, c.pkg[id])
+		c.pkgOnline[idx] = c.pkgMask[idx].clone()
+		c.pkgOnline[idx].andNot(c.offline)
+		for _, cpu := range c.pkgMask[idx].appendIDs(nil) {
+			c.cpuPkg[cpu] = idx
+		}
+	}
+
+	c.nodeMask = make(map[idset.ID]cpuMask, len(c.node))
+	for id, cset := range c.node {
+		c.nodeMask[id] = maskFromCPUSet(c.words, cset)
+	}
+
+	c.buildCacheMasks(sys)
+
+	c.coreMask = make([]cpuMask, numIDs)
+	c.coreOnline = make([]cpuMask, numIDs)
+	for _, id := range c.cpuIDs {
+		c.coreMask[id] = maskFromCPUSet(c.words, c.core[id])
+		c.coreOnline[id] = c.coreMask[id].clone()
+		c.coreOnline[id].andNot(c.offline)
+	}
+}
+
+// buildCacheMasks precomputes bitmaps of last level caches. These are only
+// used if some package has more than one cache, IOW on chiplet CPUs with a
+// cache per core complex.
+func (c *topologyCache) buildCacheMasks(sys sysfs.System) {
+	c.cacheMask = nil
+
+	caches := map[idset.ID]cpuMask{}
+	ids := []idset.ID{}
+	split := false
+	for _, id := range c.cpuIDs {
+		cpu := sys.CPU(id)
+		if cpu == nil || cpu.L3CacheID() < 0 {
+			continue
+		}
+		cacheID := cpu.L3CacheID()
+		if _, ok := caches[cacheID]; ok {
+			continue
+		}
+		mask := maskFromCPUSet(c.words, cpu.L3CacheCPUSet())
+		mask.and(c.cpus)
+		mask.andNot(c.offline)
+		caches[cacheID] = mask
+		ids = append(ids, cacheID)
+		if pkg := c.pkgOnline[c.cpuPkg[id]]; !pkg.isSubsetOf(mask) {
+			split = true
+		}
+	}
+
+	if !split {
+		return
+	}
+
+	c.cacheMask = make([]cpuMask, 0, len(ids))
+	for _, id := range ids {
+		c.cacheMask = append(c.cacheMask, caches[id])
+	}
+}
+
+// setCPUPriorities sets the CPU priority mapping, updating related bitmaps.
+func (c *topologyCache) setCPUPriorities(prio cpuPriorities) {
+	c.cpuPriorities = prio
+
+	for p := range prio {
+		c.prioMask[p] = maskFromCPUSet(c.words, prio[p])
+	}
+
+	c.pkgPrio = make([]prioCounts, len(c.pkgMask))
+	for idx, cset := range c.pkgMask {
+		c.pkgPrio[idx] = c.countPriorities(cset, nil)
+	}
+	c.corePrio = make([]prioCounts, len(c.coreMask))
+	for id, cset := range c.coreMask {
+		if cset != nil {
+			c.corePrio[id] = c.countPriorities(cset, nil)
+		}
+	}
+}
+
+// countPriorities counts CPUs per priority in a mask, optionally intersected with another one.
+func (c *topologyCache) countPriorities(m, and cpuMask) prioCounts {
+	var cnt prioCounts
+	for p := range c.prioMask {
+		if and == nil {
+			cnt[p] = m.andCount(c.prioMask[p])
+		} else {
+			cnt[p] = andCount3(m, and, c.prioMask[p])
+		}
+	}
+	return cnt
+}
+
+// cpuPriority returns the priority counts for a single CPU.
+func (c *topologyCache) cpuPriority(id int) prioCounts {
+	var cnt prioCounts
+	for p := range c.prioMask {
+		if c.prioMask[p].has(id) {
+			cnt[p] = 1
+		}
+	}
+	return cnt
+}
+
 func (c *topologyCache) discoverCPUPriorities(sys sysfs.System) {
 	if sys == nil {
 		return
@@ -428,7 +631,7 @@ func (c *topologyCache) discoverCPUPriorities(sys sysfs.System) {
 			prio[p] = prio[p].Union(cset)
 		}
 	}
-	c.cpuPriorities = prio
+	c.setCPUPriorities(prio)
 }
 
 func (c *topologyCache) discoverSstCPUPriority(sys sysfs.System, pkgID idset.ID) ([NumCPUPriorities][]idset.ID, bool) {
@@ -632,22 +835,22 @@ func (p CPUPriority) String() string {
 	return "none"
 }
 
-// cmpCPUSet compares two cpusets in terms of preferred cpu priority. Returns:
+// cmp compares two sets of CPUs in terms of preferred cpu priority. Returns:
 //
-//	> 0 if cpuset A is preferred
-//	< 0 if cpuset B is preferred
-//	0 if cpusets A and B are equal in terms of cpu priority
-func (c *cpuPriorities) cmpCPUSet(csetA, csetB cpuset.CPUSet, prefer CPUPriority, cpuCnt int) int {
+//	> 0 if set A is preferred
+//	< 0 if set B is preferred
+//	0 if sets A and B are equal in terms of cpu priority
+func (a prioCounts) cmp(b prioCounts, prefer CPUPriority, cpuCnt int) int {
 	if prefer == PriorityNone {
 		return 0
 	}
 
-	// Favor cpuset having CPUs with priorities equal to or lower than what was requested
+	// Favor set having CPUs with priorities equal to or lower than what was requested
 	for prio := prefer; prio < NumCPUPriorities; prio++ {
-		prefA := csetA.Intersection(c[prio]).Size()
-		prefB := csetB.Intersection(c[prio]).Size()
+		prefA := a[prio]
+		prefB := b[prio]
 		if cpuCnt > 0 && prio == prefer && prefA >= cpuCnt && prefB >= cpuCnt {
-			// Prefer the tightest fitting if both cpusets satisfy the
+			// Prefer the tightest fitting if both sets satisfy the
 			// requested amount of CPUs with the preferred priority
 			return prefB - prefA
 		}
@@ -655,10 +858,10 @@ func (c *cpuPriorities) cmpCPUSet(csetA, csetB cpuset.CPUSet, prefer CPUPriority
 			return prefA - prefB
 		}
 	}
-	// Repel cpuset having CPUs with higher priority than what was requested
+	// Repel set having CPUs with higher priority than what was requested
 	for prio := PriorityHigh; prio < prefer; prio++ {
-		nonprefA := csetA.Intersection(c[prio]).Size()
-		nonprefB := csetB.Intersection(c[prio]).Size()
+		nonprefA := a[prio]
+		nonprefB := b[prio]
 		if nonprefA != nonprefB {
 			return nonprefB - nonprefA
 		}
@@ -16,26 +16,31 @@ package cpuallocator
 
 import (
 	"io/ioutil"
+	"math/rand"
 	"os"
 	"path"
+	"strconv"
 	"testing"
 
 	"github.com/containers/nri-plugins/pkg/utils/cpuset"
 
 	"github.com/containers/nri-plugins/pkg/sysfs"
+	"github.com/containers/nri-plugins/pkg/testutils"
 	"github.com/containers/nri-plugins/pkg/utils"
 )
 
-func TestAllocatorHelper(t *testing.T) {
+// discoverTestSystem discovers the mock system from the testdata.
+func discoverTestSystem(tb testing.TB) (sysfs.System, func()) {
 	// Create tmpdir and decompress testdata there
 	tmpdir, err := ioutil.TempDir("", "nri-resource-policy-test-")
 	if err != nil {
-		t.Fatalf("failed to create tmpdir: %v", err)
+		tb.Fatalf("failed to create tmpdir: %v", err)
 	}
-	defer os.RemoveAll(tmpdir)
+	cleanup := func() { os.RemoveAll(tmpdir) }
 
 	if err := utils.UncompressTbz2(path.Join("testdata", "sysfs.tar.bz2"), tmpdir); err != nil {
-		t.Fatalf("failed to decompress testdata: %v", err)
+		cleanup()
+		tb.Fatalf("failed to decompress testdata: %v", err)
 	}
 
 	// Discover mock system from the testdata
@@ -43,17 +48,33 @@ func TestAllocatorHelper(t *testing.T) {
 		path.Join(tmpdir, "sysfs", "2-socket-4-node-40-core", "sys"),
 		sysfs.DiscoverCPUTopology, sysfs.DiscoverMemTopology)
 	if err != nil {
-		t.Fatalf("failed to discover mock system: %v", err)
+		cleanup()
+		tb.Fatalf("failed to discover mock system: %v", err)
 	}
+
+	return sys, cleanup
+}
+
+// newTestTopologyCache creates a topology cache with fake CPU priorities.
+func newTestTopologyCache(sys sysfs.System) topologyCache {
 	topoCache := newTopologyCache(sys)
 
 	// Fake cpu priorities: 5 cores from pkg #0 as high prio
 	// Package CPUs: #0: [0-19,40-59], #1: [20-39,60-79]
-	topoCache.cpuPriorities = [NumCPUPriorities]cpuset.CPUSet{
+	topoCache.setCPUPriorities([NumCPUPriorities]cpuset.CPUSet{
 		cpuset.MustParse("2,5,8,15,17,42,45,48,55,57"),
 		cpuset.MustParse("20-39,60-79"),
 		cpuset.MustParse("0,1,3,4,6,7,9-14,16,18,19,40,41,43,44,46,47,49-54,56,58,59"),
-	}
+	})
+
+	return topoCache
+}
+
+func TestAllocatorHelper(t *testing.T) {
+	sys, cleanup := discoverTestSystem(t)
+	defer cleanup()
+
+	topoCache := newTestTopologyCache(sys)
 
 	tcs := []struct {
 		description string
@@ -99,3 +120,221 @@ func TestAllocatorHelper(t *testing.T) {
 		})
 	}
 }
+
+func TestAllocateSingleCache(t *testing.T) {
+	sys, cleanup := discoverTestSystem(t)
+	defer cleanup()
+
+	// Fake last level caches splitting package #0 in halves.
+	topoCache := newTestTopologyCache(sys)
+	topoCache.cacheMask = []cpuMask{
+		maskFromCPUSet(topoCache.words, cpuset.MustParse("0-9,40-49")),
+		maskFromCPUSet(topoCache.words, cpuset.MustParse("10-19,50-59")),
+		maskFromCPUSet(topoCache.words, cpuset.MustParse("20-39,60-79")),
+	}
+
+	tcs := []struct {
+		description string
+		from        cpuset.CPUSet
+		cnt         int
+		expected    cpuset.CPUSet
+	}{
+		{
+			description: "pack into the tightest fitting cache",
+			from:        cpuset.MustParse("0-5,10-19,50-59"),
+			cnt:         4,
+			expected:    cpuset.MustParse("0-3"),
+		},
+		{
+			description: "pack into the only fitting cache",
+			from:        cpuset.MustParse("0-5,10-19,50-59"),
+			cnt:         8,
+			expected:    cpuset.MustParse("10-13,50-53"),
+		},
+		{
+			description: "spread over caches if none fits",
+			from:        cpuset.MustParse("0-5,10-19,50-59"),
+			cnt:         24,
+			expected:    cpuset.MustParse("0-3,10-19,50-59"),
+		},
+	}
+
+	for _, tc := range tcs {
+		t.Run(tc.description, func(t *testing.T) {
+			a := newAllocatorHelper(sys, topoCache)
+			a.from = tc.from
+			a.prefer = PriorityNone
+			a.cnt = tc.cnt
+			result := a.allocate()
+			if !result.Equals(tc.expected) {
+				t.Errorf("expected %q, result was %q", tc.expected, result)
+			}
+		})
+	}
+}
+
+// randomAllocations generates random allocation requests.
+func randomAllocations(sys sysfs.System, cnt int) []struct {
+	from   cpuset.CPUSet
+	prefer CPUPriority
+	cnt    int
+} {
+	rng := rand.New(rand.NewSource(1))
+	cpus := sys.CPUSet().List()
+
+	reqs := make([]struct {
+		from   cpuset.CPUSet
+		prefer CPUPriority
+		cnt    int
+	}, cnt)
+
+	for i := range reqs {
+		from := []int{}
+		for _, id := range cpus {
+			if rng.Intn(4) != 0 {
+				from = append(from, id)
+			}
+		}
+		if len(from) == 0 {
+			from = append(from, cpus[0])
+		}
+		reqs[i].from = cpuset.New(from...)
+		reqs[i].prefer = CPUPriority(rng.Intn(int(NumCPUPriorities) + 1))
+		reqs[i].cnt = 1 + rng.Intn(len(from))
+	}
+
+	return reqs
+}
+
+func TestAllocatorMatchesLegacy(t *testing.T) {
+	sys, cleanup := discoverTestSystem(t)
+	defer cleanup()
+
+	topoCache := newTestTopologyCache(sys)
+
+	for i, req := range randomAllocations(sys, 500) {
+		for _, flags := range []AllocFlag{AllocDefault, AllocIdleCores, 0} {
+			a := newAllocatorHelper(sys, topoCache)
+			a.flags = flags
+			a.from = req.from.Clone()
+			a.prefer = req.prefer
+			a.cnt = req.cnt
+			result := a.allocate()
+
+			l := &legacyAllocatorHelper{newAllocatorHelper(sys, topoCache)}
+			l.flags = flags
+			l.from = req.from.Clone()
+			l.prefer = req.prefer
+			l.cnt = req.cnt
+			expected := l.allocate()
+
+			if !result.Equals(expected) || !a.from.Equals(l.from) {
+				t.Errorf("request #%d (%d CPUs from #%s, prefer %s, flags 0x%x): "+
+					"expected #%s (left #%s), got #%s (left #%s)", i, req.cnt, req.from,
+					req.prefer, flags, expected, l.from, result, a.from)
+			}
+		}
+	}
+}
+
+func BenchmarkAllocate(b *testing.B) {
+	sys, cleanup := discoverTestSystem(b)
+	defer cleanup()
+
+	topoCache := newTestTopologyCache(sys)
+	reqs := randomAllocations(sys, 64)
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		req := &reqs[i%len(reqs)]
+		a := newAllocatorHelper(sys, topoCache)
+		a.from = req.from.Clone()
+		a.prefer = req.prefer
+		a.cnt = req.cnt
+		a.allocate()
+	}
+}
+
+func BenchmarkAllocateLegacy(b *testing.B) {
+	sys, cleanup := discoverTestSystem(b)
+	defer cleanup()
+
+	topoCache := newTestTopologyCache(sys)
+	reqs := randomAllocations(sys, 64)
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		req := &reqs[i%len(reqs)]
+		l := &legacyAllocatorHelper{newAllocatorHelper(sys, topoCache)}
+		l.from = req.from.Clone()
+		l.prefer = req.prefer
+		l.cnt = req.cnt
+		l.allocate()
+	}
+}
+
+func BenchmarkAllocateSynthetic(b *testing.B) {
+	topologies := []testutils.SysfsTopology{
+		testutils.Sysfs32CPUs,
+		testutils.Sysfs256CPUs,
+		testutils.Sysfs1024CPUs,
+	}
+	for _, topology := range topologies {
+		root, err := testutils.GenerateSysfs(b.TempDir(), topology)
+		if err != nil {
+			b.Fatalf("%v", err)
+		}
+		sys, err := sysfs.DiscoverSystemAt(root, sysfs.DiscoverCPUTopology, sysfs.DiscoverMemTopology)
+		if err != nil {
+			b.Fatalf("failed to discover synthetic system: %v", err)
+		}
+		ca := NewCPUAllocator(sys)
+
+		for _, containers := range []int{10, 100, 1000} {
+			// Give each container an equal share of exclusive CPUs.
+			size := sys.CPUCount() / containers
+			if size < 1 {
+				continue
+			}
+
+			// Measure allocating and shrinking the last container's CPUs.
+			free := sys.CPUSet()
+			for i := 0; i < containers-1; i++ {
+				if _, err := ca.AllocateCpus(&free, size, PriorityNormal); err != nil {
+					b.Fatalf("failed to allocate CPUs for container #%d: %v", i, err)
+				}
+			}
+
+			name := topology.String() + "/containers=" + strconv.Itoa(containers)
+			b.Run(name+"/allocate", func(b *testing.B) {
+				b.ReportAllocs()
+				for i := 0; i < b.N; i++ {
+					from := free.Clone()
+					if _, err := ca.AllocateCpus(&from, size, PriorityNormal); err != nil {
+						b.Fatalf("failed to allocate CPUs: %v", err)
+					}
+				}
+			})
+
+			if size < 2 {
+				continue
+			}
+			rest := free.Clone()
+			cpus, err := ca.AllocateCpus(&rest, size, PriorityNormal)
+			if err != nil {
+				b.Fatalf("failed to allocate CPUs: %v", err)
+			}
+			b.Run(name+"/release", func(b *testing.B) {
+				b.ReportAllocs()
+				for i := 0; i < b.N; i++ {
+					from := cpus.Clone()
+					if _, err := ca.ReleaseCpus(&from, size/2, PriorityNormal); err != nil {
+						b.Fatalf("failed to release CPUs: %v", err)
+					}
+				}
+			})
+		}
+	}
+}
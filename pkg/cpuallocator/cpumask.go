@@ -0,0 +1,197 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cpuallocator
+
+import (
+	"math/bits"
+
+	"github.com/containers/nri-plugins/pkg/utils/cpuset"
+)
+
+const (
+	wordBits = 64
+)
+
+// cpuMask is a fixed-width bitmap of CPU IDs. Masks of different widths
+// can be freely combined, bits beyond the width of a mask are zero. The
+// in-place operations never grow the mask they are invoked on.
+type cpuMask []uint64
+
+// maskWords returns the number of words needed for the given number of CPU IDs.
+func maskWords(ids int) int {
+	return (ids + wordBits - 1) / wordBits
+}
+
+// newCPUMask creates a mask with room for the given number of words.
+func newCPUMask(words int) cpuMask {
+	return make(cpuMask, words)
+}
+
+// maskFromCPUSet creates a mask of at least the given width for a CPUSet.
+func maskFromCPUSet(words int, cset cpuset.CPUSet) cpuMask {
+	ids := cset.List()
+	if len(ids) > 0 {
+		if w := maskWords(ids[len(ids)-1] + 1); w > words {
+			words = w
+		}
+	}
+	m := newCPUMask(words)
+	for _, id := range ids {
+		m.set(id)
+	}
+	return m
+}
+
+// CPUSet returns the CPUs in the mask as a CPUSet.
+func (m cpuMask) CPUSet() cpuset.CPUSet {
+	return cpuset.New(m.appendIDs(make([]int, 0, m.count()))...)
+}
+
+// String returns the mask as a CPU list string.
+func (m cpuMask) String() string {
+	return m.CPUSet().String()
+}
+
+// set sets the bit for the given CPU.
+func (m cpuMask) set(id int) {
+	m[id/wordBits] |= 1 << (uint(id) % wordBits)
+}
+
+// has checks if the given CPU is set in the mask.
+func (m cpuMask) has(id int) bool {
+	w := id / wordBits
+	return id >= 0 && w < len(m) && m[w]&(1<<(uint(id)%wordBits)) != 0
+}
+
+// count returns the number of CPUs in the mask.
+func (m cpuMask) count() int {
+	cnt := 0
+	for _, w := range m {
+		cnt += bits.OnesCount64(w)
+	}
+	return cnt
+}
+
+// andCount returns the number of CPUs common to both masks.
+func (m cpuMask) andCount(o cpuMask) int {
+	n := len(m)
+	if len(o) < n {
+		n = len(o)
+	}
+	cnt := 0
+	for i := 0; i < n; i++ {
+		cnt += bits.OnesCount64(m[i] & o[i])
+	}
+	return cnt
+}
+
+// isEmpty checks if the mask has no CPUs set.
+func (m cpuMask) isEmpty() bool {
+	for _, w := range m {
+		if w != 0 {
+			return false
+		}
+	}
+	return true
+}
+
+// isSubsetOf checks if all CPUs in the mask are also in the other one.
+func (m cpuMask) isSubsetOf(o cpuMask) bool {
+	for i, w := range m {
+		var ow uint64
+		if i < len(o) {
+			ow = o[i]
+		}
+		if w&^ow != 0 {
+			return false
+		}
+	}
+	return true
+}
+
+// first returns the lowest CPU in the mask, or -1 for an empty mask.
+func (m cpuMask) first() int {
+	for i, w := range m {
+		if w != 0 {
+			return i*wordBits + bits.TrailingZeros64(w)
+		}
+	}
+	return -1
+}
+
+// or adds all CPUs of the other mask to this one.
+func (m cpuMask) or(o cpuMask) {
+	for i := 0; i < len(m) && i < len(o); i++ {
+		m[i] |= o[i]
+	}
+}
+
+// andNot removes all CPUs of the other mask from this one.
+func (m cpuMask) andNot(o cpuMask) {
+	for i := 0; i < len(m) && i < len(o); i++ {
+		m[i] &^= o[i]
+	}
+}
+
+// and keeps only the CPUs common to both masks in this one.
+func (m cpuMask) and(o cpuMask) {
+	for i := range m {
+		if i < len(o) {
+			m[i] &= o[i]
+		} else {
+			m[i] = 0
+		}
+	}
+}
+
+// clone returns a copy of the mask.
+func (m cpuMask) clone() cpuMask {
+	return append(cpuMask(nil), m...)
+}
+
+// appendIDs appends the CPUs in the mask, in increasing order, to ids.
+func (m cpuMask) appendIDs(ids []int) []int {
+	for i, w := range m {
+		for w != 0 {
+			b := bits.TrailingZeros64(w)
+			ids = append(ids, i*wordBits+b)
+			w &= w - 1
+		}
+	}
+	return ids
+}
+
+// unset clears the bit for the given CPU.
+func (m cpuMask) unset(id int) {
+	if w := id / wordBits; w < len(m) {
+		m[w] &^= 1 << (uint(id) % wordBits)
+	}
+}
+
+// andCount3 returns the number of CPUs common to all three masks.
+func andCount3(a, b, c cpuMask) int {
+	n := len(a)
+	if len(b) < n {
+		n = len(b)
+	}
+	if len(c) < n {
+		n = len(c)
+	}
+	cnt := 0
+	for i := 0; i < n; i++ {
+		cnt += bits.OnesCount64(a[i] & b[i] & c[i])
+	}
+	return cnt
+}
@@ -0,0 +1,272 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cpuallocator
+
+import (
+	"sort"
+
+	"github.com/containers/nri-plugins/pkg/utils/cpuset"
+
+	idset "github.com/intel/goresctrl/pkg/utils"
+)
+
+// legacyAllocatorHelper is the original CPUSet-based implementation of the
+// allocation algorithm. It is kept as a reference for verifying and
+// benchmarking the bitmap-based implementation.
+type legacyAllocatorHelper struct {
+	*allocatorHelper
+}
+
+// Pick packages, nodes or CPUs by filtering according to a function.
+func legacyPickIds(idSlice []idset.ID, f IDFilter) []idset.ID {
+	ids := make([]idset.ID, len(idSlice))
+
+	idx := 0
+	for _, id := range idSlice {
+		if f == nil || f(id) {
+			ids[idx] = id
+			idx++
+		}
+	}
+
+	return ids[0:idx]
+}
+
+// Allocate full idle CPU packages.
+func (a *legacyAllocatorHelper) takeIdlePackages() {
+	a.Debug("* takeIdlePackages()...")
+
+	offline := a.sys.Offlined()
+
+	// pick idle packages
+	pkgs := legacyPickIds(a.sys.PackageIDs(),
+		func(id idset.ID) bool {
+			cset := a.topology.pkg[id].Difference(offline)
+			return cset.Intersection(a.from).Equals(cset)
+		})
+
+	// sorted by number of preferred cpus and then by cpu id
+	sort.Slice(pkgs,
+		func(i, j int) bool {
+			if res := a.topology.cpuPriorities.legacyCmpCPUSet(a.topology.pkg[pkgs[i]], a.topology.pkg[pkgs[j]], a.prefer, -1); res != 0 {
+				return res > 0
+			}
+			return pkgs[i] < pkgs[j]
+		})
+
+	a.Debug(" => idle packages sorted by preference: %v", pkgs)
+
+	// take as many idle packages as we need/can
+	for _, id := range pkgs {
+		cset := a.topology.pkg[id].Difference(offline)
+		a.Debug(" => considering package %v (#%s)...", id, cset)
+		if a.cnt >= cset.Size() {
+			a.Debug(" => taking package %v...", id)
+			a.result = a.result.Union(cset)
+			a.from = a.from.Difference(cset)
+			a.cnt -= cset.Size()
+
+			if a.cnt == 0 {
+				break
+			}
+		}
+	}
+}
+
+// Allocate full idle CPU cores.
+func (a *legacyAllocatorHelper) takeIdleCores() {
+	a.Debug("* takeIdleCores()...")
+
+	offline := a.sys.Offlined()
+
+	// pick (first id for all) idle cores
+	cores := legacyPickIds(a.sys.CPUIDs(),
+		func(id idset.ID) bool {
+			cset := a.topology.core[id].Difference(offline)
+			if cset.IsEmpty() {
+				return false
+			}
+			return cset.Intersection(a.from).Equals(cset) && cset.List()[0] == int(id)
+		})
+
+	// sorted by id
+	sort.Slice(cores,
+		func(i, j int) bool {
+			if res := a.topology.cpuPriorities.legacyCmpCPUSet(a.topology.core[cores[i]], a.topology.core[cores[j]], a.prefer, -1); res != 0 {
+				return res > 0
+			}
+			return cores[i] < cores[j]
+		})
+
+	a.Debug(" => idle cores sorted by preference: %v", cores)
+
+	// take as many idle cores as we can
+	for _, id := range cores {
+		cset := a.topology.core[id].Difference(offline)
+		a.Debug(" => considering core %v (#%s)...", id, cset)
+		if a.cnt >= cset.Size() {
+			a.Debug(" => taking core %v...", id)
+			a.result = a.result.Union(cset)
+			a.from = a.from.Difference(cset)
+			a.cnt -= cset.Size()
+
+			if a.cnt == 0 {
+				break
+			}
+		}
+	}
+}
+
+// Allocate idle CPU hyperthreads.
+func (a *legacyAllocatorHelper) takeIdleThreads() {
+	offline := a.sys.Offlined()
+
+	// pick all threads with free capacity
+	cores := legacyPickIds(a.sys.CPUIDs(),
+		func(id idset.ID) bool {
+			return a.from.Difference(offline).Contains(int(id))
+		})
+
+	a.Debug(" => idle threads unsorted: %v", cores)
+
+	// sorted for preference by id, mimicking cpus_assignment.go for now:
+	//   IOW, prefer CPUs
+	//     - from packages with higher number of CPUs/cores already in a.result
+	//     - from packages having larger number of available cpus with preferred priority
+	//     - from a single package
+	//     - from the list of cpus with preferred priority
+	//     - from packages with fewer remaining free CPUs/cores in a.from
+	//     - from cores with fewer remaining free CPUs/cores in a.from
+	//     - from packages with lower id
+	//     - with lower id
+	sort.Slice(cores,
+		func(i, j int) bool {
+			iCore := cores[i]
+			jCore := cores[j]
+			iPkg := a.sys.CPU(iCore).PackageID()
+			jPkg := a.sys.CPU(jCore).PackageID()
+
+			iCoreSet := a.topology.core[iCore]
+			jCoreSet := a.topology.core[jCore]
+			iPkgSet := a.topology.pkg[iPkg]
+			jPkgSet := a.topology.pkg[jPkg]
+
+			iPkgColo := iPkgSet.Intersection(a.result).Size()
+			jPkgColo := jPkgSet.Intersection(a.result).Size()
+			if iPkgColo != jPkgColo {
+				return iPkgColo > jPkgColo
+			}
+
+			// Always sort cores in package order
+			if res := a.topology.cpuPriorities.legacyCmpCPUSet(iPkgSet.Intersection(a.from), jPkgSet.Intersection(a.from), a.prefer, a.cnt); res != 0 {
+				return res > 0
+			}
+			if iPkg != jPkg {
+				return iPkg < jPkg
+			}
+
+			iCset := cpuset.New(int(cores[i]))
+			jCset := cpuset.New(int(cores[j]))
+			if res := a.topology.cpuPriorities.legacyCmpCPUSet(iCset, jCset, a.prefer, 0); res != 0 {
+				return res > 0
+			}
+
+			iPkgFree := iPkgSet.Intersection(a.from).Size()
+			jPkgFree := jPkgSet.Intersection(a.from).Size()
+			if iPkgFree != jPkgFree {
+				return iPkgFree < jPkgFree
+			}
+
+			iCoreFree := iCoreSet.Intersection(a.from).Size()
+			jCoreFree := jCoreSet.Intersection(a.from).Size()
+			if iCoreFree != jCoreFree {
+				return iCoreFree < jCoreFree
+			}
+
+			return iCore < jCore
+		})
+
+	a.Debug(" => idle threads sorted: %v", cores)
+
+	// take as many idle cores as we can
+	for _, id := range cores {
+		cset := a.topology.core[id].Difference(offline)
+		a.Debug(" => considering thread %v (#%s)...", id, cset)
+		cset = cpuset.New(int(id))
+		a.result = a.result.Union(cset)
+		a.from = a.from.Difference(cset)
+		a.cnt -= cset.Size()
+
+		if a.cnt == 0 {
+			break
+		}
+	}
+}
+
+// Perform CPU allocation.
+func (a *legacyAllocatorHelper) allocate() cpuset.CPUSet {
+	if a.sys != nil {
+		if (a.flags & AllocIdlePackages) != 0 {
+			a.takeIdlePackages()
+		}
+		if a.cnt > 0 && (a.flags&AllocIdleCores) != 0 {
+			a.takeIdleCores()
+		}
+		if a.cnt > 0 {
+			a.takeIdleThreads()
+		}
+	} else {
+		a.takeAny()
+	}
+	if a.cnt == 0 {
+		return a.result
+	}
+
+	return cpuset.New()
+}
+
+// legacyCmpCPUSet compares two cpusets in terms of preferred cpu priority. Returns:
+//
+//	> 0 if cpuset A is preferred
+//	< 0 if cpuset B is preferred
+//	0 if cpusets A and B are equal in terms of cpu priority
+func (c *cpuPriorities) legacyCmpCPUSet(csetA, csetB cpuset.CPUSet, prefer CPUPriority, cpuCnt int) int {
+	if prefer == PriorityNone {
+		return 0
+	}
+
+	// Favor cpuset having CPUs with priorities equal to or lower than what was requested
+	for prio := prefer; prio < NumCPUPriorities; prio++ {
+		prefA := csetA.Intersection(c[prio]).Size()
+		prefB := csetB.Intersection(c[prio]).Size()
+		if cpuCnt > 0 && prio == prefer && prefA >= cpuCnt && prefB >= cpuCnt {
+			// Prefer the tightest fitting if both cpusets satisfy the
+			// requested amount of CPUs with the preferred priority
+			return prefB - prefA
+		}
+		if prefA != prefB {
+			return prefA - prefB
+		}
+	}
+	// Repel cpuset having CPUs with higher priority than what was requested
+	for prio := PriorityHigh; prio < prefer; prio++ {
+		nonprefA := csetA.Intersection(c[prio]).Size()
+		nonprefB := csetB.Intersection(c[prio]).Size()
+		if nonprefA != nonprefB {
+			return nonprefB - nonprefA
+		}
+	}
+	return 0
+}
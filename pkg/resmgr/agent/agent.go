@@ -19,6 +19,7 @@ package agent
 import (
 	"fmt"
 	"sync"
+	"time"
 
 	"github.com/containers/nri-plugins/pkg/log"
 	"github.com/containers/nri-plugins/pkg/resmgr/config"
@@ -45,7 +46,13 @@ type agent struct {
 	nrtCli     *nrtapi.TopologyV1alpha2Client
 	watcher    k8sWatcher    // Watcher monitoring events in K8s cluster
 	updater    configUpdater // Client sending config updates to nri-resource-policy
-	nrtLock    sync.Mutex    // serialize async CR updates
+	nrtLock    sync.Mutex    // protect pending CR update
+	nrtPending *nrtUpdate    // pending CR update
+	nrtTimer   *time.Timer   // timer for publishing pending CR update
+	nrtLast    *nrtUpdate    // last published CR update
+	nrtVersion string        // resourceVersion of last published CR
+
+	nrtPublishLock sync.Mutex // serialize async CR updates
 }
 
 // NewResourceManagerAgent creates a new instance of ResourceManagerAgent
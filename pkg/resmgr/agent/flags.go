@@ -18,6 +18,7 @@ package agent
 
 import (
 	"flag"
+	"time"
 
 	"github.com/containers/nri-plugins/pkg/kubernetes"
 )
@@ -27,6 +28,8 @@ type options struct {
 	configNs      string
 	configMapName string
 	labelName     string
+
+	nrtUpdateWindow time.Duration
 }
 
 var opts = options{}
@@ -36,4 +39,5 @@ func init() {
 	flag.StringVar(&opts.configNs, "config-ns", "kube-system", "Kubernetes namespace where to look for config")
 	flag.StringVar(&opts.configMapName, "configmap-name", "nri-resource-policy-config", "Name of the K8s ConfigMap to watch")
 	flag.StringVar(&opts.labelName, "label-name", kubernetes.ResmgrKey("group"), "Name of the label used to assign a node to a configuration group.")
+	flag.DurationVar(&opts.nrtUpdateWindow, "nrt-update-window", time.Second, "Time window for coalescing node resource topology CR updates.")
 }
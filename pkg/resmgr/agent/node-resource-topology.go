@@ -18,53 +18,106 @@ package agent
 
 import (
 	"context"
+	"encoding/json"
 	"fmt"
+	"time"
 
+	"k8s.io/apimachinery/pkg/api/equality"
 	"k8s.io/apimachinery/pkg/api/errors"
 	metav1 "k8s.io/apimachinery/pkg/apis/meta/v1"
+	"k8s.io/apimachinery/pkg/types"
 
 	policyapi "github.com/containers/nri-plugins/pkg/resmgr/policy"
 	nrtapi "github.com/k8stopologyawareschedwg/noderesourcetopology-api/pkg/apis/topology/v1alpha2"
 )
 
+// nrtUpdate is an update to the node resource topology CR.
+type nrtUpdate struct {
+	attributes nrtapi.AttributeList
+	zones      nrtapi.ZoneList
+}
+
+// nrtPatch is a merge patch for the node resource topology CR.
+type nrtPatch struct {
+	Metadata   nrtPatchMeta         `json:"metadata"`
+	Attributes nrtapi.AttributeList `json:"attributes"`
+	Zones      nrtapi.ZoneList      `json:"zones"`
+}
+
+type nrtPatchMeta struct {
+	ResourceVersion string `json:"resourceVersion"`
+}
+
 // UpdateNrtCR updates the node's node resource topology CR using the given data.
 func (a *agent) UpdateNrtCR(policy string, zones []*policyapi.TopologyZone) error {
-	a.Info("updating node resource topology CR")
-
 	if a.nrtCli == nil {
 		return fmt.Errorf("no node resource topology client, can't update CR")
 	}
 
+	u := &nrtUpdate{
+		attributes: nrtapi.AttributeList{
+			nrtapi.AttributeInfo{
+				Name:  "TopologyPolicy",
+				Value: policy,
+			},
+		},
+		zones: zonesToNrt(zones),
+	}
+
 	// To minimize the risk of an NRI request timeout (and the plugin getting
-	// kicked out) we do the update asynchronously. We can rework this to use
-	// a single goroutine that reads update requests from a channel to mimick
-	// the rest if necessary.
+	// kicked out) we do the update asynchronously. Updates are coalesced over
+	// the update window, and only the latest one gets published.
 	// XXX TODO(klihub): We can't/don't propagate update errors now back
 	//     to the caller. We could do that (using a channel) if necessary...
-	go func() {
-		if err := a.updateNrtCR(policy, zones); err != nil {
-			a.Error("failed to update topology CR: %v", err)
-		}
-	}()
+	a.nrtLock.Lock()
+	defer a.nrtLock.Unlock()
+
+	a.nrtPending = u
+	if a.nrtTimer == nil {
+		a.nrtTimer = time.AfterFunc(opts.nrtUpdateWindow, a.publishNrtCR)
+	}
 
 	return nil
 }
 
-// updateNrtCR updates the node's node resource topology CR using the given data.
-func (a *agent) updateNrtCR(policy string, zones []*policyapi.TopologyZone) error {
+// publishNrtCR publishes the latest pending node resource topology CR update.
+func (a *agent) publishNrtCR() {
 	a.nrtLock.Lock()
-	defer a.nrtLock.Unlock()
+	u := a.nrtPending
+	a.nrtPending = nil
+	a.nrtTimer = nil
+	a.nrtLock.Unlock()
 
-	cli := a.nrtCli.NodeResourceTopologies()
-	ctx := context.Background()
-	cr, err := cli.Get(ctx, nodeName, metav1.GetOptions{})
-	if err != nil {
-		cr = nil
-		if !errors.IsNotFound(err) {
-			a.Warn("failed to look up current node resource topology CR: %v", err)
+	if u == nil {
+		return
+	}
+
+	a.nrtPublishLock.Lock()
+	defer a.nrtPublishLock.Unlock()
+
+	if err := a.updateNrtCR(u); err != nil {
+		// Force a full update next time.
+		a.nrtLast = nil
+		a.nrtVersion = ""
+		a.Error("failed to update topology CR: %v", err)
+	}
+}
+
+// updateNrtCR updates the node's node resource topology CR using the given data.
+func (a *agent) updateNrtCR(u *nrtUpdate) error {
+	if last := a.nrtLast; last != nil {
+		if equality.Semantic.DeepEqual(last.attributes, u.attributes) &&
+			equality.Semantic.DeepEqual(last.zones, u.zones) {
+			a.Debug("node resource topology unchanged, skipping CR update")
+			return nil
 		}
 	}
 
+	a.Info("updating node resource topology CR")
+
+	cli := a.nrtCli.NodeResourceTopologies()
+	ctx := context.Background()
+
 	// delete existing CR if we got no data from policy
 	// XXX TODO Deletion should be handled differently:
 	//   1. add expiration timestamp to nrtapi.NodeResourceTopology
@@ -72,32 +125,57 @@ func (a *agent) updateNrtCR(policy string, zones []*policyapi.TopologyZone) erro
 	//   3. make sure we refresh our CR (either here or preferably/easier
 	//      by triggering in resmgr an updateTopologyZones() during longer
 	//      periods of inactivity)
-	if len(zones) == 0 {
-		if cr != nil {
-			err := cli.Delete(ctx, nodeName, metav1.DeleteOptions{})
-			if err != nil && !errors.IsNotFound(err) {
-				return fmt.Errorf("failed to delete node resource topology CR: %w", err)
-			}
+	if len(u.zones) == 0 {
+		err := cli.Delete(ctx, nodeName, metav1.DeleteOptions{})
+		if err != nil && !errors.IsNotFound(err) {
+			return fmt.Errorf("failed to delete node resource topology CR: %w", err)
 		}
+		a.nrtLast, a.nrtVersion = u, ""
 		return nil
 	}
 
-	// otherwise update CR if one exists
-	if cr != nil {
-		cr.Attributes = nrtapi.AttributeList{
-			nrtapi.AttributeInfo{
-				Name:  "TopologyPolicy",
-				Value: policy,
-			},
+	// patch the CR we last published if we know its version
+	if a.nrtVersion != "" {
+		data, err := json.Marshal(&nrtPatch{
+			Metadata:   nrtPatchMeta{ResourceVersion: a.nrtVersion},
+			Attributes: u.attributes,
+			Zones:      u.zones,
+		})
+		if err != nil {
+			return fmt.Errorf("failed to create node resource topology CR patch: %w", err)
 		}
 
-		cr.Zones = zonesToNrt(zones)
+		cr, err := cli.Patch(ctx, nodeName, types.MergePatchType, data, metav1.PatchOptions{})
+		if err == nil {
+			a.nrtLast, a.nrtVersion = u, cr.ResourceVersion
+			return nil
+		}
+		if !errors.IsConflict(err) && !errors.IsNotFound(err) {
+			return fmt.Errorf("failed to patch node resource topology CR: %w", err)
+		}
+
+		a.Warn("failed to patch node resource topology CR (%v), doing a full update", err)
+	}
 
-		_, err = cli.Update(ctx, cr, metav1.UpdateOptions{})
+	cr, err := cli.Get(ctx, nodeName, metav1.GetOptions{})
+	if err != nil {
+		cr = nil
+		if !errors.IsNotFound(err) {
+			a.Warn("failed to look up current node resource topology CR: %v", err)
+		}
+	}
+
+	// otherwise update CR if one exists
+	if cr != nil {
+		cr.Attributes = u.attributes
+		cr.Zones = u.zones
+
+		cr, err = cli.Update(ctx, cr, metav1.UpdateOptions{})
 		if err != nil {
 			return fmt.Errorf("failed to update node resource topology CR: %w", err)
 		}
 
+		a.nrtLast, a.nrtVersion = u, cr.ResourceVersion
 		return nil
 	}
 
@@ -106,21 +184,16 @@ func (a *agent) updateNrtCR(policy string, zones []*policyapi.TopologyZone) erro
 		ObjectMeta: metav1.ObjectMeta{
 			Name: nodeName,
 		},
-
-		Attributes: nrtapi.AttributeList{
-			nrtapi.AttributeInfo{
-				Name:  "TopologyPolicy",
-				Value: policy,
-			},
-		},
-		Zones: zonesToNrt(zones),
+		Attributes: u.attributes,
+		Zones:      u.zones,
 	}
 
-	_, err = cli.Create(ctx, cr, metav1.CreateOptions{})
+	cr, err = cli.Create(ctx, cr, metav1.CreateOptions{})
 	if err != nil {
 		return fmt.Errorf("failed to create node resource topology CR: %w", err)
 	}
 
+	a.nrtLast, a.nrtVersion = u, cr.ResourceVersion
 	return nil
 }
 
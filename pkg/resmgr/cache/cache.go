@@ -232,6 +232,10 @@ type Container interface {
 	SetCPUQuota(int64)
 	// SetCPUPeriod sets the CFS CPU period of the container.
 	SetCPUPeriod(int64)
+	// GetCpusetCpus gets the cgroup cpuset.cpus of the container, as reported by the runtime.
+	GetCpusetCpus() string
+	// GetCpusetMems gets the cgroup cpuset.mems of the container, as reported by the runtime.
+	GetCpusetMems() string
 	// SetCpusetCpu sets the cgroup cpuset.cpus of the container.
 	SetCpusetCpus(string)
 	// SetCpusetMems sets the cgroup cpuset.mems of the container.
@@ -352,8 +356,8 @@ type Cachable interface {
 //
 // Cache tracks pods and containers in the runtime, mostly by processing CRI
 // requests and responses which the cache is fed as these are being procesed.
-// Cache also saves its state upon changes to secondary storage and restores
-// itself upon startup.
+// Unless it is ephemeral, Cache also saves its state upon changes to secondary
+// storage and restores itself upon startup.
 type Cache interface {
 	// InsertPod inserts a pod into the cache, using a runtime request or reply.
 	InsertPod(pod *nri.PodSandbox) (Pod, error)
@@ -396,7 +400,8 @@ type Cache interface {
 	// ResetActivePolicy clears the active policy any any policy-specific data from the cache.
 	ResetActivePolicy() error
 
-	// SetPolicyEntry sets the policy entry for a key.
+	// SetPolicyEntry sets the policy entry for a key. Policies need to
+	// (re)set any entry they changed for the change to get saved.
 	SetPolicyEntry(string, interface{})
 	// GetPolicyEntry gets the policy entry for a key.
 	GetPolicyEntry(string, interface{}) bool
@@ -408,7 +413,8 @@ type Cache interface {
 	// ResetConfig clears any stored configuration from the cache.
 	ResetConfig() error
 
-	// Save requests a cache save.
+	// Save requests a cache save. Only changes since the last save are
+	// written, periodically compacting them into a full snapshot.
 	Save() error
 
 	// RefreshPods purges/inserts stale/new pods/containers using a pod sandbox list response.
@@ -449,6 +455,7 @@ type cache struct {
 	sync.Mutex `json:"-"` // we're lockable
 	filePath   string     // where to store to/load from
 	dataDir    string     // container data directory
+	ephemeral  bool       // never save to/load from filePath
 
 	Pods       map[string]*pod       // known/cached pods
 	Containers map[string]*container // known/cache containers
@@ -459,9 +466,14 @@ type cache struct {
 	policyData map[string]interface{} // opaque policy data
 	PolicyJSON map[string]string      // ditto in raw, unmarshaled form
 
-	pending map[string]struct{} // cache IDs of containers with pending changes
+	pending       map[string]struct{}              // cache IDs of containers with pending changes
+	podContainers map[string]map[string]*container // containers by pod ID
 
 	implicit map[string]ImplicitAffinity // implicit affinities
+
+	generation uint64     // generation of the last saved snapshot
+	journal    *journal   // journal of changes since the last snapshot
+	changes    *changeSet // changes since the last save
 }
 
 // Make sure cache implements Cache.
@@ -471,6 +483,9 @@ var _ Cache = &cache{}
 type Options struct {
 	// CacheDir is the directory the cache should save its state in.
 	CacheDir string
+	// Ephemeral keeps the cache in memory only. It is never saved or
+	// loaded, state is rebuilt from the runtime when we're restarted.
+	Ephemeral bool
 }
 
 // NewCache instantiates a new cache. Load it from the given path if it exists.
@@ -484,6 +499,8 @@ func NewCache(options Options) (Cache, error) {
 		policyData: make(map[string]interface{}),
 		PolicyJSON: make(map[string]string),
 		implicit:   make(map[string]ImplicitAffinity),
+		changes:    newChangeSet(),
+		ephemeral:  options.Ephemeral,
 	}
 
 	if _, err := cch.checkPerm("cache", cch.filePath, false, cacheFilePerm); err != nil {
@@ -495,6 +512,10 @@ func NewCache(options Options) (Cache, error) {
 	if err := cch.mkdirAll("container", cch.dataDir, dataDirPerm); err != nil {
 		return nil, err
 	}
+	if cch.ephemeral {
+		cch.removeSaved()
+		return cch, nil
+	}
 	if err := cch.Load(); err != nil {
 		return nil, err
 	}
@@ -510,6 +531,7 @@ func (cch *cache) GetActivePolicy() string {
 // SetActivePolicy updaes the name of the active policy stored in the cache.
 func (cch *cache) SetActivePolicy(policy string) error {
 	cch.PolicyName = policy
+	cch.markStateChanged()
 	return cch.Save()
 }
 
@@ -521,6 +543,7 @@ func (cch *cache) ResetActivePolicy() error {
 	cch.PolicyName = ""
 	cch.policyData = make(map[string]interface{})
 	cch.PolicyJSON = make(map[string]string)
+	cch.markCompaction()
 
 	return cch.Save()
 }
@@ -529,6 +552,7 @@ func (cch *cache) ResetActivePolicy() error {
 func (cch *cache) SetConfig(cfg config.RawConfig) error {
 	old := cch.Cfg
 	cch.Cfg = cfg
+	cch.markStateChanged()
 
 	if err := cch.Save(); err != nil {
 		cch.Cfg = old
@@ -547,6 +571,7 @@ func (cch *cache) GetConfig() config.RawConfig {
 func (cch *cache) ResetConfig() error {
 	old := cch.Cfg
 	cch.Cfg = nil
+	cch.markStateChanged()
 
 	if err := cch.Save(); err != nil {
 		cch.Cfg = old
@@ -560,6 +585,7 @@ func (cch *cache) ResetConfig() error {
 func (cch *cache) InsertPod(nriPod *nri.PodSandbox) (Pod, error) {
 	p := cch.createPod(nriPod)
 	cch.Pods[nriPod.GetId()] = p
+	cch.markPodChanged(p.GetID())
 	cch.Save()
 
 	return p, nil
@@ -574,6 +600,7 @@ func (cch *cache) DeletePod(id string) Pod {
 
 	log.Debug("removing pod %s (%s)", p.PrettyName(), p.GetID())
 	delete(cch.Pods, id)
+	cch.markPodChanged(id)
 
 	cch.Save()
 
@@ -599,7 +626,12 @@ func (cch *cache) InsertContainer(ctr *nri.Container) (Container, error) {
 		return nil, cacheError("failed to insert container %s: %v", c.GetID(), err)
 	}
 
+	if old, ok := cch.Containers[c.GetID()]; ok {
+		cch.unindexContainer(old)
+	}
 	cch.Containers[c.GetID()] = c
+	cch.indexContainer(c)
+	cch.markContainerChanged(c.GetID())
 	cch.createContainerDirectory(c.GetID())
 	cch.Save()
 
@@ -616,6 +648,8 @@ func (cch *cache) DeleteContainer(id string) Container {
 	log.Debug("removing container %s", c.PrettyName())
 	cch.removeContainerDirectory(c.GetID())
 	delete(cch.Containers, c.GetID())
+	cch.unindexContainer(c)
+	cch.markContainerChanged(c.GetID())
 
 	cch.Save()
 
@@ -632,7 +666,12 @@ func (cch *cache) LookupContainer(id string) (Container, bool) {
 func (cch *cache) LookupContainerByCgroup(path string) (Container, bool) {
 	log.Debug("resolving %s to a container...", path)
 
-	for _, c := range cch.Containers {
+	for _, id := range cgroupPathTokens(path) {
+		c, ok := cch.Containers[id]
+		if !ok {
+			continue
+		}
+
 		parent := ""
 		if pod, ok := c.GetPod(); ok {
 			parent = pod.GetCgroupParent()
@@ -641,11 +680,7 @@ func (cch *cache) LookupContainerByCgroup(path string) (Container, bool) {
 			continue
 		}
 
-		if !strings.HasPrefix(path, parent+"/") {
-			continue
-		}
-
-		if strings.Index(path, c.GetID()) != -1 {
+		if strings.HasPrefix(path, parent+"/") {
 			return c, true
 		}
 	}
@@ -784,6 +819,7 @@ func (cch *cache) GetContainers() []Container {
 // Set the policy entry for a key.
 func (cch *cache) SetPolicyEntry(key string, obj interface{}) {
 	cch.policyData[key] = obj
+	cch.markPolicyEntryChanged(key)
 
 	if log.DebugEnabled() {
 		if data, err := marshalEntry(obj); err != nil {
@@ -1041,6 +1077,7 @@ func (cch *cache) mkdirAll(what, path string, p *permissions) error {
 // snapshot is used to serialize the cache into a saveable/loadable state.
 type snapshot struct {
 	Version    string
+	Generation uint64 `json:",omitempty"`
 	Pods       map[string]*pod
 	Containers map[string]*container
 	NextID     uint64
@@ -1053,6 +1090,7 @@ type snapshot struct {
 func (cch *cache) Snapshot() ([]byte, error) {
 	s := snapshot{
 		Version:    CacheVersion,
+		Generation: cch.generation,
 		Pods:       make(map[string]*pod),
 		Containers: make(map[string]*container),
 		Cfg:        cch.Cfg,
@@ -1110,6 +1148,10 @@ func (cch *cache) Restore(data []byte) error {
 	cch.PolicyJSON = s.PolicyJSON
 	cch.PolicyName = s.PolicyName
 	cch.policyData = make(map[string]interface{})
+	cch.generation = s.Generation
+	cch.changes = newChangeSet()
+	cch.journal.close()
+	cch.journal = nil
 
 	for _, p := range cch.Pods {
 		p.cache = cch
@@ -1118,28 +1160,59 @@ func (cch *cache) Restore(data []byte) error {
 		c.cache = cch
 		cch.Containers[c.GetID()] = c
 	}
+	cch.rebuildIndex()
 
 	return nil
 }
 
 // Save the state of the cache.
 func (cch *cache) Save() error {
+	if cch.ephemeral {
+		cch.changes = newChangeSet()
+		return nil
+	}
+
+	if cch.needsCompaction() {
+		return cch.saveSnapshot()
+	}
+
+	if cch.changes.isEmpty() {
+		return nil
+	}
+
+	return cch.saveJournal()
+}
+
+// saveSnapshot saves the full state of the cache and starts a new journal.
+func (cch *cache) saveSnapshot() error {
 	log.Debug("saving cache to file '%s'...", cch.filePath)
 
+	cch.generation++
 	data, err := cch.Snapshot()
 	if err != nil {
+		cch.generation--
 		return cacheError("failed to save cache: %v", err)
 	}
 
 	tmpPath := cch.filePath + ".saving"
 	if err = os.WriteFile(tmpPath, data, cacheFilePerm.prefer); err != nil {
+		cch.generation--
 		return cacheError("failed to write cache to file %q: %v", tmpPath, err)
 	}
 	if err := os.Rename(tmpPath, cch.filePath); err != nil {
+		cch.generation--
 		return cacheError("failed to rename %q to %q: %v",
 			tmpPath, cch.filePath, err)
 	}
 
+	cch.changes = newChangeSet()
+	cch.journal.close()
+	cch.journal, err = openJournal(cch.journalPath(), cch.generation, int64(len(data)))
+	if err != nil {
+		// The snapshot is intact, we'll try again on the next save.
+		return cacheError("failed to start new journal: %v", err)
+	}
+
 	return nil
 }
 
@@ -1160,7 +1233,25 @@ func (cch *cache) Load() error {
 		return cacheError("failed to load cache from file '%s': %v", cch.filePath, err)
 	}
 
-	return cch.Restore(data)
+	if err := cch.Restore(data); err != nil {
+		return err
+	}
+
+	// Replayed changes get compacted into a new snapshot on the next save.
+	err = cch.replayJournal()
+	cch.rebuildIndex()
+
+	return err
+}
+
+// removeSaved removes any stale saved state, which we would otherwise load
+// if we were later restarted with a persistent cache.
+func (cch *cache) removeSaved() {
+	for _, path := range []string{cch.filePath, cch.journalPath()} {
+		if err := os.Remove(path); err != nil && !os.IsNotExist(err) {
+			log.Warn("failed to remove stale cache file %q: %v", path, err)
+		}
+	}
 }
 
 func (cch *cache) ContainerDirectory(id string) string {
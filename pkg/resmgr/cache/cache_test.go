@@ -87,10 +87,165 @@ var _ = Describe("Cache", func() {
 		Expect(pod).To(BeNil())
 		Expect(ok).To(BeFalse())
 	})
+
+	It("restores saved changes after a restart", func() {
+		var (
+			dir     = GinkgoT().TempDir()
+			nriPods = []*nri.PodSandbox{
+				makePod(),
+				makePod(),
+			}
+			nriCtrs = []*nri.Container{
+				makeCtr(WithCtrPodID(nriPods[0].GetId())),
+				makeCtr(WithCtrPodID(nriPods[1].GetId())),
+			}
+		)
+
+		c := makeCacheInDir(dir)
+		for _, nriPod := range nriPods {
+			_, err := c.InsertPod(nriPod)
+			Expect(err).To(BeNil())
+		}
+		for _, nriCtr := range nriCtrs {
+			_, err := c.InsertContainer(nriCtr)
+			Expect(err).To(BeNil())
+		}
+
+		ctr, ok := c.LookupContainer(nriCtrs[0].GetId())
+		Expect(ok).To(BeTrue())
+		ctr.SetTag("foo", "bar")
+		ctr.UpdateState(cache.ContainerStateRunning)
+		c.DeleteContainer(nriCtrs[1].GetId())
+		c.DeletePod(nriPods[1].GetId())
+		c.SetPolicyEntry("answer", 42)
+		Expect(c.Save()).To(BeNil())
+
+		r := makeCacheInDir(dir)
+
+		_, ok = r.LookupPod(nriPods[0].GetId())
+		Expect(ok).To(BeTrue())
+		_, ok = r.LookupPod(nriPods[1].GetId())
+		Expect(ok).To(BeFalse())
+		_, ok = r.LookupContainer(nriCtrs[1].GetId())
+		Expect(ok).To(BeFalse())
+
+		chk, ok := r.LookupContainer(nriCtrs[0].GetId())
+		Expect(ok).To(BeTrue())
+		Expect(chk.GetState()).To(Equal(cache.ContainerStateRunning))
+		tag, ok := chk.GetTag("foo")
+		Expect(ok).To(BeTrue())
+		Expect(tag).To(Equal("bar"))
+
+		answer := 0
+		Expect(r.GetPolicyEntry("answer", &answer)).To(BeTrue())
+		Expect(answer).To(Equal(42))
+	})
+
+	It("does not save or restore an ephemeral cache", func() {
+		var (
+			dir     = GinkgoT().TempDir()
+			nriPods = []*nri.PodSandbox{
+				makePod(),
+			}
+		)
+
+		c := makeCacheInDir(dir)
+		_, err := c.InsertPod(nriPods[0])
+		Expect(err).To(BeNil())
+		Expect(c.Save()).To(BeNil())
+
+		e, err := cache.NewCache(cache.Options{CacheDir: dir, Ephemeral: true})
+		Expect(err).To(BeNil())
+		_, ok := e.LookupPod(nriPods[0].GetId())
+		Expect(ok).To(BeFalse())
+
+		_, err = e.InsertPod(makePod())
+		Expect(err).To(BeNil())
+		Expect(e.Save()).To(BeNil())
+
+		r := makeCacheInDir(dir)
+		Expect(r.GetPods()).To(BeEmpty())
+	})
+
+	It("keeps track of the containers of pods", func() {
+		var (
+			dir     = GinkgoT().TempDir()
+			nriPods = []*nri.PodSandbox{
+				makePod(),
+				makePod(),
+			}
+			nriCtrs = []*nri.Container{
+				makeCtr(WithCtrPodID(nriPods[0].GetId())),
+				makeCtr(WithCtrPodID(nriPods[0].GetId())),
+				makeCtr(WithCtrPodID(nriPods[1].GetId())),
+			}
+		)
+
+		c := makeCacheInDir(dir)
+		for _, nriPod := range nriPods {
+			_, err := c.InsertPod(nriPod)
+			Expect(err).To(BeNil())
+		}
+		for _, nriCtr := range nriCtrs {
+			_, err := c.InsertContainer(nriCtr)
+			Expect(err).To(BeNil())
+		}
+
+		pod, ok := c.LookupPod(nriPods[0].GetId())
+		Expect(ok).To(BeTrue())
+		Expect(pod.GetContainers()).To(HaveLen(2))
+
+		c.DeleteContainer(nriCtrs[0].GetId())
+		Expect(pod.GetContainers()).To(HaveLen(1))
+		Expect(pod.GetContainers()[0].GetID()).To(Equal(nriCtrs[1].GetId()))
+		Expect(c.Save()).To(BeNil())
+
+		r := makeCacheInDir(dir)
+		pod, ok = r.LookupPod(nriPods[0].GetId())
+		Expect(ok).To(BeTrue())
+		Expect(pod.GetContainers()).To(HaveLen(1))
+		pod, ok = r.LookupPod(nriPods[1].GetId())
+		Expect(ok).To(BeTrue())
+		Expect(pod.GetContainers()).To(HaveLen(1))
+		Expect(pod.GetContainers()[0].GetID()).To(Equal(nriCtrs[2].GetId()))
+	})
+
+	It("resolves cgroup paths to containers", func() {
+		var (
+			parent  = "/kubepods.slice/kubepods-besteffort.slice/kubepods-besteffort-pod1234.slice"
+			nriPods = []*nri.PodSandbox{
+				makePod(WithCgroupParent(parent)),
+				makePod(WithCgroupParent("/kubepods/besteffort/pod5678")),
+			}
+			nriCtrs = []*nri.Container{
+				makeCtr(WithCtrPodID(nriPods[0].GetId())),
+				makeCtr(WithCtrPodID(nriPods[1].GetId())),
+			}
+		)
+
+		c, _, _ := makePopulatedCache(nriPods, nriCtrs)
+
+		ctr, ok := c.LookupContainerByCgroup(parent + "/cri-containerd-" + nriCtrs[0].GetId() + ".scope")
+		Expect(ok).To(BeTrue())
+		Expect(ctr.GetID()).To(Equal(nriCtrs[0].GetId()))
+
+		ctr, ok = c.LookupContainerByCgroup("/kubepods/besteffort/pod5678/" + nriCtrs[1].GetId())
+		Expect(ok).To(BeTrue())
+		Expect(ctr.GetID()).To(Equal(nriCtrs[1].GetId()))
+
+		_, ok = c.LookupContainerByCgroup("/kubepods/besteffort/pod5678/" + nriCtrs[0].GetId())
+		Expect(ok).To(BeFalse())
+		_, ok = c.LookupContainerByCgroup(parent + "/cri-containerd-xyzzy.scope")
+		Expect(ok).To(BeFalse())
+	})
 })
 
 func makeCache() cache.Cache {
-	c, err := cache.NewCache(cache.Options{CacheDir: GinkgoT().TempDir()})
+	return makeCacheInDir(GinkgoT().TempDir())
+}
+
+func makeCacheInDir(dir string) cache.Cache {
+	c, err := cache.NewCache(cache.Options{CacheDir: dir})
 	Expect(c).ToNot(BeNil())
 	Expect(err).To(BeNil())
 	if err != nil {
@@ -344,6 +344,7 @@ func (c *container) GetNamespace() string {
 
 func (c *container) UpdateState(state ContainerState) {
 	c.State = state
+	c.markChanged()
 }
 
 func (c *container) GetState() ContainerState {
@@ -483,6 +484,7 @@ func (c *container) SetResourceUpdates(r *nri.LinuxResources) bool {
 	}
 
 	c.ResourceUpdates = &updated
+	c.markChanged()
 	return !same
 }
 
@@ -603,6 +605,14 @@ func (c *container) SetCPUPeriod(value int64) {
 	c.markPending(NRI)
 }
 
+func (c *container) GetCpusetCpus() string {
+	return c.Ctr.GetLinux().GetResources().GetCpu().GetCpus()
+}
+
+func (c *container) GetCpusetMems() string {
+	return c.Ctr.GetLinux().GetResources().GetCpu().GetMems()
+}
+
 func (c *container) SetCpusetCpus(value string) {
 	switch req := c.getPendingRequest().(type) {
 	case *nri.ContainerAdjustment:
@@ -820,6 +830,12 @@ func (c *container) markPending(controllers ...string) {
 		c.pending[ctrl] = struct{}{}
 		c.cache.markPending(c)
 	}
+	c.markChanged()
+}
+
+// markChanged marks the container changed since the cache was last saved.
+func (c *container) markChanged() {
+	c.cache.markContainerChanged(c.GetID())
 }
 
 func (c *container) ClearPending(controller string) {
@@ -857,12 +873,14 @@ func (c *container) GetTag(key string) (string, bool) {
 func (c *container) SetTag(key string, value string) (string, bool) {
 	prev, ok := c.Tags[key]
 	c.Tags[key] = value
+	c.markChanged()
 	return prev, ok
 }
 
 func (c *container) DeleteTag(key string) (string, bool) {
 	value, ok := c.Tags[key]
 	delete(c.Tags, key)
+	c.markChanged()
 	return value, ok
 }
 
@@ -0,0 +1,97 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cache
+
+import (
+	"strings"
+)
+
+// indexContainer adds a container to the secondary indexes.
+func (cch *cache) indexContainer(c *container) {
+	if cch.podContainers == nil {
+		cch.podContainers = make(map[string]map[string]*container)
+	}
+
+	podID := c.GetPodID()
+	ctrs, ok := cch.podContainers[podID]
+	if !ok {
+		ctrs = make(map[string]*container)
+		cch.podContainers[podID] = ctrs
+	}
+	ctrs[c.GetID()] = c
+}
+
+// unindexContainer removes a container from the secondary indexes.
+func (cch *cache) unindexContainer(c *container) {
+	podID := c.GetPodID()
+	if ctrs, ok := cch.podContainers[podID]; ok {
+		delete(ctrs, c.GetID())
+		if len(ctrs) == 0 {
+			delete(cch.podContainers, podID)
+		}
+	}
+	delete(cch.pending, c.GetID())
+}
+
+// rebuildIndex rebuilds all secondary indexes from scratch.
+func (cch *cache) rebuildIndex() {
+	cch.podContainers = make(map[string]map[string]*container)
+	for _, c := range cch.Containers {
+		cch.indexContainer(c)
+	}
+	for id := range cch.pending {
+		if _, ok := cch.Containers[id]; !ok {
+			delete(cch.pending, id)
+		}
+	}
+}
+
+// podContainerList returns the indexed containers of the given pod.
+func (cch *cache) podContainerList(podID string) []Container {
+	ctrs := cch.podContainers[podID]
+	containers := make([]Container, 0, len(ctrs))
+	for _, c := range ctrs {
+		containers = append(containers, c)
+	}
+	return containers
+}
+
+// cgroupPathTokens returns the candidate container IDs embedded in a cgroup
+// path. Runtimes name container cgroups after the container ID, possibly with
+// a prefix and a suffix, for instance 'cri-containerd-<ID>.scope' with the
+// systemd driver or plain '<ID>' with the cgroupfs one. For every directory
+// we take the name with and without any suffix, along with everything after
+// each '-' or ':' in them.
+func cgroupPathTokens(path string) []string {
+	var tokens []string
+	for _, dir := range strings.Split(path, "/") {
+		if dir == "" {
+			continue
+		}
+		names := []string{dir}
+		if idx := strings.LastIndexByte(dir, '.'); idx > 0 {
+			names = append(names, dir[:idx])
+		}
+		for _, name := range names {
+			tokens = append(tokens, name)
+			for idx, r := range name {
+				if (r == '-' || r == ':') && idx+1 < len(name) {
+					tokens = append(tokens, name[idx+1:])
+				}
+			}
+		}
+	}
+	return tokens
+}
@@ -0,0 +1,358 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cache
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/json"
+	"errors"
+	"os"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/config"
+)
+
+//
+// The cache is persisted as a full snapshot together with an append-only
+// journal of changes made since that snapshot was taken. A save appends
+// records only for pods, containers, and policy entries changed since the
+// previous save. Once the journal grows larger than the last snapshot, the
+// next save compacts the state into a fresh snapshot and truncates the
+// journal. Both the snapshot and the journal carry a generation number. A
+// journal is only replayed on top of a snapshot of the same generation,
+// which protects against replaying stale records if we crash between
+// writing a new snapshot and truncating the journal.
+//
+
+const (
+	// journalMinLimit is the minimum journal size to allow before compaction.
+	journalMinLimit = 64 * 1024
+)
+
+// journalOp is the type of a single journal record.
+type journalOp string
+
+const (
+	journalHeader          journalOp = "header"
+	journalSetPod          journalOp = "pod"
+	journalDeletePod       journalOp = "delete-pod"
+	journalSetContainer    journalOp = "container"
+	journalDeleteContainer journalOp = "delete-container"
+	journalSetPolicyEntry  journalOp = "policy"
+	journalSetState        journalOp = "state"
+)
+
+// journalEntry is a single journal record.
+type journalEntry struct {
+	Op         journalOp     `json:"op"`
+	ID         string        `json:"id,omitempty"`
+	Generation uint64        `json:"generation,omitempty"`
+	Pod        *pod          `json:"pod,omitempty"`
+	Container  *container    `json:"container,omitempty"`
+	Policy     string        `json:"policy,omitempty"`
+	State      *journalState `json:"state,omitempty"`
+}
+
+// journalState is the non-pod, non-container, non-policy state of the cache.
+type journalState struct {
+	NextID     uint64
+	Cfg        config.RawConfig
+	PolicyName string
+}
+
+// journal is an open append-only journal file.
+type journal struct {
+	path  string        // journal file path
+	file  *os.File      // journal file, opened for appending
+	size  int64         // current size of the journal
+	limit int64         // size beyond which we compact into a snapshot
+	buf   bytes.Buffer  // reusable record buffer
+	enc   *json.Encoder // record encoder, writing to buf
+}
+
+// changeSet tracks changes in the cache since it was last saved.
+type changeSet struct {
+	pods       map[string]struct{} // changed or deleted pods
+	containers map[string]struct{} // changed or deleted containers
+	policy     map[string]struct{} // changed policy entries
+	state      bool                // changed configuration, policy name, etc.
+	compact    bool                // force compaction into a full snapshot
+}
+
+func newChangeSet() *changeSet {
+	return &changeSet{
+		pods:       make(map[string]struct{}),
+		containers: make(map[string]struct{}),
+		policy:     make(map[string]struct{}),
+	}
+}
+
+func (cs *changeSet) isEmpty() bool {
+	return !cs.state && !cs.compact &&
+		len(cs.pods) == 0 && len(cs.containers) == 0 && len(cs.policy) == 0
+}
+
+// openJournal creates or truncates the journal, writing a header for the generation.
+func openJournal(path string, generation uint64, limit int64) (*journal, error) {
+	file, err := os.OpenFile(path, os.O_CREATE|os.O_TRUNC|os.O_WRONLY|os.O_APPEND,
+		cacheFilePerm.prefer)
+	if err != nil {
+		return nil, cacheError("failed to open journal %q: %v", path, err)
+	}
+
+	if limit < journalMinLimit {
+		limit = journalMinLimit
+	}
+
+	j := &journal{
+		path:  path,
+		file:  file,
+		limit: limit,
+	}
+	j.enc = json.NewEncoder(&j.buf)
+
+	if err := j.enc.Encode(&journalEntry{Op: journalHeader, Generation: generation}); err != nil {
+		j.close()
+		return nil, cacheError("failed to encode journal header: %v", err)
+	}
+	if err := j.flush(); err != nil {
+		j.close()
+		return nil, err
+	}
+
+	return j, nil
+}
+
+// add encodes a new record to the journal buffer.
+func (j *journal) add(e *journalEntry) error {
+	if err := j.enc.Encode(e); err != nil {
+		return cacheError("failed to encode %s journal record %q: %v", e.Op, e.ID, err)
+	}
+	return nil
+}
+
+// flush writes all buffered records to the journal.
+func (j *journal) flush() error {
+	if j.buf.Len() == 0 {
+		return nil
+	}
+
+	n, err := j.file.Write(j.buf.Bytes())
+	j.size += int64(n)
+	j.buf.Reset()
+	if err != nil {
+		return cacheError("failed to write journal %q: %v", j.path, err)
+	}
+
+	return nil
+}
+
+// close closes the journal.
+func (j *journal) close() {
+	if j != nil && j.file != nil {
+		j.file.Close()
+		j.file = nil
+	}
+}
+
+// needsCompaction checks if the cache should be saved as a full snapshot.
+func (cch *cache) needsCompaction() bool {
+	return cch.journal == nil || cch.changes.compact || cch.journal.size >= cch.journal.limit
+}
+
+// markPodChanged marks a pod changed (or deleted) since the last save.
+func (cch *cache) markPodChanged(id string) {
+	cch.changes.pods[id] = struct{}{}
+}
+
+// markContainerChanged marks a container changed (or deleted) since the last save.
+func (cch *cache) markContainerChanged(id string) {
+	cch.changes.containers[id] = struct{}{}
+}
+
+// markPolicyEntryChanged marks a policy entry changed since the last save.
+func (cch *cache) markPolicyEntryChanged(key string) {
+	cch.changes.policy[key] = struct{}{}
+}
+
+// markStateChanged marks configuration or the active policy changed since the last save.
+func (cch *cache) markStateChanged() {
+	cch.changes.state = true
+}
+
+// markCompaction forces the next save to write a full snapshot.
+func (cch *cache) markCompaction() {
+	cch.changes.compact = true
+}
+
+// saveJournal appends all changes since the last save to the journal.
+func (cch *cache) saveJournal() error {
+	j := cch.journal
+
+	log.Debug("saving cache changes to journal '%s'...", j.path)
+
+	for id := range cch.changes.pods {
+		e := &journalEntry{Op: journalDeletePod, ID: id}
+		if p, ok := cch.Pods[id]; ok {
+			e.Op, e.Pod = journalSetPod, p
+		}
+		if err := j.add(e); err != nil {
+			return cch.abortJournal(err)
+		}
+	}
+
+	for id := range cch.changes.containers {
+		e := &journalEntry{Op: journalDeleteContainer, ID: id}
+		if c, ok := cch.Containers[id]; ok {
+			e.Op, e.Container = journalSetContainer, c
+		}
+		if err := j.add(e); err != nil {
+			return cch.abortJournal(err)
+		}
+	}
+
+	for key := range cch.changes.policy {
+		obj, ok := cch.policyData[key]
+		if !ok {
+			continue
+		}
+		data, err := marshalEntry(obj)
+		if err != nil {
+			return cch.abortJournal(cacheError("failed to marshal policy entry '%s': %v",
+				key, err))
+		}
+		if entry, ok := cch.PolicyJSON[key]; ok && entry == string(data) {
+			continue
+		}
+		cch.PolicyJSON[key] = string(data)
+		if err := j.add(&journalEntry{Op: journalSetPolicyEntry, ID: key, Policy: string(data)}); err != nil {
+			return cch.abortJournal(err)
+		}
+	}
+
+	if cch.changes.state {
+		e := &journalEntry{
+			Op: journalSetState,
+			State: &journalState{
+				NextID:     cch.NextID,
+				Cfg:        cch.Cfg,
+				PolicyName: cch.PolicyName,
+			},
+		}
+		if err := j.add(e); err != nil {
+			return cch.abortJournal(err)
+		}
+	}
+
+	if err := j.flush(); err != nil {
+		return cch.abortJournal(err)
+	}
+
+	cch.changes = newChangeSet()
+
+	return nil
+}
+
+// abortJournal discards buffered records and forces compaction on the next save.
+func (cch *cache) abortJournal(err error) error {
+	cch.journal.buf.Reset()
+	cch.markCompaction()
+	return cacheError("failed to save cache: %v", err)
+}
+
+// replayJournal applies journaled changes on top of the restored snapshot.
+func (cch *cache) replayJournal() error {
+	path := cch.journalPath()
+
+	file, err := os.Open(path)
+	if err != nil {
+		if errors.Is(err, os.ErrNotExist) {
+			return nil
+		}
+		return cacheError("failed to open journal %q: %v", path, err)
+	}
+	defer file.Close()
+
+	log.Debug("replaying cache journal '%s'...", path)
+
+	scanner := bufio.NewScanner(file)
+	scanner.Buffer(make([]byte, 64*1024), 64*1024*1024)
+
+	cnt := 0
+	for scanner.Scan() {
+		e := journalEntry{}
+		if err := json.Unmarshal(scanner.Bytes(), &e); err != nil {
+			// Most likely a record torn by a crash, ignore the rest.
+			log.Warn("ignoring corrupt cache journal record #%d and beyond: %v", cnt, err)
+			break
+		}
+
+		if cnt == 0 {
+			if e.Op != journalHeader || e.Generation != cch.generation {
+				log.Warn("ignoring stale cache journal (generation %d, expected %d)",
+					e.Generation, cch.generation)
+				return nil
+			}
+			cnt++
+			continue
+		}
+
+		cch.replayEntry(&e)
+		cnt++
+	}
+
+	if err := scanner.Err(); err != nil {
+		log.Warn("failed to fully read cache journal %q: %v", path, err)
+	}
+
+	log.Debug("replayed %d cache journal records", cnt)
+
+	return nil
+}
+
+// replayEntry applies a single journal record to the cache.
+func (cch *cache) replayEntry(e *journalEntry) {
+	switch e.Op {
+	case journalSetPod:
+		if e.Pod != nil {
+			e.Pod.cache = cch
+			cch.Pods[e.Pod.GetID()] = e.Pod
+		}
+	case journalDeletePod:
+		delete(cch.Pods, e.ID)
+	case journalSetContainer:
+		if e.Container != nil {
+			e.Container.cache = cch
+			cch.Containers[e.Container.GetID()] = e.Container
+		}
+	case journalDeleteContainer:
+		delete(cch.Containers, e.ID)
+	case journalSetPolicyEntry:
+		cch.PolicyJSON[e.ID] = e.Policy
+	case journalSetState:
+		if e.State != nil {
+			cch.NextID = e.State.NextID
+			cch.Cfg = e.State.Cfg
+			cch.PolicyName = e.State.PolicyName
+		}
+	default:
+		log.Warn("ignoring unknown cache journal record %q", e.Op)
+	}
+}
+
+// journalPath returns the path of the journal file.
+func (cch *cache) journalPath() string {
+	return cch.filePath + ".journal"
+}
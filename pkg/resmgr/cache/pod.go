@@ -40,15 +40,7 @@ func (cch *cache) createPod(nriPod *nri.PodSandbox) *pod {
 }
 
 func (p *pod) GetContainers() []Container {
-	containers := []Container{}
-
-	for _, c := range p.cache.Containers {
-		if c.GetPodID() == p.GetID() {
-			containers = append(containers, c)
-		}
-	}
-
-	return containers
+	return p.cache.podContainerList(p.GetID())
 }
 
 func (p *pod) GetID() string {
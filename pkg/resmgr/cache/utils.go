@@ -154,6 +154,9 @@ func findContainerDir(podCgroupDir, podID, ID string) string {
 	}
 
 	cpusetDir := cgroups.Cpuset.Path()
+	if cgroups.IsUnifiedHierarchy(cgroups.GetMountDir()) {
+		cpusetDir = cgroups.GetMountDir()
+	}
 
 	dirs = []string{
 		path.Join(cpusetDir, podCgroupDir, ID),
@@ -64,6 +64,7 @@ func Assign(c cache.Cache, class string, cpus ...int) error {
 		if err := ctl.enforceUncore(assignments, cpus...); err != nil {
 			log.Error("uncore frequency enforcement failed: %v", err)
 		}
+		ctl.freq.apply()
 	}
 
 	return nil
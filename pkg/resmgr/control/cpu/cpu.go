@@ -40,9 +40,18 @@ type cpuctl struct {
 	cache   cache.Cache  // resource manager cache
 	system  sysfs.System // system topology
 	config  *config
+	freq    *freqProgrammer // cpufreq and uncore frequency limit writer
+	dies    []*dieCPUs      // CPU package/dies, discovered on first use
 	started bool
 }
 
+// dieCPUs is a CPU package/die with its CPUs.
+type dieCPUs struct {
+	uncoreDie
+	cpus cpuset.CPUSet
+	ids  utils.IDSet
+}
+
 type config struct {
 	Classes map[string]Class `json:"classes"`
 
@@ -66,7 +75,7 @@ var singleton *cpuctl
 // getCPUController returns the (singleton) CPU controller instance.
 func getCPUController() *cpuctl {
 	if singleton == nil {
-		singleton = &cpuctl{}
+		singleton = &cpuctl{freq: newFreqProgrammer()}
 		singleton.config = singleton.defaultOptions().(*config)
 	}
 	return singleton
@@ -81,6 +90,7 @@ func (ctl *cpuctl) Start(cache cache.Cache) error {
 
 	ctl.system = sys
 	ctl.cache = cache
+	ctl.freq.start()
 
 	// DEBUG: dump the class assignments we have stored in the cache
 	log.Debug("retrieved cpu class assignments from cache:\n%s", utils.DumpJSON(getClassAssignments(ctl.cache)))
@@ -100,6 +110,7 @@ func (ctl *cpuctl) Start(cache cache.Cache) error {
 
 // Stop shuts down the controller.
 func (ctl *cpuctl) Stop() {
+	ctl.freq.close()
 }
 
 // PreCreateHook handler for the CPU controller.
@@ -127,28 +138,24 @@ func (ctl *cpuctl) PostStopHook(c cache.Container) error {
 	return nil
 }
 
-// enforceCpufreq enforces a class-specific cpufreq configuration to a cpuset
+// enforceCpufreq enforces a class-specific cpufreq configuration to a cpuset.
+// The limits are written asynchronously by ctl.freq once applied.
 func (ctl *cpuctl) enforceCpufreq(class string, cpus ...int) error {
 	if _, ok := ctl.config.Classes[class]; !ok {
 		return fmt.Errorf("non-existent cpu class %q", class)
 	}
 
-	min := int(ctl.config.Classes[class].MinFreq)
-	max := int(ctl.config.Classes[class].MaxFreq)
+	min := ctl.config.Classes[class].MinFreq
+	max := ctl.config.Classes[class].MaxFreq
 	log.Debug("enforcing cpu frequency limits {%d, %d} from class %q on %v", min, max, class, cpus)
 
-	if err := utils.SetCPUsScalingMinFreq(cpus, min); err != nil {
-		return fmt.Errorf("Cannot set min freq %d: %w", min, err)
-	}
-
-	if err := utils.SetCPUsScalingMaxFreq(cpus, max); err != nil {
-		return fmt.Errorf("Cannot set max freq %d: %w", max, err)
-	}
+	ctl.freq.setCPUs(freqLimits{min: min, max: max}, cpus...)
 
 	return nil
 }
 
-// enforceUncore enforces uncore frequency limits
+// enforceUncore enforces uncore frequency limits. The limits are written
+// asynchronously by ctl.freq once applied.
 func (ctl *cpuctl) enforceUncore(assignments cpuClassAssignments, affectedCPUs ...int) error {
 	if !ctl.config.uncoreEnabled {
 		return nil
@@ -156,39 +163,48 @@ func (ctl *cpuctl) enforceUncore(assignments cpuClassAssignments, affectedCPUs .
 
 	cpus := cpuset.New(affectedCPUs...)
 
+	for _, d := range ctl.uncoreDies() {
+		// Check if this die is affected by the specified cpuset
+		if cpus.Size() != 0 && d.cpus.Intersection(cpus).Size() == 0 {
+			continue
+		}
+
+		min, max, minCls, maxCls := effectiveUncoreFreqs(d.ids, ctl.config.Classes, assignments)
+
+		if min == 0 && max == 0 {
+			log.Debug("no uncore frequency limits for cpu package/die %d/%d", d.pkg, d.die)
+			continue
+		}
+
+		log.Debug("enforcing uncore min freq to %d (class %q), max freq to %d (class %q) on cpu package/die %d/%d", min, minCls, max, maxCls, d.pkg, d.die)
+		if min > 0 && max > 0 && min > max {
+			log.Warn("uncore frequency limit min > max (%d > %d) on cpu package/die %d/%d", min, max, d.pkg, d.die)
+		}
+
+		ctl.freq.setUncore(d.pkg, d.die, freqLimits{min: min, max: max})
+	}
+	return nil
+}
+
+// uncoreDies returns the CPU package/dies of the system with their CPUs.
+func (ctl *cpuctl) uncoreDies() []*dieCPUs {
+	if ctl.dies != nil {
+		return ctl.dies
+	}
+
+	ctl.dies = []*dieCPUs{}
 	for _, cpuPkgID := range ctl.system.PackageIDs() {
 		cpuPkg := ctl.system.Package(cpuPkgID)
 		for _, cpuDieID := range cpuPkg.DieIDs() {
-			dieCPUs := cpuPkg.DieCPUSet(cpuDieID)
-
-			// Check if this die is affected by the specified cpuset
-			if cpus.Size() == 0 || dieCPUs.Intersection(cpus).Size() > 0 {
-				min, max, minCls, maxCls := effectiveUncoreFreqs(utils.NewIDSet(dieCPUs.List()...), ctl.config.Classes, assignments)
-
-				if min == 0 && max == 0 {
-					log.Debug("no uncore frequency limits for cpu package/die %d/%d", cpuPkgID, cpuDieID)
-					continue
-				}
-
-				log.Debug("enforcing uncore min freq to %d (class %q), max freq to %d (class %q) on cpu package/die %d/%d", min, minCls, max, maxCls, cpuPkgID, cpuDieID)
-				if min > 0 {
-					if max > 0 && min > max {
-						log.Warn("uncore frequency limit min > max (%d > %d) on cpu package/die %d/%d", min, max, cpuPkgID, cpuDieID)
-					}
-
-					if err := utils.SetUncoreMinFreq(cpuPkgID, cpuDieID, int(min)); err != nil {
-						return err
-					}
-				}
-				if max > 0 {
-					if err := utils.SetUncoreMaxFreq(cpuPkgID, cpuDieID, int(max)); err != nil {
-						return err
-					}
-				}
-			}
+			cpus := cpuPkg.DieCPUSet(cpuDieID)
+			ctl.dies = append(ctl.dies, &dieCPUs{
+				uncoreDie: uncoreDie{pkg: cpuPkgID, die: cpuDieID},
+				cpus:      cpus,
+				ids:       utils.NewIDSet(cpus.List()...),
+			})
 		}
 	}
-	return nil
+	return ctl.dies
 }
 
 // effectiveUncoreClasses resolves the effective classes for setting the uncore
@@ -268,6 +284,7 @@ func (ctl *cpuctl) configure() error {
 	if err := ctl.enforceUncore(assignments); err != nil {
 		log.Error("uncore frequency enforcement on re-configure failed: %v", err)
 	}
+	ctl.freq.apply()
 
 	log.Debug("cpu controller configured")
 
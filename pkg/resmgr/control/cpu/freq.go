@@ -0,0 +1,294 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cpu
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"sync"
+)
+
+// Root of the sysfs tree frequency limits are written to, overridable for testing.
+var sysfsRoot = "/sys"
+
+// freqLimits are min and max frequency limits in kHz.
+type freqLimits struct {
+	min uint
+	max uint
+}
+
+// uncoreDie identifies the uncore of a CPU package/die.
+type uncoreDie struct {
+	pkg int
+	die int
+}
+
+// freqProgrammer programs cpufreq and uncore frequency limits. It tracks the
+// desired and the last written limits of every CPU and uncore. Only limits
+// which differ from the last written ones are written, in the background,
+// using sysfs files which are kept open across writes.
+type freqProgrammer struct {
+	sync.Mutex
+	cpus     map[int]freqLimits       // desired cpufreq limits
+	dies     map[uncoreDie]freqLimits // desired uncore limits
+	dirty    map[int]struct{}         // CPUs with changed desired limits
+	dirtyDie map[uncoreDie]struct{}   // uncores with changed desired limits
+
+	io         sync.Mutex // serializes writes, protects the rest
+	writtenCPU map[int]freqLimits
+	writtenDie map[uncoreDie]freqLimits
+	files      map[string]*os.File
+	writeLimit func(path string, value uint) error // overridable for testing
+
+	kick chan struct{}
+	stop chan struct{}
+	done chan struct{}
+}
+
+// newFreqProgrammer creates a new frequency programmer.
+func newFreqProgrammer() *freqProgrammer {
+	fp := &freqProgrammer{
+		cpus:       make(map[int]freqLimits),
+		dies:       make(map[uncoreDie]freqLimits),
+		dirty:      make(map[int]struct{}),
+		dirtyDie:   make(map[uncoreDie]struct{}),
+		writtenCPU: make(map[int]freqLimits),
+		writtenDie: make(map[uncoreDie]freqLimits),
+		files:      make(map[string]*os.File),
+		kick:       make(chan struct{}, 1),
+	}
+	fp.writeLimit = fp.write
+	return fp
+}
+
+// start starts writing limits in the background.
+func (fp *freqProgrammer) start() {
+	if fp.stop != nil {
+		return
+	}
+	fp.stop = make(chan struct{})
+	fp.done = make(chan struct{})
+	go fp.run(fp.stop, fp.done)
+}
+
+// close stops writing limits in the background, flushes any pending
+// limits and closes all open files.
+func (fp *freqProgrammer) close() {
+	if fp.stop != nil {
+		close(fp.stop)
+		<-fp.done
+		fp.stop = nil
+	}
+
+	fp.flush()
+
+	fp.io.Lock()
+	defer fp.io.Unlock()
+	for path, f := range fp.files {
+		f.Close()
+		delete(fp.files, path)
+	}
+}
+
+func (fp *freqProgrammer) run(stop, done chan struct{}) {
+	defer close(done)
+	for {
+		select {
+		case <-stop:
+			return
+		case <-fp.kick:
+			fp.flush()
+		}
+	}
+}
+
+// setCPUs sets the desired cpufreq limits of the given CPUs.
+func (fp *freqProgrammer) setCPUs(limits freqLimits, cpus ...int) {
+	fp.Lock()
+	defer fp.Unlock()
+	for _, id := range cpus {
+		if old, ok := fp.cpus[id]; !ok || old != limits {
+			fp.cpus[id] = limits
+			fp.dirty[id] = struct{}{}
+		}
+	}
+}
+
+// setUncore sets the desired uncore frequency limits of a CPU package/die.
+// A zero limit is left unchanged.
+func (fp *freqProgrammer) setUncore(pkg, die int, limits freqLimits) {
+	fp.Lock()
+	defer fp.Unlock()
+	key := uncoreDie{pkg: pkg, die: die}
+	if old, ok := fp.dies[key]; !ok || old != limits {
+		fp.dies[key] = limits
+		fp.dirtyDie[key] = struct{}{}
+	}
+}
+
+// apply triggers writing any changed limits in the background.
+func (fp *freqProgrammer) apply() {
+	select {
+	case fp.kick <- struct{}{}:
+	default:
+	}
+}
+
+// flush writes all changed limits.
+func (fp *freqProgrammer) flush() {
+	fp.Lock()
+	cpus := make(map[int]freqLimits, len(fp.dirty))
+	for id := range fp.dirty {
+		cpus[id] = fp.cpus[id]
+		delete(fp.dirty, id)
+	}
+	dies := make(map[uncoreDie]freqLimits, len(fp.dirtyDie))
+	for key := range fp.dirtyDie {
+		dies[key] = fp.dies[key]
+		delete(fp.dirtyDie, key)
+	}
+	fp.Unlock()
+
+	if len(cpus) == 0 && len(dies) == 0 {
+		return
+	}
+
+	fp.io.Lock()
+	defer fp.io.Unlock()
+
+	ids := make([]int, 0, len(cpus))
+	for id := range cpus {
+		ids = append(ids, id)
+	}
+	sort.Ints(ids)
+
+	written := 0
+	for _, id := range ids {
+		written += fp.writeCPU(id, cpus[id])
+	}
+	for key, limits := range dies {
+		written += fp.writeUncore(key, limits)
+	}
+
+	log.Debug("wrote %d frequency limits for %d CPUs and %d uncores",
+		written, len(cpus), len(dies))
+}
+
+// writeCPU writes the changed cpufreq limits of a CPU.
+func (fp *freqProgrammer) writeCPU(id int, limits freqLimits) int {
+	dir := filepath.Join(sysfsRoot, "devices", "system", "cpu", "cpu"+strconv.Itoa(id), "cpufreq")
+	old, known := fp.writtenCPU[id]
+	delete(fp.writtenCPU, id)
+
+	written, err := writeLimits(old, known, limits,
+		!known || old.min != limits.min,
+		!known || old.max != limits.max,
+		func() error { return fp.writeLimit(filepath.Join(dir, "scaling_min_freq"), limits.min) },
+		func() error { return fp.writeLimit(filepath.Join(dir, "scaling_max_freq"), limits.max) },
+	)
+	if err != nil {
+		log.Error("failed to set cpufreq limits of CPU #%d: %v", id, err)
+		return written
+	}
+
+	fp.writtenCPU[id] = limits
+	return written
+}
+
+// writeUncore writes the changed uncore frequency limits of a package/die.
+func (fp *freqProgrammer) writeUncore(key uncoreDie, limits freqLimits) int {
+	dir := filepath.Join(sysfsRoot, "devices", "system", "cpu", "intel_uncore_frequency",
+		fmt.Sprintf("package_%02d_die_%02d", key.pkg, key.die))
+	old, known := fp.writtenDie[key]
+	delete(fp.writtenDie, key)
+
+	written, err := writeLimits(old, known, limits,
+		limits.min > 0 && (!known || old.min != limits.min),
+		limits.max > 0 && (!known || old.max != limits.max),
+		func() error { return fp.writeLimit(filepath.Join(dir, "min_freq_khz"), limits.min) },
+		func() error { return fp.writeLimit(filepath.Join(dir, "max_freq_khz"), limits.max) },
+	)
+	if err != nil {
+		log.Error("failed to set uncore frequency limits of cpu package/die %d/%d: %v",
+			key.pkg, key.die, err)
+		return written
+	}
+
+	fp.writtenDie[key] = limits
+	return written
+}
+
+// writeLimits writes the min and/or max limit, as needed, in an order which
+// never takes min above max. Returns the number of limits written.
+func writeLimits(old freqLimits, known bool, limits freqLimits, needMin, needMax bool,
+	writeMin, writeMax func() error) (int, error) {
+	written := 0
+
+	switch {
+	case !known && needMin && needMax:
+		// We don't know the limits in effect, so neither which one has to
+		// go first. Write max both before and after min. If the first write
+		// fails because max would go below the current min, the last one
+		// succeeds once min is lowered.
+		if err := writeMax(); err == nil {
+			written++
+		}
+	case known && needMax && limits.min > old.max:
+		// Raise max first, min goes above the current one.
+		if err := writeMax(); err != nil {
+			return written, err
+		}
+		written++
+		needMax = false
+	}
+
+	if needMin {
+		if err := writeMin(); err != nil {
+			return written, err
+		}
+		written++
+	}
+	if needMax {
+		if err := writeMax(); err != nil {
+			return written, err
+		}
+		written++
+	}
+
+	return written, nil
+}
+
+// write writes a value to a sysfs file, opening it unless already open.
+func (fp *freqProgrammer) write(path string, value uint) error {
+	f, ok := fp.files[path]
+	if !ok {
+		var err error
+		if f, err = os.OpenFile(path, os.O_WRONLY, 0); err != nil {
+			return err
+		}
+		fp.files[path] = f
+	}
+
+	if _, err := f.WriteAt([]byte(strconv.FormatUint(uint64(value), 10)), 0); err != nil {
+		f.Close()
+		delete(fp.files, path)
+		return fmt.Errorf("failed to write %d to %s: %w", value, path, err)
+	}
+
+	return nil
+}
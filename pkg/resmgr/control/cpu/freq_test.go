@@ -0,0 +1,129 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cpu
+
+import (
+	"os"
+	"path/filepath"
+	"reflect"
+	"strconv"
+	"testing"
+)
+
+func TestFreqProgrammer(t *testing.T) {
+	sysfsRoot = t.TempDir()
+	defer func() { sysfsRoot = "/sys" }()
+
+	files := []string{
+		"devices/system/cpu/cpu0/cpufreq/scaling_min_freq",
+		"devices/system/cpu/cpu0/cpufreq/scaling_max_freq",
+		"devices/system/cpu/cpu1/cpufreq/scaling_min_freq",
+		"devices/system/cpu/cpu1/cpufreq/scaling_max_freq",
+		"devices/system/cpu/intel_uncore_frequency/package_00_die_00/min_freq_khz",
+		"devices/system/cpu/intel_uncore_frequency/package_00_die_00/max_freq_khz",
+	}
+	for _, file := range files {
+		path := filepath.Join(sysfsRoot, file)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatalf("failed to create fake sysfs: %v", err)
+		}
+		if err := os.WriteFile(path, []byte("0000000"), 0644); err != nil {
+			t.Fatalf("failed to create fake sysfs: %v", err)
+		}
+	}
+
+	// check verifies the content of the fake sysfs files, then resets them
+	// to detect which files get written next.
+	check := func(expected ...string) {
+		t.Helper()
+		for i, file := range files {
+			path := filepath.Join(sysfsRoot, file)
+			data, err := os.ReadFile(path)
+			if err != nil {
+				t.Fatalf("failed to read %s: %v", file, err)
+			}
+			if string(data) != expected[i] {
+				t.Errorf("expected %s in %s, got %s", expected[i], file, string(data))
+			}
+			if err := os.WriteFile(path, []byte("0000000"), 0644); err != nil {
+				t.Fatalf("failed to reset %s: %v", file, err)
+			}
+		}
+	}
+
+	fp := newFreqProgrammer()
+	defer fp.close()
+
+	fp.setCPUs(freqLimits{min: 1000000, max: 2000000}, 0, 1)
+	fp.setUncore(0, 0, freqLimits{min: 1200000})
+	fp.flush()
+	check("1000000", "2000000", "1000000", "2000000", "1200000", "0000000")
+
+	// Unchanged limits are not rewritten.
+	fp.setCPUs(freqLimits{min: 1000000, max: 2000000}, 0, 1)
+	fp.setUncore(0, 0, freqLimits{min: 1200000})
+	fp.flush()
+	check("0000000", "0000000", "0000000", "0000000", "0000000", "0000000")
+
+	// Only changed limits are written.
+	fp.setCPUs(freqLimits{min: 1000000, max: 3000000}, 1)
+	fp.setUncore(0, 0, freqLimits{min: 1200000, max: 2400000})
+	fp.flush()
+	check("0000000", "0000000", "0000000", "3000000", "0000000", "2400000")
+
+	// Limits are written in the background once applied.
+	fp.start()
+	fp.setCPUs(freqLimits{min: 1500000, max: 3000000}, 0)
+	fp.apply()
+	fp.close()
+	check("1500000", "3000000", "0000000", "0000000", "0000000", "0000000")
+}
+
+func TestFreqLimitOrder(t *testing.T) {
+	var writes []string
+	fp := newFreqProgrammer()
+	fp.writeLimit = func(path string, value uint) error {
+		writes = append(writes, filepath.Base(path)+"="+strconv.FormatUint(uint64(value), 10))
+		return nil
+	}
+	check := func(expected ...string) {
+		t.Helper()
+		if !reflect.DeepEqual(writes, expected) {
+			t.Errorf("expected writes %v, got %v", expected, writes)
+		}
+		writes = nil
+	}
+
+	// With the limits in effect unknown, max is written before and after min.
+	fp.setCPUs(freqLimits{min: 1000000, max: 2000000}, 0)
+	fp.setUncore(0, 0, freqLimits{min: 1200000, max: 2400000})
+	fp.flush()
+	check("scaling_max_freq=2000000", "scaling_min_freq=1000000", "scaling_max_freq=2000000",
+		"max_freq_khz=2400000", "min_freq_khz=1200000", "max_freq_khz=2400000")
+
+	// Raising both limits past the current max writes max first.
+	fp.setCPUs(freqLimits{min: 2500000, max: 3500000}, 0)
+	fp.setUncore(0, 0, freqLimits{min: 2600000, max: 3000000})
+	fp.flush()
+	check("scaling_max_freq=3500000", "scaling_min_freq=2500000",
+		"max_freq_khz=3000000", "min_freq_khz=2600000")
+
+	// Lowering both limits below the current min writes min first.
+	fp.setCPUs(freqLimits{min: 800000, max: 1500000}, 0)
+	fp.setUncore(0, 0, freqLimits{min: 1000000, max: 2000000})
+	fp.flush()
+	check("scaling_min_freq=800000", "scaling_max_freq=1500000",
+		"min_freq_khz=1000000", "max_freq_khz=2000000")
+}
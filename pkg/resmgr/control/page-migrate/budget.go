@@ -0,0 +1,125 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"os"
+	"sync"
+	"time"
+
+	idset "github.com/intel/goresctrl/pkg/utils"
+)
+
+// moveBudget is a node-wide page migration budget, shared by all container
+// demoters. It is a token bucket per target node, refilled at a constant
+// rate of pages per second and capped to one page move interval worth of
+// pages. A nil budget is unlimited.
+type moveBudget struct {
+	sync.Mutex
+	rate    float64                  // pages per second per target node
+	burst   float64                  // maximum accumulated pages per target node
+	buckets map[idset.ID]*moveBucket // per target node buckets
+	now     func() time.Time
+}
+
+type moveBucket struct {
+	pages float64   // pages currently available
+	last  time.Time // time of last refill
+}
+
+// newMoveBudget creates a budget from page and byte rate limits, 0 meaning
+// unlimited. The tighter of the two limits is used. If neither is set, it
+// returns nil.
+func newMoveBudget(pageRate uint, byteRate uint64, interval time.Duration) *moveBudget {
+	rate := float64(pageRate)
+	if byteRate > 0 {
+		if r := float64(byteRate) / float64(os.Getpagesize()); rate == 0 || r < rate {
+			rate = r
+		}
+	}
+	if rate == 0 {
+		return nil
+	}
+
+	burst := rate * interval.Seconds()
+	if burst < 1 {
+		burst = 1
+	}
+
+	return &moveBudget{
+		rate:    rate,
+		burst:   burst,
+		buckets: make(map[idset.ID]*moveBucket),
+		now:     time.Now,
+	}
+}
+
+// reserve reserves up to count pages for moving to node and returns the
+// number of pages granted.
+func (b *moveBudget) reserve(node idset.ID, count uint) uint {
+	if b == nil || count == 0 {
+		return count
+	}
+
+	b.Lock()
+	defer b.Unlock()
+
+	bucket := b.refill(node)
+	granted := count
+	if avail := uint(bucket.pages); avail < granted {
+		granted = avail
+	}
+	bucket.pages -= float64(granted)
+
+	return granted
+}
+
+// refund returns unused reserved pages to node's budget.
+func (b *moveBudget) refund(node idset.ID, count uint) {
+	if b == nil || count == 0 {
+		return
+	}
+
+	b.Lock()
+	defer b.Unlock()
+
+	bucket := b.refill(node)
+	bucket.pages += float64(count)
+	if bucket.pages > b.burst {
+		bucket.pages = b.burst
+	}
+}
+
+// refill tops up the bucket of node for the time elapsed since its last refill.
+func (b *moveBudget) refill(node idset.ID) *moveBucket {
+	now := b.now()
+
+	bucket, ok := b.buckets[node]
+	if !ok {
+		bucket = &moveBucket{pages: b.burst, last: now}
+		b.buckets[node] = bucket
+		return bucket
+	}
+
+	if elapsed := now.Sub(bucket.last); elapsed > 0 {
+		bucket.pages += elapsed.Seconds() * b.rate
+		if bucket.pages > b.burst {
+			bucket.pages = b.burst
+		}
+		bucket.last = now
+	}
+
+	return bucket
+}
@@ -16,13 +16,13 @@ package pagemigrate
 
 import (
 	"encoding/binary"
-	"fmt"
-	"io"
 	"io/ioutil"
 	"math/rand"
 	"os"
+	"runtime"
 	"strconv"
 	"strings"
+	"sync"
 	"time"
 
 	"github.com/containers/nri-plugins/pkg/cgroups"
@@ -51,6 +51,12 @@ import (
 //    which don't have the soft-dirty bit are considered to be outside of the
 //    working set.
 
+const (
+	pagemapSoftDirtyBit = uint64(0x1) << 55
+	pagemapExclusiveBit = uint64(0x1) << 56
+	pagemapPresentBit   = uint64(0x1) << 63
+)
+
 type page struct {
 	pid  int
 	addr uint64
@@ -74,8 +80,19 @@ type demoter struct {
 	pageScanInterval  config.Duration             // How often should we scan pages.
 	pageMoveInterval  config.Duration             // How often should we move pages for a container.
 	maxPageMoveCount  uint                        // How many pages to move at once.
+	maxPageMoveRate   uint                        // Max. pages per second to move to a node.
+	maxPageMoveBytes  uint64                      // Max. bytes per second to move to a node.
+	budget            *moveBudget                 // Node-wide page migration budget.
+	idleTracking      string                      // How to detect idle pages.
 }
 
+const (
+	// maxScanWorkers is the maximum number of containers to scan concurrently.
+	maxScanWorkers = 8
+	// pagemapChunk is the number of pagemap entries to read at once.
+	pagemapChunk = 512
+)
+
 type pagePool struct {
 	pages        map[int][]page
 	longestRange uint
@@ -86,18 +103,6 @@ type demotion struct {
 	targetNodes idset.IDSet
 }
 
-func copyPagePool(p pagePool) pagePool {
-	c := pagePool{
-		longestRange: p.longestRange,
-		pages:        make(map[int][]page, 0),
-	}
-	for pid, pages := range p.pages {
-		c.pages[pid] = make([]page, len(pages))
-		copy(c.pages[pid], pages)
-	}
-	return c
-}
-
 func newDemoter(m *migration) *demoter {
 	return &demoter{
 		migration:         m,
@@ -128,11 +133,23 @@ func (d *demoter) Stop() {
 func (d *demoter) Reconfigure() {
 	if d.pageScanInterval != opt.PageScanInterval ||
 		d.pageMoveInterval != opt.PageMoveInterval ||
-		d.maxPageMoveCount != opt.MaxPageMoveCount {
+		d.maxPageMoveCount != opt.MaxPageMoveCount ||
+		d.maxPageMoveRate != opt.MaxPageMoveRate ||
+		d.maxPageMoveBytes != opt.MaxPageMoveBandwidth ||
+		d.idleTracking != opt.IdleTracking {
 		d.Stop()
 		d.pageScanInterval = opt.PageScanInterval
 		d.pageMoveInterval = opt.PageMoveInterval
 		d.maxPageMoveCount = opt.MaxPageMoveCount
+		d.maxPageMoveRate = opt.MaxPageMoveRate
+		d.maxPageMoveBytes = opt.MaxPageMoveBandwidth
+		d.budget = newMoveBudget(d.maxPageMoveRate, d.maxPageMoveBytes,
+			time.Duration(d.pageMoveInterval))
+		d.idleTracking = opt.IdleTracking
+		if err := checkIdleTracking(d.idleTracking); err != nil {
+			log.Error("%v, falling back to %s tracking", err, SoftDirtyTracking)
+			d.idleTracking = SoftDirtyTracking
+		}
 	}
 	d.start()
 }
@@ -153,14 +170,14 @@ func (d *demoter) updateDemoter(cid string, p pagePool, targetNodes idset.IDSet)
 					demotion, ok := msg.(demotion)
 					if ok {
 						pagePool = demotion.pagePool
-						targetNodes = demotion.targetNodes
-						if p.longestRange > d.maxPageMoveCount {
+						nodes = demotion.targetNodes
+						if pagePool.longestRange > d.maxPageMoveCount {
 							// The number of pages moved needs to be at least as large as a range in numa_maps
 							// file so that we know that all pages will be moved (even if some of them were
 							// already on the PMEM node).
 
 							// TODO: adjust the timer if we have a larger-than-usual range of pages to move.
-							count = p.longestRange
+							count = pagePool.longestRange
 						} else {
 							count = d.maxPageMoveCount
 						}
@@ -268,45 +285,101 @@ func (d *demoter) resetDirtyBit(c *container) error {
 }
 
 // scanPages scans pages of tracked containers to detect idle ones.
+//
+// Containers are snapshotted with the migration lock held, then scanned
+// without the lock by a bounded pool of workers. The lock is reacquired
+// only for handing the results over to the container demoters.
 func (d *demoter) scanPages() {
+	d.migration.Lock()
+	containers := make([]*container, 0, len(d.migration.containers))
+	for _, c := range d.migration.containers {
+		pm := c.GetPageMigration()
+		if pm == nil || pm.SourceNodes.Size() == 0 || pm.TargetNodes.Size() == 0 {
+			continue
+		}
+		containers = append(containers, &container{
+			id:         c.id,
+			prettyName: c.prettyName,
+			cgroupDir:  c.cgroupDir,
+			pm:         pm.Clone(),
+		})
+	}
+	d.migration.Unlock()
+
+	pools := make([]*pagePool, len(containers))
+
+	workers := runtime.NumCPU()
+	if workers > maxScanWorkers {
+		workers = maxScanWorkers
+	}
+	if workers > len(containers) {
+		workers = len(containers)
+	}
+
+	var wg sync.WaitGroup
+	work := make(chan int)
+
+	wg.Add(workers)
+	for i := 0; i < workers; i++ {
+		go func() {
+			defer wg.Done()
+			buf := make([]byte, 8*pagemapChunk)
+			tracker := d.newIdleTracker()
+			defer tracker.close()
+			for idx := range work {
+				pools[idx] = d.scanContainer(containers[idx], buf, tracker)
+			}
+		}()
+	}
+	for idx := range containers {
+		work <- idx
+	}
+	close(work)
+	wg.Wait()
+
 	d.migration.Lock()
 	defer d.migration.Unlock()
 
-	for _, container := range d.migration.containers {
-		pm := container.GetPageMigration()
-		if pm == nil {
+	for idx, c := range containers {
+		if pools[idx] == nil {
 			continue
 		}
-		dramNodes := pm.SourceNodes
-		pmemNodes := pm.TargetNodes
-		if dramNodes.Size() == 0 || pmemNodes.Size() == 0 {
+		// Skip containers which were removed while we were scanning.
+		if _, ok := d.migration.containers[c.id]; !ok {
 			continue
 		}
+		// Give the pages to the page moving goroutine.
+		d.updateDemoter(c.id, *pools[idx], c.pm.TargetNodes)
+	}
 
-		// Gather the known pages which need to be moved.
-		pagePool, err := d.getPagesForContainer(container, dramNodes)
-		if err != nil {
-			log.Error("failed to get pages for container %v", container.prettyName)
-			continue
-		}
+	d.stopUnusedDemoters(d.migration.containers)
+}
 
-		count := 0
-		for _, pages := range pagePool.pages {
-			count += len(pages)
-		}
-		log.Debug("%d pages for (maybe) demoting for %v", count, container.prettyName)
+// scanContainer collects demotion candidate pages and rearms idle tracking for a container.
+func (d *demoter) scanContainer(c *container, buf []byte, tracker idleTracker) *pagePool {
+	// Gather the known pages which need to be moved.
+	pool, err := d.getPagesForContainer(c, c.pm.SourceNodes, buf, tracker)
+	if err != nil {
+		log.Error("failed to get pages for container %v", c.prettyName)
+		return nil
+	}
 
-		// Reset the dirty bit from all pages.
-		d.resetDirtyBit(container)
+	count := 0
+	for _, pages := range pool.pages {
+		count += len(pages)
+	}
+	log.Debug("%d pages for (maybe) demoting for %v", count, c.prettyName)
 
-		// Give the pages to the page moving goroutine. Copy the page pool so that there's no race.
-		d.updateDemoter(container.GetID(), copyPagePool(pagePool), pmemNodes.Clone())
+	// Restart tracking page accesses.
+	if err := tracker.rearm(c); err != nil {
+		log.Error("failed to rearm idle page tracking: %v", err)
 	}
 
-	d.stopUnusedDemoters(d.migration.containers)
+	return &pool
 }
 
-func (d *demoter) getPagesForContainer(c *container, sourceNodes idset.IDSet) (pagePool, error) {
+// getPagesForContainer collects demotion candidate pages using buf for reading pagemap.
+func (d *demoter) getPagesForContainer(c *container, sourceNodes idset.IDSet, buf []byte, tracker idleTracker) (pagePool, error) {
 	pool := pagePool{
 		pages:        make(map[int][]page, 0),
 		longestRange: 0,
@@ -336,8 +409,8 @@ func (d *demoter) getPagesForContainer(c *container, sourceNodes idset.IDSet) (p
 		mapsPath := "/proc/" + pid + "/maps"
 		mapsBytes, err := ioutil.ReadFile(mapsPath)
 		if err != nil {
-			log.Error("Could not read maps: %v\n", err)
-			os.Exit(1)
+			log.Error("Could not read maps: %v", err)
+			continue
 		}
 		mapsLines := strings.Split(string(mapsBytes), "\n")
 
@@ -406,49 +479,47 @@ func (d *demoter) getPagesForContainer(c *container, sourceNodes idset.IDSet) (p
 			pageMap, err := os.OpenFile(path, os.O_RDONLY, 0)
 			if err != nil {
 				// Probably the process just died?
-				fmt.Printf("Could not read pagemaps: %v\n", err)
-				break
+				log.Error("Could not read pagemaps: %v", err)
+				continue
 			}
+			pageSize := uint64(os.Getpagesize())
 			for _, addressRange := range addressRanges {
-				idx := int64(addressRange.addr / uint64(os.Getpagesize()) * 8)
-				offset, err := pageMap.Seek(idx, io.SeekStart)
-				if err != nil {
-					// Maybe there was a race condition and the maps changed?
-					log.Error("Failed to seek: %v\n", err)
-					continue
-				}
-				for i := uint64(0); i < addressRange.length; i++ {
-					bytes := make([]byte, 8)
-					// Read exactly 8 bytes (because the file interface breaks otherwise).
-					_, err = io.ReadAtLeast(pageMap, bytes, 8)
-					if err != nil {
+				// Read pagemap entries in chunks of len(buf) bytes.
+				offset := int64(addressRange.addr / pageSize * 8)
+				for i := uint64(0); i < addressRange.length; {
+					n := addressRange.length - i
+					if chunk := uint64(len(buf) / 8); n > chunk {
+						n = chunk
+					}
+					cnt, err := pageMap.ReadAt(buf[:n*8], offset+int64(i*8))
+					if err != nil && cnt < int(n*8) {
 						// Possibly the maps changed.
-						log.Error("Could not read data from pagemaps(%v)(page size: %d, seek offset: %d): %v\n", idx, os.Getpagesize(), offset, err)
-						break
+						log.Error("Could not read data from pagemaps (offset %d): %v", offset+int64(i*8), err)
+						n = uint64(cnt / 8)
+						addressRange.length = i + n
 					}
-					data := binary.LittleEndian.Uint64(bytes)
-
-					// Check that the page is present (not swapped), exclusively
-					// mapped (not used by any other process), and it has the
-					// soft-dirty bit off.
-
-					// Note: there appears to be no way to see from the pagemap entry what the NUMA node is.
-					// We could map this back to the physical address ranges if needed. Currently this is handled
-					// in movePages() by calling move_pages() first with an empty node array.
-
-					softDirtyBit := uint64(0x1) << 55
-					exclusiveBit := uint64(0x1) << 56
-					presentBit := uint64(0x1) << 63
-					present := (data&presentBit == presentBit)
-					exclusive := (data&exclusiveBit == exclusiveBit)
-					softDirty := (data&softDirtyBit == softDirtyBit)
-
-					if present && exclusive && !softDirty {
-						// log.Debug("page a candidate for moving: 0x%08x", addressRange.addr+i*uint64(os.Getpagesize()))
-						pages = append(pages, page{addr: addressRange.addr + i*uint64(os.Getpagesize()), pid: pidNumber})
+					for j := uint64(0); j < n; j++ {
+						data := binary.LittleEndian.Uint64(buf[j*8:])
+
+						// Check that the page is present (not swapped), exclusively
+						// mapped (not used by any other process), and it has been
+						// idle since the last scan.
+
+						// Note: there appears to be no way to see from the pagemap entry what the NUMA node is.
+						// We could map this back to the physical address ranges if needed. Currently this is handled
+						// in movePages() by calling move_pages() first with an empty node array.
+
+						present := (data&pagemapPresentBit == pagemapPresentBit)
+						exclusive := (data&pagemapExclusiveBit == pagemapExclusiveBit)
+
+						if present && exclusive && tracker.isIdle(data) {
+							pages = append(pages, page{addr: addressRange.addr + (i+j)*pageSize, pid: pidNumber})
+						}
 					}
+					i += n
 				}
 			}
+			pageMap.Close()
 			if _, found := pool.pages[pidNumber]; found {
 				pool.pages[pidNumber] = append(pool.pages[pidNumber], pages...)
 			} else {
@@ -498,26 +569,53 @@ func (d *demoter) movePagesForPid(p []page, count uint, pid int, targetNodes ids
 		return 0, err
 	}
 
-	dramPages := make([]uintptr, 0)
-	nodes := make([]int, 0)
 	// Choose a target node for every page. Drop the pages which already are on the right controller from the list.
+	targets := make([]int, len(currentStatus))
+	demand := make(map[idset.ID]uint)
 	for i, pageStatus := range currentStatus {
+		targets[i] = -1
 		if pageStatus < 0 {
 			// There was an error regarding this page.
 			continue
 		}
-		// log.Debug("page 0x%08X: old status %d", pages[i], pageStatus)
 		if !targetNodes.Has(idset.ID(pageStatus)) {
 			// In case of many PMEM controllers choose the one that is the closest.
-			dramPages = append(dramPages, pages[i])
-			nodes = append(nodes, int(pickClosestPMEMNode(idset.ID(pageStatus), targetNodes)))
+			node := pickClosestPMEMNode(idset.ID(pageStatus), targetNodes)
+			targets[i] = int(node)
+			demand[node]++
 		} // else no need to move.
 	}
 
+	// Reserve migration budget for the target nodes. If we run out of budget,
+	// stop at the first page we can't move and leave the rest for later.
+	granted := make(map[idset.ID]uint, len(demand))
+	for node, cnt := range demand {
+		granted[node] = d.budget.reserve(node, cnt)
+	}
+
+	dramPages := make([]uintptr, 0, len(targets))
+	nodes := make([]int, 0, len(targets))
+	for i, node := range targets {
+		if node < 0 {
+			continue
+		}
+		if granted[idset.ID(node)] == 0 {
+			log.Debug("page migration budget for node %d exhausted", node)
+			nPages = uint(i)
+			break
+		}
+		granted[idset.ID(node)]--
+		dramPages = append(dramPages, pages[i])
+		nodes = append(nodes, node)
+	}
+	for node, cnt := range granted {
+		d.budget.refund(node, cnt)
+	}
+
 	// Call move_pages() to actually move the pages.
 	_, _, err = d.pageMover.MovePagesSyscall(pid, uint(len(dramPages)), dramPages, nodes, flags)
 
-	// We processed (moved or ignored) at least nPages.
+	// We processed (moved or ignored) nPages.
 	return nPages, err
 }
 
@@ -16,8 +16,11 @@ package pagemigrate
 
 import (
 	"fmt"
-	idset "github.com/intel/goresctrl/pkg/utils"
+	"os"
 	"testing"
+	"time"
+
+	idset "github.com/intel/goresctrl/pkg/utils"
 )
 
 type mockPageMover struct {
@@ -256,3 +259,86 @@ func TestMovePages(t *testing.T) {
 		})
 	}
 }
+
+func TestMovePagesWithBudget(t *testing.T) {
+	now := time.Unix(0, 0)
+	budget := newMoveBudget(2, 0, time.Second)
+	budget.now = func() time.Time { return now }
+
+	pool := pagePool{
+		pages: map[int][]page{
+			500: {
+				{pid: 500, addr: 0xdeadbeef},
+				{pid: 500, addr: 0xc0ffee},
+				{pid: 500, addr: 0xbadc0de},
+			},
+		},
+	}
+	mover := &mockPageMover{
+		firstSuccess:               true,
+		secondSuccess:              true,
+		firstStatus:                []int{0, 0, 0},
+		expectedPagesForSecondCall: 2,
+	}
+	d := &demoter{
+		maxPageMoveCount: 3,
+		pageMover:        mover,
+		budget:           budget,
+	}
+
+	if err := d.movePages(pool, 3, idset.NewIDSet(1)); err != nil {
+		t.Errorf("unexpected error: %v", err)
+	}
+	if len(pool.pages[500]) != 1 {
+		t.Errorf("expected 1 page left over budget, got %d", len(pool.pages[500]))
+	}
+
+	mover.firstStatus = []int{0}
+	mover.expectedPagesForSecondCall = 0
+	if err := d.movePages(pool, 3, idset.NewIDSet(1)); err != nil {
+		t.Errorf("unexpected error: %v", err)
+	}
+	if len(pool.pages[500]) != 1 {
+		t.Errorf("expected no pages moved with exhausted budget, got %d left", len(pool.pages[500]))
+	}
+
+	now = now.Add(500 * time.Millisecond)
+	mover.expectedPagesForSecondCall = 1
+	if err := d.movePages(pool, 3, idset.NewIDSet(1)); err != nil {
+		t.Errorf("unexpected error: %v", err)
+	}
+	if len(pool.pages[500]) != 0 {
+		t.Errorf("expected all pages moved after refill, got %d left", len(pool.pages[500]))
+	}
+}
+
+func TestMoveBudget(t *testing.T) {
+	if b := newMoveBudget(0, 0, time.Second); b != nil {
+		t.Errorf("expected nil (unlimited) budget without limits")
+	}
+
+	now := time.Unix(0, 0)
+	b := newMoveBudget(1000, 100*uint64(os.Getpagesize()), time.Second)
+	b.now = func() time.Time { return now }
+
+	if b.rate != 100 {
+		t.Errorf("expected tighter byte rate limit to be used, got rate %f", b.rate)
+	}
+	if n := b.reserve(1, 150); n != 100 {
+		t.Errorf("expected 100 pages granted, got %d", n)
+	}
+	if n := b.reserve(2, 50); n != 50 {
+		t.Errorf("expected separate budget for node 2, got %d", n)
+	}
+	if n := b.reserve(1, 10); n != 0 {
+		t.Errorf("expected exhausted budget, got %d", n)
+	}
+	b.refund(1, 5)
+	if n := b.reserve(1, 10); n != 5 {
+		t.Errorf("expected refunded 5 pages granted, got %d", n)
+	}
+	now = now.Add(10 * time.Second)
+	if n := b.reserve(1, 1000); n != 100 {
+		t.Errorf("expected budget capped to burst, got %d", n)
+	}
+}
@@ -26,6 +26,12 @@ type options struct {
 	PageMoveInterval config.Duration
 	// MaxPageMoveCount controls how many pages we can move in a single go.
 	MaxPageMoveCount uint
+	// MaxPageMoveRate limits how many pages per second we move to a single target node.
+	MaxPageMoveRate uint
+	// MaxPageMoveBandwidth limits how many bytes per second we move to a single target node.
+	MaxPageMoveBandwidth uint64
+	// IdleTracking selects how idle pages are detected, soft-dirty (default) or idle-page.
+	IdleTracking string
 }
 
 // Our runtime configuration.
@@ -0,0 +1,178 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"encoding/binary"
+	"os"
+)
+
+const (
+	// SoftDirtyTracking detects idle pages by clearing and checking soft-dirty bits.
+	SoftDirtyTracking = "soft-dirty"
+	// IdlePageTracking detects idle pages using kernel idle page tracking.
+	IdlePageTracking = "idle-page"
+)
+
+// Idle page tracking:
+//   https://www.kernel.org/doc/html/latest/admin-guide/mm/idle_page_tracking.html
+//
+// With idle page tracking we mark the candidate pages of a container idle
+// in the kernel idle page bitmap during a scan. Any access, read or write,
+// clears the idle flag of a page. On the next scan the pages which still
+// have their idle flag set are the ones which have not been accessed since
+// the last scan. Unlike soft-dirty tracking this does not need to write
+// clear_refs, which write-protects every PTE of the process and flushes
+// its TLB, and it detects read-mostly working sets, too.
+//
+// Idle page tracking works by page frame number. Reading page frame numbers
+// from pagemap requires CAP_SYS_ADMIN, without it every page is considered
+// active.
+
+var (
+	// pageIdleBitmap is the path to the kernel idle page bitmap.
+	pageIdleBitmap = "/sys/kernel/mm/page_idle/bitmap"
+)
+
+const (
+	// pagemapPFNMask masks the page frame number of a present pagemap entry.
+	pagemapPFNMask = (uint64(0x1) << 55) - 1
+	// idleBitmapChunk is the number of idle bitmap words to read at once.
+	idleBitmapChunk = 64
+)
+
+// idleTracker detects pages which have not been accessed since the last scan.
+type idleTracker interface {
+	// isIdle checks if the page of a present pagemap entry has been idle.
+	isIdle(entry uint64) bool
+	// rearm restarts tracking accesses for the pages of a container.
+	rearm(c *container) error
+	// close releases any resources used by the tracker.
+	close()
+}
+
+// softDirtyTracker detects idle pages using soft-dirty bits.
+type softDirtyTracker struct {
+	d *demoter
+}
+
+// idlePageTracker detects idle pages using the kernel idle page bitmap.
+type idlePageTracker struct {
+	bitmap *os.File         // idle page bitmap
+	buf    []byte           // bitmap read buffer
+	base   int64            // index of the first word in buf, -1 if none
+	cnt    int64            // number of words in buf
+	marks  map[int64]uint64 // bits to mark idle, by word index
+}
+
+// checkIdleTracking checks if the given idle page tracking method is usable.
+func checkIdleTracking(method string) error {
+	switch method {
+	case "", SoftDirtyTracking:
+		return nil
+	case IdlePageTracking:
+		f, err := os.OpenFile(pageIdleBitmap, os.O_RDWR, 0)
+		if err != nil {
+			return migrationError("idle page tracking not available: %v", err)
+		}
+		f.Close()
+		return nil
+	}
+	return migrationError("unknown idle page tracking method %q", method)
+}
+
+// newIdleTracker creates an idle page tracker for a scanning worker.
+func (d *demoter) newIdleTracker() idleTracker {
+	if d.idleTracking == IdlePageTracking {
+		f, err := os.OpenFile(pageIdleBitmap, os.O_RDWR, 0)
+		if err == nil {
+			return &idlePageTracker{
+				bitmap: f,
+				buf:    make([]byte, 8*idleBitmapChunk),
+				base:   -1,
+				marks:  make(map[int64]uint64),
+			}
+		}
+		log.Error("failed to open idle page bitmap, falling back to soft-dirty tracking: %v", err)
+	}
+	return &softDirtyTracker{d: d}
+}
+
+func (t *softDirtyTracker) isIdle(entry uint64) bool {
+	return entry&pagemapSoftDirtyBit == 0
+}
+
+func (t *softDirtyTracker) rearm(c *container) error {
+	return t.d.resetDirtyBit(c)
+}
+
+func (t *softDirtyTracker) close() {}
+
+func (t *idlePageTracker) isIdle(entry uint64) bool {
+	pfn := int64(entry & pagemapPFNMask)
+	if pfn == 0 {
+		return false
+	}
+
+	idx, bit := pfn/64, uint64(0x1)<<(pfn%64)
+	t.marks[idx] |= bit
+
+	if idx < t.base || idx >= t.base+t.cnt || t.base < 0 {
+		base := idx - idx%idleBitmapChunk
+		n, err := t.bitmap.ReadAt(t.buf, base*8)
+		if n < 8 {
+			if err != nil {
+				log.Error("failed to read idle page bitmap (offset %d): %v", base*8, err)
+			}
+			t.base = -1
+			return false
+		}
+		t.base, t.cnt = base, int64(n/8)
+		if idx >= t.base+t.cnt {
+			return false
+		}
+	}
+
+	word := binary.LittleEndian.Uint64(t.buf[(idx-t.base)*8:])
+	return word&bit != 0
+}
+
+func (t *idlePageTracker) rearm(c *container) error {
+	var (
+		buf  [8]byte
+		errs int
+		err  error
+	)
+
+	for idx, bits := range t.marks {
+		binary.LittleEndian.PutUint64(buf[:], bits)
+		if _, e := t.bitmap.WriteAt(buf[:], idx*8); e != nil {
+			errs++
+			err = e
+		}
+		delete(t.marks, idx)
+	}
+	t.base = -1
+
+	if err != nil {
+		return migrationError("%s: failed to mark %d idle bitmap words: %v",
+			c.prettyName, errs, err)
+	}
+	return nil
+}
+
+func (t *idlePageTracker) close() {
+	t.bitmap.Close()
+}
@@ -0,0 +1,93 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package pagemigrate
+
+import (
+	"encoding/binary"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func TestIdlePageTracker(t *testing.T) {
+	bitmap := filepath.Join(t.TempDir(), "bitmap")
+	if err := os.WriteFile(bitmap, make([]byte, 8*2*idleBitmapChunk), 0600); err != nil {
+		t.Fatalf("failed to create fake idle page bitmap: %v", err)
+	}
+	defer func(path string) { pageIdleBitmap = path }(pageIdleBitmap)
+	pageIdleBitmap = bitmap
+
+	if err := checkIdleTracking(IdlePageTracking); err != nil {
+		t.Fatalf("unexpected error: %v", err)
+	}
+	if err := checkIdleTracking("foo"); err == nil {
+		t.Errorf("expected error for unknown tracking method")
+	}
+
+	d := &demoter{idleTracking: IdlePageTracking}
+	tracker := d.newIdleTracker()
+	defer tracker.close()
+	if _, ok := tracker.(*idlePageTracker); !ok {
+		t.Fatalf("expected idle page tracker, got %T", tracker)
+	}
+
+	c := &container{prettyName: "test"}
+	pfns := []uint64{5, 64*idleBitmapChunk + 3}
+
+	for _, pfn := range pfns {
+		if tracker.isIdle(pagemapPresentBit | pfn) {
+			t.Errorf("unmarked page %d reported idle", pfn)
+		}
+	}
+	if tracker.isIdle(pagemapPresentBit) {
+		t.Errorf("page without PFN reported idle")
+	}
+	if err := tracker.rearm(c); err != nil {
+		t.Fatalf("failed to rearm tracker: %v", err)
+	}
+
+	for _, pfn := range pfns {
+		if !tracker.isIdle(pagemapPresentBit | pfn) {
+			t.Errorf("marked page %d not reported idle", pfn)
+		}
+	}
+	if tracker.isIdle(pagemapPresentBit | 6) {
+		t.Errorf("unmarked page 6 reported idle")
+	}
+
+	if err := tracker.rearm(c); err != nil {
+		t.Fatalf("failed to rearm tracker: %v", err)
+	}
+
+	// Simulate the kernel clearing the idle flag of page 5 on access.
+	f, err := os.OpenFile(bitmap, os.O_RDWR, 0)
+	if err != nil {
+		t.Fatalf("failed to open fake idle page bitmap: %v", err)
+	}
+	word := make([]byte, 8)
+	binary.LittleEndian.PutUint64(word, uint64(0x1)<<6)
+	_, err = f.WriteAt(word, 0)
+	f.Close()
+	if err != nil {
+		t.Fatalf("failed to update fake idle page bitmap: %v", err)
+	}
+
+	if !tracker.isIdle(pagemapPresentBit | 6) {
+		t.Errorf("marked page 6 not reported idle")
+	}
+	if tracker.isIdle(pagemapPresentBit | 5) {
+		t.Errorf("accessed page 5 reported idle")
+	}
+}
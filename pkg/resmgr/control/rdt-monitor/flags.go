@@ -0,0 +1,42 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package rdtmonitor
+
+import (
+	"github.com/containers/nri-plugins/pkg/config"
+)
+
+// options captures our configurable controller parameters.
+type options struct {
+	// MonitorContainers creates a resctrl monitoring group for each container.
+	// Classes are always monitored. Each monitoring group uses up an RMID, of
+	// which there is a limited number in the system.
+	MonitorContainers bool
+}
+
+// Our runtime configuration.
+var opt = defaultOptions().(*options)
+
+// defaultOptions returns a new options instance, all initialized to defaults.
+func defaultOptions() interface{} {
+	return &options{
+		MonitorContainers: true,
+	}
+}
+
+// Register us for configuration handling.
+func init() {
+	config.Register(RDTMonitorConfigPath, RDTMonitorDescription, opt, defaultOptions)
+}
@@ -0,0 +1,577 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package rdtmonitor
+
+import (
+	"errors"
+	"fmt"
+	"os"
+	"path/filepath"
+	"sync"
+	"syscall"
+	"time"
+
+	"github.com/prometheus/client_golang/prometheus"
+
+	"github.com/containers/nri-plugins/pkg/cgroups"
+	logger "github.com/containers/nri-plugins/pkg/log"
+	"github.com/containers/nri-plugins/pkg/metrics"
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+	"github.com/containers/nri-plugins/pkg/resmgr/control"
+	"github.com/containers/nri-plugins/pkg/resmgr/sampler"
+)
+
+const (
+	// RDTMonitorController is the name of the RDT monitoring controller.
+	RDTMonitorController = "rdt-monitor"
+	// RDTMonitorConfigPath is the configuration path for the RDT monitoring controller.
+	RDTMonitorConfigPath = "resource-manager.control." + RDTMonitorController
+	// RDTMonitorDescription is the description for the RDT monitoring controller.
+	RDTMonitorDescription = "RDT monitoring controller"
+
+	// monGroupPrefix is the name prefix of our per-container monitoring groups.
+	monGroupPrefix = "nri-"
+)
+
+//
+// The runtime assigns containers to resctrl control groups, one per RDT
+// class, according to the class we set for them. Each control group has
+// its own monitoring data, which we export per class. For per-container
+// data we create a monitoring group for each container within its class
+// and keep adding the container's threads to it. Threads created since
+// the last sampling round are accounted to the control group until added.
+//
+// Sampling happens in the rounds of the shared sampler, asynchronously to
+// request processing, so just like the page migration controller we keep
+// a local copy of the little data we need about containers. Metrics
+// collection only reports the data of the latest round.
+//
+
+// Usage is the latest measured last level cache and memory bandwidth usage.
+type Usage struct {
+	// LLCOccupancy is the number of bytes of last level cache occupied.
+	LLCOccupancy uint64
+	// MemoryBandwidth is the total memory bandwidth used, in bytes/s.
+	MemoryBandwidth float64
+	// LocalMemoryBandwidth is the memory bandwidth to local memory, in bytes/s.
+	LocalMemoryBandwidth float64
+}
+
+// monitor implements the controller for RDT monitoring.
+type monitor struct {
+	sync.Mutex
+	root       string                // resctrl mount point
+	running    bool                  // whether we are running
+	classes    map[string]*group     // monitored classes
+	containers map[string]*container // monitored containers
+	noRMIDs    bool                  // whether we ran out of RMIDs
+}
+
+// group is a monitored resctrl group.
+type group struct {
+	dir   string  // resctrl group directory
+	last  monData // last monitoring data
+	usage Usage   // usage calculated from the last two samples
+}
+
+// container is the per container data we track locally.
+type container struct {
+	group
+	id         string // container ID
+	prettyName string // container pretty name
+	cgroupDir  string // container cgroup directory
+	class      string // RDT class of the container
+}
+
+// Prometheus Metric descriptor indices and descriptor table
+const (
+	classLLCOccupancyDesc = iota
+	classMemoryBandwidthDesc
+	classMemoryTrafficDesc
+	containerLLCOccupancyDesc
+	containerMemoryBandwidthDesc
+	containerMemoryTrafficDesc
+	numDescriptors
+)
+
+var descriptors = [numDescriptors]*prometheus.Desc{
+	classLLCOccupancyDesc: prometheus.NewDesc(
+		"rdt_class_llc_occupancy_bytes",
+		"Last level cache occupancy of an RDT class.",
+		[]string{"class"}, nil,
+	),
+	classMemoryBandwidthDesc: prometheus.NewDesc(
+		"rdt_class_memory_bandwidth_bytes_per_second",
+		"Memory bandwidth of an RDT class.",
+		[]string{"class", "type"}, nil,
+	),
+	classMemoryTrafficDesc: prometheus.NewDesc(
+		"rdt_class_memory_bytes_total",
+		"Total memory traffic of an RDT class.",
+		[]string{"class", "type"}, nil,
+	),
+	containerLLCOccupancyDesc: prometheus.NewDesc(
+		"rdt_container_llc_occupancy_bytes",
+		"Last level cache occupancy of a container.",
+		[]string{"container_id", "container", "class"}, nil,
+	),
+	containerMemoryBandwidthDesc: prometheus.NewDesc(
+		"rdt_container_memory_bandwidth_bytes_per_second",
+		"Memory bandwidth of a container.",
+		[]string{"container_id", "container", "class", "type"}, nil,
+	),
+	containerMemoryTrafficDesc: prometheus.NewDesc(
+		"rdt_container_memory_bytes_total",
+		"Total memory traffic of a container since its monitoring started.",
+		[]string{"container_id", "container", "class", "type"}, nil,
+	),
+}
+
+var (
+	// Our logger instance.
+	log = logger.NewLogger(RDTMonitorController)
+	// Our singleton RDT monitoring controller.
+	singleton *monitor
+	// hostRoot is the host root directory, if not running on the host.
+	hostRoot = ""
+	// mkdir creates monitoring groups, overridable for testing.
+	mkdir = os.Mkdir
+)
+
+// SetSysRoot sets the host root directory for resctrl.
+func SetSysRoot(path string) {
+	hostRoot = path
+}
+
+// SetSampler sets the shared sampler to take our monitoring samples with.
+func SetSampler(s *sampler.Sampler) {
+	s.AddSource(RDTMonitorController, getMonitorController().sample)
+}
+
+// getMonitorController returns our singleton controller instance.
+func getMonitorController() *monitor {
+	if singleton == nil {
+		singleton = &monitor{
+			classes:    make(map[string]*group),
+			containers: make(map[string]*container),
+		}
+	}
+	return singleton
+}
+
+// GetClassUsage returns the latest measured usage of an RDT class.
+func GetClassUsage(class string) (Usage, bool) {
+	m := getMonitorController()
+	m.Lock()
+	defer m.Unlock()
+	if g, ok := m.classes[class]; ok && !g.last.time.IsZero() {
+		return g.usage, true
+	}
+	return Usage{}, false
+}
+
+// GetContainerUsage returns the latest measured usage of a container.
+func GetContainerUsage(id string) (Usage, bool) {
+	m := getMonitorController()
+	m.Lock()
+	defer m.Unlock()
+	if c, ok := m.containers[id]; ok && c.dir != "" && !c.last.time.IsZero() {
+		return c.usage, true
+	}
+	return Usage{}, false
+}
+
+// Start prepares the controller for resource control/decision enforcement.
+func (m *monitor) Start(cc cache.Cache) error {
+	m.Lock()
+	defer m.Unlock()
+
+	m.root = resctrlRoot(hostRoot)
+	if err := checkMonitoring(m.root); err != nil {
+		return err
+	}
+
+	m.running = true
+	m.noRMIDs = false
+	m.syncClasses()
+
+	m.containers = make(map[string]*container)
+	for _, c := range cc.GetContainers() {
+		m.insertContainer(c)
+	}
+	m.removeStaleGroups()
+
+	return nil
+}
+
+// Stop shuts down the controller.
+func (m *monitor) Stop() {
+	m.Lock()
+	defer m.Unlock()
+
+	for _, c := range m.containers {
+		c.removeGroup()
+	}
+	m.containers = make(map[string]*container)
+	m.classes = make(map[string]*group)
+	m.running = false
+}
+
+// PreCreateHook is the controller's pre-create hook.
+func (m *monitor) PreCreateHook(cache.Container) error {
+	return nil
+}
+
+// PreStartHook is the controller's pre-start hook.
+func (m *monitor) PreStartHook(cache.Container) error {
+	return nil
+}
+
+// PostStartHook is the controller's post-start hook.
+func (m *monitor) PostStartHook(cc cache.Container) error {
+	m.Lock()
+	defer m.Unlock()
+	m.insertContainer(cc)
+	return nil
+}
+
+// PostUpdateHook is the controller's post-update hook.
+func (m *monitor) PostUpdateHook(cc cache.Container) error {
+	m.Lock()
+	defer m.Unlock()
+
+	c, ok := m.containers[cc.GetID()]
+	if !ok {
+		m.insertContainer(cc)
+		return nil
+	}
+	if class := containerClass(cc); class != c.class {
+		m.removeGroup(c)
+		delete(m.containers, c.id)
+		m.insertContainer(cc)
+	}
+	return nil
+}
+
+// PostStopHook is the controller's post-stop hook.
+func (m *monitor) PostStopHook(cc cache.Container) error {
+	m.Lock()
+	defer m.Unlock()
+	if c, ok := m.containers[cc.GetID()]; ok {
+		m.removeGroup(c)
+		delete(m.containers, c.id)
+	}
+	return nil
+}
+
+// removeGroup removes the monitoring group of a container. This frees up an
+// RMID, so we can try creating groups for new containers again.
+func (m *monitor) removeGroup(c *container) {
+	if c.removeGroup() {
+		m.noRMIDs = false
+	}
+}
+
+// containerClass returns the effective RDT class of a container.
+func containerClass(cc cache.Container) string {
+	class := cc.GetRDTClass()
+	switch class {
+	case "":
+		return RootClass
+	case cache.RDTClassPodQoS:
+		return string(cc.GetQOSClass())
+	}
+	return class
+}
+
+// syncClasses updates the set of monitored classes with resctrl.
+func (m *monitor) syncClasses() {
+	groups, err := listCtrlGroups(m.root)
+	if err != nil {
+		log.Error("%v", err)
+		return
+	}
+	for class, dir := range groups {
+		if _, ok := m.classes[class]; !ok {
+			m.classes[class] = &group{dir: dir}
+		}
+	}
+	for class := range m.classes {
+		if _, ok := groups[class]; !ok {
+			delete(m.classes, class)
+		}
+	}
+}
+
+// insertContainer starts monitoring a container.
+func (m *monitor) insertContainer(cc cache.Container) {
+	if !m.running {
+		return
+	}
+
+	c := &container{
+		id:         cc.GetID(),
+		prettyName: cc.PrettyName(),
+		cgroupDir:  cc.GetCgroupDir(),
+		class:      containerClass(cc),
+	}
+	m.containers[c.id] = c
+
+	if !opt.MonitorContainers || m.noRMIDs || c.cgroupDir == "" {
+		return
+	}
+
+	ctrl, ok := m.classes[c.class]
+	if !ok {
+		log.Warn("%s: unknown RDT class %q, assuming %q", c.prettyName, c.class, RootClass)
+		if ctrl, ok = m.classes[RootClass]; !ok {
+			return
+		}
+	}
+
+	dir := filepath.Join(ctrl.dir, monGroupsDir, monGroupPrefix+c.id)
+	if err := mkdir(dir, 0755); err != nil && !os.IsExist(err) {
+		// mkdir fails with ENOSPC once we run out of RMIDs
+		if errors.Is(err, syscall.ENOSPC) {
+			log.Warn("%s: out of RMIDs, disabling per-container monitoring "+
+				"for new containers: %v", c.prettyName, err)
+			m.noRMIDs = true
+		} else {
+			log.Warn("%s: failed to create monitoring group: %v", c.prettyName, err)
+		}
+		return
+	}
+	c.dir = dir
+}
+
+// removeStaleGroups removes our monitoring groups left behind for gone containers.
+func (m *monitor) removeStaleGroups() {
+	for _, ctrl := range m.classes {
+		for _, name := range listMonGroups(ctrl.dir, monGroupPrefix) {
+			if c, ok := m.containers[name[len(monGroupPrefix):]]; ok && c.dir != "" {
+				continue
+			}
+			dir := filepath.Join(ctrl.dir, monGroupsDir, name)
+			if err := os.Remove(dir); err != nil {
+				log.Warn("failed to remove stale monitoring group %s: %v", dir, err)
+			}
+		}
+	}
+}
+
+// removeGroup removes the monitoring group of the container. Returns true
+// if the container had a monitoring group.
+func (c *container) removeGroup() bool {
+	if c.dir == "" {
+		return false
+	}
+	if err := os.Remove(c.dir); err != nil && !os.IsNotExist(err) {
+		log.Warn("%s: failed to remove monitoring group: %v", c.prettyName, err)
+	}
+	c.dir = ""
+	return true
+}
+
+// syncTasks adds threads of a container cgroup missing from a monitoring group.
+func syncTasks(cgroupDir, dir string) error {
+	var ctrGroup cgroups.Group
+	if cgroups.IsUnifiedHierarchy(cgroups.GetMountDir()) {
+		ctrGroup = cgroups.AsGroup(filepath.Join(cgroups.GetMountDir(), cgroupDir))
+	} else {
+		ctrGroup = cgroups.Cpuset.Group(cgroupDir)
+	}
+
+	threads, err := ctrGroup.GetThreads()
+	if err != nil {
+		return err
+	}
+
+	monitored := readTasks(dir)
+	missing := make([]string, 0, len(threads))
+	for _, tid := range threads {
+		if _, ok := monitored[tid]; !ok {
+			missing = append(missing, tid)
+		}
+	}
+	if len(missing) == 0 {
+		return nil
+	}
+
+	return cgroups.AsGroup(dir).AddTasks(missing...)
+}
+
+// update reads new monitoring data for the group, updating its usage. If
+// some counter is unavailable, the sample is dropped and the last complete
+// one is kept, so that the summed counters never go backwards and the next
+// rate is calculated against the last complete sample.
+func (g *group) update(now time.Time) error {
+	data, err := readMonData(g.dir, now)
+	if err != nil {
+		return err
+	}
+	return g.apply(data)
+}
+
+// apply updates the usage of the group from newly read monitoring data.
+func (g *group) apply(data monData) error {
+	if data.incomplete {
+		if g.last.time.IsZero() {
+			return monitorError("%s: monitoring data unavailable", g.dir)
+		}
+		return nil
+	}
+	total, local := data.bandwidth(g.last)
+	g.usage = Usage{
+		LLCOccupancy:         data.llcOccupancy,
+		MemoryBandwidth:      total,
+		LocalMemoryBandwidth: local,
+	}
+	g.last = data
+	return nil
+}
+
+// Describe implements prometheus.Collector.
+func (m *monitor) Describe(ch chan<- *prometheus.Desc) {
+	for _, d := range descriptors {
+		ch <- d
+	}
+}
+
+// sample is our sampler source. It adds new threads of containers to their
+// monitoring groups and reads new monitoring data for all groups. Files are
+// accessed without holding our lock, which hooks take under the resource
+// manager lock.
+func (m *monitor) sample(now time.Time) {
+	type target struct {
+		*group
+		dir       string
+		cgroupDir string
+		data      monData
+		err       error
+	}
+
+	m.Lock()
+	if !m.running {
+		m.Unlock()
+		return
+	}
+	m.syncClasses()
+	classes := make(map[string]*target, len(m.classes))
+	for class, g := range m.classes {
+		classes[class] = &target{group: g, dir: g.dir}
+	}
+	containers := make(map[*container]*target, len(m.containers))
+	for _, c := range m.containers {
+		if c.dir != "" {
+			containers[c] = &target{group: &c.group, dir: c.dir, cgroupDir: c.cgroupDir}
+		}
+	}
+	m.Unlock()
+
+	for _, t := range classes {
+		t.data, t.err = readMonData(t.dir, now)
+	}
+	for c, t := range containers {
+		if err := syncTasks(t.cgroupDir, t.dir); err != nil {
+			log.Debug("%s: failed to sync monitored tasks: %v", c.prettyName, err)
+		}
+		t.data, t.err = readMonData(t.dir, now)
+	}
+
+	m.Lock()
+	defer m.Unlock()
+
+	for class, t := range classes {
+		if g, ok := m.classes[class]; !ok || g != t.group {
+			continue
+		}
+		if t.err == nil {
+			t.err = t.apply(t.data)
+		}
+		if t.err != nil {
+			log.Debug("class %s: %v", class, t.err)
+		}
+	}
+	for c, t := range containers {
+		if m.containers[c.id] != c || c.dir != t.dir {
+			continue
+		}
+		if t.err == nil {
+			t.err = t.apply(t.data)
+		}
+		if t.err != nil {
+			log.Debug("%s: %v", c.prettyName, t.err)
+		}
+	}
+}
+
+// Collect implements prometheus.Collector. It reports the monitoring data
+// of the latest sampling round.
+func (m *monitor) Collect(ch chan<- prometheus.Metric) {
+	m.Lock()
+	defer m.Unlock()
+
+	if !m.running {
+		return
+	}
+
+	for class, g := range m.classes {
+		if g.last.time.IsZero() {
+			continue
+		}
+		ch <- prometheus.MustNewConstMetric(descriptors[classLLCOccupancyDesc],
+			prometheus.GaugeValue, float64(g.usage.LLCOccupancy), class)
+		ch <- prometheus.MustNewConstMetric(descriptors[classMemoryBandwidthDesc],
+			prometheus.GaugeValue, g.usage.MemoryBandwidth, class, "total")
+		ch <- prometheus.MustNewConstMetric(descriptors[classMemoryBandwidthDesc],
+			prometheus.GaugeValue, g.usage.LocalMemoryBandwidth, class, "local")
+		ch <- prometheus.MustNewConstMetric(descriptors[classMemoryTrafficDesc],
+			prometheus.CounterValue, float64(g.last.mbmTotal), class, "total")
+		ch <- prometheus.MustNewConstMetric(descriptors[classMemoryTrafficDesc],
+			prometheus.CounterValue, float64(g.last.mbmLocal), class, "local")
+	}
+
+	for _, c := range m.containers {
+		if c.dir == "" || c.last.time.IsZero() {
+			continue
+		}
+		ch <- prometheus.MustNewConstMetric(descriptors[containerLLCOccupancyDesc],
+			prometheus.GaugeValue, float64(c.usage.LLCOccupancy), c.id, c.prettyName, c.class)
+		ch <- prometheus.MustNewConstMetric(descriptors[containerMemoryBandwidthDesc],
+			prometheus.GaugeValue, c.usage.MemoryBandwidth, c.id, c.prettyName, c.class, "total")
+		ch <- prometheus.MustNewConstMetric(descriptors[containerMemoryBandwidthDesc],
+			prometheus.GaugeValue, c.usage.LocalMemoryBandwidth, c.id, c.prettyName, c.class, "local")
+		ch <- prometheus.MustNewConstMetric(descriptors[containerMemoryTrafficDesc],
+			prometheus.CounterValue, float64(c.last.mbmTotal), c.id, c.prettyName, c.class, "total")
+		ch <- prometheus.MustNewConstMetric(descriptors[containerMemoryTrafficDesc],
+			prometheus.CounterValue, float64(c.last.mbmLocal), c.id, c.prettyName, c.class, "local")
+	}
+}
+
+// init registers this controller and its collector.
+func init() {
+	control.Register(RDTMonitorController, RDTMonitorDescription, getMonitorController())
+	err := metrics.RegisterCollector("rdtMonitor", func() (prometheus.Collector, error) {
+		return getMonitorController(), nil
+	})
+	if err != nil {
+		log.Error("failed to register RDT monitoring collector: %v", err)
+	}
+}
+
+// monitorError creates a controller-specific formatted error message.
+func monitorError(format string, args ...interface{}) error {
+	return fmt.Errorf("rdt-monitor: "+format, args...)
+}
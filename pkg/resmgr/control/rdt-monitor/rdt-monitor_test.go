@@ -0,0 +1,183 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package rdtmonitor
+
+import (
+	"os"
+	"path/filepath"
+	"syscall"
+	"testing"
+	"time"
+
+	"github.com/prometheus/client_golang/prometheus"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+)
+
+// fakeContainer implements the few cache.Container methods we use.
+type fakeContainer struct {
+	cache.Container
+	id    string
+	class string
+}
+
+func (c *fakeContainer) GetID() string        { return c.id }
+func (c *fakeContainer) PrettyName() string   { return c.id }
+func (c *fakeContainer) GetCgroupDir() string { return "/" + c.id }
+func (c *fakeContainer) GetRDTClass() string  { return c.class }
+
+func TestRMIDExhaustion(t *testing.T) {
+	root := t.TempDir()
+	writeEntries(t, root, map[string]string{
+		"info/L3_MON/num_rmids":       "2\n",
+		"tasks":                       "",
+		"mon_groups/other/tasks":      "",
+		"gold/tasks":                  "",
+		"gold/mon_groups/other/tasks": "",
+	})
+
+	full := false
+	mkdir = func(dir string, perm os.FileMode) error {
+		if full {
+			return &os.PathError{Op: "mkdir", Path: dir, Err: syscall.ENOSPC}
+		}
+		return os.Mkdir(dir, perm)
+	}
+	defer func() { mkdir = os.Mkdir }()
+
+	m := &monitor{
+		root:       root,
+		running:    true,
+		classes:    map[string]*group{},
+		containers: map[string]*container{},
+	}
+	m.syncClasses()
+
+	monitored := func(id string) string {
+		t.Helper()
+		c, ok := m.containers[id]
+		if !ok {
+			t.Fatalf("container %s not tracked", id)
+		}
+		return c.dir
+	}
+
+	ctr0 := &fakeContainer{id: "ctr0"}
+	m.PostStartHook(ctr0)
+	if dir := monitored("ctr0"); dir != filepath.Join(root, monGroupsDir, monGroupPrefix+"ctr0") {
+		t.Errorf("unexpected monitoring group %q for ctr0", dir)
+	}
+
+	// Running out of RMIDs stops creating groups for new containers.
+	full = true
+	m.PostStartHook(&fakeContainer{id: "ctr1"})
+	if dir := monitored("ctr1"); dir != "" || !m.noRMIDs {
+		t.Errorf("expected no monitoring group for ctr1, got %q", dir)
+	}
+	full = false
+	m.PostStartHook(&fakeContainer{id: "ctr2"})
+	if dir := monitored("ctr2"); dir != "" {
+		t.Errorf("expected no monitoring group for ctr2 when out of RMIDs, got %q", dir)
+	}
+
+	// Removing a group frees an RMID for new containers.
+	m.PostStopHook(ctr0)
+	if m.noRMIDs {
+		t.Errorf("expected stopping a monitored container to free an RMID")
+	}
+	ctr3 := &fakeContainer{id: "ctr3"}
+	m.PostStartHook(ctr3)
+	if dir := monitored("ctr3"); dir == "" {
+		t.Errorf("expected a monitoring group for ctr3")
+	}
+
+	// So does moving a container to another class.
+	full = true
+	m.PostStartHook(&fakeContainer{id: "ctr4"})
+	full = false
+	if !m.noRMIDs {
+		t.Fatalf("expected to be out of RMIDs")
+	}
+	ctr3.class = "gold"
+	m.PostUpdateHook(ctr3)
+	if dir := monitored("ctr3"); dir != filepath.Join(root, "gold", monGroupsDir, monGroupPrefix+"ctr3") || m.noRMIDs {
+		t.Errorf("unexpected monitoring group %q for ctr3 in class gold", dir)
+	}
+
+	// Other errors only affect the container at hand.
+	mkdir = func(string, os.FileMode) error { return syscall.EACCES }
+	m.PostStartHook(&fakeContainer{id: "ctr5"})
+	if dir := monitored("ctr5"); dir != "" || m.noRMIDs {
+		t.Errorf("expected no monitoring group for ctr5 without running out of RMIDs")
+	}
+}
+
+func TestSampling(t *testing.T) {
+	root := t.TempDir()
+	writeEntries(t, root, map[string]string{
+		"info/L3_MON/num_rmids":              "2\n",
+		"tasks":                              "",
+		"mon_groups/other/tasks":             "",
+		"mon_data/mon_L3_00/mbm_total_bytes": "1000\n",
+	})
+
+	m := &monitor{
+		root:       root,
+		running:    true,
+		classes:    map[string]*group{},
+		containers: map[string]*container{},
+	}
+	saved := singleton
+	singleton = m
+	defer func() { singleton = saved }()
+
+	m.syncClasses()
+	m.PostStartHook(&fakeContainer{id: "ctr0"})
+	writeEntries(t, root, map[string]string{
+		"mon_groups/nri-ctr0/mon_data/mon_L3_00/mbm_total_bytes": "100\n",
+	})
+
+	if _, ok := GetContainerUsage("ctr0"); ok {
+		t.Errorf("expected no usage for ctr0 before sampling")
+	}
+
+	now := time.Now()
+	m.sample(now)
+	writeEntries(t, root, map[string]string{
+		"mon_data/mon_L3_00/mbm_total_bytes":                     "3000\n",
+		"mon_groups/nri-ctr0/mon_data/mon_L3_00/mbm_total_bytes": "300\n",
+	})
+	m.sample(now.Add(time.Second))
+
+	if u, ok := GetClassUsage(RootClass); !ok || u.MemoryBandwidth != 2000 {
+		t.Errorf("expected class bandwidth of 2000 bytes/s, got %v (%v)", u.MemoryBandwidth, ok)
+	}
+	if u, ok := GetContainerUsage("ctr0"); !ok || u.MemoryBandwidth != 200 {
+		t.Errorf("expected ctr0 bandwidth of 200 bytes/s, got %v (%v)", u.MemoryBandwidth, ok)
+	}
+
+	// Collection only reports the latest samples, without taking new ones.
+	for i := 0; i < 2; i++ {
+		ch := make(chan prometheus.Metric, 32)
+		m.Collect(ch)
+		close(ch)
+		if len(ch) != 10 {
+			t.Errorf("expected 10 metrics, got %d", len(ch))
+		}
+	}
+	if c := m.containers["ctr0"]; c.last.mbmTotal != 300 || !c.last.time.Equal(now.Add(time.Second)) {
+		t.Errorf("expected collection not to change samples, got %+v", c.last)
+	}
+}
@@ -0,0 +1,171 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package rdtmonitor
+
+import (
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"time"
+)
+
+const (
+	// RootClass is the name of the RDT class of the resctrl root group.
+	RootClass = "system/default"
+
+	// resctrl entries
+	infoDir      = "info"
+	monGroupsDir = "mon_groups"
+	monDataDir   = "mon_data"
+	tasksEntry   = "tasks"
+	l3MonInfo    = "L3_MON"
+	llcOccupancy = "llc_occupancy"
+	mbmTotal     = "mbm_total_bytes"
+	mbmLocal     = "mbm_local_bytes"
+)
+
+// monData is the monitoring data of a resctrl group, summed over all L3 domains.
+type monData struct {
+	llcOccupancy uint64    // bytes of last level cache occupied
+	mbmTotal     uint64    // total memory traffic, in bytes
+	mbmLocal     uint64    // memory traffic to the local NUMA node, in bytes
+	time         time.Time // time of reading the data
+	incomplete   bool      // whether some counter was unavailable
+}
+
+// resctrlRoot returns the resctrl mount point under the given host root.
+func resctrlRoot(hostRoot string) string {
+	return filepath.Join("/", hostRoot, "sys/fs/resctrl")
+}
+
+// checkMonitoring checks if resctrl L3 monitoring is available at root.
+func checkMonitoring(root string) error {
+	if _, err := os.Stat(filepath.Join(root, infoDir, l3MonInfo)); err != nil {
+		return monitorError("resctrl L3 monitoring not available: %v", err)
+	}
+	return nil
+}
+
+// listCtrlGroups returns the directories of resctrl control groups by class name.
+func listCtrlGroups(root string) (map[string]string, error) {
+	entries, err := os.ReadDir(root)
+	if err != nil {
+		return nil, monitorError("failed to list resctrl groups: %v", err)
+	}
+
+	groups := map[string]string{RootClass: root}
+	for _, e := range entries {
+		name := e.Name()
+		if !e.IsDir() || name == infoDir || name == monGroupsDir || name == monDataDir {
+			continue
+		}
+		dir := filepath.Join(root, name)
+		if _, err := os.Stat(filepath.Join(dir, tasksEntry)); err != nil {
+			continue
+		}
+		groups[name] = dir
+	}
+
+	return groups, nil
+}
+
+// readMonData reads the monitoring data of the resctrl group at dir.
+func readMonData(dir string, now time.Time) (monData, error) {
+	domains, err := filepath.Glob(filepath.Join(dir, monDataDir, "mon_L3_*"))
+	if err != nil || len(domains) == 0 {
+		return monData{}, monitorError("%s: no monitoring data", dir)
+	}
+
+	data := monData{time: now}
+	for _, domain := range domains {
+		for _, c := range []struct {
+			entry string
+			sum   *uint64
+		}{
+			{llcOccupancy, &data.llcOccupancy},
+			{mbmTotal, &data.mbmTotal},
+			{mbmLocal, &data.mbmLocal},
+		} {
+			val, ok := readCounter(domain, c.entry)
+			if !ok {
+				data.incomplete = true
+			}
+			*c.sum += val
+		}
+	}
+
+	return data, nil
+}
+
+// readCounter reads a monitoring counter. Missing counters, for instance of
+// an unsupported monitoring event, read as zero. Returns false if a counter
+// is (temporarily) unavailable, for instance due to a recycled RMID.
+func readCounter(domain, entry string) (uint64, bool) {
+	buf, err := os.ReadFile(filepath.Join(domain, entry))
+	if err != nil {
+		return 0, os.IsNotExist(err)
+	}
+	val, err := strconv.ParseUint(strings.TrimSpace(string(buf)), 10, 64)
+	if err != nil {
+		return 0, false
+	}
+	return val, true
+}
+
+// bandwidth returns the total and local memory bandwidth since a previous
+// sample, in bytes/s. Counters going backwards, for instance after the RMID
+// of the group got recycled, give zero bandwidth.
+func (d monData) bandwidth(prev monData) (float64, float64) {
+	if prev.time.IsZero() || !d.time.After(prev.time) {
+		return 0, 0
+	}
+	secs := d.time.Sub(prev.time).Seconds()
+	rate := func(cur, old uint64) float64 {
+		if cur < old {
+			return 0
+		}
+		return float64(cur-old) / secs
+	}
+	return rate(d.mbmTotal, prev.mbmTotal), rate(d.mbmLocal, prev.mbmLocal)
+}
+
+// listMonGroups returns the names of monitoring groups with the given prefix.
+func listMonGroups(ctrlDir, prefix string) []string {
+	entries, err := os.ReadDir(filepath.Join(ctrlDir, monGroupsDir))
+	if err != nil {
+		return nil
+	}
+	names := []string{}
+	for _, e := range entries {
+		if e.IsDir() && strings.HasPrefix(e.Name(), prefix) {
+			names = append(names, e.Name())
+		}
+	}
+	return names
+}
+
+// readTasks reads the set of task ids in a resctrl group.
+func readTasks(dir string) map[string]struct{} {
+	tasks := map[string]struct{}{}
+	buf, err := os.ReadFile(filepath.Join(dir, tasksEntry))
+	if err != nil {
+		return tasks
+	}
+	for _, id := range strings.Fields(string(buf)) {
+		tasks[id] = struct{}{}
+	}
+	return tasks
+}
@@ -0,0 +1,149 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package rdtmonitor
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+// writeEntries creates a fake resctrl directory tree with the given entries.
+func writeEntries(t *testing.T, root string, entries map[string]string) {
+	for entry, content := range entries {
+		path := filepath.Join(root, entry)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatalf("failed to create %s: %v", filepath.Dir(path), err)
+		}
+		if err := os.WriteFile(path, []byte(content), 0644); err != nil {
+			t.Fatalf("failed to write %s: %v", path, err)
+		}
+	}
+}
+
+func TestResctrlMonitoring(t *testing.T) {
+	root := t.TempDir()
+
+	if err := checkMonitoring(root); err == nil {
+		t.Errorf("expected error for missing L3 monitoring")
+	}
+
+	writeEntries(t, root, map[string]string{
+		"info/L3_MON/num_rmids":                   "224\n",
+		"tasks":                                   "1\n2\n",
+		"mon_data/mon_L3_00/llc_occupancy":        "1000\n",
+		"mon_data/mon_L3_00/mbm_total_bytes":      "4000\n",
+		"mon_data/mon_L3_00/mbm_local_bytes":      "1000\n",
+		"gold/tasks":                              "3\n4\n",
+		"gold/mon_data/mon_L3_00/llc_occupancy":   "2048\n",
+		"gold/mon_data/mon_L3_00/mbm_total_bytes": "1000\n",
+		"gold/mon_data/mon_L3_01/llc_occupancy":   "2048\n",
+		"gold/mon_data/mon_L3_01/mbm_total_bytes": "Unavailable\n",
+		"gold/mon_groups/nri-foo/tasks":           "3\n",
+		"gold/mon_groups/other/tasks":             "",
+		"mon_groups/nri-bar/tasks":                "",
+		"notagroup/foo":                           "",
+	})
+
+	if err := checkMonitoring(root); err != nil {
+		t.Errorf("unexpected error: %v", err)
+	}
+
+	groups, err := listCtrlGroups(root)
+	if err != nil {
+		t.Fatalf("failed to list control groups: %v", err)
+	}
+	if len(groups) != 2 || groups[RootClass] != root || groups["gold"] != filepath.Join(root, "gold") {
+		t.Errorf("unexpected control groups %v", groups)
+	}
+
+	now := time.Now()
+	data, err := readMonData(groups["gold"], now)
+	if err != nil {
+		t.Fatalf("failed to read monitoring data: %v", err)
+	}
+	if data.llcOccupancy != 4096 || data.mbmTotal != 1000 || data.mbmLocal != 0 || !data.incomplete {
+		t.Errorf("unexpected monitoring data %+v", data)
+	}
+	if _, err := readMonData(filepath.Join(groups["gold"], "mon_groups", "other"), now); err == nil {
+		t.Errorf("expected error for group without monitoring data")
+	}
+
+	prev, _ := readMonData(root, now.Add(-2*time.Second))
+	prev.mbmTotal, prev.mbmLocal = 2000, 1200
+	data, _ = readMonData(root, now)
+	if data.incomplete {
+		t.Errorf("expected complete monitoring data, got %+v", data)
+	}
+	if total, local := data.bandwidth(prev); total != 1000 || local != 0 {
+		t.Errorf("expected bandwidth 1000/0, got %v/%v", total, local)
+	}
+	if total, local := data.bandwidth(monData{}); total != 0 || local != 0 {
+		t.Errorf("expected no bandwidth without previous sample, got %v/%v", total, local)
+	}
+
+	if names := listMonGroups(groups["gold"], monGroupPrefix); len(names) != 1 || names[0] != "nri-foo" {
+		t.Errorf("unexpected monitoring groups %v", names)
+	}
+	if tasks := readTasks(groups["gold"]); len(tasks) != 2 {
+		t.Errorf("unexpected tasks %v", tasks)
+	}
+}
+
+func TestUnavailableDomain(t *testing.T) {
+	root := t.TempDir()
+	g := &group{dir: root}
+	now := time.Now()
+
+	sample := func(secs int, total0, total1 string) {
+		t.Helper()
+		writeEntries(t, root, map[string]string{
+			"mon_data/mon_L3_00/llc_occupancy":   "1000\n",
+			"mon_data/mon_L3_00/mbm_total_bytes": total0,
+			"mon_data/mon_L3_01/llc_occupancy":   "1000\n",
+			"mon_data/mon_L3_01/mbm_total_bytes": total1,
+		})
+		if err := g.update(now.Add(time.Duration(secs) * time.Second)); err != nil {
+			t.Fatalf("failed to update group: %v", err)
+		}
+	}
+
+	sample(0, "1000\n", "1000\n")
+	sample(1, "2000\n", "2000\n")
+	if g.last.mbmTotal != 4000 || g.usage.MemoryBandwidth != 2000 {
+		t.Errorf("expected 4000 bytes at 2000 bytes/s, got %d at %v", g.last.mbmTotal, g.usage.MemoryBandwidth)
+	}
+
+	// While a domain is unavailable the last complete sample is kept.
+	sample(2, "3000\n", "Unavailable\n")
+	sample(3, "4000\n", "Unavailable\n")
+	if g.last.mbmTotal != 4000 || g.usage.MemoryBandwidth != 2000 {
+		t.Errorf("expected 4000 bytes at 2000 bytes/s kept, got %d at %v", g.last.mbmTotal, g.usage.MemoryBandwidth)
+	}
+
+	// Once it recovers, the rate is calculated since the last complete sample.
+	sample(4, "5000\n", "5000\n")
+	if g.last.mbmTotal != 10000 || g.usage.MemoryBandwidth != 2000 {
+		t.Errorf("expected 10000 bytes at 2000 bytes/s, got %d at %v", g.last.mbmTotal, g.usage.MemoryBandwidth)
+	}
+
+	// A group without any complete sample yet has no data.
+	g = &group{dir: root}
+	writeEntries(t, root, map[string]string{"mon_data/mon_L3_01/mbm_total_bytes": "Unavailable\n"})
+	if err := g.update(now); err == nil {
+		t.Errorf("expected error without any complete sample")
+	}
+}
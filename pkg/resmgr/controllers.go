@@ -20,4 +20,5 @@ import (
 	_ "github.com/containers/nri-plugins/pkg/resmgr/control/e2e-test"
 	_ "github.com/containers/nri-plugins/pkg/resmgr/control/memory"
 	_ "github.com/containers/nri-plugins/pkg/resmgr/control/page-migrate"
+	_ "github.com/containers/nri-plugins/pkg/resmgr/control/rdt-monitor"
 )
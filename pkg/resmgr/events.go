@@ -34,6 +34,7 @@ func (m *resmgr) setupEventProcessing() error {
 	options := metrics.Options{
 		PollInterval: opt.MetricsTimer,
 		Events:       m.events,
+		Sampler:      m.sampler,
 	}
 	if m.metrics, err = metrics.NewMetrics(options); err != nil {
 		return resmgrError("failed to create metrics (pre)processor: %v", err)
@@ -46,6 +47,7 @@ func (m *resmgr) startMetricsProcessing() error {
 	if err := m.metrics.Start(); err != nil {
 		return resmgrError("failed to start metrics (pre)processor: %v", err)
 	}
+	m.sampler.Start()
 
 	return nil
 }
@@ -77,9 +79,9 @@ func (m *resmgr) startEventProcessing() error {
 			case event := <-m.events:
 				m.processEvent(event)
 			case _ = <-rebalanceChan:
-				//if err := m.RebalanceContainers(); err != nil {
-				//	evtlog.Error("rebalancing failed: %v", err)
-				//}
+				unlock := m.lock("rebalance")
+				m.rebalance("periodic rebalancing")
+				unlock()
 			}
 			logger.Flush()
 		}
@@ -93,6 +95,7 @@ func (m *resmgr) stopEventProcessing() {
 	if m.stop != nil {
 		close(m.stop)
 		m.metrics.Stop()
+		m.sampler.Stop()
 		m.stop = nil
 	}
 }
@@ -37,11 +37,16 @@ type options struct {
 	ForceConfig       string
 	ForceConfigSignal string
 	MetricsTimer      time.Duration
+	MetricsMaxTimer   time.Duration
 	RebalanceTimer    time.Duration
+	UpdateBatchWindow time.Duration
 	DisableAgent      bool
+	DisableTopoCache  bool
+	EphemeralCache    bool
 	NriPluginName     string
 	NriPluginIdx      string
 	NriSocket         string
+	NriTraceFile      string
 	EnableTestAPIs    bool
 }
 
@@ -58,6 +63,8 @@ func init() {
 		"NRI plugin index to register.")
 	flag.StringVar(&opt.NriSocket, "nri-socket", nri.DefaultSocketPath,
 		"NRI unix domain socket path to connect to.")
+	flag.StringVar(&opt.NriTraceFile, "nri-trace-file", "",
+		"Record received NRI requests to this file for replaying them later.")
 
 	flag.StringVar(&opt.PidFile, "pid-file", pidfile.GetPath(),
 		"PID file to write daemon PID to")
@@ -69,11 +76,19 @@ func init() {
 		"Signal used to reload forced configuration.")
 	flag.DurationVar(&opt.MetricsTimer, "metrics-interval", 0,
 		"Interval for polling/gathering runtime metrics data. Use 'disable' for disabling.")
+	flag.DurationVar(&opt.MetricsMaxTimer, "metrics-max-interval", 0,
+		"Maximum interval polling backs off to while no containers are created or removed. Defaults to 8 times the metrics interval.")
 	flag.DurationVar(&opt.RebalanceTimer, "rebalance-interval", 0,
-		"Minimum interval between two container rebalancing attempts. Use 'disable' for disabling.")
+		"Interval for periodically rebalancing containers by the active policy. 0 disables periodic rebalancing.")
+	flag.DurationVar(&opt.UpdateBatchWindow, "update-batch-window", 0,
+		"Maximum time to delay and coalesce unsolicited container updates for. 0 disables batching.")
 	flag.StringVar(&opt.StateDir, "state-dir", "/var/lib/nri-resource-policy",
 		"Permanent storage directory path for the resource manager to store its state in.")
+	flag.BoolVar(&opt.EphemeralCache, "ephemeral-cache", false,
+		"Don't save the cache to the state directory. Rebuild state from the runtime on restart.")
 	flag.BoolVar(&opt.EnableTestAPIs, "enable-test-apis", false, "Allow enabling various test APIs (currently only 'e2e-test' test controller).")
 	flag.BoolVar(&opt.DisableAgent, "disable-agent", false,
 		"Disable K8s cluster agent.")
+	flag.BoolVar(&opt.DisableTopoCache, "disable-topology-cache", false,
+		"Don't cache discovered system topology in the state directory. Rediscover it on every restart.")
 }
@@ -0,0 +1,82 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metrics
+
+import (
+	"time"
+
+	"github.com/prometheus/client_golang/prometheus"
+
+	"github.com/containers/nri-plugins/pkg/metrics"
+)
+
+// Phases of request processing we collect latencies for.
+const (
+	// PhaseTotal is the full processing of a request.
+	PhaseTotal = "total"
+	// PhasePolicy is the policy allocating, updating or releasing resources.
+	PhasePolicy = "policy"
+	// PhaseControllers is running controller hooks.
+	PhaseControllers = "controllers"
+	// PhaseCache is updating and persisting the cache.
+	PhaseCache = "cache"
+	// PhaseExport is exporting resource data and topology zones.
+	PhaseExport = "export"
+)
+
+var (
+	requestLatency = prometheus.NewHistogramVec(
+		prometheus.HistogramOpts{
+			Name: "nri_request_duration_seconds",
+			Help: "Latency of processing NRI requests, by event and processing phase.",
+			// 50us ... ~3.3s
+			Buckets: prometheus.ExponentialBuckets(0.00005, 2, 17),
+		},
+		[]string{"event", "phase"},
+	)
+)
+
+// RequestTimer measures the latency of processing a single NRI request.
+type RequestTimer struct {
+	event string
+	start time.Time
+}
+
+// StartRequestTimer starts measuring the latency of processing a request.
+func StartRequestTimer(event string) RequestTimer {
+	return RequestTimer{
+		event: event,
+		start: time.Now(),
+	}
+}
+
+// ObservePhase records the latency of a processing phase started at start.
+func (t RequestTimer) ObservePhase(phase string, start time.Time) {
+	requestLatency.WithLabelValues(t.event, phase).Observe(time.Since(start).Seconds())
+}
+
+// Done records the total latency of processing the request.
+func (t RequestTimer) Done() {
+	t.ObservePhase(PhaseTotal, t.start)
+}
+
+func init() {
+	err := metrics.RegisterCollector("nriRequestLatency", func() (prometheus.Collector, error) {
+		return requestLatency, nil
+	})
+	if err != nil {
+		log.Error("failed to register NRI request latency collector: %v", err)
+	}
+}
@@ -0,0 +1,86 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metrics
+
+import (
+	"time"
+
+	"github.com/prometheus/client_golang/prometheus"
+
+	"github.com/containers/nri-plugins/pkg/metrics"
+)
+
+var (
+	lockWait = prometheus.NewHistogramVec(
+		prometheus.HistogramOpts{
+			Name: "resmgr_lock_wait_seconds",
+			Help: "Time spent waiting for the resource manager lock, by lock holder.",
+			// 1us ... ~1s
+			Buckets: prometheus.ExponentialBuckets(0.000001, 4, 11),
+		},
+		[]string{"holder"},
+	)
+	lockHold = prometheus.NewHistogramVec(
+		prometheus.HistogramOpts{
+			Name: "resmgr_lock_hold_seconds",
+			Help: "Time the resource manager lock was held for, by lock holder.",
+			// 1us ... ~1s
+			Buckets: prometheus.ExponentialBuckets(0.000001, 4, 11),
+		},
+		[]string{"holder"},
+	)
+	snapshotServed = prometheus.NewCounterVec(
+		prometheus.CounterOpts{
+			Name: "resmgr_state_snapshot_served_total",
+			Help: "Number of read-only requests served from a state snapshot, by whether it was fresh.",
+		},
+		[]string{"state"},
+	)
+)
+
+// ObserveLockWait records the time holder waited for the resource manager lock.
+func ObserveLockWait(holder string, d time.Duration) {
+	lockWait.WithLabelValues(holder).Observe(d.Seconds())
+}
+
+// ObserveLockHold records the time holder held the resource manager lock.
+func ObserveLockHold(holder string, d time.Duration) {
+	lockHold.WithLabelValues(holder).Observe(d.Seconds())
+}
+
+// SnapshotServed counts a read-only request served from a fresh or stale snapshot.
+func SnapshotServed(fresh bool) {
+	state := "stale"
+	if fresh {
+		state = "fresh"
+	}
+	snapshotServed.WithLabelValues(state).Inc()
+}
+
+func init() {
+	for name, c := range map[string]prometheus.Collector{
+		"resmgrLockWait":      lockWait,
+		"resmgrLockHold":      lockHold,
+		"resmgrStateSnapshot": snapshotServed,
+	} {
+		collector := c
+		err := metrics.RegisterCollector(name, func() (prometheus.Collector, error) {
+			return collector, nil
+		})
+		if err != nil {
+			log.Error("failed to register %s collector: %v", name, err)
+		}
+	}
+}
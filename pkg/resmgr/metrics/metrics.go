@@ -30,6 +30,7 @@ import (
 	"github.com/containers/nri-plugins/pkg/instrumentation"
 	"github.com/containers/nri-plugins/pkg/metrics"
 	"github.com/containers/nri-plugins/pkg/resmgr/events"
+	"github.com/containers/nri-plugins/pkg/resmgr/sampler"
 
 	// pull in all metrics collectors
 	_ "github.com/containers/nri-plugins/pkg/metrics/register"
@@ -41,6 +42,8 @@ type Options struct {
 	PollInterval time.Duration
 	// Events is the channel for delivering metrics events.
 	Events chan interface{}
+	// Sampler, if set, drives polling instead of PollInterval.
+	Sampler *sampler.Sampler
 }
 
 // Metrics implements collecting, caching and processing of raw metrics.
@@ -85,6 +88,16 @@ func (m *Metrics) Start() error {
 		return nil
 	}
 
+	if m.opts.Sampler != nil {
+		m.opts.Sampler.AddSource("metrics", func(time.Time) {
+			if err := m.poll(); err != nil {
+				log.Error("failed to poll raw metrics: %v", err)
+			}
+		})
+		m.stop = make(chan interface{})
+		return nil
+	}
+
 	stop := make(chan interface{})
 	go func() {
 		var pollTimer *time.Ticker
@@ -17,11 +17,16 @@ package resmgr
 import (
 	"context"
 	"fmt"
+	"sort"
+	"sync"
+	"time"
 
 	"github.com/containers/nri-plugins/pkg/instrumentation/tracing"
 	logger "github.com/containers/nri-plugins/pkg/log"
 	"github.com/containers/nri-plugins/pkg/resmgr/cache"
 	"github.com/containers/nri-plugins/pkg/resmgr/events"
+	"github.com/containers/nri-plugins/pkg/resmgr/metrics"
+	"github.com/containers/nri-plugins/pkg/resmgr/nritrace"
 	"github.com/containers/nri-plugins/pkg/resmgr/policy"
 	"sigs.k8s.io/yaml"
 
@@ -31,8 +36,11 @@ import (
 
 type nriPlugin struct {
 	logger.Logger
-	stub   stub.Stub
-	resmgr *resmgr
+	stub     stub.Stub
+	resmgr   *resmgr
+	updates  *updateCoalescer
+	sendLock sync.Mutex // serializes sending batched updates
+	trace    *nritrace.Recorder
 }
 
 func newNRIPlugin(resmgr *resmgr) (*nriPlugin, error) {
@@ -40,9 +48,18 @@ func newNRIPlugin(resmgr *resmgr) (*nriPlugin, error) {
 		Logger: logger.NewLogger("nri-plugin"),
 		resmgr: resmgr,
 	}
+	p.updates = newUpdateCoalescer(p.Logger, opt.UpdateBatchWindow, p.flushUpdates)
 
 	p.Info("creating plugin...")
 
+	if opt.NriTraceFile != "" {
+		trace, err := nritrace.NewRecorder(opt.NriTraceFile)
+		if err != nil {
+			return nil, err
+		}
+		p.trace = trace
+	}
+
 	return p, nil
 }
 
@@ -91,6 +108,7 @@ func (p *nriPlugin) stop() {
 
 	p.Info("stopping plugin...")
 	p.stub.Stop()
+	p.trace.Close()
 }
 
 func (p *nriPlugin) restart() error {
@@ -133,6 +151,11 @@ func (p *nriPlugin) syncWithNRI(pods []*api.PodSandbox, containers []*api.Contai
 
 	m.Info("synchronizing cache state with NRI runtime...")
 
+	p.updates.reset()
+	for _, c := range containers {
+		p.updates.setApplied(c.GetId(), c.GetLinux().GetResources())
+	}
+
 	_, _, deleted := m.cache.RefreshPods(pods)
 	for _, c := range deleted {
 		m.Info("discovered stale container %s...", c.GetID())
@@ -170,11 +193,23 @@ func (p *nriPlugin) syncWithNRI(pods []*api.PodSandbox, containers []*api.Contai
 		}
 	}
 
+	// Reallocate in a fixed order, so that restarting with the same set
+	// of containers always ends up with the same allocations.
+	sort.Slice(allocated, func(i, j int) bool {
+		ci, cj := allocated[i], allocated[j]
+		if ni, nj := ci.PrettyName(), cj.PrettyName(); ni != nj {
+			return ni < nj
+		}
+		return ci.GetID() < cj.GetID()
+	})
+
 	return allocated, released, nil
 }
 
 func (p *nriPlugin) Synchronize(ctx context.Context, pods []*api.PodSandbox, containers []*api.Container) (updates []*api.ContainerUpdate, retErr error) {
 	event := Synchronize
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -189,25 +224,45 @@ func (p *nriPlugin) Synchronize(ctx context.Context, pods []*api.PodSandbox, con
 		p.dump(out, event, updates, retErr)
 	}()
 
+	// Notes: we don't take the resmgr lock here. Synchronize is the first
+	// request we get and it can be delivered while resmgr.Start(), which
+	// starts the plugin stub, is still holding the lock.
 	m := p.resmgr
 
+	start := time.Now()
 	allocated, released, err := p.syncWithNRI(pods, containers)
+	timer.ObservePhase(metrics.PhaseCache, start)
 	if err != nil {
 		p.resmgr.Error("failed to synchronize with NRI: %v", err)
 		return nil, err
 	}
 
-	if err := m.policy.Start(allocated, released); err != nil {
+	start = time.Now()
+	err = m.policy.Start(allocated, released)
+	timer.ObservePhase(metrics.PhasePolicy, start)
+	if err != nil {
 		return nil, fmt.Errorf("failed to start policy %s: %w", policy.ActivePolicy(), err)
 	}
 
+	for _, c := range released {
+		m.sampler.Untrack(c.GetID())
+	}
+	for _, c := range allocated {
+		m.sampler.Track(c.GetID(), c.GetCgroupDir())
+	}
+	m.sampler.Poke()
+
+	start = time.Now()
 	m.updateTopologyZones()
+	timer.ObservePhase(metrics.PhaseExport, start)
 
-	return p.getPendingUpdates(nil), nil
+	return p.updates.replyAll(p.collectPendingUpdates(nil)), nil
 }
 
 func (p *nriPlugin) RunPodSandbox(ctx context.Context, pod *api.PodSandbox) (retErr error) {
 	event := RunPodSandbox
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -224,15 +279,20 @@ func (p *nriPlugin) RunPodSandbox(ctx context.Context, pod *api.PodSandbox) (ret
 	}()
 
 	m := p.resmgr
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock(event)
+	defer unlock()
 
+	start := time.Now()
 	m.cache.InsertPod(pod)
+	timer.ObservePhase(metrics.PhaseCache, start)
+
 	return nil
 }
 
 func (p *nriPlugin) StopPodSandbox(ctx context.Context, podSandbox *api.PodSandbox) (retErr error) {
 	event := StopPodSandbox
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -243,7 +303,14 @@ func (p *nriPlugin) StopPodSandbox(ctx context.Context, podSandbox *api.PodSandb
 		span.End(tracing.WithStatus(retErr))
 	}()
 
+	p.dump(in, event, podSandbox)
+	defer func() {
+		p.dump(out, event, retErr)
+	}()
+
 	m := p.resmgr
+	unlock := m.lock(event)
+	defer unlock()
 
 	released := []cache.Container{}
 	pod, _ := m.cache.LookupPod(podSandbox.GetId())
@@ -252,21 +319,20 @@ func (p *nriPlugin) StopPodSandbox(ctx context.Context, podSandbox *api.PodSandb
 		released = append(released, c)
 	}
 
+	start := time.Now()
 	if err := p.runPostReleaseHooks(event, released...); err != nil {
 		m.Error("%s: failed to run post-release hooks for pod %s: %v",
 			event, pod.GetName(), err)
 	}
-
-	p.dump(in, event, podSandbox)
-	defer func() {
-		p.dump(out, event, retErr)
-	}()
+	timer.ObservePhase(metrics.PhaseControllers, start)
 
 	return nil
 }
 
 func (p *nriPlugin) RemovePodSandbox(ctx context.Context, podSandbox *api.PodSandbox) (retErr error) {
 	event := RemovePodSandbox
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -283,6 +349,8 @@ func (p *nriPlugin) RemovePodSandbox(ctx context.Context, podSandbox *api.PodSan
 	}()
 
 	m := p.resmgr
+	unlock := m.lock(event)
+	defer unlock()
 
 	released := []cache.Container{}
 	pod, _ := m.cache.LookupPod(podSandbox.GetId())
@@ -291,20 +359,24 @@ func (p *nriPlugin) RemovePodSandbox(ctx context.Context, podSandbox *api.PodSan
 		released = append(released, c)
 	}
 
+	start := time.Now()
 	if err := p.runPostReleaseHooks(event, released...); err != nil {
 		m.Error("%s: failed to run post-release hooks for pod %s: %v",
 			event, pod.GetName(), err)
 	}
+	timer.ObservePhase(metrics.PhaseControllers, start)
 
-	m.Lock()
-	defer m.Unlock()
-
+	start = time.Now()
 	m.cache.DeletePod(podSandbox.GetId())
+	timer.ObservePhase(metrics.PhaseCache, start)
+
 	return nil
 }
 
 func (p *nriPlugin) CreateContainer(ctx context.Context, podSandbox *api.PodSandbox, container *api.Container) (adjust *api.ContainerAdjustment, updates []*api.ContainerUpdate, retErr error) {
 	event := CreateContainer
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -321,16 +393,21 @@ func (p *nriPlugin) CreateContainer(ctx context.Context, podSandbox *api.PodSand
 	}()
 
 	m := p.resmgr
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock(event)
+	defer unlock()
 
+	start := time.Now()
 	c, err := m.cache.InsertContainer(container)
+	timer.ObservePhase(metrics.PhaseCache, start)
 	if err != nil {
 		return nil, nil, fmt.Errorf("failed to cache container: %w", err)
 	}
 	c.UpdateState(cache.ContainerStateCreating)
 
-	if err := m.policy.AllocateResources(c); err != nil {
+	start = time.Now()
+	err = m.policy.AllocateResources(c)
+	timer.ObservePhase(metrics.PhasePolicy, start)
+	if err != nil {
 		c.UpdateState(cache.ContainerStateStale)
 		return nil, nil, fmt.Errorf("failed to allocate resources: %w", err)
 	}
@@ -343,24 +420,36 @@ func (p *nriPlugin) CreateContainer(ctx context.Context, podSandbox *api.PodSand
 		Options:     []string{"bind", "ro", "rslave"},
 	})
 
-	if err := p.runPostAllocateHooks(event, c); err != nil {
+	start = time.Now()
+	err = p.runPostAllocateHooks(event, c)
+	if err != nil {
 		m.Error("%s: failed to run post-allocate hooks for %s: %v",
 			event, container.GetName(), err)
 		p.runPostReleaseHooks(event, c)
+	}
+	timer.ObservePhase(metrics.PhaseControllers, start)
+	if err != nil {
 		return nil, nil, fmt.Errorf("failed to allocate container resources: %w", err)
 	}
 
+	start = time.Now()
 	m.policy.ExportResourceData(c)
 	m.updateTopologyZones()
+	timer.ObservePhase(metrics.PhaseExport, start)
+
+	m.sampler.Track(c.GetID(), c.GetCgroupDir())
+	m.sampler.Poke()
 
 	adjust = p.getPendingAdjustment(container)
-	updates = p.getPendingUpdates(container)
+	updates = p.getPendingUpdates(container, nil)
 
 	return adjust, updates, nil
 }
 
 func (p *nriPlugin) StartContainer(ctx context.Context, pod *api.PodSandbox, container *api.Container) (retErr error) {
 	event := StartContainer
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -377,8 +466,8 @@ func (p *nriPlugin) StartContainer(ctx context.Context, pod *api.PodSandbox, con
 	}()
 
 	m := p.resmgr
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock(event)
+	defer unlock()
 
 	c, ok := m.cache.LookupContainer(container.Id)
 	if !ok {
@@ -393,20 +482,26 @@ func (p *nriPlugin) StartContainer(ctx context.Context, pod *api.PodSandbox, con
 		Data:   c,
 	}
 
+	start := time.Now()
 	if _, err := m.policy.HandleEvent(e); err != nil {
 		m.Error("%s: policy failed to handle event %s: %v", event, e.Type, err)
 	}
+	timer.ObservePhase(metrics.PhasePolicy, start)
 
+	start = time.Now()
 	if err := p.runPostStartHooks(event, c); err != nil {
 		m.Error("%s: failed to run post-start hooks for %s: %v",
 			event, c.PrettyName(), err)
 	}
+	timer.ObservePhase(metrics.PhaseControllers, start)
 
 	return nil
 }
 
 func (p *nriPlugin) UpdateContainer(ctx context.Context, pod *api.PodSandbox, container *api.Container, res *api.LinuxResources) (updates []*api.ContainerUpdate, retErr error) {
 	event := UpdateContainer
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -423,8 +518,8 @@ func (p *nriPlugin) UpdateContainer(ctx context.Context, pod *api.PodSandbox, co
 	}()
 
 	m := p.resmgr
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock(event)
+	defer unlock()
 
 	c, ok := m.cache.LookupContainer(container.Id)
 	if !ok {
@@ -437,15 +532,23 @@ func (p *nriPlugin) UpdateContainer(ctx context.Context, pod *api.PodSandbox, co
 	}
 	//r := cache.EstimateResourceRequirements(res, c.GetQOSClass())
 
-	if err := m.policy.UpdateResources(c); err != nil {
+	// The runtime applies the requested resources together with our updates.
+	p.updates.setApplied(container.GetId(), res)
+
+	start := time.Now()
+	err := m.policy.UpdateResources(c)
+	timer.ObservePhase(metrics.PhasePolicy, start)
+	if err != nil {
 		return nil, fmt.Errorf("failed to update resources: %w", err)
 	}
 
-	return p.getPendingUpdates(nil), nil
+	return p.getPendingUpdates(nil, container), nil
 }
 
 func (p *nriPlugin) StopContainer(ctx context.Context, pod *api.PodSandbox, container *api.Container) (updates []*api.ContainerUpdate, retErr error) {
 	event := StopContainer
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -462,26 +565,37 @@ func (p *nriPlugin) StopContainer(ctx context.Context, pod *api.PodSandbox, cont
 	}()
 
 	m := p.resmgr
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock(event)
+	defer unlock()
 
 	c, ok := m.cache.LookupContainer(container.Id)
 	if !ok {
 		return nil, nil
 	}
 
-	if err := m.policy.ReleaseResources(c); err != nil {
+	start := time.Now()
+	err := m.policy.ReleaseResources(c)
+	timer.ObservePhase(metrics.PhasePolicy, start)
+	if err != nil {
 		return nil, fmt.Errorf("failed to release resources: %w", err)
 	}
 
 	c.UpdateState(cache.ContainerStateExited)
+	m.sampler.Poke()
+
+	start = time.Now()
 	m.updateTopologyZones()
+	timer.ObservePhase(metrics.PhaseExport, start)
 
-	return p.getPendingUpdates(container), nil
+	p.updates.forget(container.GetId())
+
+	return p.getPendingUpdates(container, nil), nil
 }
 
 func (p *nriPlugin) RemoveContainer(ctx context.Context, pod *api.PodSandbox, container *api.Container) (retErr error) {
 	event := RemoveContainer
+	timer := metrics.StartRequestTimer(event)
+	defer timer.Done()
 
 	_, span := tracing.StartSpan(
 		ctx,
@@ -498,17 +612,54 @@ func (p *nriPlugin) RemoveContainer(ctx context.Context, pod *api.PodSandbox, co
 	}()
 
 	m := p.resmgr
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock(event)
+	defer unlock()
 
+	start := time.Now()
 	m.cache.DeleteContainer(container.Id)
+	timer.ObservePhase(metrics.PhaseCache, start)
+
+	m.sampler.Untrack(container.GetId())
+	m.sampler.Poke()
+
+	p.updates.forget(container.GetId())
 	return nil
 }
 
-func (p *nriPlugin) updateContainers() (retErr error) {
+// updateContainers queues all pending container updates and triggers sending
+// them in a single batch. The batch is sent outside of the resmgr lock.
+func (p *nriPlugin) updateContainers() {
 	// Notes: must be called with p.resmgr lock held.
 
-	updates := p.getPendingUpdates(nil)
+	p.updates.queue(p.collectPendingUpdates(nil))
+	go p.flushUpdates()
+}
+
+// flushUpdates sends any queued container updates once the batching window expires.
+func (p *nriPlugin) flushUpdates() {
+	// Flushes can overlap (triggered by updateContainers and the batching
+	// timer). Hold sendLock from taking the updates until the runtime has
+	// processed them, so a later batch can't be overtaken by an earlier one.
+	p.sendLock.Lock()
+	defer p.sendLock.Unlock()
+
+	unlock := p.resmgr.lock(UpdateContainers)
+	updates := p.updates.takeAll()
+	unlock()
+
+	if len(updates) == 0 {
+		return
+	}
+
+	if err := p.sendUpdates(updates); err != nil {
+		p.Error("batched container update failed: %v", err)
+	}
+}
+
+// sendUpdates sends unsolicited container updates to the runtime.
+func (p *nriPlugin) sendUpdates(updates []*api.ContainerUpdate) (retErr error) {
+	// Notes: must be called without p.resmgr lock held. The runtime might
+	// be waiting for us to reply to a request while processing updates.
 
 	event := UpdateContainers
 	p.dump(out, event, updates)
@@ -516,10 +667,17 @@ func (p *nriPlugin) updateContainers() (retErr error) {
 		p.dump(in, event, retErr)
 	}()
 
-	_, err := p.stub.UpdateContainers(updates)
+	failed, err := p.stub.UpdateContainers(updates)
+
+	unlock := p.resmgr.lock(event)
+	defer unlock()
+
 	if err != nil {
-		return fmt.Errorf("post-config container update failed: %w", err)
+		// We can't tell what got applied, so don't omit any later updates.
+		p.updates.forgetApplied(updates)
+		return err
 	}
+	p.updates.forgetApplied(failed)
 
 	return nil
 }
@@ -530,13 +688,24 @@ func (p *nriPlugin) getPendingAdjustment(container *api.Container) *api.Containe
 		for _, ctrl := range c.GetPending() {
 			c.ClearPending(ctrl)
 		}
+		p.updates.forget(c.GetID())
+		p.updates.setApplied(c.GetID(), adjust.GetLinux().GetResources())
 		return adjust
 	}
 
 	return nil
 }
 
-func (p *nriPlugin) getPendingUpdates(skip *api.Container) []*api.ContainerUpdate {
+// getPendingUpdates returns the pending updates to include in a reply. With
+// update batching enabled, only the update for subject is returned and the
+// rest get queued for sending in a single batch later.
+func (p *nriPlugin) getPendingUpdates(skip, subject *api.Container) []*api.ContainerUpdate {
+	return p.updates.reply(p.collectPendingUpdates(skip), subject.GetId())
+}
+
+// collectPendingUpdates collects and clears the pending updates of all containers
+// and queues re-exporting their resource data.
+func (p *nriPlugin) collectPendingUpdates(skip *api.Container) []*api.ContainerUpdate {
 	m := p.resmgr
 	updates := []*api.ContainerUpdate{}
 	for _, c := range m.cache.GetPendingContainers() {
@@ -556,6 +725,9 @@ func (p *nriPlugin) getPendingUpdates(skip *api.Container) []*api.ContainerUpdat
 			for _, ctrl := range c.GetPending() {
 				c.ClearPending(ctrl)
 			}
+
+			// Refresh exported data, the update might have changed it.
+			m.policy.ExportResourceData(c)
 		}
 	}
 
@@ -582,6 +754,12 @@ const (
 )
 
 func (p *nriPlugin) dump(dir, event string, args ...interface{}) {
+	if dir == in {
+		if err := p.trace.Record(event, args...); err != nil {
+			p.Error("%s %s: failed to record trace: %v", dir, event, err)
+		}
+	}
+
 	switch event {
 	case RunPodSandbox, StopPodSandbox, RemovePodSandbox:
 		if dir == in {
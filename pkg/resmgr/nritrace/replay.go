@@ -0,0 +1,305 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nritrace
+
+import (
+	"fmt"
+	"runtime"
+	"sort"
+	"time"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+	"github.com/containers/nri-plugins/pkg/resmgr/events"
+	"github.com/containers/nri-plugins/pkg/resmgr/policy"
+)
+
+// Replayer replays a trace of NRI requests against a policy backend. It
+// drives the cache and the backend the same way the resource manager does,
+// but without controllers, resource export or an NRI runtime connection.
+type Replayer struct {
+	cache   cache.Cache
+	backend policy.Backend
+	started bool
+}
+
+// Result is the outcome of replaying a single event.
+type Result struct {
+	// Event is the replayed request.
+	Event string
+	// Latency is the time it took the backend and the cache to process it.
+	Latency time.Duration
+	// Allocs is the number of heap allocations done while processing it.
+	Allocs uint64
+	// Updates is the number of unsolicited container updates it resulted in.
+	Updates int
+	// Err is the error processing the event failed with.
+	Err error
+}
+
+// Summary summarizes the results of replaying events of a single type.
+type Summary struct {
+	Event   string
+	Count   int
+	Errors  int
+	Total   time.Duration
+	Max     time.Duration
+	Allocs  uint64
+	Updates int
+}
+
+// NewReplayer creates a replayer for the given cache and policy backend.
+func NewReplayer(cch cache.Cache, backend policy.Backend) *Replayer {
+	return &Replayer{
+		cache:   cch,
+		backend: backend,
+	}
+}
+
+// Replay replays the given events, returning the results for each event.
+func (r *Replayer) Replay(events []*Event) []*Result {
+	results := make([]*Result, 0, len(events))
+	for _, e := range events {
+		if res := r.ReplayEvent(e); res != nil {
+			results = append(results, res)
+		}
+	}
+	return results
+}
+
+// ReplayEvent replays a single event. It returns nil for events which are
+// not relevant for the policy backend.
+func (r *Replayer) ReplayEvent(e *Event) *Result {
+	switch e.Event {
+	case Synchronize, RunPodSandbox, RemovePodSandbox,
+		CreateContainer, StartContainer, UpdateContainer, StopContainer, RemoveContainer:
+	default:
+		return nil
+	}
+
+	// Start the backend with an empty state if the trace has no Synchronize.
+	if !r.started && e.Event != Synchronize {
+		if err := r.backend.Start(nil, nil); err != nil {
+			return &Result{Event: e.Event, Err: replayError("failed to start policy: %v", err)}
+		}
+		r.started = true
+	}
+
+	var (
+		ms     runtime.MemStats
+		allocs uint64
+	)
+
+	runtime.ReadMemStats(&ms)
+	allocs = ms.Mallocs
+	start := time.Now()
+
+	err := r.replay(e)
+
+	latency := time.Since(start)
+	runtime.ReadMemStats(&ms)
+
+	return &Result{
+		Event:   e.Event,
+		Latency: latency,
+		Allocs:  ms.Mallocs - allocs,
+		Updates: r.collectUpdates(e),
+		Err:     err,
+	}
+}
+
+func (r *Replayer) replay(e *Event) error {
+	switch e.Event {
+	case Synchronize:
+		return r.synchronize(e)
+
+	case RunPodSandbox:
+		if _, err := r.cache.InsertPod(e.Pod); err != nil {
+			return replayError("%s: %v", e.Event, err)
+		}
+
+	case RemovePodSandbox:
+		r.cache.DeletePod(e.Pod.GetId())
+
+	case CreateContainer:
+		c, err := r.cache.InsertContainer(e.Container)
+		if err != nil {
+			return replayError("%s: %v", e.Event, err)
+		}
+		c.UpdateState(cache.ContainerStateCreating)
+		if err := r.backend.AllocateResources(c); err != nil {
+			c.UpdateState(cache.ContainerStateStale)
+			return replayError("%s: failed to allocate %s: %v", e.Event, c.PrettyName(), err)
+		}
+		c.UpdateState(cache.ContainerStateCreated)
+
+	case StartContainer:
+		c, ok := r.cache.LookupContainer(e.Container.GetId())
+		if !ok {
+			return nil
+		}
+		c.UpdateState(cache.ContainerStateRunning)
+		_, err := r.backend.HandleEvent(&events.Policy{
+			Type:   events.ContainerStarted,
+			Source: "nri-trace",
+			Data:   c,
+		})
+		if err != nil {
+			return replayError("%s: %v", e.Event, err)
+		}
+
+	case UpdateContainer:
+		c, ok := r.cache.LookupContainer(e.Container.GetId())
+		if !ok {
+			return nil
+		}
+		if !c.SetResourceUpdates(e.Resources) {
+			return nil
+		}
+		if err := r.backend.UpdateResources(c); err != nil {
+			return replayError("%s: failed to update %s: %v", e.Event, c.PrettyName(), err)
+		}
+
+	case StopContainer:
+		c, ok := r.cache.LookupContainer(e.Container.GetId())
+		if !ok {
+			return nil
+		}
+		if err := r.backend.ReleaseResources(c); err != nil {
+			return replayError("%s: failed to release %s: %v", e.Event, c.PrettyName(), err)
+		}
+		c.UpdateState(cache.ContainerStateExited)
+
+	case RemoveContainer:
+		r.cache.DeleteContainer(e.Container.GetId())
+	}
+
+	return nil
+}
+
+func (r *Replayer) synchronize(e *Event) error {
+	released := []cache.Container{}
+	allocated := []cache.Container{}
+
+	_, _, deleted := r.cache.RefreshPods(e.Pods)
+	released = append(released, deleted...)
+	_, deleted = r.cache.RefreshContainers(e.Containers)
+	released = append(released, deleted...)
+
+	for _, c := range r.cache.GetContainers() {
+		switch c.GetState() {
+		case cache.ContainerStateRunning, cache.ContainerStateCreated:
+			allocated = append(allocated, c)
+			released = append(released, c)
+		case cache.ContainerStateExited:
+			released = append(released, c)
+		}
+	}
+
+	sort.Slice(allocated, func(i, j int) bool {
+		ci, cj := allocated[i], allocated[j]
+		if ni, nj := ci.PrettyName(), cj.PrettyName(); ni != nj {
+			return ni < nj
+		}
+		return ci.GetID() < cj.GetID()
+	})
+
+	var err error
+	if !r.started {
+		err = r.backend.Start(allocated, released)
+		r.started = true
+	} else {
+		err = r.backend.Sync(allocated, released)
+	}
+	if err != nil {
+		return replayError("%s: %v", e.Event, err)
+	}
+
+	return nil
+}
+
+// collectUpdates counts and clears pending container updates. The pending
+// changes of a container being created go into its adjustment, so they are
+// not counted as updates.
+func (r *Replayer) collectUpdates(e *Event) int {
+	cnt := 0
+	for _, c := range r.cache.GetPendingContainers() {
+		if e.Event != CreateContainer || c.GetID() != e.Container.GetId() {
+			if c.GetPendingUpdate() != nil {
+				cnt++
+			}
+		}
+		for _, ctrl := range c.GetPending() {
+			c.ClearPending(ctrl)
+		}
+	}
+	return cnt
+}
+
+// Summarize summarizes replay results by event type.
+func Summarize(results []*Result) []*Summary {
+	byEvent := map[string]*Summary{}
+	for _, res := range results {
+		s, ok := byEvent[res.Event]
+		if !ok {
+			s = &Summary{Event: res.Event}
+			byEvent[res.Event] = s
+		}
+		s.Count++
+		if res.Err != nil {
+			s.Errors++
+		}
+		s.Total += res.Latency
+		if res.Latency > s.Max {
+			s.Max = res.Latency
+		}
+		s.Allocs += res.Allocs
+		s.Updates += res.Updates
+	}
+
+	summary := make([]*Summary, 0, len(byEvent))
+	for _, s := range byEvent {
+		summary = append(summary, s)
+	}
+	sort.Slice(summary, func(i, j int) bool {
+		return summary[i].Event < summary[j].Event
+	})
+
+	return summary
+}
+
+// Mean returns the mean latency of the summarized events.
+func (s *Summary) Mean() time.Duration {
+	if s.Count == 0 {
+		return 0
+	}
+	return s.Total / time.Duration(s.Count)
+}
+
+// AllocsPerOp returns the mean number of allocations per summarized event.
+func (s *Summary) AllocsPerOp() uint64 {
+	if s.Count == 0 {
+		return 0
+	}
+	return s.Allocs / uint64(s.Count)
+}
+
+func (s *Summary) String() string {
+	return fmt.Sprintf("%-16s %6d events, %d errors, mean %v, max %v, %d allocs/op, %d updates",
+		s.Event, s.Count, s.Errors, s.Mean(), s.Max, s.AllocsPerOp(), s.Updates)
+}
+
+func replayError(format string, args ...interface{}) error {
+	return fmt.Errorf("nri-trace: replay: "+format, args...)
+}
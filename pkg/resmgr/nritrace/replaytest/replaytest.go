@@ -0,0 +1,213 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Package replaytest implements shared tests and benchmarks which replay
+// NRI event traces against policy backends.
+package replaytest
+
+import (
+	"bytes"
+	"flag"
+	"fmt"
+	"path"
+	"testing"
+
+	resapi "k8s.io/apimachinery/pkg/api/resource"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+	"github.com/containers/nri-plugins/pkg/resmgr/nritrace"
+	"github.com/containers/nri-plugins/pkg/resmgr/policy"
+	system "github.com/containers/nri-plugins/pkg/sysfs"
+	"github.com/containers/nri-plugins/pkg/testutils"
+	"github.com/containers/nri-plugins/pkg/utils"
+)
+
+// Replay a trace recorded with --nri-trace-file instead of a synthetic one.
+var nriTrace = flag.String("nri-trace", "", "NRI event trace to replay")
+
+// CreateFn creates the policy backend to replay traces against.
+type CreateFn func(*policy.BackendOptions) policy.Backend
+
+// Options for replaying traces.
+type Options struct {
+	// Reserved is the amount of CPU reserved for system and kube tasks.
+	Reserved string
+	// Fixture is the compressed sysfs fixture to replay recorded traces on.
+	Fixture string
+}
+
+// TestReplay replays a recorded or synthetic trace, failing on any errors.
+func TestReplay(t *testing.T, create CreateFn, o Options) {
+	sys := discoverFixture(t, o.Fixture)
+	trace := loadTrace(t)
+
+	r, events := newReplayer(t, create, o, sys, trace)
+	for _, res := range r.Replay(events) {
+		if res.Err != nil {
+			t.Errorf("%s failed: %v", res.Event, res.Err)
+		}
+	}
+}
+
+// BenchmarkReplay benchmarks replaying a recorded or synthetic trace.
+func BenchmarkReplay(b *testing.B, create CreateFn, o Options) {
+	sys := discoverFixture(b, o.Fixture)
+	trace := loadTrace(b)
+
+	var results []*nritrace.Result
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		b.StopTimer()
+		r, events := newReplayer(b, create, o, sys, trace)
+		b.StartTimer()
+		results = append(results, r.Replay(events)...)
+	}
+	b.StopTimer()
+
+	for _, s := range nritrace.Summarize(results) {
+		b.Logf("%s", s)
+	}
+}
+
+// BenchmarkReplaySynthetic measures container allocation, resizing and release
+// latencies and allocations on synthetic systems of increasing size.
+func BenchmarkReplaySynthetic(b *testing.B, create CreateFn, o Options) {
+	topologies := []testutils.SysfsTopology{
+		testutils.Sysfs32CPUs,
+		testutils.Sysfs256CPUs,
+		testutils.Sysfs1024CPUs,
+	}
+	for _, topology := range topologies {
+		sys := syntheticSystem(b, topology)
+		for _, containers := range []int{10, 100, 1000} {
+			trace := syntheticTrace(b, sys, containers)
+			b.Run(fmt.Sprintf("%s/containers=%d", topology, containers), func(b *testing.B) {
+				var results []*nritrace.Result
+				for i := 0; i < b.N; i++ {
+					b.StopTimer()
+					r, events := newReplayer(b, create, o, sys, trace)
+					b.StartTimer()
+					results = append(results, r.Replay(events)...)
+				}
+				b.StopTimer()
+
+				for _, s := range nritrace.Summarize(results) {
+					switch s.Event {
+					case nritrace.CreateContainer, nritrace.UpdateContainer, nritrace.RemoveContainer:
+						b.ReportMetric(float64(s.Mean().Nanoseconds()), "ns/"+s.Event)
+						b.ReportMetric(float64(s.AllocsPerOp()), "allocs/"+s.Event)
+					}
+					b.Logf("%s", s)
+				}
+			})
+		}
+	}
+}
+
+func loadTrace(tb testing.TB) []byte {
+	var (
+		events []*nritrace.Event
+		err    error
+	)
+
+	if *nriTrace != "" {
+		if events, err = nritrace.Load(*nriTrace); err != nil {
+			tb.Fatalf("failed to load trace: %v", err)
+		}
+	} else {
+		events = nritrace.Workload(24, 2)
+	}
+
+	return encodeTrace(tb, events)
+}
+
+// encodeTrace serializes a trace, so every replay starts from pristine objects.
+func encodeTrace(tb testing.TB, events []*nritrace.Event) []byte {
+	buf := &bytes.Buffer{}
+	if err := nritrace.Write(buf, events); err != nil {
+		tb.Fatalf("failed to serialize trace: %v", err)
+	}
+	return buf.Bytes()
+}
+
+func newReplayer(tb testing.TB, create CreateFn, o Options, sys system.System, trace []byte) (*nritrace.Replayer, []*nritrace.Event) {
+	cch, err := cache.NewCache(cache.Options{CacheDir: tb.TempDir(), Ephemeral: true})
+	if err != nil {
+		tb.Fatalf("failed to create cache: %v", err)
+	}
+
+	reserved, err := resapi.ParseQuantity(o.Reserved)
+	if err != nil {
+		tb.Fatalf("invalid reserved CPU %q: %v", o.Reserved, err)
+	}
+	backend := create(&policy.BackendOptions{
+		Cache:  cch,
+		System: sys,
+		Reserved: policy.ConstraintSet{
+			policy.DomainCPU: reserved,
+		},
+	})
+
+	events, err := nritrace.Read(bytes.NewReader(trace))
+	if err != nil {
+		tb.Fatalf("failed to read trace: %v", err)
+	}
+
+	return nritrace.NewReplayer(cch, backend), events
+}
+
+func discoverFixture(tb testing.TB, fixture string) system.System {
+	dir := tb.TempDir()
+	if err := utils.UncompressTbz2(fixture, dir); err != nil {
+		tb.Fatalf("failed to uncompress sysfs fixture: %v", err)
+	}
+
+	sys, err := system.DiscoverSystemAt(path.Join(dir, "sysfs", "server", "sys"))
+	if err != nil {
+		tb.Fatalf("failed to discover sysfs fixture: %v", err)
+	}
+	return sys
+}
+
+// syntheticSystem discovers a generated system of the given topology.
+func syntheticSystem(tb testing.TB, topology testutils.SysfsTopology) system.System {
+	root, err := testutils.GenerateSysfs(tb.TempDir(), topology)
+	if err != nil {
+		tb.Fatalf("%v", err)
+	}
+	sys, err := system.DiscoverSystemAt(root)
+	if err != nil {
+		tb.Fatalf("failed to discover synthetic system: %v", err)
+	}
+	return sys
+}
+
+// syntheticTrace generates a trace of pods with two containers each,
+// asking in total for about 3/4 of the CPU and DRAM of the system.
+func syntheticTrace(tb testing.TB, sys system.System, containers int) []byte {
+	var memory int64
+	for _, id := range sys.NodeIDs() {
+		if node := sys.Node(id); node.GetMemoryType() == system.MemoryTypeDRAM {
+			info, err := node.MemoryInfo()
+			if err != nil {
+				tb.Fatalf("failed to get memory info of node #%d: %v", id, err)
+			}
+			memory += int64(info.MemTotal)
+		}
+	}
+	milliCPU := int64(sys.CPUCount()-1) * 1000
+
+	return encodeTrace(tb, nritrace.WorkloadWithin(containers/2, 2, milliCPU*3/4, memory*3/4))
+}
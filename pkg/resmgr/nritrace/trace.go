@@ -0,0 +1,211 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Package nritrace records NRI requests into an event trace and replays
+// recorded traces against policy backends.
+package nritrace
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"io"
+	"os"
+	"sync"
+	"time"
+
+	"github.com/containerd/nri/pkg/api"
+
+	logger "github.com/containers/nri-plugins/pkg/log"
+)
+
+// NRI requests we record and replay.
+const (
+	Configure        = "Configure"
+	Synchronize      = "Synchronize"
+	RunPodSandbox    = "RunPodSandbox"
+	StopPodSandbox   = "StopPodSandbox"
+	RemovePodSandbox = "RemovePodSandbox"
+	CreateContainer  = "CreateContainer"
+	StartContainer   = "StartContainer"
+	UpdateContainer  = "UpdateContainer"
+	StopContainer    = "StopContainer"
+	RemoveContainer  = "RemoveContainer"
+)
+
+// Event is a single recorded NRI request.
+type Event struct {
+	Time       time.Time           `json:"time"`
+	Event      string              `json:"event"`
+	Pod        *api.PodSandbox     `json:"pod,omitempty"`
+	Container  *api.Container      `json:"container,omitempty"`
+	Resources  *api.LinuxResources `json:"resources,omitempty"`
+	Pods       []*api.PodSandbox   `json:"pods,omitempty"`
+	Containers []*api.Container    `json:"containers,omitempty"`
+}
+
+// Recorder writes NRI requests to a trace file, one JSON event per line.
+type Recorder struct {
+	sync.Mutex
+	f *os.File
+	w *bufio.Writer
+}
+
+var log = logger.NewLogger("nri-trace")
+
+// NewRecorder creates a recorder appending to the given trace file.
+func NewRecorder(path string) (*Recorder, error) {
+	f, err := os.OpenFile(path, os.O_WRONLY|os.O_CREATE|os.O_APPEND, 0o600)
+	if err != nil {
+		return nil, traceError("failed to open trace file %s: %v", path, err)
+	}
+
+	log.Info("recording NRI requests to %s...", path)
+
+	return &Recorder{
+		f: f,
+		w: bufio.NewWriter(f),
+	}, nil
+}
+
+// Record records a request with the arguments it was received with. The
+// arguments are the pod, container, and updated resources or the pods and
+// containers being synchronized. Recording with a nil Recorder is a no-op.
+func (r *Recorder) Record(event string, args ...interface{}) error {
+	if r == nil {
+		return nil
+	}
+
+	e := &Event{
+		Time:  time.Now(),
+		Event: event,
+	}
+
+	for _, arg := range args {
+		switch obj := arg.(type) {
+		case *api.PodSandbox:
+			e.Pod = obj
+		case *api.Container:
+			e.Container = obj
+		case *api.LinuxResources:
+			e.Resources = obj
+		case []*api.PodSandbox:
+			e.Pods = obj
+		case []*api.Container:
+			e.Containers = obj
+		}
+	}
+
+	data, err := json.Marshal(e)
+	if err != nil {
+		return traceError("failed to marshal %s event: %v", event, err)
+	}
+
+	r.Lock()
+	defer r.Unlock()
+
+	if r.f == nil {
+		return nil
+	}
+
+	r.w.Write(data)
+	r.w.WriteByte('\n')
+
+	// Flush every event, so that a crash leaves a usable trace behind.
+	if err := r.w.Flush(); err != nil {
+		return traceError("failed to write %s event: %v", event, err)
+	}
+
+	return nil
+}
+
+// Close flushes and closes the trace file.
+func (r *Recorder) Close() error {
+	if r == nil {
+		return nil
+	}
+
+	r.Lock()
+	defer r.Unlock()
+
+	if r.f == nil {
+		return nil
+	}
+
+	err := r.w.Flush()
+	if cerr := r.f.Close(); err == nil {
+		err = cerr
+	}
+	r.f = nil
+
+	return err
+}
+
+// Read reads a trace of events.
+func Read(r io.Reader) ([]*Event, error) {
+	var (
+		events  []*Event
+		scanner = bufio.NewScanner(r)
+		line    = 0
+	)
+
+	// Synchronize events can carry the full node state in a single line.
+	scanner.Buffer(make([]byte, 0, 64*1024), 64*1024*1024)
+
+	for scanner.Scan() {
+		line++
+		data := scanner.Bytes()
+		if len(data) == 0 {
+			continue
+		}
+		e := &Event{}
+		if err := json.Unmarshal(data, e); err != nil {
+			return nil, traceError("line %d: failed to unmarshal event: %v", line, err)
+		}
+		events = append(events, e)
+	}
+
+	if err := scanner.Err(); err != nil {
+		return nil, traceError("failed to read trace: %v", err)
+	}
+
+	return events, nil
+}
+
+// Load reads a trace of events from the given file.
+func Load(path string) ([]*Event, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, traceError("failed to open trace file %s: %v", path, err)
+	}
+	defer f.Close()
+
+	return Read(f)
+}
+
+// Write writes a trace of events.
+func Write(w io.Writer, events []*Event) error {
+	enc := json.NewEncoder(w)
+	for _, e := range events {
+		if err := enc.Encode(e); err != nil {
+			return traceError("failed to write %s event: %v", e.Event, err)
+		}
+	}
+	return nil
+}
+
+// traceError creates a formatted trace-specific error.
+func traceError(format string, args ...interface{}) error {
+	return fmt.Errorf("nri-trace: "+format, args...)
+}
@@ -0,0 +1,165 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nritrace
+
+import (
+	"path/filepath"
+	"testing"
+	"time"
+
+	"github.com/containerd/nri/pkg/api"
+
+	"github.com/containers/nri-plugins/pkg/kubernetes"
+)
+
+func TestRecordAndLoad(t *testing.T) {
+	file := filepath.Join(t.TempDir(), "trace")
+
+	r, err := NewRecorder(file)
+	if err != nil {
+		t.Fatalf("failed to create recorder: %v", err)
+	}
+
+	pod := &api.PodSandbox{Id: "pod0", Name: "pod0", Namespace: "default"}
+	ctr := &api.Container{Id: "ctr0", PodSandboxId: "pod0", Name: "ctr0"}
+	res := &api.LinuxResources{
+		Cpu: &api.LinuxCPU{
+			Cpus: "0-3",
+		},
+	}
+
+	for _, rec := range [][]interface{}{
+		{Configure, "runtime", "v1.0"},
+		{Synchronize, []*api.PodSandbox{pod}, []*api.Container{ctr}},
+		{RunPodSandbox, pod},
+		{UpdateContainer, pod, ctr, res},
+	} {
+		if err := r.Record(rec[0].(string), rec[1:]...); err != nil {
+			t.Fatalf("failed to record %s: %v", rec[0], err)
+		}
+	}
+	if err := r.Close(); err != nil {
+		t.Fatalf("failed to close recorder: %v", err)
+	}
+
+	// Recording after closing or with a nil recorder is a no-op.
+	if err := r.Record(RunPodSandbox, pod); err != nil {
+		t.Errorf("recording after close failed: %v", err)
+	}
+	if err := (*Recorder)(nil).Record(RunPodSandbox, pod); err != nil {
+		t.Errorf("recording with nil recorder failed: %v", err)
+	}
+
+	events, err := Load(file)
+	if err != nil {
+		t.Fatalf("failed to load trace: %v", err)
+	}
+
+	if len(events) != 4 {
+		t.Fatalf("expected 4 events, got %d", len(events))
+	}
+
+	e := events[0]
+	if e.Event != Configure || e.Pod != nil || e.Container != nil || e.Time.IsZero() {
+		t.Errorf("unexpected %s event %+v", Configure, e)
+	}
+	e = events[1]
+	if len(e.Pods) != 1 || e.Pods[0].GetId() != "pod0" ||
+		len(e.Containers) != 1 || e.Containers[0].GetId() != "ctr0" {
+		t.Errorf("unexpected %s event %+v", Synchronize, e)
+	}
+	e = events[2]
+	if e.Pod.GetId() != "pod0" || e.Container != nil {
+		t.Errorf("unexpected %s event %+v", RunPodSandbox, e)
+	}
+	e = events[3]
+	if e.Pod.GetId() != "pod0" || e.Container.GetId() != "ctr0" ||
+		e.Resources.GetCpu().GetCpus() != "0-3" {
+		t.Errorf("unexpected %s event %+v", UpdateContainer, e)
+	}
+}
+
+func TestWorkload(t *testing.T) {
+	events := Workload(6, 2)
+
+	pods := map[string]int{}
+	ctrs := map[string]int{}
+	last := time.Time{}
+
+	for _, e := range events {
+		if !e.Time.After(last) {
+			t.Errorf("%s event out of order", e.Event)
+		}
+		last = e.Time
+
+		switch e.Event {
+		case RunPodSandbox:
+			pods[e.Pod.GetId()]++
+		case RemovePodSandbox:
+			pods[e.Pod.GetId()]--
+		case CreateContainer:
+			ctrs[e.Container.GetId()]++
+		case RemoveContainer:
+			ctrs[e.Container.GetId()]--
+		}
+	}
+
+	if len(pods) != 6 || len(ctrs) != 12 {
+		t.Errorf("expected 6 pods with 12 containers, got %d pods, %d containers",
+			len(pods), len(ctrs))
+	}
+	for id, cnt := range pods {
+		if cnt != 0 {
+			t.Errorf("pod %s not removed", id)
+		}
+	}
+	for id, cnt := range ctrs {
+		if cnt != 0 {
+			t.Errorf("container %s not removed", id)
+		}
+	}
+}
+
+func TestWorkloadWithin(t *testing.T) {
+	const (
+		milliCPU = 8000
+		memory   = 4 << 30
+	)
+
+	var (
+		cpu, mem int64
+		limited  int
+	)
+	for _, e := range WorkloadWithin(30, 2, milliCPU, memory) {
+		if e.Event != CreateContainer {
+			continue
+		}
+		res := e.Container.GetLinux().GetResources()
+		if res.GetMemory() == nil {
+			continue
+		}
+		cpu += kubernetes.SharesToMilliCPU(int64(res.GetCpu().GetShares().GetValue()))
+		mem += res.GetMemory().GetLimit().GetValue()
+		limited++
+	}
+
+	// Allow for rounding in the conversion to and from CPU shares.
+	if cpu > milliCPU+int64(limited) {
+		t.Errorf("expected at most %dm CPU requested, got %dm", milliCPU, cpu)
+	}
+	if mem > memory {
+		t.Errorf("expected at most %d memory limited, got %d", memory, mem)
+	}
+}
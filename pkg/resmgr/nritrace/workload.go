@@ -0,0 +1,186 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package nritrace
+
+import (
+	"fmt"
+	"time"
+
+	"github.com/containerd/nri/pkg/api"
+
+	"github.com/containers/nri-plugins/pkg/kubernetes"
+)
+
+const (
+	memLimit    = 256 * 1024 * 1024
+	minMilliCPU = 10
+)
+
+// Workload generates a trace of pods cycling through their lifecycle, for
+// replaying when no recorded trace is available. Pods are created in QoS
+// class order guaranteed, burstable, besteffort, with containers asking for
+// 1 to 2 full CPUs, 250m to 750m CPU, or nothing. Every other pod gets its
+// first container resized. Finally all pods are torn down.
+func Workload(pods, containers int) []*Event {
+	return WorkloadWithin(pods, containers, 0, 0)
+}
+
+// WorkloadWithin generates a trace like Workload, but with the CPU and memory
+// asked for by containers scaled down to fit in total into the given milli-CPU
+// and memory budget. This lets the same number of containers be replayed on
+// systems of any size. A budget of 0 means no scaling.
+func WorkloadWithin(pods, containers int, milliCPU, memory int64) []*Event {
+	var (
+		trace []*Event
+		now   = time.Now()
+		qos   = []string{"guaranteed", "burstable", "besteffort"}
+		total int64
+		mem   = int64(memLimit)
+		count int64
+	)
+
+	// Sum up what all containers would ask for at their largest.
+	for i := 0; i < pods; i++ {
+		class := qos[i%len(qos)]
+		for j := 0; j < containers; j++ {
+			req := workloadMilliCPU(class, i+j)
+			if j == 0 && i%2 == 1 {
+				if resized := workloadMilliCPU(class, i+1); resized > req {
+					req = resized
+				}
+			}
+			total += req
+			if req > 0 {
+				count++
+			}
+		}
+	}
+	if memory > 0 && count*mem > memory {
+		mem = memory / count
+	}
+
+	resources := func(class string, size int) *api.LinuxResources {
+		req := workloadMilliCPU(class, size)
+		if milliCPU > 0 && total > milliCPU && req > 0 {
+			if req = req * milliCPU / total; req < minMilliCPU {
+				req = minMilliCPU
+			}
+		}
+		return workloadResources(class, req, mem)
+	}
+
+	add := func(event string, pod *api.PodSandbox, ctr *api.Container, res *api.LinuxResources) {
+		trace = append(trace, &Event{
+			Time:      now.Add(time.Duration(len(trace)) * time.Millisecond),
+			Event:     event,
+			Pod:       pod,
+			Container: ctr,
+			Resources: res,
+		})
+	}
+
+	allPods := make([]*api.PodSandbox, 0, pods)
+	allCtrs := make([][]*api.Container, 0, pods)
+
+	for i := 0; i < pods; i++ {
+		class := qos[i%len(qos)]
+		pod := &api.PodSandbox{
+			Id:        fmt.Sprintf("pod%d", i),
+			Uid:       fmt.Sprintf("pod%d-uid", i),
+			Name:      fmt.Sprintf("pod%d", i),
+			Namespace: "default",
+			Linux: &api.LinuxPodSandbox{
+				CgroupParent: fmt.Sprintf("/kubepods.slice/kubepods-%s.slice/kubepods-%s-pod%d.slice",
+					class, class, i),
+			},
+		}
+		allPods = append(allPods, pod)
+		add(RunPodSandbox, pod, nil, nil)
+
+		ctrs := make([]*api.Container, 0, containers)
+		for j := 0; j < containers; j++ {
+			ctr := &api.Container{
+				Id:           fmt.Sprintf("pod%d-ctr%d", i, j),
+				PodSandboxId: pod.Id,
+				Name:         fmt.Sprintf("ctr%d", j),
+				State:        api.ContainerState_CONTAINER_CREATED,
+				Linux: &api.LinuxContainer{
+					Resources: resources(class, i+j),
+				},
+			}
+			ctrs = append(ctrs, ctr)
+			add(CreateContainer, pod, ctr, nil)
+			add(StartContainer, pod, ctr, nil)
+		}
+		allCtrs = append(allCtrs, ctrs)
+
+		if i%2 == 1 && len(ctrs) > 0 {
+			add(UpdateContainer, pod, ctrs[0], resources(class, i+1))
+		}
+	}
+
+	for i, pod := range allPods {
+		for _, ctr := range allCtrs[i] {
+			add(StopContainer, pod, ctr, nil)
+			add(RemoveContainer, pod, ctr, nil)
+		}
+		add(StopPodSandbox, pod, nil, nil)
+		add(RemovePodSandbox, pod, nil, nil)
+	}
+
+	return trace
+}
+
+// workloadMilliCPU returns the CPU asked for by a container of a QoS class
+// and size.
+func workloadMilliCPU(class string, size int) int64 {
+	switch class {
+	case "guaranteed":
+		return int64(1000 * (1 + size%2))
+	case "burstable":
+		return int64(250 * (1 + size%3))
+	}
+	return 0
+}
+
+// workloadResources returns container resources for a QoS class, CPU and
+// memory limit.
+func workloadResources(class string, milliCPU, mem int64) *api.LinuxResources {
+	if class != "guaranteed" && class != "burstable" {
+		return &api.LinuxResources{
+			Cpu: &api.LinuxCPU{
+				Shares: &api.OptionalUInt64{Value: 2},
+			},
+		}
+	}
+
+	quota, period := kubernetes.MilliCPUToQuota(milliCPU)
+	res := &api.LinuxResources{
+		Cpu: &api.LinuxCPU{
+			Shares: &api.OptionalUInt64{Value: kubernetes.MilliCPUToShares(milliCPU)},
+			Period: &api.OptionalUInt64{Value: uint64(period)},
+			Quota:  &api.OptionalInt64{Value: quota},
+		},
+		Memory: &api.LinuxMemory{
+			Limit: &api.OptionalInt64{Value: mem},
+		},
+	}
+
+	if class == "burstable" {
+		res.Cpu.Quota.Value *= 2
+	}
+
+	return res
+}
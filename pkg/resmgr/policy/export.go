@@ -0,0 +1,167 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package policy
+
+import (
+	"bytes"
+	"errors"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"sync"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+)
+
+const (
+	// exportPerm is the permission of exported resource data files.
+	exportPerm = 0644
+)
+
+// exporter writes exported resource data to container data directories.
+// The first export of a container is written synchronously, so that it is
+// in place by the time the container starts. Later exports are queued to a
+// background writer which coalesces repeated exports of a container. Exports
+// with content identical to the last one are skipped.
+type exporter struct {
+	sync.Mutex
+	cache   cache.Cache
+	last    map[string][]byte  // last exported data per container
+	pending map[string]*export // exports queued for the writer
+	kick    chan struct{}
+	once    sync.Once
+}
+
+// writeExportFn writes exported data, overridable for testing.
+var writeExportFn = writeExport
+
+// export is a queued write of resource data.
+type export struct {
+	dir  string
+	data []byte
+}
+
+func newExporter(cch cache.Cache) *exporter {
+	return &exporter{
+		cache:   cch,
+		last:    make(map[string][]byte),
+		pending: make(map[string]*export),
+		kick:    make(chan struct{}, 1),
+	}
+}
+
+// export exports data for the container with the given ID.
+func (e *exporter) export(id string, data []byte) {
+	e.Lock()
+
+	prev, exported := e.last[id]
+	if exported && bytes.Equal(prev, data) {
+		e.Unlock()
+		return
+	}
+	e.last[id] = data
+
+	if !exported {
+		e.Unlock()
+		if err := e.cache.WriteFile(id, ExportedResources, exportPerm, data); err != nil {
+			log.Error("container %s: failed to export resource data: %v", id, err)
+			e.forget(id)
+		}
+		return
+	}
+
+	if p, ok := e.pending[id]; ok {
+		p.data = data
+		e.Unlock()
+		return
+	}
+
+	dir := e.cache.ContainerDirectory(id)
+	if dir == "" {
+		e.Unlock()
+		return
+	}
+	e.pending[id] = &export{dir: dir, data: data}
+	e.Unlock()
+
+	e.once.Do(func() { go e.run() })
+
+	select {
+	case e.kick <- struct{}{}:
+	default:
+	}
+}
+
+// forget forgets any exported or pending data of the given container.
+func (e *exporter) forget(id string) {
+	e.Lock()
+	defer e.Unlock()
+	delete(e.last, id)
+	delete(e.pending, id)
+}
+
+// run writes queued exports until the process exits.
+func (e *exporter) run() {
+	for range e.kick {
+		e.flush()
+	}
+}
+
+// flush writes all currently queued exports.
+func (e *exporter) flush() {
+	e.Lock()
+	pending := e.pending
+	e.pending = make(map[string]*export, len(pending))
+	e.Unlock()
+
+	for id, p := range pending {
+		if err := writeExportFn(p.dir, p.data); err != nil {
+			// The container might have been removed since queueing.
+			if errors.Is(err, fs.ErrNotExist) {
+				log.Debug("container %s: skipping export, directory gone", id)
+			} else {
+				log.Error("container %s: failed to export resource data: %v", id, err)
+			}
+			// Keep any export queued meanwhile, only forget what we failed to write.
+			e.Lock()
+			delete(e.last, id)
+			e.Unlock()
+		}
+	}
+}
+
+// writeExport atomically replaces the exported resource data in dir.
+func writeExport(dir string, data []byte) error {
+	tmp, err := os.CreateTemp(dir, "."+ExportedResources+"-*")
+	if err != nil {
+		return err
+	}
+
+	_, err = tmp.Write(data)
+	if cerr := tmp.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Chmod(tmp.Name(), exportPerm)
+	}
+	if err == nil {
+		err = os.Rename(tmp.Name(), filepath.Join(dir, ExportedResources))
+	}
+	if err != nil {
+		os.Remove(tmp.Name())
+	}
+
+	return err
+}
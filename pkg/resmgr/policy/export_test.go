@@ -0,0 +1,125 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package policy
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+
+	nri "github.com/containerd/nri/pkg/api"
+
+	"github.com/containers/nri-plugins/pkg/resmgr/cache"
+)
+
+func TestExporter(t *testing.T) {
+	cch, err := cache.NewCache(cache.Options{CacheDir: t.TempDir(), Ephemeral: true})
+	if err != nil {
+		t.Fatalf("failed to create cache: %v", err)
+	}
+
+	if _, err := cch.InsertPod(&nri.PodSandbox{Id: "pod0", Name: "pod0"}); err != nil {
+		t.Fatalf("failed to insert pod: %v", err)
+	}
+	if _, err := cch.InsertContainer(&nri.Container{Id: "ctr0", PodSandboxId: "pod0", Name: "ctr0"}); err != nil {
+		t.Fatalf("failed to insert container: %v", err)
+	}
+
+	e := newExporter(cch)
+	file := filepath.Join(cch.ContainerDirectory("ctr0"), ExportedResources)
+
+	read := func() string {
+		data, _ := os.ReadFile(file)
+		return string(data)
+	}
+	waitFor := func(expected string) {
+		deadline := time.Now().Add(5 * time.Second)
+		for read() != expected && time.Now().Before(deadline) {
+			time.Sleep(time.Millisecond)
+		}
+		if data := read(); data != expected {
+			t.Errorf("expected exported data %q, got %q", expected, data)
+		}
+	}
+
+	// The first export is written synchronously.
+	e.export("ctr0", []byte("A=1\n"))
+	if data := read(); data != "A=1\n" {
+		t.Errorf("expected exported data %q, got %q", "A=1\n", data)
+	}
+
+	// Later ones are written in the background.
+	e.export("ctr0", []byte("A=2\n"))
+	e.export("ctr0", []byte("A=3\n"))
+	waitFor("A=3\n")
+
+	// Forgetting a container writes the next export synchronously again.
+	e.forget("ctr0")
+	e.export("ctr0", []byte("A=4\n"))
+	if data := read(); data != "A=4\n" {
+		t.Errorf("expected exported data %q, got %q", "A=4\n", data)
+	}
+}
+
+func TestExporterFailedWrite(t *testing.T) {
+	cch, err := cache.NewCache(cache.Options{CacheDir: t.TempDir(), Ephemeral: true})
+	if err != nil {
+		t.Fatalf("failed to create cache: %v", err)
+	}
+
+	if _, err := cch.InsertPod(&nri.PodSandbox{Id: "pod0", Name: "pod0"}); err != nil {
+		t.Fatalf("failed to insert pod: %v", err)
+	}
+	if _, err := cch.InsertContainer(&nri.Container{Id: "ctr0", PodSandboxId: "pod0", Name: "ctr0"}); err != nil {
+		t.Fatalf("failed to insert container: %v", err)
+	}
+
+	defer func() { writeExportFn = writeExport }()
+
+	e := newExporter(cch)
+	e.once.Do(func() {}) // flush manually, without the background writer
+
+	e.export("ctr0", []byte("A=1\n"))
+	e.export("ctr0", []byte("A=2\n"))
+
+	// A newer export gets queued while the failing write is in progress.
+	writeExportFn = func(dir string, data []byte) error {
+		e.export("ctr0", []byte("A=3\n"))
+		return fmt.Errorf("failed to write %s", dir)
+	}
+	e.flush()
+
+	e.Lock()
+	p, queued := e.pending["ctr0"]
+	_, exported := e.last["ctr0"]
+	e.Unlock()
+
+	if !queued || string(p.data) != "A=3\n" {
+		t.Errorf("expected newer export to stay queued after a failed write")
+	}
+	if exported {
+		t.Errorf("expected failed export to be forgotten")
+	}
+
+	writeExportFn = writeExport
+	e.flush()
+
+	file := filepath.Join(cch.ContainerDirectory("ctr0"), ExportedResources)
+	if data, _ := os.ReadFile(file); string(data) != "A=3\n" {
+		t.Errorf("expected exported data %q, got %q", "A=3\n", string(data))
+	}
+}
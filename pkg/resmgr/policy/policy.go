@@ -28,6 +28,7 @@ import (
 	"github.com/containers/nri-plugins/pkg/resmgr/cache"
 	"github.com/containers/nri-plugins/pkg/resmgr/events"
 	"github.com/containers/nri-plugins/pkg/resmgr/introspect"
+	"github.com/containers/nri-plugins/pkg/resmgr/sampler"
 	"github.com/prometheus/client_golang/prometheus"
 
 	logger "github.com/containers/nri-plugins/pkg/log"
@@ -61,6 +62,8 @@ type ConstraintSet map[Domain]Constraint
 type Options struct {
 	// SendEvent is the function for delivering events back to the resource manager.
 	SendEvent SendEventFn
+	// Sampler is the shared sampling engine.
+	Sampler *sampler.Sampler
 }
 
 // BackendOptions describes the options for a policy backend instance
@@ -75,6 +78,8 @@ type BackendOptions struct {
 	Reserved ConstraintSet
 	// SendEvent is the function for delivering events up to the resource manager.
 	SendEvent SendEventFn
+	// Sampler provides shared samples of container CPU usage, if not nil.
+	Sampler *sampler.Sampler
 }
 
 // CreateFn is the type for functions used to create a policy instance.
@@ -184,6 +189,8 @@ const (
 	ReservedCPUsAttribute = "reserved cpuset"
 	// IsolatedCPUsAttribute is the attribute name for the assignable isolated CPU set
 	IsolatedCPUsAttribute = "isolated cpuset"
+	// ExclusiveCPUsAttribute is the attribute name for an exclusively assigned CPU set
+	ExclusiveCPUsAttribute = "exclusive cpuset"
 )
 
 // TopologyZone provides policy-/pool-specific data for 'node resource topology' CRs.
@@ -217,6 +224,7 @@ type policy struct {
 	system    system.System      // system/HW/topology info
 	inspsys   *introspect.System // ditto for introspection
 	sendEvent SendEventFn        // function to send event up to the resource manager
+	exporter  *exporter          // resource data exporter
 }
 
 // backend is a registered Backend.
@@ -261,9 +269,10 @@ func NewPolicy(cache cache.Cache, o *Options) (Policy, error) {
 	}
 
 	p := &policy{
-		cache:   cache,
-		system:  sys,
-		options: *o,
+		cache:    cache,
+		system:   sys,
+		options:  *o,
+		exporter: newExporter(cache),
 	}
 
 	selected := ActivePolicy()
@@ -296,6 +305,7 @@ func NewPolicy(cache cache.Cache, o *Options) (Policy, error) {
 	backendOpts.Available = opt.Available
 	backendOpts.Reserved = opt.Reserved
 	backendOpts.SendEvent = o.SendEvent
+	backendOpts.Sampler = o.Sampler
 
 	p.active = active.create(backendOpts)
 
@@ -320,6 +330,7 @@ func (p *policy) AllocateResources(c cache.Container) error {
 
 // ReleaseResources release resources of a container.
 func (p *policy) ReleaseResources(c cache.Container) error {
+	p.exporter.forget(c.GetID())
 	return p.active.ReleaseResources(c)
 }
 
@@ -359,7 +370,7 @@ func (p *policy) ExportResourceData(c cache.Container) {
 		}
 	}
 
-	p.cache.WriteFile(c.GetID(), ExportedResources, 0644, buf.Bytes())
+	p.exporter.export(c.GetID(), buf.Bytes())
 }
 
 // Introspect provides data for external introspection/visualization.
@@ -15,19 +15,43 @@
 package policycollector
 
 import (
+	"sync"
+
 	"github.com/containers/nri-plugins/pkg/metrics"
+	resmgrmetrics "github.com/containers/nri-plugins/pkg/resmgr/metrics"
 	"github.com/containers/nri-plugins/pkg/resmgr/policy"
 	"github.com/prometheus/client_golang/prometheus"
 )
 
+// StateLock is the lock protecting the policy state.
+type StateLock interface {
+	RLock()
+	TryRLock() bool
+	RUnlock()
+}
+
 type PolicyCollector struct {
+	sync.Mutex
 	policy policy.Policy
+	lock   StateLock
+	last   *snapshot
+}
+
+// snapshot is the last policy metrics polled.
+type snapshot struct {
+	metrics policy.Metrics
 }
 
 func (c *PolicyCollector) SetPolicy(policy policy.Policy) {
 	c.policy = policy
 }
 
+// SetStateLock sets the lock to hold while polling policy metrics. If the
+// lock is contended, the last polled metrics are served instead of waiting.
+func (c *PolicyCollector) SetStateLock(lock StateLock) {
+	c.lock = lock
+}
+
 // HasPolicySpecificMetrics judges whether the policy defines the policy-specific metrics
 func (c *PolicyCollector) HasPolicySpecificMetrics() bool {
 	if c.policy.DescribeMetrics() == nil {
@@ -45,7 +69,7 @@ func (c *PolicyCollector) Describe(ch chan<- *prometheus.Desc) {
 
 // Collect implements prometheus.Collector interface
 func (c *PolicyCollector) Collect(ch chan<- prometheus.Metric) {
-	prometheusMetrics, err := c.policy.CollectMetrics(c.policy.PollMetrics())
+	prometheusMetrics, err := c.policy.CollectMetrics(c.pollMetrics())
 	if err != nil {
 		return
 	}
@@ -54,6 +78,30 @@ func (c *PolicyCollector) Collect(ch chan<- prometheus.Metric) {
 	}
 }
 
+// pollMetrics polls policy metrics, or returns the last polled ones if the
+// state lock is contended.
+func (c *PolicyCollector) pollMetrics() policy.Metrics {
+	if c.lock == nil {
+		return c.policy.PollMetrics()
+	}
+
+	c.Lock()
+	defer c.Unlock()
+
+	if !c.lock.TryRLock() {
+		if c.last != nil {
+			resmgrmetrics.SnapshotServed(false)
+			return c.last.metrics
+		}
+		c.lock.RLock()
+	}
+	c.last = &snapshot{metrics: c.policy.PollMetrics()}
+	c.lock.RUnlock()
+
+	resmgrmetrics.SnapshotServed(true)
+	return c.last.metrics
+}
+
 // RegisterPolicyMetricsCollector registers policy-specific collector
 func (c *PolicyCollector) RegisterPolicyMetricsCollector() error {
 	return metrics.RegisterCollector("policyMetrics", func() (prometheus.Collector, error) {
@@ -18,13 +18,14 @@ import (
 	"fmt"
 	"os"
 	"os/signal"
+	"path/filepath"
 	"strings"
 	"sync"
-
-	//	"time"
+	"time"
 
 	"golang.org/x/sys/unix"
 
+	"github.com/containers/nri-plugins/pkg/cgroupstats"
 	pkgcfg "github.com/containers/nri-plugins/pkg/config"
 	"github.com/containers/nri-plugins/pkg/healthz"
 	"github.com/containers/nri-plugins/pkg/instrumentation"
@@ -35,9 +36,11 @@ import (
 	"github.com/containers/nri-plugins/pkg/resmgr/cache"
 	config "github.com/containers/nri-plugins/pkg/resmgr/config"
 	"github.com/containers/nri-plugins/pkg/resmgr/control"
+	rdtmonitor "github.com/containers/nri-plugins/pkg/resmgr/control/rdt-monitor"
 	"github.com/containers/nri-plugins/pkg/resmgr/introspect"
 	"github.com/containers/nri-plugins/pkg/resmgr/metrics"
 	"github.com/containers/nri-plugins/pkg/resmgr/policy"
+	"github.com/containers/nri-plugins/pkg/resmgr/sampler"
 	"github.com/containers/nri-plugins/pkg/sysfs"
 	"github.com/containers/nri-plugins/pkg/topology"
 	goresctrlpath "github.com/intel/goresctrl/pkg/path"
@@ -74,11 +77,14 @@ type resmgr struct {
 	signals      chan os.Signal     // signal channel
 	introspect   *introspect.Server // server for external introspection
 	nri          *nriPlugin         // NRI plugins, if we're running as such
+	sampler      *sampler.Sampler   // shared sampling engine
 	agent        agent.ResourceManagerAgent
 }
 
 const (
 	topologyLogger = "topology-hints"
+	// topologyCacheFile is the file in the state directory to cache system topology in.
+	topologyCacheFile = "topology.cache"
 )
 
 // NewResourceManager creates a new ResourceManager instance.
@@ -90,7 +96,11 @@ func NewResourceManager() (ResourceManager, error) {
 	}
 
 	sysfs.SetSysRoot(opt.HostRoot)
+	if !opt.DisableTopoCache {
+		sysfs.SetTopologyCache(filepath.Join(opt.StateDir, topologyCacheFile))
+	}
 	topology.SetSysRoot(opt.HostRoot)
+	rdtmonitor.SetSysRoot(opt.HostRoot)
 	topology.SetLogger(logger.Get(topologyLogger))
 
 	if opt.HostRoot != "" {
@@ -112,6 +122,13 @@ func NewResourceManager() (ResourceManager, error) {
 		return nil, err
 	}
 
+	m.sampler = sampler.New(sampler.Options{
+		MinInterval: opt.MetricsTimer,
+		MaxInterval: opt.MetricsMaxTimer,
+	})
+	cgroupstats.SetUsageSource(m.sampler)
+	rdtmonitor.SetSampler(m.sampler)
+
 	if err := m.setupPolicy(); err != nil {
 		return nil, err
 	}
@@ -145,8 +162,8 @@ func NewResourceManager() (ResourceManager, error) {
 func (m *resmgr) Start() error {
 	m.Info("starting...")
 
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock("start")
+	defer unlock()
 
 	if err := m.nri.start(); err != nil {
 		return err
@@ -193,8 +210,8 @@ func (m *resmgr) Start() error {
 func (m *resmgr) Stop() {
 	m.Info("shutting down...")
 
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock("stop")
+	defer unlock()
 
 	if m.signals != nil {
 		close(m.signals)
@@ -204,11 +221,29 @@ func (m *resmgr) Stop() {
 	m.nri.stop()
 }
 
+// lock acquires the resource manager lock for holder, returning the function
+// to release it with. The time spent waiting for and holding the lock is
+// recorded per holder.
+func (m *resmgr) lock(holder string) func() {
+	start := time.Now()
+	m.Lock()
+	acquired := time.Now()
+	metrics.ObserveLockWait(holder, acquired.Sub(start))
+
+	return func() {
+		metrics.ObserveLockHold(holder, time.Since(acquired))
+		m.Unlock()
+	}
+}
+
 // setupCache creates a cache and reloads its last saved state if found.
 func (m *resmgr) setupCache() error {
 	var err error
 
-	options := cache.Options{CacheDir: opt.StateDir}
+	options := cache.Options{
+		CacheDir:  opt.StateDir,
+		Ephemeral: opt.EphemeralCache,
+	}
 	if m.cache, err = cache.NewCache(options); err != nil {
 		return resmgrError("failed to create cache: %v", err)
 	}
@@ -258,7 +293,10 @@ func (m *resmgr) setupPolicy() error {
 		m.policySwitch = true
 	}
 
-	options := &policy.Options{SendEvent: m.SendEvent}
+	options := &policy.Options{
+		SendEvent: m.SendEvent,
+		Sampler:   m.sampler,
+	}
 	if m.policy, err = policy.NewPolicy(m.cache, options); err != nil {
 		return resmgrError("failed to create policy %s: %v", active, err)
 	}
@@ -378,6 +416,7 @@ func (m *resmgr) stopAgent() {
 func (m *resmgr) registerPolicyMetricsCollector() error {
 	pc := &policyCollector.PolicyCollector{}
 	pc.SetPolicy(m.policy)
+	pc.SetStateLock(&m.RWMutex)
 	if pc.HasPolicySpecificMetrics() {
 		return pc.RegisterPolicyMetricsCollector()
 	}
@@ -463,8 +502,8 @@ func (m *resmgr) setConfigFromFile(path string) error {
 func (m *resmgr) setConfig(v interface{}) error {
 	var err error
 
-	m.Lock()
-	defer m.Unlock()
+	unlock := m.lock("config")
+	defer unlock()
 
 	switch cfg := v.(type) {
 	case config.RawConfig:
@@ -490,10 +529,7 @@ func (m *resmgr) setConfig(v interface{}) error {
 		m.cache.SetConfig(cfg)
 	}
 
-	err = m.nri.updateContainers()
-	if err != nil {
-		m.Warn("failed to update containers for new configuration: %v", err)
-	}
+	m.nri.updateContainers()
 
 	return nil
 }
@@ -548,7 +584,9 @@ func (m *resmgr) rebalance(method string) error {
 	}
 
 	if changes {
-		// TODO: fix this
+		// Send all updates of a rebalancing cycle in a single batch.
+		m.nri.updateContainers()
+		m.updateTopologyZones()
 	}
 
 	return m.cache.Save()
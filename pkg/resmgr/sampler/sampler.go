@@ -0,0 +1,340 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Package sampler implements a shared sampling engine. It reads the CPU and
+// memory usage of tracked containers once per sampling round, keeping CPU
+// usage in per-container ring buffers, and runs any registered sources in
+// the same round, so that consumers share a single set of samples instead
+// of each re-reading the same cgroup and sysfs files. The sampling interval
+// adapts to activity: rounds happen at the minimum interval during container
+// churn and back off towards the maximum interval while the node stays idle.
+package sampler
+
+import (
+	"sync"
+	"time"
+
+	"github.com/containers/nri-plugins/pkg/cgroups"
+	logger "github.com/containers/nri-plugins/pkg/log"
+)
+
+const (
+	// DefaultDepth is the default number of samples kept per container.
+	DefaultDepth = 8
+	// maxIntervalFactor is the default maximum interval relative to the minimum.
+	maxIntervalFactor = 8
+)
+
+// Options for the sampler.
+type Options struct {
+	// MinInterval is the sampling interval during churn. 0 disables sampling.
+	MinInterval time.Duration
+	// MaxInterval is the longest interval sampling backs off to when idle.
+	MaxInterval time.Duration
+	// Depth is the number of samples kept per container.
+	Depth int
+}
+
+// SourceFn is a function reading a source once per sampling round.
+type SourceFn func(now time.Time)
+
+// Sampler is the shared sampling engine.
+type Sampler struct {
+	sync.RWMutex
+	opts     Options
+	sources  []*source
+	tracked  map[string]*ring
+	interval time.Duration
+	churn    bool
+	poke     chan struct{}
+	stop     chan struct{}
+}
+
+// source is a registered sample source.
+type source struct {
+	name string
+	fn   SourceFn
+}
+
+// ring is a ring buffer of CPU usage samples of a cgroup.
+type ring struct {
+	dir     string
+	samples []sample
+	next    int
+	count   int
+	latest  *cgroups.Usage // usage read in the latest round, if any
+}
+
+// sample is a single CPU usage sample.
+type sample struct {
+	taken time.Time
+	usage time.Duration
+}
+
+// Functions used to take samples, overridable for testing.
+var (
+	getUsage = cgroups.GetUsage
+	timeNow  = time.Now
+)
+
+var log = logger.NewLogger("sampler")
+
+// New creates a new sampler with the given options.
+func New(opts Options) *Sampler {
+	if opts.Depth < 2 {
+		opts.Depth = DefaultDepth
+	}
+	if opts.MaxInterval < opts.MinInterval {
+		opts.MaxInterval = maxIntervalFactor * opts.MinInterval
+	}
+
+	return &Sampler{
+		opts:     opts,
+		tracked:  make(map[string]*ring),
+		interval: opts.MinInterval,
+		poke:     make(chan struct{}, 1),
+	}
+}
+
+// AddSource registers a source to sample once per sampling round.
+func (s *Sampler) AddSource(name string, fn SourceFn) {
+	s.Lock()
+	defer s.Unlock()
+	s.sources = append(s.sources, &source{name: name, fn: fn})
+}
+
+// Track starts sampling the CPU usage of a container in the given cgroup.
+func (s *Sampler) Track(id, dir string) {
+	if s == nil || dir == "" {
+		return
+	}
+
+	s.Lock()
+	defer s.Unlock()
+
+	if r, ok := s.tracked[id]; ok && r.dir == dir {
+		return
+	}
+	s.tracked[id] = &ring{
+		dir:     dir,
+		samples: make([]sample, s.opts.Depth),
+	}
+}
+
+// Untrack stops sampling the CPU usage of the given container.
+func (s *Sampler) Untrack(id string) {
+	if s == nil {
+		return
+	}
+
+	s.Lock()
+	defer s.Unlock()
+	delete(s.tracked, id)
+}
+
+// Poke notes container churn, switching sampling to the minimum interval.
+func (s *Sampler) Poke() {
+	if s == nil {
+		return
+	}
+
+	s.Lock()
+	s.churn = true
+	s.Unlock()
+
+	select {
+	case s.poke <- struct{}{}:
+	default:
+	}
+}
+
+// CPUUsage returns the CPU usage of a container in milli-CPUs, averaged
+// over the latest samples spanning at most the given window. It returns
+// false if there are not enough samples for the container.
+func (s *Sampler) CPUUsage(id string, window time.Duration) (int, bool) {
+	if s == nil {
+		return 0, false
+	}
+
+	s.RLock()
+	defer s.RUnlock()
+
+	r, ok := s.tracked[id]
+	if !ok || r.count < 2 {
+		return 0, false
+	}
+
+	newest := r.at(0)
+	oldest := newest
+	for i := 1; i < r.count; i++ {
+		smpl := r.at(i)
+		if window > 0 && newest.taken.Sub(smpl.taken) > window {
+			break
+		}
+		oldest = smpl
+	}
+
+	elapsed := newest.taken.Sub(oldest.taken)
+	if elapsed <= 0 || newest.usage < oldest.usage {
+		return 0, false
+	}
+
+	return int(1000*float64(newest.usage-oldest.usage)/float64(elapsed) + 0.5), true
+}
+
+// Usage returns the CPU and memory usage of a container read in the latest
+// sampling round. It returns false if that round failed to read it.
+func (s *Sampler) Usage(id string) (cgroups.Usage, bool) {
+	if s == nil {
+		return cgroups.Usage{}, false
+	}
+
+	s.RLock()
+	defer s.RUnlock()
+
+	r, ok := s.tracked[id]
+	if !ok || r.latest == nil {
+		return cgroups.Usage{}, false
+	}
+	return *r.latest, true
+}
+
+// Interval returns the current sampling interval.
+func (s *Sampler) Interval() time.Duration {
+	s.RLock()
+	defer s.RUnlock()
+	return s.interval
+}
+
+// Start starts periodic sampling.
+func (s *Sampler) Start() {
+	if s.opts.MinInterval <= 0 {
+		log.Info("periodic sampling is disabled")
+		return
+	}
+	if s.stop != nil {
+		return
+	}
+
+	log.Info("sampling every %v...%v", s.opts.MinInterval, s.opts.MaxInterval)
+
+	s.stop = make(chan struct{})
+	go s.run(s.stop)
+}
+
+// Stop stops periodic sampling.
+func (s *Sampler) Stop() {
+	if s.stop != nil {
+		close(s.stop)
+		s.stop = nil
+	}
+}
+
+func (s *Sampler) run(stop chan struct{}) {
+	timer := time.NewTimer(s.Interval())
+	defer timer.Stop()
+
+	for {
+		select {
+		case <-stop:
+			return
+
+		case <-s.poke:
+			// Cut an idle back-off short when churn starts.
+			if s.Interval() > s.opts.MinInterval {
+				if !timer.Stop() {
+					<-timer.C
+				}
+				timer.Reset(0)
+			}
+
+		case <-timer.C:
+			s.Sample()
+			timer.Reset(s.adjustInterval())
+		}
+	}
+}
+
+// adjustInterval updates the sampling interval after a round, resetting it
+// to the minimum after churn and doubling it otherwise.
+func (s *Sampler) adjustInterval() time.Duration {
+	s.Lock()
+	defer s.Unlock()
+
+	if s.churn {
+		s.interval = s.opts.MinInterval
+	} else {
+		s.interval *= 2
+		if s.interval > s.opts.MaxInterval {
+			s.interval = s.opts.MaxInterval
+		}
+	}
+	s.churn = false
+
+	return s.interval
+}
+
+// Sample runs a single sampling round.
+func (s *Sampler) Sample() {
+	now := timeNow()
+
+	s.RLock()
+	dirs := make(map[string]string, len(s.tracked))
+	for id, r := range s.tracked {
+		dirs[id] = r.dir
+	}
+	sources := s.sources
+	s.RUnlock()
+
+	usages := make(map[string]*cgroups.Usage, len(dirs))
+	for id, dir := range dirs {
+		usage, err := getUsage(dir)
+		if err != nil {
+			log.Debug("failed to sample usage of %s: %v", id, err)
+			usages[id] = nil
+			continue
+		}
+		usages[id] = &usage
+	}
+
+	s.Lock()
+	for id, usage := range usages {
+		if r, ok := s.tracked[id]; ok && r.dir == dirs[id] {
+			r.latest = usage
+			if usage != nil {
+				r.push(sample{taken: now, usage: usage.CPU})
+			}
+		}
+	}
+	s.Unlock()
+
+	for _, src := range sources {
+		src.fn(now)
+	}
+}
+
+// push adds a sample, overwriting the oldest one if the ring is full.
+func (r *ring) push(smpl sample) {
+	r.samples[r.next] = smpl
+	r.next = (r.next + 1) % len(r.samples)
+	if r.count < len(r.samples) {
+		r.count++
+	}
+}
+
+// at returns the sample taken age samples before the newest one.
+func (r *ring) at(age int) sample {
+	idx := (r.next - 1 - age + 2*len(r.samples)) % len(r.samples)
+	return r.samples[idx]
+}
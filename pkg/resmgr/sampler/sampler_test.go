@@ -0,0 +1,129 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package sampler
+
+import (
+	"fmt"
+	"testing"
+	"time"
+
+	"github.com/containers/nri-plugins/pkg/cgroups"
+)
+
+func TestSampler(t *testing.T) {
+	var (
+		now   = time.Unix(1000, 0)
+		usage = map[string]time.Duration{}
+		reads = 0
+	)
+
+	getUsage = func(dir string) (cgroups.Usage, error) {
+		reads++
+		u, ok := usage[dir]
+		if !ok {
+			return cgroups.Usage{}, fmt.Errorf("no cgroup %s", dir)
+		}
+		return cgroups.Usage{CPU: u, Memory: &cgroups.MemoryUsage{Bytes: int64(u / time.Millisecond)}}, nil
+	}
+	timeNow = func() time.Time { return now }
+
+	s := New(Options{MinInterval: time.Second, Depth: 4})
+
+	polled := 0
+	s.AddSource("test", func(time.Time) { polled++ })
+
+	s.Track("ctr0", "ctr0.scope")
+	s.Track("ctr1", "ctr1.scope")
+	usage["ctr0.scope"] = 0
+	usage["ctr1.scope"] = 0
+
+	// Take 5 samples, ctr0 using 500m and ctr1 2 CPUs first, then 1 CPU.
+	for i := 0; i < 5; i++ {
+		s.Sample()
+		now = now.Add(time.Second)
+		usage["ctr0.scope"] += 500 * time.Millisecond
+		if i < 2 {
+			usage["ctr1.scope"] += 2 * time.Second
+		} else {
+			usage["ctr1.scope"] += time.Second
+		}
+	}
+
+	if reads != 10 || polled != 5 {
+		t.Errorf("expected 10 reads and 5 polls, got %d, %d", reads, polled)
+	}
+
+	for _, tc := range []struct {
+		id     string
+		window time.Duration
+		usage  int
+		ok     bool
+	}{
+		{id: "ctr0", usage: 500, ok: true},
+		{id: "ctr0", window: time.Second, usage: 500, ok: true},
+		{id: "ctr1", window: time.Second, usage: 1000, ok: true},
+		{id: "ctr1", window: 2 * time.Second, usage: 1000, ok: true},
+		// Only the last 4 samples are kept, the oldest is 3 seconds old.
+		{id: "ctr1", usage: 1333, ok: true},
+		{id: "ctr1", window: time.Hour, usage: 1333, ok: true},
+		{id: "ctr1", window: time.Millisecond, ok: false},
+		{id: "ctr2", ok: false},
+	} {
+		usage, ok := s.CPUUsage(tc.id, tc.window)
+		if ok != tc.ok || usage != tc.usage {
+			t.Errorf("%s, window %v: expected usage %d (%v), got %d (%v)",
+				tc.id, tc.window, tc.usage, tc.ok, usage, ok)
+		}
+	}
+
+	// The latest usage is available for other consumers.
+	if u, ok := s.Usage("ctr0"); !ok || u.CPU != 2*time.Second || u.Memory == nil || u.Memory.Bytes != 2000 {
+		t.Errorf("expected latest ctr0 usage of 2s CPU, 2000 bytes, got %+v (%v)", u, ok)
+	}
+	delete(usage, "ctr0.scope")
+	s.Sample()
+	if _, ok := s.Usage("ctr0"); ok {
+		t.Errorf("expected no latest usage for ctr0 after a failed read")
+	}
+
+	s.Untrack("ctr1")
+	if _, ok := s.CPUUsage("ctr1", 0); ok {
+		t.Errorf("expected no samples for untracked ctr1")
+	}
+
+	// Tracking with a new cgroup starts afresh.
+	s.Track("ctr0", "ctr0-new.scope")
+	if _, ok := s.CPUUsage("ctr0", 0); ok {
+		t.Errorf("expected no samples for ctr0 in a new cgroup")
+	}
+}
+
+func TestAdaptiveInterval(t *testing.T) {
+	s := New(Options{MinInterval: time.Second})
+
+	for _, expected := range []time.Duration{2, 4, 8, 8} {
+		if interval := s.adjustInterval(); interval != expected*time.Second {
+			t.Errorf("expected idle interval %v, got %v", expected*time.Second, interval)
+		}
+	}
+
+	s.Poke()
+	if interval := s.adjustInterval(); interval != time.Second {
+		t.Errorf("expected interval %v after churn, got %v", time.Second, interval)
+	}
+	if interval := s.adjustInterval(); interval != 2*time.Second {
+		t.Errorf("expected interval %v after idling, got %v", 2*time.Second, interval)
+	}
+}
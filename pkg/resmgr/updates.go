@@ -0,0 +1,328 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package resmgr
+
+import (
+	"time"
+
+	"github.com/containerd/nri/pkg/api"
+
+	logger "github.com/containers/nri-plugins/pkg/log"
+)
+
+// ctrResources is the subset of container resources we update.
+type ctrResources struct {
+	shares       *uint64
+	quota        *int64
+	period       *uint64
+	cpus         *string
+	mems         *string
+	memLimit     *int64
+	blockIOClass *string
+	rdtClass     *string
+}
+
+// updateCoalescer merges and deduplicates container updates.
+//
+// Every update is compared against the last resources known to be applied
+// to the container, and only fields which really change are kept. If update
+// batching is enabled, updates for containers other than the subject of the
+// request being processed are queued, merged with any earlier queued update
+// for the same container (last writer wins), and sent in a single batched
+// UpdateContainers request once the batching window expires.
+//
+// Notes: the coalescer must be used with the resmgr lock held.
+type updateCoalescer struct {
+	logger.Logger
+	window  time.Duration            // batching window, 0 for no batching
+	queued  map[string]*ctrResources // queued, merged updates
+	applied map[string]*ctrResources // last known applied resources
+	timer   *time.Timer              // timer for sending queued updates
+	flush   func()                   // function to send queued updates
+}
+
+func newUpdateCoalescer(log logger.Logger, window time.Duration, flush func()) *updateCoalescer {
+	return &updateCoalescer{
+		Logger:  log,
+		window:  window,
+		queued:  make(map[string]*ctrResources),
+		applied: make(map[string]*ctrResources),
+		flush:   flush,
+	}
+}
+
+// reply returns the updates to include in the reply to a request for subject.
+// With batching enabled any other updates are queued for sending later.
+func (u *updateCoalescer) reply(updates []*api.ContainerUpdate, subject string) []*api.ContainerUpdate {
+	u.queue(updates)
+
+	if u.window == 0 {
+		return u.takeAll()
+	}
+
+	if len(u.queued) > 0 && u.timer == nil {
+		u.timer = time.AfterFunc(u.window, u.flush)
+	}
+
+	if subject == "" {
+		return nil
+	}
+
+	return u.take(subject)
+}
+
+// replyAll returns all queued updates together with the given ones.
+func (u *updateCoalescer) replyAll(updates []*api.ContainerUpdate) []*api.ContainerUpdate {
+	u.queue(updates)
+	return u.takeAll()
+}
+
+// queue merges the given updates with any already queued ones.
+func (u *updateCoalescer) queue(updates []*api.ContainerUpdate) {
+	for _, update := range updates {
+		id := update.GetContainerId()
+		r := resourcesFromUpdate(update)
+		if q, ok := u.queued[id]; ok {
+			q.merge(r)
+		} else {
+			u.queued[id] = r
+		}
+	}
+}
+
+// take takes the queued update for the given container.
+func (u *updateCoalescer) take(id string) []*api.ContainerUpdate {
+	q, ok := u.queued[id]
+	if !ok {
+		return nil
+	}
+	delete(u.queued, id)
+
+	if update := u.apply(id, q); update != nil {
+		return []*api.ContainerUpdate{update}
+	}
+	return nil
+}
+
+// takeAll takes all queued updates.
+func (u *updateCoalescer) takeAll() []*api.ContainerUpdate {
+	if u.timer != nil {
+		u.timer.Stop()
+		u.timer = nil
+	}
+
+	updates := make([]*api.ContainerUpdate, 0, len(u.queued))
+	for id, q := range u.queued {
+		if update := u.apply(id, q); update != nil {
+			updates = append(updates, update)
+		}
+	}
+	u.queued = make(map[string]*ctrResources)
+
+	return updates
+}
+
+// apply filters out the already applied parts of an update and records the rest applied.
+func (u *updateCoalescer) apply(id string, r *ctrResources) *api.ContainerUpdate {
+	a, ok := u.applied[id]
+	if !ok {
+		a = &ctrResources{}
+		u.applied[id] = a
+	}
+
+	r = r.diff(a)
+	if r.isEmpty() {
+		u.Debug("omitting no-op update for container %s", id)
+		return nil
+	}
+	a.merge(r)
+
+	return r.toUpdate(id)
+}
+
+// setApplied records the given resources as applied to the container.
+func (u *updateCoalescer) setApplied(id string, r *api.LinuxResources) {
+	a, ok := u.applied[id]
+	if !ok {
+		a = &ctrResources{}
+		u.applied[id] = a
+	}
+	a.merge(resourcesFromLinux(r))
+}
+
+// forget drops any queued updates and applied resources for the container.
+func (u *updateCoalescer) forget(id string) {
+	delete(u.queued, id)
+	delete(u.applied, id)
+}
+
+// forgetApplied drops applied resources for the given updates, for instance after a failure.
+func (u *updateCoalescer) forgetApplied(updates []*api.ContainerUpdate) {
+	for _, update := range updates {
+		delete(u.applied, update.GetContainerId())
+	}
+}
+
+// reset drops all queued updates and applied resources.
+func (u *updateCoalescer) reset() {
+	if u.timer != nil {
+		u.timer.Stop()
+		u.timer = nil
+	}
+	u.queued = make(map[string]*ctrResources)
+	u.applied = make(map[string]*ctrResources)
+}
+
+func resourcesFromUpdate(u *api.ContainerUpdate) *ctrResources {
+	return resourcesFromLinux(u.GetLinux().GetResources())
+}
+
+func resourcesFromLinux(l *api.LinuxResources) *ctrResources {
+	r := &ctrResources{}
+	if l == nil {
+		return r
+	}
+
+	if cpu := l.GetCpu(); cpu != nil {
+		if v := cpu.GetShares(); v != nil {
+			shares := v.GetValue()
+			r.shares = &shares
+		}
+		if v := cpu.GetQuota(); v != nil {
+			quota := v.GetValue()
+			r.quota = &quota
+		}
+		if v := cpu.GetPeriod(); v != nil {
+			period := v.GetValue()
+			r.period = &period
+		}
+		if v := cpu.GetCpus(); v != "" {
+			r.cpus = &v
+		}
+		if v := cpu.GetMems(); v != "" {
+			r.mems = &v
+		}
+	}
+	if mem := l.GetMemory(); mem != nil {
+		if v := mem.GetLimit(); v != nil {
+			limit := v.GetValue()
+			r.memLimit = &limit
+		}
+	}
+	if v := l.GetBlockioClass(); v != nil {
+		class := v.GetValue()
+		r.blockIOClass = &class
+	}
+	if v := l.GetRdtClass(); v != nil {
+		class := v.GetValue()
+		r.rdtClass = &class
+	}
+
+	return r
+}
+
+// merge merges newer resources into r, newer values taking precedence.
+func (r *ctrResources) merge(o *ctrResources) {
+	if o.shares != nil {
+		r.shares = o.shares
+	}
+	if o.quota != nil {
+		r.quota = o.quota
+	}
+	if o.period != nil {
+		r.period = o.period
+	}
+	if o.cpus != nil {
+		r.cpus = o.cpus
+	}
+	if o.mems != nil {
+		r.mems = o.mems
+	}
+	if o.memLimit != nil {
+		r.memLimit = o.memLimit
+	}
+	if o.blockIOClass != nil {
+		r.blockIOClass = o.blockIOClass
+	}
+	if o.rdtClass != nil {
+		r.rdtClass = o.rdtClass
+	}
+}
+
+// diff returns the resources in r which differ from the applied ones.
+func (r *ctrResources) diff(applied *ctrResources) *ctrResources {
+	d := &ctrResources{}
+	if r.shares != nil && (applied.shares == nil || *r.shares != *applied.shares) {
+		d.shares = r.shares
+	}
+	if r.quota != nil && (applied.quota == nil || *r.quota != *applied.quota) {
+		d.quota = r.quota
+	}
+	if r.period != nil && (applied.period == nil || *r.period != *applied.period) {
+		d.period = r.period
+	}
+	if r.cpus != nil && (applied.cpus == nil || *r.cpus != *applied.cpus) {
+		d.cpus = r.cpus
+	}
+	if r.mems != nil && (applied.mems == nil || *r.mems != *applied.mems) {
+		d.mems = r.mems
+	}
+	if r.memLimit != nil && (applied.memLimit == nil || *r.memLimit != *applied.memLimit) {
+		d.memLimit = r.memLimit
+	}
+	if r.blockIOClass != nil && (applied.blockIOClass == nil || *r.blockIOClass != *applied.blockIOClass) {
+		d.blockIOClass = r.blockIOClass
+	}
+	if r.rdtClass != nil && (applied.rdtClass == nil || *r.rdtClass != *applied.rdtClass) {
+		d.rdtClass = r.rdtClass
+	}
+	return d
+}
+
+func (r *ctrResources) isEmpty() bool {
+	return r.shares == nil && r.quota == nil && r.period == nil &&
+		r.cpus == nil && r.mems == nil && r.memLimit == nil &&
+		r.blockIOClass == nil && r.rdtClass == nil
+}
+
+// toUpdate creates a container update for the resources.
+func (r *ctrResources) toUpdate(id string) *api.ContainerUpdate {
+	u := &api.ContainerUpdate{ContainerId: id}
+	if r.shares != nil {
+		u.SetLinuxCPUShares(*r.shares)
+	}
+	if r.quota != nil {
+		u.SetLinuxCPUQuota(*r.quota)
+	}
+	if r.period != nil {
+		u.SetLinuxCPUPeriod(int64(*r.period))
+	}
+	if r.cpus != nil {
+		u.SetLinuxCPUSetCPUs(*r.cpus)
+	}
+	if r.mems != nil {
+		u.SetLinuxCPUSetMems(*r.mems)
+	}
+	if r.memLimit != nil {
+		u.SetLinuxMemoryLimit(*r.memLimit)
+	}
+	if r.blockIOClass != nil {
+		u.SetLinuxBlockIOClass(*r.blockIOClass)
+	}
+	if r.rdtClass != nil {
+		u.SetLinuxRDTClass(*r.rdtClass)
+	}
+	return u
+}
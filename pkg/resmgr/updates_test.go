@@ -0,0 +1,178 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package resmgr
+
+import (
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/containerd/nri/pkg/api"
+	"github.com/containerd/nri/pkg/stub"
+
+	logger "github.com/containers/nri-plugins/pkg/log"
+)
+
+func makeUpdate(id, cpus, mems string) *api.ContainerUpdate {
+	u := &api.ContainerUpdate{ContainerId: id}
+	if cpus != "" {
+		u.SetLinuxCPUSetCPUs(cpus)
+	}
+	if mems != "" {
+		u.SetLinuxCPUSetMems(mems)
+	}
+	return u
+}
+
+func TestUpdateDeduplication(t *testing.T) {
+	u := newUpdateCoalescer(logger.Get("test"), 0, func() {})
+
+	updates := u.reply([]*api.ContainerUpdate{makeUpdate("ctr0", "0-3", "0")}, "")
+	if len(updates) != 1 {
+		t.Fatalf("expected 1 update, got %d", len(updates))
+	}
+
+	updates = u.reply([]*api.ContainerUpdate{makeUpdate("ctr0", "0-3", "0")}, "")
+	if len(updates) != 0 {
+		t.Fatalf("expected no-op update to be omitted, got %d updates", len(updates))
+	}
+
+	updates = u.reply([]*api.ContainerUpdate{makeUpdate("ctr0", "0-3", "1")}, "")
+	if len(updates) != 1 {
+		t.Fatalf("expected 1 update, got %d", len(updates))
+	}
+	cpu := updates[0].GetLinux().GetResources().GetCpu()
+	if cpu.GetCpus() != "" || cpu.GetMems() != "1" {
+		t.Errorf("expected only changed mems, got cpus %q, mems %q", cpu.GetCpus(), cpu.GetMems())
+	}
+
+	u.forget("ctr0")
+	updates = u.reply([]*api.ContainerUpdate{makeUpdate("ctr0", "0-3", "1")}, "")
+	if len(updates) != 1 {
+		t.Fatalf("expected 1 update for forgotten container, got %d", len(updates))
+	}
+}
+
+func TestUpdateBatching(t *testing.T) {
+	u := newUpdateCoalescer(logger.Get("test"), time.Hour, func() {})
+
+	updates := u.reply([]*api.ContainerUpdate{
+		makeUpdate("ctr0", "0-3", ""),
+		makeUpdate("ctr1", "4-7", ""),
+	}, "ctr1")
+	if len(updates) != 1 || updates[0].GetContainerId() != "ctr1" {
+		t.Fatalf("expected only update for subject ctr1, got %v", updates)
+	}
+
+	updates = u.reply([]*api.ContainerUpdate{
+		makeUpdate("ctr0", "0-5", "0"),
+	}, "")
+	if len(updates) != 0 {
+		t.Fatalf("expected updates to be queued, got %d", len(updates))
+	}
+
+	updates = u.takeAll()
+	if len(updates) != 1 {
+		t.Fatalf("expected 1 coalesced update, got %d", len(updates))
+	}
+	cpu := updates[0].GetLinux().GetResources().GetCpu()
+	if cpu.GetCpus() != "0-5" || cpu.GetMems() != "0" {
+		t.Errorf("expected coalesced cpus 0-5, mems 0, got cpus %q, mems %q",
+			cpu.GetCpus(), cpu.GetMems())
+	}
+	if u.timer != nil {
+		t.Errorf("expected batching timer to be stopped")
+	}
+}
+
+// slowStub blocks the first UpdateContainers request until released.
+type slowStub struct {
+	stub.Stub
+	sync.Mutex
+	calls   int
+	entered chan struct{}
+	release chan struct{}
+	cpus    map[string]string
+}
+
+func (s *slowStub) UpdateContainers(updates []*api.ContainerUpdate) ([]*api.ContainerUpdate, error) {
+	s.Lock()
+	s.calls++
+	first := s.calls == 1
+	s.Unlock()
+
+	if first {
+		close(s.entered)
+		<-s.release
+	}
+
+	s.Lock()
+	defer s.Unlock()
+	for _, u := range updates {
+		if cpus := u.GetLinux().GetResources().GetCpu().GetCpus(); cpus != "" {
+			s.cpus[u.GetContainerId()] = cpus
+		}
+	}
+	return nil, nil
+}
+
+func TestOverlappingFlushes(t *testing.T) {
+	s := &slowStub{
+		entered: make(chan struct{}),
+		release: make(chan struct{}),
+		cpus:    map[string]string{},
+	}
+	p := &nriPlugin{
+		Logger: logger.Get("test"),
+		resmgr: &resmgr{},
+		stub:   s,
+	}
+	p.updates = newUpdateCoalescer(p.Logger, time.Hour, p.flushUpdates)
+
+	queue := func(cpus string) {
+		unlock := p.resmgr.lock("test")
+		p.updates.queue([]*api.ContainerUpdate{makeUpdate("ctr0", cpus, "")})
+		unlock()
+	}
+	flush := func() chan struct{} {
+		done := make(chan struct{})
+		go func() {
+			p.flushUpdates()
+			close(done)
+		}()
+		return done
+	}
+
+	queue("0-3")
+	done1 := flush()
+	<-s.entered
+
+	queue("4-7")
+	done2 := flush()
+
+	select {
+	case <-done2:
+		t.Errorf("expected second flush to wait for the first one")
+	case <-time.After(50 * time.Millisecond):
+	}
+
+	close(s.release)
+	<-done1
+	<-done2
+
+	if cpus := s.cpus["ctr0"]; cpus != "4-7" {
+		t.Errorf("expected final cpus 4-7, got %q", cpus)
+	}
+}
@@ -15,9 +15,13 @@
 package sysfs
 
 import (
+	"bytes"
+	"io"
 	"io/ioutil"
+	"os"
 	"strconv"
 	"strings"
+	"sync"
 )
 
 // unit multipliers
@@ -166,3 +170,151 @@ func ParseFileEntries(path string, values map[string]interface{}, pickFn PickEnt
 
 	return nil
 }
+
+// readBufPool is a pool of reusable buffers for reading sysfs files.
+var readBufPool = sync.Pool{
+	New: func() interface{} {
+		buf := make([]byte, 0, 4096)
+		return &buf
+	},
+}
+
+// readFileWith reads a sysfs file into a pooled buffer, passing the content to fn.
+// The content is only valid until fn returns.
+func readFileWith(path string, fn func([]byte) error) error {
+	f, err := os.Open(path)
+	if err != nil {
+		return sysfsError(path, "failed to open file: %v", err)
+	}
+	defer f.Close()
+
+	bufp := readBufPool.Get().(*[]byte)
+	defer readBufPool.Put(bufp)
+
+	buf := (*bufp)[:0]
+	for {
+		if len(buf) == cap(buf) {
+			buf = append(buf, 0)[:len(buf)]
+		}
+		n, err := f.Read(buf[len(buf):cap(buf)])
+		buf = buf[:len(buf)+n]
+		if err != nil {
+			if err == io.EOF {
+				break
+			}
+			*bufp = buf
+			return sysfsError(path, "failed to read file: %v", err)
+		}
+	}
+	*bufp = buf
+
+	return fn(buf)
+}
+
+// splitFields splits line into whitespace-separated fields, filling at most len(fields).
+func splitFields(line []byte, fields [][]byte) int {
+	n := 0
+	for n < len(fields) {
+		line = bytes.TrimLeft(line, " \t")
+		if len(line) == 0 {
+			break
+		}
+		end := bytes.IndexAny(line, " \t")
+		if end < 0 {
+			end = len(line)
+		}
+		fields[n] = line[:end]
+		line = line[end:]
+		n++
+	}
+	return n
+}
+
+// parseUint parses an unsigned decimal integer.
+func parseUint(b []byte) (uint64, bool) {
+	if len(b) == 0 {
+		return 0, false
+	}
+	var n uint64
+	for _, c := range b {
+		if c < '0' || c > '9' {
+			return 0, false
+		}
+		d := uint64(c - '0')
+		if n > (^uint64(0)-d)/10 {
+			return 0, false
+		}
+		n = n*10 + d
+	}
+	return n, true
+}
+
+// parseNodeMemInfo parses MemTotal, MemFree and easily reclaimable memory
+// from per-node meminfo content.
+func parseNodeMemInfo(path string, data []byte, buf *MemInfo) error {
+
+	// File looks like this:
+	//
+	// Node 0 MemTotal:       32617588 kB
+	// Node 0 MemFree:        20777516 kB
+	// Node 0 MemUsed:        11840072 kB
+	// ...
+
+	var (
+		fields       [5][]byte
+		inactiveFile uint64
+		sreclaimable uint64
+	)
+
+	left := 4
+	for len(data) > 0 && left > 0 {
+		var line []byte
+		if i := bytes.IndexByte(data, '\n'); i >= 0 {
+			line, data = data[:i], data[i+1:]
+		} else {
+			line, data = data, nil
+		}
+
+		n := splitFields(line, fields[:])
+		if n == 0 {
+			continue
+		}
+		if n < 4 {
+			return sysfsError(path, "failed to parse entry: '%s'", line)
+		}
+
+		var ptr *uint64
+		switch string(fields[2]) {
+		case "MemTotal:":
+			ptr = &buf.MemTotal
+		case "MemFree:":
+			ptr = &buf.MemFree
+		case "Inactive(file):":
+			ptr = &inactiveFile
+		case "SReclaimable:":
+			ptr = &sreclaimable
+		default:
+			continue
+		}
+
+		value, ok := parseUint(fields[3])
+		if !ok {
+			return sysfsError(path, "invalid numeric value %s", fields[3])
+		}
+		if n == 5 {
+			unit, ok := units[string(fields[4])]
+			if !ok {
+				return sysfsError(path, "failed to parse '%s', invalid unit '%s'",
+					line, fields[4])
+			}
+			value *= uint64(unit)
+		}
+
+		*ptr = value
+		left--
+	}
+
+	buf.MemReclaimable = inactiveFile + sreclaimable
+
+	return nil
+}
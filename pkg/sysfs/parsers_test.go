@@ -0,0 +1,90 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package sysfs
+
+import (
+	"strings"
+	"testing"
+)
+
+const (
+	nodeFixture = "testdata/node0"
+)
+
+func TestNodeMemoryInfo(t *testing.T) {
+	n := &node{path: nodeFixture}
+
+	mem, err := n.MemoryInfo()
+	if err != nil {
+		t.Fatalf("failed to get node memory info: %v", err)
+	}
+
+	// Cross-check against the generic file entry parser.
+	var total, free, inactiveFile, sreclaimable uint64
+	err = ParseFileEntries(nodeFixture+"/meminfo",
+		map[string]interface{}{
+			"MemTotal:":       &total,
+			"MemFree:":        &free,
+			"Inactive(file):": &inactiveFile,
+			"SReclaimable:":   &sreclaimable,
+		},
+		func(line string) (string, string, error) {
+			fields := strings.Fields(line)
+			if len(fields) < 4 {
+				return "", "", nil
+			}
+			return fields[2], strings.Join(fields[3:], " "), nil
+		},
+	)
+	if err != nil {
+		t.Fatalf("failed to parse node meminfo: %v", err)
+	}
+
+	if mem.MemTotal != total || mem.MemFree != free || mem.MemUsed != total-free {
+		t.Errorf("expected total %d, free %d, got %+v", total, free, mem)
+	}
+	if mem.MemReclaimable != inactiveFile+sreclaimable {
+		t.Errorf("expected reclaimable %d, got %+v", inactiveFile+sreclaimable, mem)
+	}
+}
+
+func BenchmarkNodeMemoryInfo(b *testing.B) {
+	n := &node{path: nodeFixture}
+
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if _, err := n.MemoryInfo(); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
+
+func BenchmarkParseNodeMemInfo(b *testing.B) {
+	buf := &MemInfo{}
+	err := readFileWith(nodeFixture+"/meminfo", func(data []byte) error {
+		b.ReportAllocs()
+		b.ResetTimer()
+		for i := 0; i < b.N; i++ {
+			if err := parseNodeMemInfo(nodeFixture, data, buf); err != nil {
+				return err
+			}
+		}
+		return nil
+	})
+	if err != nil {
+		b.Fatal(err)
+	}
+}
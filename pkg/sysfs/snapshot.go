@@ -0,0 +1,251 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package sysfs
+
+import (
+	"bufio"
+	"crypto/sha256"
+	"encoding/gob"
+	"encoding/hex"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+
+	idset "github.com/intel/goresctrl/pkg/utils"
+)
+
+//
+// Discovering the topology of a large system walks and parses thousands of
+// sysfs entries. Since the topology only changes if CPUs or NUMA nodes are
+// hotplugged, onlined or offlined, or across reboots, we can cache it in a
+// snapshot file. A snapshot is keyed by a fingerprint of the online, present
+// and isolated CPU masks, the online NUMA node and memory masks, and the
+// kernel boot ID. Discovery uses a snapshot only if its fingerprint matches
+// that of the running system. Dynamic details, like SST configuration, EPP
+// and memory usage, are never cached but always read from sysfs.
+//
+
+const (
+	// snapshotMagic identifies topology snapshot files.
+	snapshotMagic = "nri-sysfs-topology"
+	// snapshotVersion is bumped whenever the snapshot format changes.
+	snapshotVersion = 1
+)
+
+var (
+	// File to cache discovered topology in, empty to disable caching.
+	snapshotFile = ""
+)
+
+// snapshot is the cached topology of a system.
+type snapshot struct {
+	Magic       string
+	Version     int
+	Fingerprint string
+	Threads     int
+	Offline     []idset.ID
+	Isolated    []idset.ID
+	CPUs        []cpuSnapshot
+	Nodes       []nodeSnapshot
+}
+
+// cpuSnapshot is the cached topology of a CPU.
+type cpuSnapshot struct {
+	ID       idset.ID
+	Pkg      idset.ID
+	Die      idset.ID
+	Node     idset.ID
+	Core     idset.ID
+	Threads  []idset.ID
+	L3       idset.ID
+	L3CPUs   []idset.ID
+	BaseFreq uint64
+	MinFreq  uint64
+	MaxFreq  uint64
+	Online   bool
+}
+
+// nodeSnapshot is the cached topology of a NUMA node.
+type nodeSnapshot struct {
+	ID         idset.ID
+	CPUs       []idset.ID
+	MemoryType MemoryType
+	NormalMem  bool
+	Distance   []int
+}
+
+// SetTopologyCache sets the file to cache discovered system topology in.
+// An empty path disables caching.
+func SetTopologyCache(path string) {
+	snapshotFile = path
+}
+
+// fingerprint returns the hardware fingerprint of the system for the given flags.
+func (sys *system) fingerprint(flags DiscoveryFlag) string {
+	h := sha256.New()
+	fmt.Fprintf(h, "%s/%d/%s/%x\n", snapshotMagic, snapshotVersion, sys.path, uint(flags))
+
+	for _, entry := range []string{
+		filepath.Join(sysfsCPUPath, "online"),
+		filepath.Join(sysfsCPUPath, "present"),
+		filepath.Join(sysfsCPUPath, "isolated"),
+		filepath.Join(sysfsNumaNodePath, "online"),
+		filepath.Join(sysfsNumaNodePath, "has_memory"),
+		filepath.Join(sysfsNumaNodePath, "has_normal_memory"),
+		filepath.Join("..", "proc", "sys", "kernel", "random", "boot_id"),
+	} {
+		// Missing entries are part of the fingerprint, too.
+		value, _ := readSysfsEntry(sys.path, entry, nil)
+		fmt.Fprintf(h, "%s=%s\n", entry, value)
+	}
+
+	return hex.EncodeToString(h.Sum(nil))
+}
+
+// restoreSnapshot restores discovered topology from a snapshot file if it
+// matches the given fingerprint.
+func (sys *system) restoreSnapshot(path, fingerprint string) error {
+	f, err := os.Open(path)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+
+	s := &snapshot{}
+	if err := gob.NewDecoder(bufio.NewReader(f)).Decode(s); err != nil {
+		return sysfsError(path, "failed to decode topology snapshot: %v", err)
+	}
+	if s.Magic != snapshotMagic || s.Version != snapshotVersion {
+		return sysfsError(path, "unsupported topology snapshot %q, version %d", s.Magic, s.Version)
+	}
+	if s.Fingerprint != fingerprint {
+		return sysfsError(path, "stale topology snapshot")
+	}
+
+	sys.threads = s.Threads
+	sys.offline = idset.NewIDSet(s.Offline...)
+	sys.isolated = idset.NewIDSet(s.Isolated...)
+
+	sys.cpus = make(map[idset.ID]*cpu, len(s.CPUs))
+	for _, c := range s.CPUs {
+		cpu := &cpu{
+			path:     filepath.Join(sys.path, sysfsCPUPath, fmt.Sprintf("cpu%d", c.ID)),
+			id:       c.ID,
+			pkg:      c.Pkg,
+			die:      c.Die,
+			node:     c.Node,
+			core:     c.Core,
+			threads:  idset.NewIDSet(c.Threads...),
+			l3:       c.L3,
+			baseFreq: c.BaseFreq,
+			freq:     CPUFreq{min: c.MinFreq, max: c.MaxFreq},
+			online:   c.Online,
+			isolated: sys.isolated.Has(c.ID),
+			sstClos:  -1,
+		}
+		if c.L3CPUs != nil {
+			cpu.l3cpus = idset.NewIDSet(c.L3CPUs...)
+		}
+		sys.cpus[cpu.id] = cpu
+	}
+
+	sys.nodes = make(map[idset.ID]*node, len(s.Nodes))
+	for _, n := range s.Nodes {
+		sys.nodes[n.ID] = &node{
+			path:       filepath.Join(sys.path, sysfsNumaNodePath, fmt.Sprintf("node%d", n.ID)),
+			id:         n.ID,
+			cpus:       idset.NewIDSet(n.CPUs...),
+			memoryType: n.MemoryType,
+			normalMem:  n.NormalMem,
+			distance:   n.Distance,
+		}
+	}
+
+	return nil
+}
+
+// saveSnapshot saves discovered topology to a snapshot file.
+func (sys *system) saveSnapshot(path, fingerprint string) error {
+	s := &snapshot{
+		Magic:       snapshotMagic,
+		Version:     snapshotVersion,
+		Fingerprint: fingerprint,
+		Threads:     sys.threads,
+		Offline:     sys.offline.SortedMembers(),
+		Isolated:    sys.isolated.SortedMembers(),
+		CPUs:        make([]cpuSnapshot, 0, len(sys.cpus)),
+		Nodes:       make([]nodeSnapshot, 0, len(sys.nodes)),
+	}
+
+	for _, id := range sys.CPUIDs() {
+		c := sys.cpus[id]
+		cs := cpuSnapshot{
+			ID:       c.id,
+			Pkg:      c.pkg,
+			Die:      c.die,
+			Node:     c.node,
+			Core:     c.core,
+			Threads:  c.threads.SortedMembers(),
+			L3:       c.l3,
+			BaseFreq: c.baseFreq,
+			MinFreq:  c.freq.min,
+			MaxFreq:  c.freq.max,
+			Online:   c.online,
+		}
+		if c.l3cpus != nil {
+			cs.L3CPUs = c.l3cpus.SortedMembers()
+		}
+		s.CPUs = append(s.CPUs, cs)
+	}
+
+	for _, id := range sys.NodeIDs() {
+		n := sys.nodes[id]
+		s.Nodes = append(s.Nodes, nodeSnapshot{
+			ID:         n.id,
+			CPUs:       n.cpus.SortedMembers(),
+			MemoryType: n.memoryType,
+			NormalMem:  n.normalMem,
+			Distance:   n.distance,
+		})
+	}
+
+	if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+		return sysfsError(path, "failed to create directory: %v", err)
+	}
+
+	tmp, err := ioutil.TempFile(filepath.Dir(path), "."+filepath.Base(path)+"-*")
+	if err != nil {
+		return sysfsError(path, "failed to create topology snapshot: %v", err)
+	}
+	defer os.Remove(tmp.Name())
+
+	w := bufio.NewWriter(tmp)
+	err = gob.NewEncoder(w).Encode(s)
+	if err == nil {
+		err = w.Flush()
+	}
+	if cerr := tmp.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(tmp.Name(), path)
+	}
+	if err != nil {
+		return sysfsError(path, "failed to save topology snapshot: %v", err)
+	}
+
+	return nil
+}
@@ -0,0 +1,121 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package sysfs
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// writeFakeSysfs writes a fake sysfs with a single NUMA node of 2 cores, 2 threads each.
+func writeFakeSysfs(t *testing.T, root string) {
+	files := map[string]string{
+		"devices/system/cpu/online":             "0-3",
+		"devices/system/cpu/present":            "0-3",
+		"devices/system/cpu/isolated":           "",
+		"devices/system/node/online":            "0",
+		"devices/system/node/has_memory":        "0",
+		"devices/system/node/has_normal_memory": "0",
+		"devices/system/node/node0/cpulist":     "0-3",
+		"devices/system/node/node0/distance":    "10",
+	}
+	for id := 0; id < 4; id++ {
+		cpu := fmt.Sprintf("devices/system/cpu/cpu%d/", id)
+		files[cpu+"topology/physical_package_id"] = "0"
+		files[cpu+"topology/die_id"] = "0"
+		files[cpu+"topology/core_id"] = fmt.Sprintf("%d", id/2)
+		files[cpu+"topology/thread_siblings_list"] = fmt.Sprintf("%d-%d", id/2*2, id/2*2+1)
+		files[cpu+"cpufreq/energy_performance_preference"] = "performance"
+		files[cpu+"node0/.keep"] = ""
+	}
+
+	for file, content := range files {
+		path := filepath.Join(root, file)
+		if err := os.MkdirAll(filepath.Dir(path), 0755); err != nil {
+			t.Fatalf("failed to create fake sysfs: %v", err)
+		}
+		if err := os.WriteFile(path, []byte(content+"\n"), 0644); err != nil {
+			t.Fatalf("failed to create fake sysfs: %v", err)
+		}
+	}
+}
+
+func TestTopologySnapshot(t *testing.T) {
+	var (
+		dir   = t.TempDir()
+		root  = filepath.Join(dir, "sys")
+		cache = filepath.Join(dir, "state", "topology.cache")
+	)
+
+	writeFakeSysfs(t, root)
+	SetTopologyCache(cache)
+	defer SetTopologyCache("")
+
+	discover := func() *system {
+		sys, err := DiscoverSystemAt(root)
+		if err != nil {
+			t.Fatalf("failed to discover fake sysfs: %v", err)
+		}
+		return sys.(*system)
+	}
+	setFile := func(file, content string) {
+		if err := os.WriteFile(filepath.Join(root, file), []byte(content+"\n"), 0644); err != nil {
+			t.Fatalf("failed to update fake sysfs: %v", err)
+		}
+	}
+
+	sys := discover()
+	if _, err := os.Stat(cache); err != nil {
+		t.Fatalf("expected topology cache %s, got error %v", cache, err)
+	}
+	if sys.CPUCount() != 4 || sys.NUMANodeCount() != 1 || sys.PackageCount() != 1 || sys.ThreadCount() != 2 {
+		t.Errorf("unexpected discovered topology: %d CPUs, %d nodes, %d packages, %d threads",
+			sys.CPUCount(), sys.NUMANodeCount(), sys.PackageCount(), sys.ThreadCount())
+	}
+
+	// A change which does not alter the fingerprint is not seen, the cache is used.
+	setFile("devices/system/cpu/cpu3/topology/core_id", "7")
+	sys = discover()
+	if core := sys.CPU(3).CoreID(); core != 1 {
+		t.Errorf("expected cached core ID 1 for CPU #3, got %d", core)
+	}
+	if threads := sys.CPU(3).ThreadCPUSet().String(); threads != "2-3" {
+		t.Errorf("expected cached thread siblings 2-3 for CPU #3, got %s", threads)
+	}
+	if cpus := sys.Node(0).CPUSet().String(); cpus != "0-3" {
+		t.Errorf("expected cached CPUs 0-3 for node #0, got %s", cpus)
+	}
+	if pkg := sys.Package(0).CPUSet().String(); pkg != "0-3" {
+		t.Errorf("expected CPUs 0-3 for package #0, got %s", pkg)
+	}
+
+	// EPP is never cached.
+	setFile("devices/system/cpu/cpu0/cpufreq/energy_performance_preference", "power")
+	if epp := sys.CPU(0).EPP(); epp != EPPPower {
+		t.Errorf("expected EPP %v for CPU #0, got %v", EPPPower, epp)
+	}
+
+	// A change in the fingerprint triggers rediscovery.
+	setFile("devices/system/cpu/isolated", "3")
+	sys = discover()
+	if core := sys.CPU(3).CoreID(); core != 7 {
+		t.Errorf("expected rediscovered core ID 7 for CPU #3, got %d", core)
+	}
+	if isolated := sys.Isolated().String(); isolated != "3" {
+		t.Errorf("expected isolated CPUs 3, got %s", isolated)
+	}
+}
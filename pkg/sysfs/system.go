@@ -17,10 +17,12 @@ package sysfs
 import (
 	"fmt"
 	"io/ioutil"
+	"os"
 	"path/filepath"
 	"sort"
 	"strconv"
 	"strings"
+	"sync"
 
 	"github.com/containers/nri-plugins/pkg/utils/cpuset"
 
@@ -163,6 +165,8 @@ type CPU interface {
 	NodeID() idset.ID
 	CoreID() idset.ID
 	ThreadCPUSet() cpuset.CPUSet
+	L3CacheID() idset.ID
+	L3CacheCPUSet() cpuset.CPUSet
 	BaseFrequency() uint64
 	FrequencyRange() CPUFreq
 	EPP() EPP
@@ -180,9 +184,12 @@ type cpu struct {
 	node     idset.ID    // node id
 	core     idset.ID    // core id
 	threads  idset.IDSet // sibling/hyper-threads
+	l3       idset.ID    // last level cache id (lowest CPU id sharing it)
+	l3cpus   idset.IDSet // CPUs sharing the last level cache
 	baseFreq uint64      // CPU base frequency
 	freq     CPUFreq     // CPU frequencies
 	epp      EPP         // Energy Performance Preference from cpufreq governor
+	eppOnce  sync.Once   // discover EPP once, on first use
 	online   bool        // whether this CPU is online
 	isolated bool        // whether this CPU is isolated
 	sstClos  int         // SST-CP CLOS the CPU is associated with
@@ -208,9 +215,10 @@ const (
 
 // MemInfo contains data read from a NUMA node meminfo file.
 type MemInfo struct {
-	MemTotal uint64
-	MemFree  uint64
-	MemUsed  uint64
+	MemTotal       uint64
+	MemFree        uint64
+	MemUsed        uint64
+	MemReclaimable uint64 // inactive page cache and reclaimable slab
 }
 
 // CPU cache.
@@ -268,10 +276,30 @@ func DiscoverSystemAt(path string, args ...DiscoveryFlag) (System, error) {
 		offline: idset.NewIDSet(),
 	}
 
+	// Only snapshot discovery which covers the full CPU and NUMA topology.
+	fingerprint := ""
+	if snapshotFile != "" && (flags&(DiscoverCPUTopology|DiscoverSst)) != 0 {
+		fingerprint = sys.fingerprint(flags &^ DiscoverCache)
+		if err := sys.restoreSnapshot(snapshotFile, fingerprint); err != nil {
+			if !os.IsNotExist(err) {
+				sys.Info("not using cached topology: %v", err)
+			}
+		} else {
+			sys.Info("using cached topology from %s", snapshotFile)
+			fingerprint = ""
+		}
+	}
+
 	if err := sys.Discover(flags); err != nil {
 		return nil, err
 	}
 
+	if fingerprint != "" {
+		if err := sys.saveSnapshot(snapshotFile, fingerprint); err != nil {
+			sys.Warn("failed to cache discovered topology: %v", err)
+		}
+	}
+
 	return sys, nil
 }
 
@@ -352,9 +380,9 @@ func (sys *system) Discover(flags DiscoveryFlag) error {
 			sys.Debug("       node: %d", cpu.node)
 			sys.Debug("       core: %d", cpu.core)
 			sys.Debug("    threads: %s", cpu.threads)
+			sys.Debug("   L3 cache: %d (%s)", cpu.l3, cpu.l3cpus)
 			sys.Debug("  base freq: %d", cpu.baseFreq)
 			sys.Debug("       freq: %d - %d", cpu.freq.min, cpu.freq.max)
-			sys.Debug("        epp: %d", cpu.epp)
 		}
 
 		sys.Debug("offline CPUs: %s", sys.offline)
@@ -571,7 +599,7 @@ func (sys *system) discoverCPUs() error {
 
 // Discover details of the given CPU.
 func (sys *system) discoverCPU(path string) error {
-	cpu := &cpu{path: path, id: getEnumeratedID(path), online: true, sstClos: -1}
+	cpu := &cpu{path: path, id: getEnumeratedID(path), online: true, sstClos: -1, l3: -1}
 
 	cpu.isolated = sys.isolated.Has(cpu.id)
 
@@ -590,6 +618,7 @@ func (sys *system) discoverCPU(path string) error {
 		if _, err := readSysfsEntry(path, "topology/thread_siblings_list", &cpu.threads, ","); err != nil {
 			return err
 		}
+		sys.discoverL3Cache(cpu)
 	} else {
 		sys.offline.Add(cpu.id)
 	}
@@ -603,9 +632,6 @@ func (sys *system) discoverCPU(path string) error {
 	if _, err := readSysfsEntry(path, "cpufreq/cpuinfo_max_freq", &cpu.freq.max); err != nil {
 		cpu.freq.max = 0
 	}
-	if _, err := readSysfsEntry(path, "cpufreq/energy_performance_preference", &cpu.epp); err != nil {
-		cpu.epp = EPPUnknown
-	}
 	if node, _ := filepath.Glob(filepath.Join(path, "node[0-9]*")); len(node) == 1 {
 		cpu.node = getEnumeratedID(node[0])
 	} else {
@@ -663,6 +689,20 @@ func (c *cpu) ThreadCPUSet() cpuset.CPUSet {
 	return CPUSetFromIDSet(c.threads)
 }
 
+// L3CacheID returns the id of the last level cache of this CPU (lowest CPU id
+// of all CPUs sharing the cache), or -1 if it is unknown.
+func (c *cpu) L3CacheID() idset.ID {
+	return c.l3
+}
+
+// L3CacheCPUSet returns the CPUSet for all CPUs sharing the last level cache.
+func (c *cpu) L3CacheCPUSet() cpuset.CPUSet {
+	if c.l3cpus == nil {
+		return cpuset.New()
+	}
+	return CPUSetFromIDSet(c.l3cpus)
+}
+
 // BaseFrequency returns the base frequency setting for this CPU.
 func (c *cpu) BaseFrequency() uint64 {
 	return c.baseFreq
@@ -673,8 +713,14 @@ func (c *cpu) FrequencyRange() CPUFreq {
 	return c.freq
 }
 
-// EPP returns the energy performance profile of this CPU.
+// EPP returns the energy performance profile of this CPU. It is discovered
+// on first use, since few users need it.
 func (c *cpu) EPP() EPP {
+	c.eppOnce.Do(func() {
+		if _, err := readSysfsEntry(c.path, "cpufreq/energy_performance_preference", &c.epp); err != nil {
+			c.epp = EPPUnknown
+		}
+	})
 	return c.epp
 }
 
@@ -895,24 +941,9 @@ func (n *node) DistanceFrom(id idset.ID) int {
 func (n *node) MemoryInfo() (*MemInfo, error) {
 	meminfo := filepath.Join(n.path, "meminfo")
 	buf := &MemInfo{}
-	err := ParseFileEntries(meminfo,
-		map[string]interface{}{
-			"MemTotal:": &buf.MemTotal,
-			"MemFree:":  &buf.MemFree,
-		},
-		func(line string) (string, string, error) {
-			fields := strings.Fields(strings.TrimSpace(line))
-			if len(fields) < 4 {
-				return "", "", sysfsError(meminfo, "failed to parse entry: '%s'", line)
-			}
-			key := fields[2]
-			val := fields[3]
-			if len(fields) == 5 {
-				val += " " + fields[4]
-			}
-			return key, val, nil
-		},
-	)
+	err := readFileWith(meminfo, func(data []byte) error {
+		return parseNodeMemInfo(meminfo, data, buf)
+	})
 
 	if err != nil {
 		return nil, err
@@ -1128,6 +1159,39 @@ func (sys *system) discoverCache(path string) error {
 	return nil
 }
 
+// Discover the last level cache of the given CPU.
+//
+// Notes:
+//
+//	Unlike discoverCache(), we don't rely on cache ids being unique. We
+//	only look for the highest level unified cache, usually L3, and take
+//	the lowest CPU id sharing it as its id. On chiplet CPUs there can be
+//	multiple such caches per die or NUMA node.
+func (sys *system) discoverL3Cache(cpu *cpu) {
+	entries, _ := filepath.Glob(filepath.Join(cpu.path, "cache/index[0-9]*"))
+
+	level := uint8(0)
+	for _, entry := range entries {
+		var (
+			l    uint8
+			kind string
+			cpus idset.IDSet
+		)
+		if _, err := readSysfsEntry(entry, "level", &l); err != nil || l <= level {
+			continue
+		}
+		if _, err := readSysfsEntry(entry, "type", &kind); err != nil || kind != string(UnifiedCache) {
+			continue
+		}
+		if _, err := readSysfsEntry(entry, "shared_cpu_list", &cpus, ","); err != nil || cpus.Size() == 0 {
+			continue
+		}
+		level = l
+		cpu.l3cpus = cpus
+		cpu.l3 = cpus.SortedMembers()[0]
+	}
+}
+
 // eppStrings initialized this way to better catch changes in the enum
 var eppStrings = func() [EPPUnknown]string {
 	var e [EPPUnknown]string
@@ -0,0 +1,80 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package sysfs
+
+import (
+	"testing"
+
+	"github.com/containers/nri-plugins/pkg/testutils"
+	idset "github.com/intel/goresctrl/pkg/utils"
+)
+
+func TestDiscoverSyntheticSystem(t *testing.T) {
+	tcases := []struct {
+		topology testutils.SysfsTopology
+		packages int
+		dies     int // per package
+		nodes    int // with CPUs
+		pmem     int
+		hbm      int
+	}{
+		{testutils.Sysfs32CPUs, 1, 1, 2, 0, 0},
+		{testutils.Sysfs256CPUs, 2, 2, 8, 2, 0},
+		{testutils.Sysfs1024CPUs, 4, 4, 32, 0, 8},
+	}
+	for _, tc := range tcases {
+		t.Run(tc.topology.String(), func(t *testing.T) {
+			root, err := testutils.GenerateSysfs(t.TempDir(), tc.topology)
+			if err != nil {
+				t.Fatalf("%v", err)
+			}
+			sys, err := DiscoverSystemAt(root)
+			if err != nil {
+				t.Fatalf("failed to discover synthetic system: %v", err)
+			}
+
+			if cnt := sys.CPUCount(); cnt != tc.topology.CPUCount() {
+				t.Errorf("expected %d CPUs, got %d", tc.topology.CPUCount(), cnt)
+			}
+			if cnt := sys.PackageCount(); cnt != tc.packages {
+				t.Errorf("expected %d packages, got %d", tc.packages, cnt)
+			}
+			if cnt := len(sys.Package(0).DieIDs()); cnt != tc.dies {
+				t.Errorf("expected %d dies per package, got %d", tc.dies, cnt)
+			}
+			if cnt := sys.ThreadCount(); cnt != tc.topology.ThreadsPerCore {
+				t.Errorf("expected %d threads per core, got %d", tc.topology.ThreadsPerCore, cnt)
+			}
+
+			count := map[MemoryType]int{}
+			for _, id := range sys.NodeIDs() {
+				count[sys.Node(id).GetMemoryType()]++
+			}
+			if count[MemoryTypeDRAM] != tc.nodes || count[MemoryTypePMEM] != tc.pmem || count[MemoryTypeHBM] != tc.hbm {
+				t.Errorf("expected %d DRAM, %d PMEM and %d HBM nodes, got %d, %d and %d",
+					tc.nodes, tc.pmem, tc.hbm, count[MemoryTypeDRAM], count[MemoryTypePMEM], count[MemoryTypeHBM])
+			}
+
+			last := sys.CPU(idset.ID(tc.topology.CPUCount() - 1))
+			if last.PackageID() != idset.ID(tc.packages-1) || last.NodeID() != idset.ID(tc.nodes-1) {
+				t.Errorf("expected last CPU in package #%d, node #%d, got #%d, #%d",
+					tc.packages-1, tc.nodes-1, last.PackageID(), last.NodeID())
+			}
+			if size := last.L3CacheCPUSet().Size(); size != tc.topology.CPUCount()/tc.packages/tc.dies {
+				t.Errorf("expected a last level cache per die, got one of %d CPUs", size)
+			}
+		})
+	}
+}
@@ -0,0 +1,348 @@
+// Copyright The NRI Plugins Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package testutils
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+)
+
+// SysfsTopology describes a synthetic system for GenerateSysfs. CPUs are
+// enumerated the way Linux usually does: first threads of all cores first,
+// then their hyperthread siblings. NUMA nodes with CPUs are enumerated in
+// package, die order, followed by the CPU-less PMEM, then HBM nodes.
+type SysfsTopology struct {
+	Packages       int    // number of CPU packages (sockets)
+	DiesPerPackage int    // number of dies per package
+	NodesPerDie    int    // number of NUMA nodes with CPUs per die
+	CoresPerNode   int    // number of cores per NUMA node
+	ThreadsPerCore int    // number of hyperthreads per core
+	PmemNodes      int    // number of CPU-less PMEM nodes per package
+	HbmNodes       int    // number of CPU-less HBM nodes per package
+	NodeMemory     uint64 // DRAM per NUMA node with CPUs, 16G if omitted
+}
+
+// Synthetic topologies used by scaling benchmarks.
+var (
+	// Sysfs32CPUs is a single-socket desktop-class system.
+	Sysfs32CPUs = SysfsTopology{
+		Packages:       1,
+		DiesPerPackage: 1,
+		NodesPerDie:    2,
+		CoresPerNode:   8,
+		ThreadsPerCore: 2,
+	}
+	// Sysfs256CPUs is a two-socket, multi-die server with PMEM.
+	Sysfs256CPUs = SysfsTopology{
+		Packages:       2,
+		DiesPerPackage: 2,
+		NodesPerDie:    2,
+		CoresPerNode:   16,
+		ThreadsPerCore: 2,
+		PmemNodes:      1,
+	}
+	// Sysfs1024CPUs is a four-socket, sub-NUMA clustered server with HBM.
+	Sysfs1024CPUs = SysfsTopology{
+		Packages:       4,
+		DiesPerPackage: 4,
+		NodesPerDie:    2,
+		CoresPerNode:   16,
+		ThreadsPerCore: 2,
+		HbmNodes:       2,
+	}
+)
+
+const (
+	defaultNodeMemory = 16 << 30
+	sysfsCPUPath      = "devices/system/cpu"
+	sysfsNodePath     = "devices/system/node"
+)
+
+// CPUCount returns the number of CPUs in the topology.
+func (t SysfsTopology) CPUCount() int {
+	return t.coreCount() * t.ThreadsPerCore
+}
+
+// String returns a short description of the topology.
+func (t SysfsTopology) String() string {
+	return fmt.Sprintf("%dcpus", t.CPUCount())
+}
+
+func (t SysfsTopology) coreCount() int {
+	return t.Packages * t.DiesPerPackage * t.NodesPerDie * t.CoresPerNode
+}
+
+func (t SysfsTopology) cpuNodeCount() int {
+	return t.Packages * t.DiesPerPackage * t.NodesPerDie
+}
+
+// sysfsNode is a NUMA node of a synthetic system.
+type sysfsNode struct {
+	id   int
+	pkg  int
+	die  int    // -1 for CPU-less nodes
+	kind string // "DRAM", "PMEM" or "HBM"
+	cpus []int
+	mem  uint64
+}
+
+// GenerateSysfs generates a synthetic sysfs tree for the given topology under
+// dir. It returns the path of the generated tree, suitable for passing to
+// sysfs.DiscoverSystemAt().
+func GenerateSysfs(dir string, t SysfsTopology) (string, error) {
+	if t.Packages < 1 || t.DiesPerPackage < 1 || t.NodesPerDie < 1 || t.CoresPerNode < 1 || t.ThreadsPerCore < 1 {
+		return "", fmt.Errorf("invalid synthetic topology %+v", t)
+	}
+	if t.NodeMemory == 0 {
+		t.NodeMemory = defaultNodeMemory
+	}
+
+	root := filepath.Join(dir, "sys")
+	g := &sysfsGenerator{root: root}
+
+	nodes := sysfsNodes(t)
+	cores := t.coreCount()
+	coresPerDie := t.NodesPerDie * t.CoresPerNode
+	coresPerPkg := t.DiesPerPackage * coresPerDie
+
+	cpuPath := sysfsCPUPath
+	all := fmt.Sprintf("0-%d", t.CPUCount()-1)
+	g.write(filepath.Join(cpuPath, "online"), all)
+	g.write(filepath.Join(cpuPath, "present"), all)
+	g.write(filepath.Join(cpuPath, "possible"), all)
+	g.write(filepath.Join(cpuPath, "isolated"), "")
+
+	for core := 0; core < cores; core++ {
+		var (
+			pkg      = core / coresPerPkg
+			die      = core % coresPerPkg / coresPerDie
+			node     = core / t.CoresPerNode
+			siblings = make([]int, 0, t.ThreadsPerCore)
+			dieCpus  = []int{}
+			pkgCpus  = []int{}
+		)
+		for thread := 0; thread < t.ThreadsPerCore; thread++ {
+			siblings = append(siblings, thread*cores+core)
+		}
+		for c := 0; c < coresPerDie; c++ {
+			for thread := 0; thread < t.ThreadsPerCore; thread++ {
+				dieCpus = append(dieCpus, thread*cores+(pkg*coresPerPkg+die*coresPerDie+c))
+			}
+		}
+		for c := 0; c < coresPerPkg; c++ {
+			for thread := 0; thread < t.ThreadsPerCore; thread++ {
+				pkgCpus = append(pkgCpus, thread*cores+(pkg*coresPerPkg+c))
+			}
+		}
+
+		for _, id := range siblings {
+			path := filepath.Join(cpuPath, "cpu"+strconv.Itoa(id))
+			g.write(filepath.Join(path, "online"), "1")
+			g.write(filepath.Join(path, "topology/physical_package_id"), strconv.Itoa(pkg))
+			g.write(filepath.Join(path, "topology/die_id"), strconv.Itoa(die))
+			g.write(filepath.Join(path, "topology/core_id"), strconv.Itoa(core%coresPerPkg))
+			g.write(filepath.Join(path, "topology/thread_siblings_list"), cpuList(siblings))
+			g.write(filepath.Join(path, "topology/core_cpus_list"), cpuList(siblings))
+			g.write(filepath.Join(path, "topology/die_cpus_list"), cpuList(dieCpus))
+			g.write(filepath.Join(path, "topology/core_siblings_list"), cpuList(pkgCpus))
+			g.write(filepath.Join(path, "topology/package_cpus_list"), cpuList(pkgCpus))
+			g.write(filepath.Join(path, "cpufreq/base_frequency"), "2100000")
+			g.write(filepath.Join(path, "cpufreq/cpuinfo_min_freq"), "800000")
+			g.write(filepath.Join(path, "cpufreq/cpuinfo_max_freq"), "3500000")
+			g.cache(path, 0, 1, "Data", core, siblings, "48K")
+			g.cache(path, 1, 1, "Instruction", core, siblings, "32K")
+			g.cache(path, 2, 2, "Unified", core, siblings, "2048K")
+			g.cache(path, 3, 3, "Unified", pkg*t.DiesPerPackage+die, dieCpus, "32768K")
+			g.link(filepath.Join(path, "node"+strconv.Itoa(node)),
+				filepath.Join("..", "..", "node", "node"+strconv.Itoa(node)))
+		}
+	}
+
+	nodePath := sysfsNodePath
+	normal, memory := []int{}, []int{}
+	for _, n := range nodes {
+		path := filepath.Join(nodePath, "node"+strconv.Itoa(n.id))
+		g.write(filepath.Join(path, "cpulist"), cpuList(n.cpus))
+		g.write(filepath.Join(path, "distance"), nodeDistances(n, nodes))
+		g.write(filepath.Join(path, "meminfo"), nodeMemInfo(n))
+		if n.kind != "PMEM" {
+			normal = append(normal, n.id)
+		}
+		memory = append(memory, n.id)
+	}
+	g.write(filepath.Join(nodePath, "online"), cpuList(memory))
+	g.write(filepath.Join(nodePath, "possible"), cpuList(memory))
+	g.write(filepath.Join(nodePath, "has_cpu"), fmt.Sprintf("0-%d", t.cpuNodeCount()-1))
+	g.write(filepath.Join(nodePath, "has_memory"), cpuList(memory))
+	g.write(filepath.Join(nodePath, "has_normal_memory"), cpuList(normal))
+
+	if g.err != nil {
+		return "", fmt.Errorf("failed to generate synthetic sysfs for %+v: %w", t, g.err)
+	}
+
+	return root, nil
+}
+
+// sysfsGenerator writes sysfs entries, remembering the first error.
+type sysfsGenerator struct {
+	root string
+	err  error
+}
+
+func (g *sysfsGenerator) write(entry, content string) {
+	if g.err != nil {
+		return
+	}
+	path := filepath.Join(g.root, entry)
+	if g.err = os.MkdirAll(filepath.Dir(path), 0o755); g.err != nil {
+		return
+	}
+	g.err = os.WriteFile(path, []byte(content+"\n"), 0o644)
+}
+
+func (g *sysfsGenerator) link(entry, target string) {
+	if g.err != nil {
+		return
+	}
+	path := filepath.Join(g.root, entry)
+	if g.err = os.MkdirAll(filepath.Dir(path), 0o755); g.err != nil {
+		return
+	}
+	g.err = os.Symlink(target, path)
+}
+
+func (g *sysfsGenerator) cache(cpuPath string, index, level int, kind string, id int, cpus []int, size string) {
+	path := filepath.Join(cpuPath, "cache", "index"+strconv.Itoa(index))
+	g.write(filepath.Join(path, "id"), strconv.Itoa(id))
+	g.write(filepath.Join(path, "level"), strconv.Itoa(level))
+	g.write(filepath.Join(path, "type"), kind)
+	g.write(filepath.Join(path, "shared_cpu_list"), cpuList(cpus))
+	g.write(filepath.Join(path, "size"), size)
+}
+
+// sysfsNodes returns the NUMA nodes of the topology.
+func sysfsNodes(t SysfsTopology) []*sysfsNode {
+	var (
+		nodes = []*sysfsNode{}
+		cores = t.coreCount()
+	)
+
+	for id := 0; id < t.cpuNodeCount(); id++ {
+		n := &sysfsNode{
+			id:   id,
+			pkg:  id / (t.DiesPerPackage * t.NodesPerDie),
+			die:  id / t.NodesPerDie % t.DiesPerPackage,
+			kind: "DRAM",
+			mem:  t.NodeMemory,
+		}
+		for core := id * t.CoresPerNode; core < (id+1)*t.CoresPerNode; core++ {
+			for thread := 0; thread < t.ThreadsPerCore; thread++ {
+				n.cpus = append(n.cpus, thread*cores+core)
+			}
+		}
+		nodes = append(nodes, n)
+	}
+
+	// Memory type of CPU-less nodes is told apart by size: HBM nodes have
+	// less, PMEM nodes more memory than DRAM nodes on average.
+	for _, special := range []struct {
+		kind  string
+		count int
+		mem   uint64
+	}{
+		{"PMEM", t.PmemNodes, 4 * t.NodeMemory},
+		{"HBM", t.HbmNodes, t.NodeMemory / 4},
+	} {
+		for pkg := 0; pkg < t.Packages; pkg++ {
+			for i := 0; i < special.count; i++ {
+				nodes = append(nodes, &sysfsNode{
+					id:   len(nodes),
+					pkg:  pkg,
+					die:  -1,
+					kind: special.kind,
+					mem:  special.mem,
+				})
+			}
+		}
+	}
+
+	return nodes
+}
+
+// nodeDistances returns the distance entry of a NUMA node.
+func nodeDistances(n *sysfsNode, nodes []*sysfsNode) string {
+	distances := make([]string, 0, len(nodes))
+	for _, o := range nodes {
+		var d int
+		switch {
+		case o.id == n.id:
+			d = 10
+		case n.kind == "PMEM" || o.kind == "PMEM":
+			d = 17
+		case n.kind == "HBM" || o.kind == "HBM":
+			d = 13
+		case o.die == n.die && o.pkg == n.pkg:
+			d = 11
+		default:
+			d = 12
+		}
+		if o.id != n.id && o.pkg != n.pkg {
+			d += 10
+		}
+		distances = append(distances, strconv.Itoa(d))
+	}
+	return strings.Join(distances, " ")
+}
+
+// nodeMemInfo returns the meminfo entry of a NUMA node.
+func nodeMemInfo(n *sysfsNode) string {
+	var (
+		total = n.mem >> 10
+		free  = total / 10 * 9
+		cache = total / 20
+	)
+	return strings.Join([]string{
+		fmt.Sprintf("Node %d MemTotal:       %d kB", n.id, total),
+		fmt.Sprintf("Node %d MemFree:        %d kB", n.id, free),
+		fmt.Sprintf("Node %d MemUsed:        %d kB", n.id, total-free),
+		fmt.Sprintf("Node %d Inactive(file): %d kB", n.id, cache),
+		fmt.Sprintf("Node %d SReclaimable:   %d kB", n.id, cache/4),
+	}, "\n")
+}
+
+// cpuList formats IDs as a sysfs list of ranges, like 0-3,8-11.
+func cpuList(ids []int) string {
+	sorted := append([]int{}, ids...)
+	sort.Ints(sorted)
+
+	ranges := []string{}
+	for i := 0; i < len(sorted); {
+		j := i
+		for j+1 < len(sorted) && sorted[j+1] == sorted[j]+1 {
+			j++
+		}
+		if i == j {
+			ranges = append(ranges, strconv.Itoa(sorted[i]))
+		} else {
+			ranges = append(ranges, strconv.Itoa(sorted[i])+"-"+strconv.Itoa(sorted[j]))
+		}
+		i = j + 1
+	}
+	return strings.Join(ranges, ",")
+}